@@ -17,7 +17,6 @@ conan install . --output-folder=./build --build=missing --settings=compiler.cpps
 
 # Copy required files
 cp src/grammar.txt build/grammar.txt
-mkdir build/assets && cp assets/parser.dat build/assets/parser.dat
 
 # Build commands
 cd build
@@ -0,0 +1,388 @@
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+
+#include "lexer.h"
+#include "lrparser.h"
+#include "token_specs.h"
+
+// A bit of everything the lexer has to deal with: keywords, literals of every kind, operators and comments
+static const std::string SNIPPET = R"(\\ computes fibonacci numbers
+extern def printf(fmt: cstr, ...) -> int32 end
+
+def fib(n: int64) -> int64
+    if n < 2 then
+        return n
+    end
+    return fib(n - 1) + fib(n - 2)
+end
+
+def main() -> int32
+    let count: int64 := 0x1F
+    const scale: float64 := 1'000.5e-3_d
+    let flags: int8 := 0b1010 & 3 | ~1 ^ 2
+    let name: string := "fib \"numbers\""
+    let sep: char := ','
+    for i in 0 to count step 1 do
+        count += fib(i) ** 2 // 3 % 7
+        if count >= 1'000'000 && TRUE || !FALSE then break end
+    end
+    printf(c"%lld\n", count)
+    return 0
+end
+)";
+
+static std::string makeSource(size_t size) {
+    std::string source;
+    source.reserve(size + SNIPPET.size());
+
+    while (source.size() < size) {
+        source += SNIPPET;
+    }
+
+    return source;
+}
+
+static void BM_LexerConstruct(benchmark::State& state) {
+    auto specs = babelTokenSpecs();
+
+    for (auto _ : state) {
+        Lexer lexer("bench", specs);
+        benchmark::DoNotOptimize(lexer);
+    }
+}
+BENCHMARK(BM_LexerConstruct)->Unit(benchmark::kMillisecond);
+
+static void BM_LexerTokenize(benchmark::State& state) {
+    Lexer lexer("bench", babelTokenSpecs());
+    std::string source = makeSource(static_cast<size_t>(state.range(0)));
+    size_t tokens = 0;
+
+    for (auto _ : state) {
+        std::vector<Token> result = lexer.tokenize(source);
+        tokens = result.size();
+        benchmark::DoNotOptimize(result.data());
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * source.size()));
+    state.counters["tokens/s"] = benchmark::Counter(static_cast<double>(tokens), benchmark::Counter::kIsIterationInvariantRate);
+}
+BENCHMARK(BM_LexerTokenize)->Arg(16 << 10)->Arg(1 << 20)->Arg(16 << 20)->Unit(benchmark::kMillisecond);
+
+// Valid babel, so the parser benchmarks run through the whole input
+static const std::string PROGRAM = R"(\\ computes fibonacci numbers
+task fibonacci(n: int) => int do
+    if n <= 1 then
+        return n
+    end
+
+    return fibonacci(n - 1) + fibonacci(n - 2)
+end
+
+extern task printf(cstr, ...) => void
+let dial = 50
+dial += dial / 7 - 1
+if dial == 0 then
+    dial = fibonacci(dial)
+else
+    dial -= 1
+end
+printf(c"%d\n", fibonacci(dial))
+)";
+
+static std::string grammarText() {
+    std::ifstream in(BABEL_GRAMMAR_SOURCE);
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+
+    return transform_string(buffer.str());
+}
+
+static const Parser& benchParser() {
+    static const Parser parser = [] {
+        Grammar grammar(grammarText());
+        LRClosureTable closureTable(grammar);
+        return Parser(LRTable(closureTable));
+    }();
+
+    return parser;
+}
+
+static void BM_GrammarAnalysis(benchmark::State& state) {
+    std::string text = grammarText();
+
+    for (auto _ : state) {
+        Grammar grammar(text);
+        benchmark::DoNotOptimize(grammar.followSets);
+    }
+}
+BENCHMARK(BM_GrammarAnalysis)->Unit(benchmark::kMillisecond);
+
+static void BM_LRClosureTable(benchmark::State& state) {
+    Grammar grammar(grammarText());
+    size_t kernels = 0;
+
+    for (auto _ : state) {
+        LRClosureTable closureTable(grammar);
+        kernels = closureTable.kernels.size();
+        benchmark::DoNotOptimize(closureTable.kernels);
+    }
+
+    state.counters["kernels"] = static_cast<double>(kernels);
+}
+BENCHMARK(BM_LRClosureTable)->Unit(benchmark::kMillisecond);
+
+static void BM_ParserRecognize(benchmark::State& state) {
+    const Parser& parser = benchParser();
+    Lexer lexer("bench", babelTokenSpecs());
+
+    std::string source;
+    while (source.size() < static_cast<size_t>(state.range(0))) {
+        source += PROGRAM;
+    }
+
+    std::vector<Token> tokens = lexer.tokenize(source);
+    Lexer::handleComments(tokens);
+    Lexer::insertSemicolons(tokens);
+
+    if (!parser.recognize(tokens)) {
+        state.SkipWithError("benchmark program does not parse");
+        return;
+    }
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(parser.recognize(tokens));
+    }
+
+    state.counters["tokens/s"] = benchmark::Counter(static_cast<double>(tokens.size()), benchmark::Counter::kIsIterationInvariantRate);
+}
+BENCHMARK(BM_ParserRecognize)->Arg(16 << 10)->Arg(1 << 20)->Unit(benchmark::kMillisecond);
+
+// Same input as BM_ParserRecognize, the difference between the two is what the reductions and the AST cost
+static void BM_ParserReduce(benchmark::State& state) {
+    const Parser& parser = benchParser();
+    Lexer lexer("bench", babelTokenSpecs());
+
+    std::string source;
+    while (source.size() < static_cast<size_t>(state.range(0))) {
+        source += PROGRAM;
+    }
+
+    std::vector<Token> tokens = lexer.tokenize(source);
+    Lexer::handleComments(tokens);
+    Lexer::insertSemicolons(tokens);
+    CompilerContext Ctx("bench");
+
+    for (auto _ : state) {
+        std::variant<ParseTree, std::string> result = parser.parse(tokens, Ctx, state.range(1) != 0);
+        if (std::holds_alternative<std::string>(result)) {
+            state.SkipWithError("benchmark program does not parse");
+            return;
+        }
+        benchmark::DoNotOptimize(std::get<ParseTree>(result).ast);
+    }
+
+    state.counters["tokens/s"] = benchmark::Counter(static_cast<double>(tokens.size()), benchmark::Counter::kIsIterationInvariantRate);
+}
+BENCHMARK(BM_ParserReduce)->ArgNames({"bytes", "tree"})->ArgsProduct({{16 << 10, 1 << 20}, {0, 1}})->Unit(benchmark::kMillisecond);
+
+static void BM_LRTable(benchmark::State& state) {
+    Grammar grammar(grammarText());
+    LRClosureTable closureTable(grammar);
+    size_t states = 0;
+
+    for (auto _ : state) {
+        LRTable table(closureTable);
+        states = table.states.size();
+        benchmark::DoNotOptimize(table.states);
+    }
+
+    state.counters["states"] = static_cast<double>(states);
+}
+BENCHMARK(BM_LRTable)->Unit(benchmark::kMillisecond);
+
+// Programs of a given number of lines are made of copies of these, modeled on examples/fib.babel and
+// examples/aoc1_2025.babel. Names that copies would otherwise redefine end in _N_, which is replaced by
+// the number of the copy.
+static const std::string PROGRAM_PRELUDE = R"(extern task printd(int) => void
+extern task fopen(cstr, cstr) => *void
+extern task fscanf(*void, cstr, ...) => int
+extern task fclose(*void) => void
+extern task printf(cstr, int) => void
+)";
+
+static const std::string FIB_TEMPLATE = R"(task fibonacci_N_(n: int) => int do
+    if n <= 1 then
+        return n
+    end
+
+    return fibonacci_N_(n - 1) + fibonacci_N_(n - 2)
+end
+
+printd(fibonacci_N_(42))
+)";
+
+static const std::string AOC_TEMPLATE = R"(\\ the first day of the advent of code 2025
+task first_puzzle_N_() => void do
+    let fptr = fopen(c"input.txt", c"r")
+    let direction = 76
+    let distance: int = 0
+
+    \\ no type annotations needed
+    let dial = 50
+    let counter = 0
+
+    $loop_start_N_
+    if fscanf(fptr, c" %d%d", &direction, &distance) == 2 then
+        if direction == 76 then
+            dial = dial - distance + 100
+        else
+            dial += distance
+        end
+
+        dial %= 100
+        printf(c"%d\n", dial)
+        if dial == 0 then
+            counter += 1
+        end
+
+        goto loop_start_N_
+    end
+
+    fclose(fptr)
+    printf(c"We hit the 0 exactly %d times.\n", counter)
+end
+
+first_puzzle_N_()
+)";
+
+// Produces the program copy by copy as it is read, so even the largest inputs are never held in memory
+class GeneratedProgram : public std::streambuf {
+public:
+    explicit GeneratedProgram(size_t lines) : lines(lines) {
+        current = PROGRAM_PRELUDE;
+        written = std::ranges::count(current, '\n');
+        setg(current.data(), current.data(), current.data() + current.size());
+    }
+
+protected:
+    int_type underflow() override {
+        if (written >= lines) return traits_type::eof();
+
+        current = copy % 2 == 0 ? FIB_TEMPLATE : AOC_TEMPLATE;
+        std::string suffix = "_" + std::to_string(copy++);
+        for (size_t at = current.find("_N_"); at != std::string::npos; at = current.find("_N_", at + suffix.size())) {
+            current.replace(at, 3, suffix);
+        }
+
+        written += std::ranges::count(current, '\n');
+        setg(current.data(), current.data(), current.data() + current.size());
+        return traits_type::to_int_type(current.front());
+    }
+
+private:
+    size_t lines;
+    size_t written = 0;
+    size_t copy = 0;
+    std::string current;
+};
+
+static std::string generateProgram(size_t lines) {
+    GeneratedProgram program(lines);
+    std::istream in(&program);
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+
+    return buffer.str();
+}
+
+// The lexer as the driver runs it, reading the source in chunks. Memory stays flat however many lines there are.
+static void BM_TokenStream(benchmark::State& state) {
+    Lexer lexer("bench", babelTokenSpecs());
+    size_t tokens = 0;
+
+    for (auto _ : state) {
+        GeneratedProgram program(static_cast<size_t>(state.range(0)));
+        std::istream in(&program);
+        TokenStream stream(lexer, in);
+
+        tokens = 0;
+        while (stream.next()) tokens++;
+    }
+
+    state.counters["lines/s"] = benchmark::Counter(static_cast<double>(state.range(0)), benchmark::Counter::kIsIterationInvariantRate);
+    state.counters["tokens/s"] = benchmark::Counter(static_cast<double>(tokens), benchmark::Counter::kIsIterationInvariantRate);
+}
+BENCHMARK(BM_TokenStream)->RangeMultiplier(10)->Range(1'000, 10'000'000)->Unit(benchmark::kMillisecond);
+
+// Lexing, parsing and AST building of a source in memory, like a mapped file
+static void BM_ParseProgram(benchmark::State& state) {
+    const Parser& parser = benchParser();
+    Lexer lexer("bench", babelTokenSpecs());
+    std::string source = generateProgram(static_cast<size_t>(state.range(0)));
+
+    for (auto _ : state) {
+        CompilerContext Ctx("bench");
+        TokenStream tokens(lexer, source);
+        std::variant<ParseTree, std::string> result = parser.parse(tokens, Ctx, false);
+        if (std::holds_alternative<std::string>(result)) {
+            state.SkipWithError("generated program does not parse");
+            return;
+        }
+        benchmark::DoNotOptimize(std::get<ParseTree>(result).ast);
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * source.size()));
+    state.counters["lines/s"] = benchmark::Counter(static_cast<double>(state.range(0)), benchmark::Counter::kIsIterationInvariantRate);
+}
+BENCHMARK(BM_ParseProgram)->RangeMultiplier(10)->Range(1'000, 1'000'000)->Unit(benchmark::kMillisecond);
+
+// IR generation alone, every iteration parses into a fresh context untimed first
+static void BM_Codegen(benchmark::State& state) {
+    const Parser& parser = benchParser();
+    Lexer lexer("bench", babelTokenSpecs());
+    std::string source = generateProgram(static_cast<size_t>(state.range(0)));
+    size_t instructions = 0;
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        CompilerContext Ctx("bench");
+        TokenStream tokens(lexer, source);
+        std::variant<ParseTree, std::string> result = parser.parse(tokens, Ctx, false);
+        if (std::holds_alternative<std::string>(result) || !std::get<ParseTree>(result).ast) {
+            state.SkipWithError("generated program does not parse");
+            return;
+        }
+        state.ResumeTiming();
+
+        std::get<ParseTree>(result).ast->codegen(Ctx);
+
+        state.PauseTiming();
+        instructions = Ctx.Module->getInstructionCount();
+        state.ResumeTiming();
+    }
+
+    state.counters["lines/s"] = benchmark::Counter(static_cast<double>(state.range(0)), benchmark::Counter::kIsIterationInvariantRate);
+    state.counters["instructions"] = static_cast<double>(instructions);
+}
+BENCHMARK(BM_Codegen)->RangeMultiplier(10)->Range(1'000, 100'000)->Unit(benchmark::kMillisecond);
+
+static void BM_ParseTableLookup(benchmark::State& state) {
+    const ParseTable& table = benchParser().table;
+    uint32_t seed = 1;
+
+    for (auto _ : state) {
+        seed = seed * 1664525u + 1013904223u;
+        benchmark::DoNotOptimize(table.action(table.rowOf((seed >> 8) % table.numStates), (seed >> 20) % table.numSymbols));
+    }
+
+    state.counters["bytes"] = static_cast<double>(table.stateBase.size_bytes() + table.comb.size_bytes());
+}
+BENCHMARK(BM_ParseTableLookup);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,17 @@
+#include <stdio.h>
+
+static int array_sum(int rounds) {
+    int values[] = {3, 1, 4, 1, 5, 9, 2, 6, 5, 3, 5, 8, 9, 7, 9, 3};
+    int total = 0;
+    for (int round = 0; round < rounds; round += 1) {
+        for (int i = 0; i < 16; i++) {
+            total = total + (values[i] + round) % 7;
+        }
+    }
+    return total;
+}
+
+int main(void) {
+    fprintf(stderr, "%d\n", array_sum(5000000));
+    return 0;
+}
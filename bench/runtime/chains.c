@@ -0,0 +1,20 @@
+#include <stdbool.h>
+#include <stdio.h>
+
+static bool in_range(int x) {
+    return 100 < x && x < 200;
+}
+
+static int in_ranges(int n) {
+    int hits = 0;
+    for (int i = 0; i < n; i += 1) {
+        if (in_range(i % 1000))
+            hits += 1;
+    }
+    return hits;
+}
+
+int main(void) {
+    fprintf(stderr, "%d\n", in_ranges(100000000));
+    return 0;
+}
@@ -0,0 +1,13 @@
+#include <stdio.h>
+
+static int fib(int n) {
+    if (n < 2)
+        return n;
+
+    return fib(n - 1) + fib(n - 2);
+}
+
+int main(void) {
+    fprintf(stderr, "%d\n", fib(38));
+    return 0;
+}
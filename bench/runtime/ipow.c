@@ -0,0 +1,25 @@
+#include <stdio.h>
+
+static int ipow(int base, int exponent) {
+    int result = 1;
+    while (exponent > 0) {
+        if (exponent & 1)
+            result *= base;
+        base *= base;
+        exponent >>= 1;
+    }
+    return result;
+}
+
+static int power_sum(int n) {
+    int total = 0;
+    for (int i = 0; i < n; i += 1) {
+        total = (total + ipow(i % 10, i % 8)) % 1000003;
+    }
+    return total;
+}
+
+int main(void) {
+    fprintf(stderr, "%d\n", power_sum(50000000));
+    return 0;
+}
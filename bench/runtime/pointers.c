@@ -0,0 +1,20 @@
+#include <stdio.h>
+
+static int pointer_walk(int rounds) {
+    int values[] = {3, 1, 4, 1, 5, 9, 2, 6, 5, 3, 5, 8, 9, 7, 9, 3};
+    int total = 0;
+    int *cursor = values;
+    for (int round = 0; round < rounds; round += 1) {
+        cursor = values;
+        for (int i = 0; i < 16; i += 1) {
+            total = total + (*cursor + round) % 7;
+            cursor++;
+        }
+    }
+    return total;
+}
+
+int main(void) {
+    fprintf(stderr, "%d\n", pointer_walk(5000000));
+    return 0;
+}
@@ -0,0 +1,153 @@
+# Compiles every program in this directory with babel and its C equivalent with the C compiler, both at
+# the same optimization level, runs each a few times and reports how much slower the Babel build is.
+#
+#   cmake -DBABEL=<babel> -DCC=<c compiler> -DWORK_DIR=<dir> [-DOPT_LEVEL=2] [-DRUNS=3] -P run_runtime.cmake
+#
+# The table also goes to WORK_DIR/bench_runtime.csv, to compare runs over time. A program that fails to
+# compile or run, or prints something else than its C equivalent, fails the whole run.
+
+if(NOT BABEL OR NOT CC OR NOT WORK_DIR)
+    message(FATAL_ERROR "BABEL, CC and WORK_DIR are required")
+endif()
+
+if(NOT DEFINED OPT_LEVEL)
+    set(OPT_LEVEL 2)
+endif()
+
+if(NOT DEFINED RUNS)
+    set(RUNS 3)
+endif()
+
+file(MAKE_DIRECTORY ${WORK_DIR})
+file(GLOB programs ${CMAKE_CURRENT_LIST_DIR}/*.babel)
+list(SORT programs)
+
+# Best wall time of RUNS runs in microseconds, and what the program printed
+function(time_program executable out_micros out_output)
+    set(best "")
+    foreach(run RANGE 1 ${RUNS})
+        string(TIMESTAMP start "%s%f")
+        execute_process(COMMAND ${executable} OUTPUT_VARIABLE stdout ERROR_VARIABLE stderr RESULT_VARIABLE result)
+        string(TIMESTAMP end "%s%f")
+
+        if(NOT result EQUAL 0)
+            set(${out_micros} "" PARENT_SCOPE)
+            return()
+        endif()
+
+        math(EXPR elapsed "${end} - ${start}")
+        if(best STREQUAL "" OR elapsed LESS best)
+            set(best ${elapsed})
+        endif()
+    endforeach()
+
+    set(${out_micros} ${best} PARENT_SCOPE)
+    set(${out_output} "${stdout}${stderr}" PARENT_SCOPE)
+endfunction()
+
+# Microseconds as milliseconds with one decimal
+function(format_millis micros out)
+    math(EXPR tenths "(${micros} + 50) / 100")
+    math(EXPR whole "${tenths} / 10")
+    math(EXPR fraction "${tenths} % 10")
+    set(${out} "${whole}.${fraction}" PARENT_SCOPE)
+endfunction()
+
+# Pads text with spaces to width, on the left or, for a negative width, on the right
+function(pad text width out)
+    string(LENGTH "${text}" length)
+    if(width LESS 0)
+        math(EXPR missing "-${width} - ${length}")
+    else()
+        math(EXPR missing "${width} - ${length}")
+    endif()
+
+    set(padding "")
+    if(missing GREATER 0)
+        string(REPEAT " " ${missing} padding)
+    endif()
+
+    if(width LESS 0)
+        set(${out} "${text}${padding}" PARENT_SCOPE)
+    else()
+        set(${out} "${padding}${text}" PARENT_SCOPE)
+    endif()
+endfunction()
+
+set(csv "program,babel_us,c_us,slowdown\n")
+set(failed "")
+message("Runtime benchmarks at -O${OPT_LEVEL}, best of ${RUNS} runs")
+message("  Program          Babel ms        C ms  Slowdown")
+
+foreach(program ${programs})
+    get_filename_component(name ${program} NAME_WE)
+    set(babel_exe ${WORK_DIR}/${name}.babel.out)
+    set(c_exe ${WORK_DIR}/${name}.c.out)
+
+    execute_process(COMMAND ${BABEL} -O${OPT_LEVEL} --emit=exe -o ${babel_exe} ${program}
+                    WORKING_DIRECTORY ${WORK_DIR} OUTPUT_QUIET ERROR_VARIABLE babel_error RESULT_VARIABLE babel_result)
+    execute_process(COMMAND ${CC} -O${OPT_LEVEL} -o ${c_exe} ${CMAKE_CURRENT_LIST_DIR}/${name}.c
+                    ERROR_VARIABLE c_error RESULT_VARIABLE c_result)
+
+    # a failing program is reported and the others still run, the run fails at the end
+    if(NOT babel_result EQUAL 0 OR NOT EXISTS ${babel_exe})
+        string(STRIP "${babel_error}" babel_error)
+        string(REGEX REPLACE ".*\n" "" babel_error "${babel_error}")
+        message("  ${name}: babel failed to compile it: ${babel_error}")
+        list(APPEND failed ${name})
+        continue()
+    endif()
+
+    if(NOT c_result EQUAL 0)
+        message("  ${name}: ${CC} failed to compile it: ${c_error}")
+        list(APPEND failed ${name})
+        continue()
+    endif()
+
+    time_program(${babel_exe} babel_micros babel_output)
+    time_program(${c_exe} c_micros c_output)
+
+    if(babel_micros STREQUAL "" OR c_micros STREQUAL "")
+        message("  ${name}: a run failed")
+        list(APPEND failed ${name})
+        continue()
+    endif()
+
+    if(NOT babel_output STREQUAL c_output)
+        string(STRIP "${babel_output}" babel_output)
+        string(STRIP "${c_output}" c_output)
+        message("  ${name}: output differs, babel printed '${babel_output}', C printed '${c_output}'")
+        list(APPEND failed ${name})
+        continue()
+    endif()
+
+    if(c_micros EQUAL 0)
+        set(c_micros 1)
+    endif()
+
+    # slowdown in hundredths, cmake only does integer math
+    math(EXPR hundredths "(${babel_micros} * 100 + ${c_micros} / 2) / ${c_micros}")
+    math(EXPR whole "${hundredths} / 100")
+    math(EXPR fraction "${hundredths} % 100")
+    if(fraction LESS 10)
+        set(fraction "0${fraction}")
+    endif()
+
+    format_millis(${babel_micros} babel_millis)
+    format_millis(${c_micros} c_millis)
+
+    pad(${name} -14 name_column)
+    pad(${babel_millis} 11 babel_column)
+    pad(${c_millis} 11 c_column)
+    pad(${whole}.${fraction}x 10 slowdown_column)
+
+    message("  ${name_column}${babel_column} ${c_column}${slowdown_column}")
+    string(APPEND csv "${name},${babel_micros},${c_micros},${whole}.${fraction}\n")
+endforeach()
+
+file(WRITE ${WORK_DIR}/bench_runtime.csv "${csv}")
+
+if(failed)
+    list(JOIN failed ", " failed)
+    message(FATAL_ERROR "Runtime benchmarks failed: ${failed}")
+endif()
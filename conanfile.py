@@ -26,7 +26,7 @@ class BabelRecipe(ConanFile):
     languages = "C++"
 
     requires = "boost/[>=1.88.0]", "llvm-core/[>=19.1.7]"
-    test_requires = "gtest/[^1.11.0]"
+    test_requires = "gtest/[^1.11.0]", "benchmark/[^1.8.0]"
     generators = "CMakeDeps", "CMakeToolchain"
     build_policy = "missing"
     upload_policy = "skip"
@@ -0,0 +1,124 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <ranges>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump pointer allocator. Everything allocated from it stays put until the arena goes away and is then
+// released in one go. Objects that need a destructor get it run at that point, newest first.
+class Arena {
+public:
+    explicit Arena(size_t chunkSize = 64 * 1024) : chunkSize(chunkSize) {}
+
+    Arena(Arena&& that) noexcept
+        : chunkSize(that.chunkSize), chunks(std::move(that.chunks)), cursor(std::exchange(that.cursor, nullptr)), end(std::exchange(that.end, nullptr)),
+          cleanups(std::exchange(that.cleanups, nullptr)) {}
+
+    Arena& operator=(Arena&& that) noexcept {
+        if (this == &that) return *this;
+
+        destroyAll();
+        chunkSize = that.chunkSize;
+        chunks = std::move(that.chunks);
+        cursor = std::exchange(that.cursor, nullptr);
+        end = std::exchange(that.end, nullptr);
+        cleanups = std::exchange(that.cleanups, nullptr);
+        return *this;
+    }
+
+    ~Arena() {
+        destroyAll();
+    }
+
+    void* allocate(size_t size, size_t alignment) {
+        std::byte* aligned = alignUp(cursor, alignment);
+
+        // the padding alone can run past the end of a chunk that ends unaligned
+        if (cursor == nullptr || aligned > end || size > static_cast<size_t>(end - aligned)) {
+            grow(size + alignment);
+            aligned = alignUp(cursor, alignment);
+        }
+
+        cursor = aligned + size;
+        return aligned;
+    }
+
+    template<typename T, typename... Args>
+    T* make(Args&&... args) {
+        T* object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            cleanups = new (allocate(sizeof(Cleanup), alignof(Cleanup))) Cleanup{[](void* p) { static_cast<T*>(p)->~T(); }, object, cleanups};
+        }
+
+        return object;
+    }
+
+    // Copies a sized range into one contiguous block, elements are never destroyed
+    template<std::ranges::sized_range R, typename T = std::ranges::range_value_t<R>>
+    std::span<T> copy(R&& values) {
+        static_assert(std::is_trivially_copyable_v<T>, "copied elements are never destroyed");
+        size_t count = std::ranges::size(values);
+        if (count == 0) return {};
+
+        T* data = static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+        std::uninitialized_copy(std::ranges::begin(values), std::ranges::end(values), data);
+        return {data, count};
+    }
+
+    // bytes reserved from the system, not what is in use
+    size_t capacity() const {
+        size_t total = 0;
+        for (const Chunk& chunk : chunks) total += chunk.size;
+        return total;
+    }
+
+private:
+    struct Chunk {
+        std::unique_ptr<std::byte[]> memory;
+        size_t size;
+    };
+
+    // intrusive list of pending destructors, lives in the arena itself
+    struct Cleanup {
+        void (*destroy)(void*);
+        void* object;
+        Cleanup* next;
+    };
+
+    size_t chunkSize;
+    std::vector<Chunk> chunks;
+    std::byte* cursor = nullptr;
+    std::byte* end = nullptr;
+    Cleanup* cleanups = nullptr;
+
+    void destroyAll() {
+        for (Cleanup* cleanup = std::exchange(cleanups, nullptr); cleanup != nullptr; cleanup = cleanup->next) {
+            cleanup->destroy(cleanup->object);
+        }
+    }
+
+    static std::byte* alignUp(std::byte* pointer, size_t alignment) {
+        auto address = reinterpret_cast<uintptr_t>(pointer);
+        return pointer + ((alignment - address % alignment) % alignment);
+    }
+
+    void grow(size_t minimum) {
+        // chunks end aligned, so only oversized requests can leave a chunk with unaligned space
+        constexpr size_t granule = alignof(std::max_align_t);
+        size_t size = (std::max(chunkSize, minimum) + granule - 1) / granule * granule;
+        chunks.push_back({std::make_unique_for_overwrite<std::byte[]>(size), size});
+        cursor = chunks.back().memory.get();
+        end = cursor + size;
+    }
+};
+
+#endif /* ARENA_H */
@@ -11,6 +11,7 @@
 #include "llvm/IR/Verifier.h"
 #include <memory>
 #include <numeric>
+#include <span>
 #include <string>
 #include <map>
 #include <iostream>
@@ -21,7 +22,7 @@
 #include "util.hpp"
 #include "typing.h"
 
-#define GLOBAL_SCOPE Builder->GetInsertBlock()->getParent()->getName().starts_with("__global_main")
+#define GLOBAL_SCOPE Ctx.Builder->GetInsertBlock()->getParent()->getName().starts_with("__global_main")
 
 struct GlobalSymbol {
     llvm::GlobalVariable* val;
@@ -48,25 +49,50 @@ struct LoopInfo {
     llvm::BasicBlock* __break__;
 };
 
-// static std::unique_ptr<llvm::LLVMContext> TheContext;
-static std::unique_ptr<llvm::Module> TheModule;
-// static std::unique_ptr<llvm::IRBuilder<>> Builder;
-static std::map<std::string, LocalSymbol> NamedValues;
-static std::map<std::string, GlobalSymbol> GlobalValues;
-static std::map<std::string, llvm::BasicBlock*> LabelTable;
-static std::map<std::string, LoopInfo> LoopTable = {{".active", {nullptr, nullptr}}};
-static std::map<std::string, TaskTypeInfo> TaskTable;
-static std::map<std::string, bool> PolymorphTable;
+// Everything a compilation unit is parsed and generated with. Nothing in here is shared, so units compile
+// concurrently as long as each has a CompilerContext of its own, and the parser and every codegen take it
+// explicitly. The symbol tables outlive the module, a new one is opened for every REPL line.
+struct CompilerContext {
+    std::unique_ptr<llvm::LLVMContext> Context;
+    std::unique_ptr<llvm::Module> Module;
+    std::unique_ptr<llvm::IRBuilder<>> Builder;
+    std::map<std::string, LocalSymbol> NamedValues;
+    std::map<std::string, GlobalSymbol> GlobalValues;
+    std::map<std::string, llvm::BasicBlock*> LabelTable;
+    std::map<std::string, LoopInfo> LoopTable = {{".active", {nullptr, nullptr}}};
+    std::map<std::string, TaskTypeInfo> TaskTable;
+    std::map<std::string, bool> PolymorphTable;
+    TypeArena Arena;
+
+    explicit CompilerContext(const std::string &ModuleName) {
+        openModule(ModuleName);
+    }
+
+    // A fresh module in a context of its own, so the JIT can take both over once codegen is done
+    void openModule(const std::string &ModuleName) {
+        // whatever the JIT did not take over goes first, it still refers to the old context
+        Builder.reset();
+        Module.reset();
+        Context = std::make_unique<llvm::LLVMContext>();
+        Module = std::make_unique<llvm::Module>(ModuleName, *Context);
+        Builder = std::make_unique<llvm::IRBuilder<>>(*Context);
+    }
+};
+
+// AST nodes are allocated in the arena of the ParseTree they were parsed into and live as long as it does,
+// so nodes only point at each other and child lists are spans into the same arena
+class BaseAST;
+using ASTList = std::span<BaseAST* const>;
 
 // Base class for all expression node
 class BaseAST {
     public:
         virtual ~BaseAST() = default;
-        virtual llvm::Value *codegen() = 0;
-        virtual llvm::Constant *codegenComptime() { babel_panic("Cannot generate value at compile time"); }
-        virtual llvm::Value *requireLValue() { babel_panic("No lvalue available for this AST node"); }
-        virtual BabelType getType() const { babel_panic("getType() not supported for this AST node"); }
-        virtual bool isComptimeAssignable() const { babel_panic("isComptimeAssignable() not supported for this AST node"); }
+        virtual llvm::Value *codegen(CompilerContext &Ctx) = 0;
+        virtual llvm::Constant *codegenComptime(CompilerContext &Ctx) { babel_panic("Cannot generate value at compile time"); }
+        virtual llvm::Value *requireLValue(CompilerContext &Ctx) { babel_panic("No lvalue available for this AST node"); }
+        virtual BabelType getType(CompilerContext &Ctx) const { babel_panic("getType() not supported for this AST node"); }
+        virtual bool isComptimeAssignable(CompilerContext &Ctx) const { babel_panic("isComptimeAssignable() not supported for this AST node"); }
         virtual bool isStatementLike() const { return false; };
 };
 
@@ -80,28 +106,28 @@ class VariableAST : public BaseAST {
     bool requiresLValue = false;
 
     public:
-        VariableAST(const std::string &Name, const std::optional<BabelType>& Type, const bool isConst, const bool isDecl, const bool isComptime) : Name(Name), Type(Type), isConst(isConst), isDecl(isDecl), isComptime(isComptime) {
-           if (GlobalValues.contains(Name)) { this->isConst = GlobalValues.at(Name).isConstant; this->isComptime = GlobalValues.at(Name).isComptime; }
-           else if (Type.has_value()) { insertSymbol(); }
+        VariableAST(CompilerContext &Ctx, const std::string &Name, const std::optional<BabelType>& Type, const bool isConst, const bool isDecl, const bool isComptime) : Name(Name), Type(Type), isConst(isConst), isDecl(isDecl), isComptime(isComptime) {
+           if (Ctx.GlobalValues.contains(Name)) { this->isConst = Ctx.GlobalValues.at(Name).isConstant; this->isComptime = Ctx.GlobalValues.at(Name).isComptime; }
+           else if (Type.has_value()) { insertSymbol(Ctx); }
             /*  if (isDecl) { insertSymbol(); }
-            // else { this->isConst = GlobalValues.at(Name).isConstant; this->isComptime = GlobalValues.at(Name).isComptime; }
-            else if (GlobalValues.contains(Name)) { this->isConst = GlobalValues.at(Name).isConstant; this->isComptime = GlobalValues.at(Name).isComptime; }
+            // else { this->isConst = Ctx.GlobalValues.at(Name).isConstant; this->isComptime = Ctx.GlobalValues.at(Name).isComptime; }
+            else if (Ctx.GlobalValues.contains(Name)) { this->isConst = Ctx.GlobalValues.at(Name).isConstant; this->isComptime = Ctx.GlobalValues.at(Name).isComptime; }
             // TODO: each variable auto updates itself so the node knows wether its variable is constant or not
             // this allows for a significant simplification of the handleAssignment method */
         }
-        void insertSymbol() const;
-        static void insertSymbol(const std::string& Name, BabelType type, const bool isConst, const bool isComptime);
+        void insertSymbol(CompilerContext &Ctx) const;
+        static void insertSymbol(CompilerContext &Ctx, const std::string& Name, BabelType type, const bool isConst, const bool isComptime);
         std::string getName() const { return Name; }
         bool getConstness() const { return isConst; }
         bool getDecl() const { return isDecl; }
         bool hasComptimeVal() const { return isComptime; }
-        BabelType getType() const override;
-        bool isComptimeAssignable() const override { return GlobalValues.at(Name).isComptime; }
-        llvm::Value *codegen() override;
-        llvm::Constant *codegenComptime() override;
-        llvm::Value *requireLValue() override {
+        BabelType getType(CompilerContext &Ctx) const override;
+        bool isComptimeAssignable(CompilerContext &Ctx) const override { return Ctx.GlobalValues.contains(Name) && Ctx.GlobalValues.at(Name).isComptime; }
+        llvm::Value *codegen(CompilerContext &Ctx) override;
+        llvm::Constant *codegenComptime(CompilerContext &Ctx) override;
+        llvm::Value *requireLValue(CompilerContext &Ctx) override {
             requiresLValue = true;
-            llvm::Value* lVal = codegen();
+            llvm::Value* lVal = codegen(Ctx);
             requiresLValue = false;
             assert(lVal->getType()->isPointerTy() && "requireLValue returned non-pointer");
             return lVal;
@@ -113,10 +139,10 @@ class BooleanAST : public BaseAST {
 
     public:
         explicit BooleanAST(std::string_view value) : Val(value == "TRUE" ? 1 : 0) {}
-        llvm::Value *codegen() override { return codegenComptime(); }
-        llvm::Constant *codegenComptime() override;
-        BabelType getType() const override { return BabelType::Boolean(); }
-        bool isComptimeAssignable() const override { return true; }
+        llvm::Value *codegen(CompilerContext &Ctx) override { return codegenComptime(Ctx); }
+        llvm::Constant *codegenComptime(CompilerContext &Ctx) override;
+        BabelType getType(CompilerContext &Ctx) const override { return BabelType::Boolean(); }
+        bool isComptimeAssignable(CompilerContext &Ctx) const override { return true; }
 };
 
 // class for numeric literals which are integers
@@ -154,10 +180,10 @@ class IntegerAST : public BaseAST {
                 std::tie(Val, Type) = parseInt(s, 0, 10);
             }
         }
-        llvm::Value *codegen() override { return codegenComptime(); }
-        llvm::Constant *codegenComptime() override;
-        BabelType getType() const override { return Type; }
-        bool isComptimeAssignable() const override { return true; }
+        llvm::Value *codegen(CompilerContext &Ctx) override { return codegenComptime(Ctx); }
+        llvm::Constant *codegenComptime(CompilerContext &Ctx) override;
+        BabelType getType(CompilerContext &Ctx) const override { return Type; }
+        bool isComptimeAssignable(CompilerContext &Ctx) const override { return true; }
 };
 
 class CharacterAST : public BaseAST {
@@ -165,10 +191,10 @@ class CharacterAST : public BaseAST {
 
     public:
         explicit CharacterAST(const char Val) : Val(Val) {}
-        llvm::Value *codegen() override { return codegenComptime(); }
-        llvm::Constant *codegenComptime() override;
-        BabelType getType() const override { return BabelType::Character(); }
-        bool isComptimeAssignable() const override { return true; }
+        llvm::Value *codegen(CompilerContext &Ctx) override { return codegenComptime(Ctx); }
+        llvm::Constant *codegenComptime(CompilerContext &Ctx) override;
+        BabelType getType(CompilerContext &Ctx) const override { return BabelType::Character(); }
+        bool isComptimeAssignable(CompilerContext &Ctx) const override { return true; }
 };
 
 class CStringAST : public BaseAST {
@@ -176,10 +202,10 @@ class CStringAST : public BaseAST {
 
     public:
         explicit CStringAST(const std::string& Val) : Val(Val) {}
-        llvm::Value *codegen() override { return codegenComptime(); }
-        llvm::Constant *codegenComptime() override;
-        BabelType getType() const override { return BabelType::CString(); }
-        bool isComptimeAssignable() const override { return true; }
+        llvm::Value *codegen(CompilerContext &Ctx) override { return codegenComptime(Ctx); }
+        llvm::Constant *codegenComptime(CompilerContext &Ctx) override;
+        BabelType getType(CompilerContext &Ctx) const override { return BabelType::CString(); }
+        bool isComptimeAssignable(CompilerContext &Ctx) const override { return true; }
 };
 
 // class for numeric literals which are floating points
@@ -230,45 +256,45 @@ class FloatingPointAST : public BaseAST {
                 Type = fpTypeFromSuffix(suffix);
             }
         }
-        llvm::Value *codegen() override { return codegenComptime(); }
-        llvm::Constant *codegenComptime() override;
-        BabelType getType() const override { return Type; }
-        bool isComptimeAssignable() const override { return true; }
+        llvm::Value *codegen(CompilerContext &Ctx) override { return codegenComptime(Ctx); }
+        llvm::Constant *codegenComptime(CompilerContext &Ctx) override;
+        BabelType getType(CompilerContext &Ctx) const override { return Type; }
+        bool isComptimeAssignable(CompilerContext &Ctx) const override { return true; }
 };
 
 class ArrayAST : public BaseAST {
-    const std::deque<std::unique_ptr<BaseAST>> Val;
+    const ASTList Val;
     const size_t Size;
     const BabelType Inner;
 
     public:
         // arbitrary type for empty arrays
-        explicit ArrayAST(std::deque<std::unique_ptr<BaseAST>> _Val) : Val(std::move(_Val)), Size(Val.size()), Inner(Size > 0 ? Val.front()->getType() : BabelType::Int()) {
+        ArrayAST(CompilerContext &Ctx, ASTList _Val) : Val(_Val), Size(Val.size()), Inner(Size > 0 ? Val.front()->getType(Ctx) : BabelType::Int()) {
             // TODO: type casting should be allowed, e.g. Array(1, 2.9, 4)
             for (const auto& elmnt : Val) {
-                if (Inner != elmnt->getType())
+                if (Inner != elmnt->getType(Ctx))
                     babel_panic("Array elements must share the same type");
             }
         }
-        llvm::Value* codegen() override;
-        llvm::Constant *codegenComptime() override;
-        BabelType getType() const override { return BabelType::Array(&Inner, Size); }
-        bool isComptimeAssignable() const override { return std::ranges::all_of(Val, [](const std::unique_ptr<BaseAST>& elmnt) {return elmnt->isComptimeAssignable(); }); }
+        llvm::Value* codegen(CompilerContext &Ctx) override;
+        llvm::Constant *codegenComptime(CompilerContext &Ctx) override;
+        BabelType getType(CompilerContext &Ctx) const override { return BabelType::Array(&Inner, Size); }
+        bool isComptimeAssignable(CompilerContext &Ctx) const override { return std::ranges::all_of(Val, [&](const BaseAST* elmnt) {return elmnt->isComptimeAssignable(Ctx); }); }
 };
 
 class AccessElementOperatorAST : public BaseAST {
-    std::unique_ptr<BaseAST> Container;
-    std::unique_ptr<BaseAST> Index;
+    BaseAST* Container;
+    BaseAST* Index;
     bool requiresLValue = false;
 
     public:
-        AccessElementOperatorAST(std::unique_ptr<BaseAST> Container, std::unique_ptr<BaseAST> Index) : Container(std::move(Container)), Index(std::move(Index)) {}
-        llvm::Value *codegen() override;
-        BabelType getType() const override { return *(Container->getType().getArray().inner); }
-        bool isComptimeAssignable() const override { return false; }
-        llvm::Value *requireLValue() override {
+        AccessElementOperatorAST(BaseAST* Container, BaseAST* Index) : Container(Container), Index(Index) {}
+        llvm::Value *codegen(CompilerContext &Ctx) override;
+        BabelType getType(CompilerContext &Ctx) const override { return *(Container->getType(Ctx).getArray().inner); }
+        bool isComptimeAssignable(CompilerContext &Ctx) const override { return false; }
+        llvm::Value *requireLValue(CompilerContext &Ctx) override {
             requiresLValue = true;
-            llvm::Value* lVal = codegen();
+            llvm::Value* lVal = codegen(Ctx);
             requiresLValue = false;
             assert(lVal->getType()->isPointerTy() && "requireLValue returned non-pointer");
             return lVal;
@@ -276,79 +302,79 @@ class AccessElementOperatorAST : public BaseAST {
 };
 
 class DereferenceOperatorAST : public BaseAST {
-    std::unique_ptr<BaseAST> Var;
+    BaseAST* Var;
     bool requiresLValue = false;
 
     public:
-        explicit DereferenceOperatorAST(std::unique_ptr<BaseAST> Var) : Var(std::move(Var)) {}
-        llvm::Value *codegen() override;
-        BabelType getType() const override { return *(Var->getType().getPointer().to); }
-        bool isComptimeAssignable() const override { return false; }
-        llvm::Value *requireLValue() override {
+        explicit DereferenceOperatorAST(BaseAST* Var) : Var(Var) {}
+        llvm::Value *codegen(CompilerContext &Ctx) override;
+        BabelType getType(CompilerContext &Ctx) const override { return *(Var->getType(Ctx).getPointer().to); }
+        bool isComptimeAssignable(CompilerContext &Ctx) const override { return false; }
+        llvm::Value *requireLValue(CompilerContext &Ctx) override {
             requiresLValue = true;
-            llvm::Value* lVal = codegen();
+            llvm::Value* lVal = codegen(Ctx);
             requiresLValue = false;
             return lVal;
         }
 };
 
+// &var or &array[index]
 class AddressOfOperatorAST : public BaseAST {
-    std::unique_ptr<VariableAST> Var;
+    BaseAST* Operand;
     const BabelType To;
 
     public:
-        explicit AddressOfOperatorAST(std::unique_ptr<BaseAST> _Var) : To(_Var->getType()) {
-            BaseAST* const stored_ptr = _Var.release();
-            Var = std::unique_ptr<VariableAST>(dynamic_cast<VariableAST*>(stored_ptr));
-            if (!Var) {
-                _Var.reset(stored_ptr);
+        AddressOfOperatorAST(CompilerContext &Ctx, BaseAST* Operand) : Operand(Operand), To(Operand->getType(Ctx)) {
+            if (!dynamic_cast<VariableAST*>(Operand) && !dynamic_cast<AccessElementOperatorAST*>(Operand))
                 babel_panic("Cannot create pointer from non-variable");
-            }
         }
-        llvm::Value *codegen() override;
-        llvm::Constant *codegenComptime() override { assert(isComptimeAssignable()); return llvm::cast<llvm::Constant>(codegen()); }
-        BabelType getType() const override { return BabelType::Pointer(&To, Var->getConstness()); }
-        bool isComptimeAssignable() const override { return Var->isComptimeAssignable(); }
+        llvm::Value *codegen(CompilerContext &Ctx) override;
+        llvm::Constant *codegenComptime(CompilerContext &Ctx) override { assert(isComptimeAssignable(Ctx)); return llvm::cast<llvm::Constant>(codegen(Ctx)); }
+        BabelType getType(CompilerContext &Ctx) const override {
+            const auto* Var = dynamic_cast<VariableAST*>(Operand);
+            return BabelType::Pointer(&To, Var && Var->getConstness());
+        }
+        bool isComptimeAssignable(CompilerContext &Ctx) const override { return Operand->isComptimeAssignable(Ctx); }
 };
 
 class ComparisonChainAST : public BaseAST {
     const std::deque<std::string> Operators;
-    const std::deque<std::unique_ptr<BaseAST>> Operands;
+    const ASTList Operands;
 
     public:
-        ComparisonChainAST(std::deque<std::string> Operators, std::deque<std::unique_ptr<BaseAST>> Operands) : Operators(std::move(Operators)), Operands(std::move(Operands)) {}
-        llvm::Value *codegen() override;
-        llvm::Constant *codegenComptime() override { assert(isComptimeAssignable()); return llvm::cast<llvm::Constant>(codegen()); }
-        BabelType getType() const override { return BabelType::Boolean(); }
-        bool isComptimeAssignable() const override { return std::ranges::all_of(Operands, [](const std::unique_ptr<BaseAST>& elmnt) { return elmnt->isComptimeAssignable(); }); }
+        ComparisonChainAST(std::deque<std::string> Operators, ASTList Operands) : Operators(std::move(Operators)), Operands(Operands) {}
+        llvm::Value *codegen(CompilerContext &Ctx) override;
+        llvm::Constant *codegenComptime(CompilerContext &Ctx) override { assert(isComptimeAssignable(Ctx)); return llvm::cast<llvm::Constant>(codegen(Ctx)); }
+        BabelType getType(CompilerContext &Ctx) const override { return BabelType::Boolean(); }
+        bool isComptimeAssignable(CompilerContext &Ctx) const override { return std::ranges::all_of(Operands, [&](const BaseAST* elmnt) { return elmnt->isComptimeAssignable(Ctx); }); }
         bool isStatementLike() const override { return false; }
 };
 
 // class for when binary operators are used
 class BinaryOperatorAST : public BaseAST {
     const std::string Op;
-    std::unique_ptr<BaseAST> LHS;
-    std::unique_ptr<BaseAST> RHS;
+    BaseAST* LHS;
+    BaseAST* RHS;
 
     public:
-        BinaryOperatorAST(const std::string& Op, std::unique_ptr<BaseAST> LHS, std::unique_ptr<BaseAST> RHS) : Op(Op), LHS(std::move(LHS)), RHS(std::move(RHS)) {}
-        llvm::Value *codegen() override;
-        llvm::Constant* codegenComptime() override { assert(isComptimeAssignable()); return llvm::cast<llvm::Constant>(codegen()); }
-        BabelType getType() const override;
-        bool isComptimeAssignable() const override { return LHS->isComptimeAssignable() && RHS->isComptimeAssignable(); }
+        BinaryOperatorAST(const std::string& Op, BaseAST* LHS, BaseAST* RHS) : Op(Op), LHS(LHS), RHS(RHS) {}
+        llvm::Value *codegen(CompilerContext &Ctx) override;
+        llvm::Constant* codegenComptime(CompilerContext &Ctx) override { assert(isComptimeAssignable(Ctx)); return llvm::cast<llvm::Constant>(codegen(Ctx)); }
+        BabelType getType(CompilerContext &Ctx) const override;
+        bool isComptimeAssignable(CompilerContext &Ctx) const override { return LHS->isComptimeAssignable(Ctx) && RHS->isComptimeAssignable(Ctx); }
         bool isStatementLike() const override { return Op == "=" || Op == ":="; }
 };
 
 class UnaryOperatorAST : public BaseAST {
     const std::string Op;
-    std::unique_ptr<BaseAST> Val;
+    BaseAST* Val;
 
     public:
-        UnaryOperatorAST(const std::string& Op, std::unique_ptr<BaseAST> Val) : Op(Op), Val(std::move(Val)) {}
-        llvm::Value *codegen() override;
-        llvm::Constant* codegenComptime() override { assert(isComptimeAssignable()); return llvm::cast<llvm::Constant>(codegen()); }
-        BabelType getType() const override { return Val->getType(); }
-        bool isComptimeAssignable() const override { return Val->isComptimeAssignable(); }
+        UnaryOperatorAST(const std::string& Op, BaseAST* Val) : Op(Op), Val(Val) {}
+        llvm::Value *codegen(CompilerContext &Ctx) override;
+        llvm::Constant* codegenComptime(CompilerContext &Ctx) override { assert(isComptimeAssignable(Ctx)); return llvm::cast<llvm::Constant>(codegen(Ctx)); }
+        BabelType getType(CompilerContext &Ctx) const override { return Val->getType(Ctx); }
+        bool isComptimeAssignable(CompilerContext &Ctx) const override { return Val->isComptimeAssignable(Ctx); }
         bool isStatementLike() const override { return Op.ends_with("++") || Op.ends_with("--"); }
 };
 
@@ -357,7 +383,7 @@ class ContinueStmtAST : public BaseAST {
 
     public:
         explicit ContinueStmtAST(const std::optional<std::string>& Target) : Target(Target) {}
-        llvm::Value *codegen() override;
+        llvm::Value *codegen(CompilerContext &Ctx) override;
 };
 
 class BreakStmtAST : public BaseAST {
@@ -365,15 +391,15 @@ class BreakStmtAST : public BaseAST {
 
     public:
         explicit BreakStmtAST(const std::optional<std::string>& Target) : Target(Target) {}
-        llvm::Value *codegen() override;
+        llvm::Value *codegen(CompilerContext &Ctx) override;
 };
 
 class ReturnStmtAST : public BaseAST {
-    std::unique_ptr<BaseAST> Expr;
+    BaseAST* Expr;
 
     public:
-        explicit ReturnStmtAST(std::unique_ptr<BaseAST> Expr) : Expr(std::move(Expr)) {}
-        llvm::Value *codegen() override;
+        explicit ReturnStmtAST(BaseAST* Expr) : Expr(Expr) {}
+        llvm::Value *codegen(CompilerContext &Ctx) override;
 };
 
 class GotoStmtAST : public BaseAST {
@@ -381,7 +407,7 @@ class GotoStmtAST : public BaseAST {
 
     public:
         explicit GotoStmtAST(const std::string& Target) : Target(Target) {}
-        llvm::Value *codegen() override;
+        llvm::Value *codegen(CompilerContext &Ctx) override;
 };
 
 class LabelStmtAST : public BaseAST {
@@ -390,83 +416,83 @@ class LabelStmtAST : public BaseAST {
     public:
         explicit LabelStmtAST(const std::string& Name) : Name(Name) {}
         const std::string &getName() const { return Name; }
-        llvm::Value *codegen() override;
+        llvm::Value *codegen(CompilerContext &Ctx) override;
 };
 
 class BlockAST : public BaseAST {
-    std::deque<std::unique_ptr<BaseAST>> Statements;
+    ASTList Statements;
 
     public:
-        explicit BlockAST(std::deque<std::unique_ptr<BaseAST>> Statements) : Statements(std::move(Statements)) {}
-        llvm::Value *codegen() override;
+        explicit BlockAST(ASTList Statements) : Statements(Statements) {}
+        llvm::Value *codegen(CompilerContext &Ctx) override;
         bool isStatementLike() const override { return Statements.empty(); }
 };
 
 class IfStmtAST : public BaseAST {
-    std::unique_ptr<BaseAST> Cond;
-    std::unique_ptr<BaseAST> Then;
-    std::unique_ptr<BaseAST> Else;
+    BaseAST* Cond;
+    BaseAST* Then;
+    BaseAST* Else;
 
     public:
-        IfStmtAST(std::unique_ptr<BaseAST> Cond, std::unique_ptr<BaseAST> Then, std::unique_ptr<BaseAST> Else) : Cond(std::move(Cond)), Then(std::move(Then)), Else(std::move(Else)) {}
-        llvm::Value *codegen() override;
+        IfStmtAST(BaseAST* Cond, BaseAST* Then, BaseAST* Else) : Cond(Cond), Then(Then), Else(Else) {}
+        llvm::Value *codegen(CompilerContext &Ctx) override;
 };
 
 class WhileLoopAST : public BaseAST {
     std::optional<std::string> Label;
-    std::unique_ptr<BaseAST> Cond;
-    std::unique_ptr<BaseAST> Body;
+    BaseAST* Cond;
+    BaseAST* Body;
 
     public:
-        WhileLoopAST(const std::optional<std::string>& Label, std::unique_ptr<BaseAST> Cond, std::unique_ptr<BaseAST> Body) : Label(Label), Cond(std::move(Cond)), Body(std::move(Body)) {}
-        llvm::Value *codegen() override;
+        WhileLoopAST(const std::optional<std::string>& Label, BaseAST* Cond, BaseAST* Body) : Label(Label), Cond(Cond), Body(Body) {}
+        llvm::Value *codegen(CompilerContext &Ctx) override;
 };
 
 class ForLoopAST : public BaseAST {
     std::optional<std::string> Label;
-    std::unique_ptr<BaseAST> Init;
-    std::unique_ptr<BaseAST> Cond;
-    std::unique_ptr<BaseAST> Update;
-    std::unique_ptr<BaseAST> Body;
+    BaseAST* Init;
+    BaseAST* Cond;
+    BaseAST* Update;
+    BaseAST* Body;
 
     public:
-        ForLoopAST(const std::optional<std::string>& Label, std::unique_ptr<BaseAST> Init, std::unique_ptr<BaseAST> Cond, std::unique_ptr<BaseAST> Update, std::unique_ptr<BaseAST> Body) : Label(Label), Init(std::move(Init)), Cond(std::move(Cond)), Update(std::move(Update)), Body(std::move(Body)) {}
-        llvm::Value *codegen() override;
+        ForLoopAST(const std::optional<std::string>& Label, BaseAST* Init, BaseAST* Cond, BaseAST* Update, BaseAST* Body) : Label(Label), Init(Init), Cond(Cond), Update(Update), Body(Body) {}
+        llvm::Value *codegen(CompilerContext &Ctx) override;
 };
 
 class ForInLoopAST : public BaseAST {
     std::optional<std::string> Label;
-    std::unique_ptr<BaseAST> Elmnt;
-    std::unique_ptr<BaseAST> Collection;
-    std::unique_ptr<BaseAST> Body;
+    BaseAST* Elmnt;
+    BaseAST* Collection;
+    BaseAST* Body;
 
     public:
-        ForInLoopAST(const std::optional<std::string>& Label, std::unique_ptr<BaseAST> Elmnt, std::unique_ptr<BaseAST> Collection, std::unique_ptr<BaseAST> Body) : Label(Label), Elmnt(std::move(Elmnt)), Collection(std::move(Collection)), Body(std::move(Body)) {}
-        llvm::Value *codegen() override;
+        ForInLoopAST(const std::optional<std::string>& Label, BaseAST* Elmnt, BaseAST* Collection, BaseAST* Body) : Label(Label), Elmnt(Elmnt), Collection(Collection), Body(Body) {}
+        llvm::Value *codegen(CompilerContext &Ctx) override;
 };
 
 class MacroCallAST : public BaseAST {
     std::string name;
-    std::deque<std::variant<std::unique_ptr<BaseAST>, BabelType>> Args;
+    std::deque<std::variant<BaseAST*, BabelType>> Args;
 
     public:
-        MacroCallAST(const std::string& name, std::deque<std::variant<std::unique_ptr<BaseAST>, BabelType>> Args) : name(name), Args(std::move(Args)) {}
-        BabelType getType() const override;
-        llvm::Value *codegen() override;
-        bool isComptimeAssignable() const override { return true; }
+        MacroCallAST(const std::string& name, std::deque<std::variant<BaseAST*, BabelType>> Args) : name(name), Args(std::move(Args)) {}
+        BabelType getType(CompilerContext &Ctx) const override;
+        llvm::Value *codegen(CompilerContext &Ctx) override;
+        bool isComptimeAssignable(CompilerContext &Ctx) const override { return true; }
         bool isStatementLike() const override { return true; }
 };
 
 // class for when a function is called
 class TaskCallAST : public BaseAST {
     std::string callsTo;
-    std::deque<std::unique_ptr<BaseAST>> Args;
+    ASTList Args;
 
     public:
-        TaskCallAST(const std::string &callsTo, std::deque<std::unique_ptr<BaseAST>> Args) : callsTo(callsTo), Args(std::move(Args)) {}
-        BabelType getType() const override;
-        llvm::Value *codegen() override;
-        bool isComptimeAssignable() const override { return false; } /* true if it's comptime, but that doesn't exist yet */
+        TaskCallAST(const std::string &callsTo, ASTList Args) : callsTo(callsTo), Args(Args) {}
+        BabelType getType(CompilerContext &Ctx) const override;
+        llvm::Value *codegen(CompilerContext &Ctx) override;
+        bool isComptimeAssignable(CompilerContext &Ctx) const override { return false; } /* true if it's comptime, but that doesn't exist yet */
         bool isStatementLike() const override { return true; }
 };
 
@@ -479,34 +505,34 @@ class TaskHeaderAST : public BaseAST {
     bool isVarArg;
 
     public:
-        TaskHeaderAST(const std::string &Name, std::deque<std::string> Args, std::deque<BabelType> ArgTypes, BabelType ReturnType, bool isVarArg) : Name(Name), Args(std::move(Args)), ArgTypes(std::move(ArgTypes)), ReturnType(ReturnType), isVarArg(isVarArg) {
-            TaskTable[Name] = {this->ArgTypes, ReturnType, isVarArg};
-            PolymorphTable[Name] = PolymorphTable.contains(Name);
+        TaskHeaderAST(CompilerContext &Ctx, const std::string &Name, std::deque<std::string> Args, std::deque<BabelType> ArgTypes, BabelType ReturnType, bool isVarArg) : Name(Name), Args(std::move(Args)), ArgTypes(std::move(ArgTypes)), ReturnType(ReturnType), isVarArg(isVarArg) {
+            Ctx.TaskTable[Name] = {this->ArgTypes, ReturnType, isVarArg};
+            Ctx.PolymorphTable[Name] = Ctx.PolymorphTable.contains(Name);
 
             for (size_t i = 0; i < Args.size(); i++) {
-                VariableAST::insertSymbol(Args[i], ArgTypes[i], false, false);
+                VariableAST::insertSymbol(Ctx, Args[i], ArgTypes[i], false, false);
             }
         }
-        llvm::Function *codegen() override;
+        llvm::Function *codegen(CompilerContext &Ctx) override;
         const std::string &getName() const { return Name; }
         const std::deque<BabelType> &getArgTypes() const { return ArgTypes; }
         const BabelType &getRetType() const { return ReturnType; }
-        void update() {
-            if (PolymorphTable.contains(Name) && PolymorphTable.at(Name)) {
+        void update(CompilerContext &Ctx) {
+            if (Ctx.PolymorphTable.contains(Name) && Ctx.PolymorphTable.at(Name)) {
                 auto underscore_fold = [](std::string a, BabelType b) { return std::move(a) + '_' + getBabelTypeName(b); };
  
                 std::string typeinfo = !ArgTypes.empty() ? std::accumulate(std::next(ArgTypes.begin()), ArgTypes.end(), getBabelTypeName(ArgTypes[0]), underscore_fold) : "";
 
-                auto node_handle = TaskTable.extract(Name);
+                auto node_handle = Ctx.TaskTable.extract(Name);
                 Name = std::format("{}.polymorphic.{}", Name, typeinfo);
                 Name += isVarArg ? "_..." : "";
                 
                 if (!node_handle.empty()) {
                     node_handle.key() = Name;
                     node_handle.mapped() = {ArgTypes, ReturnType, isVarArg};
-                    TaskTable.insert(std::move(node_handle));
+                    Ctx.TaskTable.insert(std::move(node_handle));
                 } else {
-                    TaskTable[Name] = {ArgTypes, ReturnType, isVarArg};
+                    Ctx.TaskTable[Name] = {ArgTypes, ReturnType, isVarArg};
                 }
             }
         }
@@ -514,41 +540,42 @@ class TaskHeaderAST : public BaseAST {
 
 // class for the function definition
 class TaskAST : public BaseAST {
-    std::unique_ptr<TaskHeaderAST> Header;
-    std::unique_ptr<BaseAST> Body;
+    TaskHeaderAST* Header;
+    BaseAST* Body;
 
     public:
-        TaskAST(std::unique_ptr<TaskHeaderAST> Header, std::unique_ptr<BaseAST> Body) : Header(std::move(Header)), Body(std::move(Body)) {}
-        llvm::Function *codegen() override;
+        TaskAST(TaskHeaderAST* Header, BaseAST* Body) : Header(Header), Body(Body) {}
+        llvm::Function *codegen(CompilerContext &Ctx) override;
+        llvm::Function *declare(CompilerContext &Ctx);
 };
 
-void VariableAST::insertSymbol() const {
+void VariableAST::insertSymbol(CompilerContext &Ctx) const {
     // nullptr is not viewed as having a value
     // since we can't check using the Builder, just insert into both
-    GlobalValues[Name] = {nullptr, Type.value(), isConst, isComptime, nullptr};
-    NamedValues[Name] = {nullptr, Type.value(), isConst};
+    Ctx.GlobalValues[Name] = {nullptr, Type.value(), isConst, isComptime, nullptr};
+    Ctx.NamedValues[Name] = {nullptr, Type.value(), isConst};
 }
 
-void VariableAST::insertSymbol(const std::string& Name, BabelType type, const bool isConst, const bool isComptime) {
-    GlobalValues[Name] = {nullptr, type, isConst, isComptime, nullptr};
-    NamedValues[Name] = {nullptr, type, isConst};
+void VariableAST::insertSymbol(CompilerContext &Ctx, const std::string& Name, BabelType type, const bool isConst, const bool isComptime) {
+    Ctx.GlobalValues[Name] = {nullptr, type, isConst, isComptime, nullptr};
+    Ctx.NamedValues[Name] = {nullptr, type, isConst};
 }
 
-BabelType VariableAST::getType() const {
+BabelType VariableAST::getType(CompilerContext &Ctx) const {
     if (Type.has_value())
         return Type.value();
 
-    if (NamedValues.contains(Name))
-        return NamedValues.at(Name).type;
-    else if (GlobalValues.contains(Name))
-        return GlobalValues.at(Name).type;
+    if (Ctx.NamedValues.contains(Name))
+        return Ctx.NamedValues.at(Name).type;
+    else if (Ctx.GlobalValues.contains(Name))
+        return Ctx.GlobalValues.at(Name).type;
     else
         babel_panic("Unknown variable '%s' referenced", Name.c_str());
 }
 
-BabelType BinaryOperatorAST::getType() const {
-    BabelType lTy = LHS->getType();
-    BabelType rTy = RHS->getType();
+BabelType BinaryOperatorAST::getType(CompilerContext &Ctx) const {
+    BabelType lTy = LHS->getType(Ctx);
+    BabelType rTy = RHS->getType(Ctx);
 
     using enum OpKind;
     switch (getOperation(Op, lTy, rTy)) {
@@ -558,8 +585,6 @@ BabelType BinaryOperatorAST::getType() const {
             return BabelType::Int(); // should be ptr sized int in the future
         case MulBool:
             return lTy != BabelType::Boolean() ? lTy : rTy;
-        case PowerInt:
-            return BabelType::Float64();
         case Div: {
             if (isBabelInteger(lTy) && isBabelInteger(rTy))
                 return BabelType::Float64();
@@ -568,7 +593,7 @@ BabelType BinaryOperatorAST::getType() const {
         }
         case AddInt: case AddFloat: case SubInt: case SubFloat:
         case MulInt: case MulFloat: case IDiv: case RemInt:
-        case RemFloat: case Shl: case Shr: case LShr:
+        case RemFloat: case Shl: case Shr: case LShr: case PowerInt:
         case PowerFloatInt: case PowerFloat: case BitAnd: case BitXor:
         case BitOr: {
             if (canImplicitCast(lTy, rTy)) {
@@ -582,50 +607,63 @@ BabelType BinaryOperatorAST::getType() const {
     }
 }
 
-BabelType TaskCallAST::getType() const  {
-    return TaskTable.at(callsTo).ret;
+BabelType TaskCallAST::getType(CompilerContext &Ctx) const  {
+    return Ctx.TaskTable.at(callsTo).ret;
 }
 
-void StoreOrMemCpy(BaseAST* src, BabelType srcType, llvm::Value* dest, BabelType destType) {
+void StoreOrMemCpy(CompilerContext &Ctx, BaseAST* src, BabelType srcType, llvm::Value* dest, BabelType destType) {
     // Aggregate would be more precise, change this in the future
-    if (src->getType().isArray()) {
-        llvm::Type* type = resolveLLVMType(src->getType());
-        uint64_t size = TheModule->getDataLayout().getTypeAllocSize(type);
-        llvm::Align align = TheModule->getDataLayout().getABITypeAlign(type);
+    if (src->getType(Ctx).isArray()) {
+        llvm::Type* type = resolveLLVMType(*Ctx.Context, src->getType(Ctx));
+        uint64_t size = Ctx.Module->getDataLayout().getTypeAllocSize(type);
+        llvm::Align align = Ctx.Module->getDataLayout().getABITypeAlign(type);
         if (auto* SRC = dynamic_cast<VariableAST*>(src)) {
-            Builder->CreateMemCpy(dest, align, SRC->requireLValue(), align, size);
+            Ctx.Builder->CreateMemCpy(dest, align, SRC->requireLValue(Ctx), align, size);
             return;
         }
         
-        llvm::Value* srcVal = src->codegen();
+        llvm::Value* srcVal = src->codegen(Ctx);
         if (canImplicitCast(srcType, destType))
-            srcVal = performImplicitCast(srcVal, srcType, destType);
+            srcVal = performImplicitCast(*Ctx.Builder, srcVal, srcType, destType);
 
-        Builder->CreateMemCpy(dest, align, srcVal, align, size);
+        Ctx.Builder->CreateMemCpy(dest, align, srcVal, align, size);
     } else {
-        llvm::Value* srcVal = src->codegen();
+        llvm::Value* srcVal = src->codegen(Ctx);
         if (canImplicitCast(srcType, destType))
-                srcVal = performImplicitCast(srcVal, srcType, destType);
+                srcVal = performImplicitCast(*Ctx.Builder, srcVal, srcType, destType);
 
-        Builder->CreateStore(srcVal, dest);
+        Ctx.Builder->CreateStore(srcVal, dest);
     }
 }
 
-llvm::Value *handleAssignment(BaseAST* RHS, BabelType RHSType, BabelType VarType, const std::string& VarName, const bool isConst, const bool isDeclaration, const bool isComptime, const bool isShortDecl) {
+// Allocas outside of the entry block are not promoted to registers by mem2reg/SROA
+llvm::AllocaInst *createEntryBlockAlloca(CompilerContext &Ctx, llvm::Type *type, const llvm::Twine &name = "") {
+    llvm::Function *TheFunction = Ctx.Builder->GetInsertBlock()->getParent();
+    llvm::IRBuilder<> TmpB(&TheFunction->getEntryBlock(), TheFunction->getEntryBlock().begin());
+    return TmpB.CreateAlloca(type, nullptr, name);
+}
+
+// Return, break and the like already ended the current block, a second terminator would be invalid IR
+void branchUnlessTerminated(CompilerContext &Ctx, llvm::BasicBlock *target) {
+    if (!Ctx.Builder->GetInsertBlock()->getTerminator())
+        Ctx.Builder->CreateBr(target);
+}
+
+llvm::Value *handleAssignment(CompilerContext &Ctx, BaseAST* RHS, BabelType RHSType, BabelType VarType, const std::string& VarName, const bool isConst, const bool isDeclaration, const bool isComptime, const bool isShortDecl) {
     if (GLOBAL_SCOPE) {
         // we are in global scope
 
-        if (GlobalValues.contains(VarName) && GlobalValues.at(VarName).val != nullptr) {
+        if (Ctx.GlobalValues.contains(VarName) && Ctx.GlobalValues.at(VarName).val != nullptr) {
             if (isDeclaration && !isShortDecl) {
                 babel_panic("Redefinition of global variable '%s'", VarName.c_str());
             }
 
-            GlobalSymbol& existing = GlobalValues[VarName];
+            GlobalSymbol& existing = Ctx.GlobalValues[VarName];
             if (existing.isConstant) {
                 babel_panic("Cannot assign to constant '%s'", VarName.c_str());
             }
 
-            StoreOrMemCpy(RHS, RHSType, existing.val, existing.type);
+            StoreOrMemCpy(Ctx, RHS, RHSType, existing.val, existing.type);
             return existing.val;
         }
 
@@ -633,12 +671,12 @@ llvm::Value *handleAssignment(BaseAST* RHS, BabelType RHSType, BabelType VarType
             babel_panic("Variable '%s' used before declaration", VarName.c_str());
         }
 
-        llvm::Constant* zeroInit = llvm::Constant::getNullValue(resolveLLVMType(VarType));
-        llvm::Constant* initializer = isComptime ? llvm::cast<llvm::Constant>(performImplicitCast(RHS->codegenComptime(), RHSType, VarType)) : zeroInit;
+        llvm::Constant* zeroInit = llvm::Constant::getNullValue(resolveLLVMType(*Ctx.Context, VarType));
+        llvm::Constant* initializer = isComptime ? llvm::cast<llvm::Constant>(performImplicitCast(*Ctx.Builder, RHS->codegenComptime(Ctx), RHSType, VarType)) : zeroInit;
 
         auto *GV = new llvm::GlobalVariable(
-            *TheModule,
-            resolveLLVMType(VarType),
+            *Ctx.Module,
+            resolveLLVMType(*Ctx.Context, VarType),
             isConst,
             llvm::GlobalValue::ExternalLinkage,
             initializer,
@@ -646,29 +684,29 @@ llvm::Value *handleAssignment(BaseAST* RHS, BabelType RHSType, BabelType VarType
         );
 
         if (!isComptime) {
-            StoreOrMemCpy(RHS, RHSType, GV, VarType);
+            StoreOrMemCpy(Ctx, RHS, RHSType, GV, VarType);
             // If not in "script mode":
             // babel_panic("Global variables must be initialized with constant values");
         }
 
-        GlobalValues[VarName] = {GV, VarType, isConst, isComptime, initializer};
+        Ctx.GlobalValues[VarName] = {GV, VarType, isConst, isComptime, initializer};
         return GV;
     } else {
         // we are in local scope
-        LocalSymbol Var = NamedValues[VarName];
+        LocalSymbol Var = Ctx.NamedValues[VarName];
 
         if (!Var.val) {
-            if (GlobalValues.contains(VarName) && GlobalValues.at(VarName).val != nullptr) {
+            if (Ctx.GlobalValues.contains(VarName) && Ctx.GlobalValues.at(VarName).val != nullptr) {
                 if (isDeclaration && !isShortDecl) {
                     babel_panic("Redefinition of global variable '%s'", VarName.c_str());
                 }
     
-                GlobalSymbol& existing = GlobalValues[VarName];
+                GlobalSymbol& existing = Ctx.GlobalValues[VarName];
                 if (existing.isConstant) {
                     babel_panic("Cannot assign to constant '%s'", VarName.c_str());
                 }
 
-                StoreOrMemCpy(RHS, RHSType, existing.val, existing.type);
+                StoreOrMemCpy(Ctx, RHS, RHSType, existing.val, existing.type);
                 return existing.val;
             }
 
@@ -677,12 +715,10 @@ llvm::Value *handleAssignment(BaseAST* RHS, BabelType RHSType, BabelType VarType
             }
 
             // Declare new variable
-            llvm::Function *TheFunction = Builder->GetInsertBlock()->getParent();
-            llvm::IRBuilder<> TmpB(&TheFunction->getEntryBlock(), TheFunction->getEntryBlock().begin());
-            Var.val = TmpB.CreateAlloca(resolveLLVMType(VarType), nullptr, VarName);
+            Var.val = createEntryBlockAlloca(Ctx, resolveLLVMType(*Ctx.Context, VarType), VarName);
             Var.type = VarType;
             Var.isConstant = isConst;
-            NamedValues[VarName] = {Var.val, VarType, isConst};
+            Ctx.NamedValues[VarName] = {Var.val, VarType, isConst};
         } else {
             if (isDeclaration) {
                 babel_panic("Redefinition of local variable '%s'", VarName.c_str());
@@ -693,103 +729,103 @@ llvm::Value *handleAssignment(BaseAST* RHS, BabelType RHSType, BabelType VarType
             }
         }
 
-        StoreOrMemCpy(RHS, RHSType, Var.val, Var.type);
+        StoreOrMemCpy(Ctx, RHS, RHSType, Var.val, Var.type);
         return Var.val;
     }
 }
 
-llvm::Value *ArrayAST::codegen() {
-    llvm::ArrayType* type = llvm::ArrayType::get(resolveLLVMType(Inner), Size);
+llvm::Value *ArrayAST::codegen(CompilerContext &Ctx) {
+    llvm::ArrayType* type = llvm::ArrayType::get(resolveLLVMType(*Ctx.Context, Inner), Size);
 
-    llvm::Value* ptr = Builder->CreateAlloca(type);
-    llvm::Value* zero = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*TheContext), 0);
+    llvm::Value* ptr = createEntryBlockAlloca(Ctx, type);
+    llvm::Value* zero = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*Ctx.Context), 0);
 
     for (int i = 0; i < Val.size(); i++) {
-        llvm::Value* index = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*TheContext), i);
-        llvm::Value* slot = Builder->CreateGEP(type, ptr, {zero, index});
-        StoreOrMemCpy(Val[i].get(), Val[i]->getType(), slot, Inner);
+        llvm::Value* index = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*Ctx.Context), i);
+        llvm::Value* slot = Ctx.Builder->CreateGEP(type, ptr, {zero, index});
+        StoreOrMemCpy(Ctx, Val[i], Val[i]->getType(Ctx), slot, Inner);
     }
 
     return ptr;
 }
 
-llvm::Constant *ArrayAST::codegenComptime() {
-    llvm::ArrayType* type = llvm::ArrayType::get(resolveLLVMType(Inner), Size);
+llvm::Constant *ArrayAST::codegenComptime(CompilerContext &Ctx) {
+    llvm::ArrayType* type = llvm::ArrayType::get(resolveLLVMType(*Ctx.Context, Inner), Size);
 
-    assert(isComptimeAssignable() && GLOBAL_SCOPE);
+    assert(isComptimeAssignable(Ctx) && GLOBAL_SCOPE);
 
     std::vector<llvm::Constant*> Args;
     for (const auto& elmnt : Val) {
-        auto* var = dynamic_cast<VariableAST*>(elmnt.get());
-        Args.push_back(var == nullptr ? elmnt->codegenComptime() : GlobalValues.at(var->getName()).comptimeInit);
+        auto* var = dynamic_cast<VariableAST*>(elmnt);
+        Args.push_back(var == nullptr ? elmnt->codegenComptime(Ctx) : Ctx.GlobalValues.at(var->getName()).comptimeInit);
     }
 
     return llvm::ConstantArray::get(type, Args);
 }
 
-llvm::Constant *FloatingPointAST::codegenComptime() {
-    return llvm::ConstantFP::get(resolveLLVMType(Type), Val);
+llvm::Constant *FloatingPointAST::codegenComptime(CompilerContext &Ctx) {
+    return llvm::ConstantFP::get(resolveLLVMType(*Ctx.Context, Type), Val);
 }
 
-llvm::Constant *IntegerAST::codegenComptime() {
-    return llvm::ConstantInt::get(resolveLLVMType(Type), Val);
+llvm::Constant *IntegerAST::codegenComptime(CompilerContext &Ctx) {
+    return llvm::ConstantInt::get(resolveLLVMType(*Ctx.Context, Type), Val);
 }
 
-llvm::Constant *CharacterAST::codegenComptime() {
-    return llvm::ConstantInt::get(llvm::Type::getInt8Ty(*TheContext), Val);
+llvm::Constant *CharacterAST::codegenComptime(CompilerContext &Ctx) {
+    return llvm::ConstantInt::get(llvm::Type::getInt8Ty(*Ctx.Context), Val);
 }
 
-llvm::Constant *CStringAST::codegenComptime() {
-    return Builder->CreateGlobalString(Val, ".cstr");
+llvm::Constant *CStringAST::codegenComptime(CompilerContext &Ctx) {
+    return Ctx.Builder->CreateGlobalString(Val, ".cstr");
 }
 
-llvm::Constant *BooleanAST::codegenComptime() {
-    return llvm::ConstantInt::get(llvm::Type::getInt1Ty(*TheContext), Val);
+llvm::Constant *BooleanAST::codegenComptime(CompilerContext &Ctx) {
+    return llvm::ConstantInt::get(llvm::Type::getInt1Ty(*Ctx.Context), Val);
 }
 
-llvm::Value *VariableAST::codegen() {
-    if (NamedValues.contains(Name) && NamedValues.at(Name).val != nullptr) {
+llvm::Value *VariableAST::codegen(CompilerContext &Ctx) {
+    if (Ctx.NamedValues.contains(Name) && Ctx.NamedValues.at(Name).val != nullptr) {
         if (requiresLValue)
-            return NamedValues[Name].val;
+            return Ctx.NamedValues[Name].val;
         
-        return Builder->CreateLoad(resolveLLVMType(NamedValues[Name].type), NamedValues[Name].val, Name);
-    } else if (GlobalValues.contains(Name) && GlobalValues.at(Name).val != nullptr) {
+        return Ctx.Builder->CreateLoad(resolveLLVMType(*Ctx.Context, Ctx.NamedValues[Name].type), Ctx.NamedValues[Name].val, Name);
+    } else if (Ctx.GlobalValues.contains(Name) && Ctx.GlobalValues.at(Name).val != nullptr) {
         if (requiresLValue)
-            return GlobalValues[Name].val;
+            return Ctx.GlobalValues[Name].val;
         
-        return Builder->CreateLoad(resolveLLVMType(GlobalValues[Name].type), GlobalValues[Name].val, Name);
+        return Ctx.Builder->CreateLoad(resolveLLVMType(*Ctx.Context, Ctx.GlobalValues[Name].type), Ctx.GlobalValues[Name].val, Name);
     } else {
         babel_panic("Unknown variable '%s' referenced", Name.c_str());
     }
 }
 
-llvm::Constant *VariableAST::codegenComptime() {
-    assert(isComptimeAssignable());
-    return GlobalValues.at(Name).comptimeInit;
+llvm::Constant *VariableAST::codegenComptime(CompilerContext &Ctx) {
+    assert(isComptimeAssignable(Ctx));
+    return Ctx.GlobalValues.at(Name).comptimeInit;
 }
 
-llvm::Value *shortCircuit(const std::deque<std::unique_ptr<BaseAST>>& ops, bool continueCondition) {
-    llvm::Function *TheFunction = Builder->GetInsertBlock()->getParent();
-    llvm::BasicBlock *EndBB = llvm::BasicBlock::Create(*TheContext, "L", TheFunction);
-    std::vector<llvm::BasicBlock*> blocks = {Builder->GetInsertBlock()};
+llvm::Value *shortCircuit(CompilerContext &Ctx, const ASTList& ops, bool continueCondition) {
+    llvm::Function *TheFunction = Ctx.Builder->GetInsertBlock()->getParent();
+    llvm::BasicBlock *EndBB = llvm::BasicBlock::Create(*Ctx.Context, "L", TheFunction);
+    std::vector<llvm::BasicBlock*> blocks = {Ctx.Builder->GetInsertBlock()};
 
     for (const auto& op : ops | std::views::take(ops.size() - 1)) {
-        llvm::BasicBlock *ContinueBB = llvm::BasicBlock::Create(*TheContext, "L", TheFunction, EndBB);
+        llvm::BasicBlock *ContinueBB = llvm::BasicBlock::Create(*Ctx.Context, "L", TheFunction, EndBB);
         blocks.push_back(ContinueBB);
 
-        continueCondition ? Builder->CreateCondBr(op->codegen(), ContinueBB, EndBB) : Builder->CreateCondBr(op->codegen(), EndBB, ContinueBB);
-        Builder->SetInsertPoint(ContinueBB);
+        continueCondition ? Ctx.Builder->CreateCondBr(op->codegen(Ctx), ContinueBB, EndBB) : Ctx.Builder->CreateCondBr(op->codegen(Ctx), EndBB, ContinueBB);
+        Ctx.Builder->SetInsertPoint(ContinueBB);
     }
 
-    llvm::Value* lastVal = ops.back()->codegen();
-    Builder->CreateBr(EndBB);
+    llvm::Value* lastVal = ops.back()->codegen(Ctx);
+    Ctx.Builder->CreateBr(EndBB);
 
-    Builder->SetInsertPoint(EndBB);
-    // llvm::PHINode *phi = llvm::PHINode::Create(llvm::Type::getInt1Ty(*TheContext), static_cast<unsigned>(blocks.size()));
-    llvm::PHINode* phi = Builder->CreatePHI(llvm::Type::getInt1Ty(*TheContext), static_cast<unsigned>(blocks.size()));
+    Ctx.Builder->SetInsertPoint(EndBB);
+    // llvm::PHINode *phi = llvm::PHINode::Create(llvm::Type::getInt1Ty(*Ctx.Context), static_cast<unsigned>(blocks.size()));
+    llvm::PHINode* phi = Ctx.Builder->CreatePHI(llvm::Type::getInt1Ty(*Ctx.Context), static_cast<unsigned>(blocks.size()));
 
     for (const auto& block : blocks | std::views::take(blocks.size() - 1)) {
-        llvm::Value *b = continueCondition ? llvm::ConstantInt::getFalse(*TheContext) : llvm::ConstantInt::getTrue(*TheContext);
+        llvm::Value *b = continueCondition ? llvm::ConstantInt::getFalse(*Ctx.Context) : llvm::ConstantInt::getTrue(*Ctx.Context);
         phi->addIncoming(b, block);
     }
 
@@ -797,175 +833,192 @@ llvm::Value *shortCircuit(const std::deque<std::unique_ptr<BaseAST>>& ops, bool
     return phi;
 }
 
-llvm::Value *cmpHelper(OpKind op, llvm::Value *lhs, llvm::Value *rhs) {
+llvm::Value *cmpHelper(CompilerContext &Ctx, OpKind op, llvm::Value *lhs, llvm::Value *rhs) {
     using enum OpKind;
     switch (op) {
         case EqInt:
-            return Builder->CreateICmpEQ(lhs, rhs, "eqtmp");
+            return Ctx.Builder->CreateICmpEQ(lhs, rhs, "eqtmp");
         case EqFloat:
-            return Builder->CreateFCmpUEQ(lhs, rhs, "eqtmp");
+            return Ctx.Builder->CreateFCmpUEQ(lhs, rhs, "eqtmp");
         case NeInt:
-            return Builder->CreateICmpNE(lhs, rhs, "netmp");
+            return Ctx.Builder->CreateICmpNE(lhs, rhs, "netmp");
         case NeFloat:
-            return Builder->CreateFCmpUNE(lhs, rhs, "netmp");
+            return Ctx.Builder->CreateFCmpUNE(lhs, rhs, "netmp");
         case LtInt:
-            return Builder->CreateICmpSLT(lhs, rhs, "lttmp");
+            return Ctx.Builder->CreateICmpSLT(lhs, rhs, "lttmp");
         case LtFloat:
-            return Builder->CreateFCmpULT(lhs, rhs, "lttmp");
+            return Ctx.Builder->CreateFCmpULT(lhs, rhs, "lttmp");
         case LeInt:
-            return Builder->CreateICmpSLE(lhs, rhs, "letmp");
+            return Ctx.Builder->CreateICmpSLE(lhs, rhs, "letmp");
         case LeFloat:
-            return Builder->CreateFCmpULE(lhs, rhs, "letmp");
+            return Ctx.Builder->CreateFCmpULE(lhs, rhs, "letmp");
         case GtInt:
-            return Builder->CreateICmpSGT(lhs, rhs, "gttmp");
+            return Ctx.Builder->CreateICmpSGT(lhs, rhs, "gttmp");
         case GtFloat:
-            return Builder->CreateFCmpUGT(lhs, rhs, "gttmp");
+            return Ctx.Builder->CreateFCmpUGT(lhs, rhs, "gttmp");
         case GeInt:
-            return Builder->CreateICmpSGE(lhs, rhs, "getmp");
+            return Ctx.Builder->CreateICmpSGE(lhs, rhs, "getmp");
         case GeFloat:
-            return Builder->CreateFCmpUGE(lhs, rhs, "getmp");
+            return Ctx.Builder->CreateFCmpUGE(lhs, rhs, "getmp");
         
         default:
             babel_unreachable();
     }
 }
 
-llvm::Value *ComparisonChainAST::codegen() {
+llvm::Value *ComparisonChainAST::codegen(CompilerContext &Ctx) {
     assert(Operators.size() == Operands.size() - 1);
 
     if (std::ranges::all_of(Operators, [](std::string_view op){ return op == "&&"; }))
-        return shortCircuit(Operands, true);
+        return shortCircuit(Ctx, Operands, true);
 
     if (std::ranges::all_of(Operators, [](std::string_view op){ return op == "||"; }))
-        return shortCircuit(Operands, false);
+        return shortCircuit(Ctx, Operands, false);
 
     assert(std::ranges::all_of(Operators, [](const std::string& op){ return op == "<" || op == ">" || op == "<=" || op == ">=" || op == "==" || op == "!="; }));
 
     if (Operands.size() == 2)
-        return cmpHelper(getOperation(Operators.front(), Operands[0]->getType(), Operands[1]->getType()), Operands[0]->codegen(), Operands[1]->codegen());
+        return cmpHelper(Ctx, getOperation(Operators.front(), Operands[0]->getType(Ctx), Operands[1]->getType(Ctx)), Operands[0]->codegen(Ctx), Operands[1]->codegen(Ctx));
 
-    llvm::Function *TheFunction = Builder->GetInsertBlock()->getParent();
-    llvm::BasicBlock *EndBB = llvm::BasicBlock::Create(*TheContext, "L", TheFunction);
-    std::vector<llvm::BasicBlock*> blocks = {Builder->GetInsertBlock()};
-    llvm::Value *left = Operands.front()->codegen();
-    BabelType lTy = Operands.front()->getType();
+    llvm::Function *TheFunction = Ctx.Builder->GetInsertBlock()->getParent();
+    llvm::BasicBlock *EndBB = llvm::BasicBlock::Create(*Ctx.Context, "L", TheFunction);
+    std::vector<llvm::BasicBlock*> blocks = {Ctx.Builder->GetInsertBlock()};
+    llvm::Value *left = Operands.front()->codegen(Ctx);
+    BabelType lTy = Operands.front()->getType(Ctx);
 
     for (const auto&[op, o] : Zipped{Operands | std::views::drop(1) | std::views::take(Operands.size() - 1), Operators | std::views::take(Operators.size() - 1)}) {
-        llvm::BasicBlock *ContinueBB = llvm::BasicBlock::Create(*TheContext, "L", TheFunction, EndBB);
+        llvm::BasicBlock *ContinueBB = llvm::BasicBlock::Create(*Ctx.Context, "L", TheFunction, EndBB);
         blocks.push_back(ContinueBB);
 
-        llvm::Value* right = op->codegen();
-        BabelType rTy = op->getType();
+        llvm::Value* right = op->codegen(Ctx);
+        BabelType rTy = op->getType(Ctx);
 
-        Builder->CreateCondBr(cmpHelper(getOperation(o, lTy, rTy), left, right), ContinueBB, EndBB);
-        Builder->SetInsertPoint(ContinueBB);
+        Ctx.Builder->CreateCondBr(cmpHelper(Ctx, getOperation(o, lTy, rTy), left, right), ContinueBB, EndBB);
+        Ctx.Builder->SetInsertPoint(ContinueBB);
 
         left = right;
         lTy = rTy;
     }
 
-    llvm::Value* lastVal = cmpHelper(getOperation(Operators.back(), lTy, Operands.back()->getType()), left, Operands.back()->codegen());
-    Builder->CreateBr(EndBB);
+    llvm::Value* lastVal = cmpHelper(Ctx, getOperation(Operators.back(), lTy, Operands.back()->getType(Ctx)), left, Operands.back()->codegen(Ctx));
+    Ctx.Builder->CreateBr(EndBB);
 
-    Builder->SetInsertPoint(EndBB);
-    llvm::PHINode *phi = Builder->CreatePHI(llvm::Type::getInt1Ty(*TheContext), static_cast<unsigned>(blocks.size()));
+    Ctx.Builder->SetInsertPoint(EndBB);
+    llvm::PHINode *phi = Ctx.Builder->CreatePHI(llvm::Type::getInt1Ty(*Ctx.Context), static_cast<unsigned>(blocks.size()));
 
     for (const auto& block : blocks | std::views::take(blocks.size() - 1)) {
-        phi->addIncoming(llvm::ConstantInt::getFalse(*TheContext), block);
+        phi->addIncoming(llvm::ConstantInt::getFalse(*Ctx.Context), block);
     }
 
     phi->addIncoming(lastVal, blocks.back());
     return phi;
 }
 
-llvm::Function *getOrCreate_ipow(llvm::Type* ty) {
-    std::string name = std::format("babel.ipow.i{}.i{}", ty->getIntegerBitWidth(), ty->getIntegerBitWidth());
-
-    llvm::Function* F = TheModule->getFunction(name);
-    if (F) return F;
+// x ** n of integers by squaring, same width in and out. Negative powers truncate 1 / x ** -n toward zero.
+llvm::APInt foldIntegerPower(llvm::APInt base, llvm::APInt power) {
+    unsigned width = base.getBitWidth();
+    if (power.isNegative()) {
+        if (base.isOne()) return base;
+        if (base.isAllOnes()) return power[0] ? base : llvm::APInt(width, 1);
+        return llvm::APInt(width, 0);
+    }
 
-    llvm::FunctionType *FT = llvm::FunctionType::get(Builder->getDoubleTy(), {ty, ty}, false);
-    F = llvm::Function::Create(FT, llvm::Function::ExternalLinkage, name, TheModule.get());
-    F->getArg(0)->setName("Val"); F->getArg(1)->setName("Power");
+    llvm::APInt result(width, 1);
+    while (!power.isZero()) {
+        if (power[0]) result *= base;
+        base *= base;
+        power.lshrInPlace(1);
+    }
+    return result;
+}
 
-    llvm::IRBuilder<>::InsertPoint PrevInsertPoint = Builder->saveIP();
+// The runtime counterpart of foldIntegerPower, one loop iteration per bit of the power
+llvm::Function *getOrCreate_ipow(CompilerContext &Ctx, llvm::Type* ty) {
+    std::string name = std::format("babel.ipow.i{}", ty->getIntegerBitWidth());
 
-    llvm::BasicBlock *BB = llvm::BasicBlock::Create(*TheContext, "entry", F);
-    Builder->SetInsertPoint(BB);
+    llvm::Function* F = Ctx.Module->getFunction(name);
+    if (F) return F;
 
-    llvm::IRBuilder<> TmpB(&F->getEntryBlock(), F->getEntryBlock().begin());
-    llvm::AllocaInst *Alloca0 = TmpB.CreateAlloca(ty);
-    llvm::AllocaInst *Alloca1 = TmpB.CreateAlloca(ty);
-    Builder->CreateStore(F->getArg(0), Alloca0);
-    Builder->CreateStore(F->getArg(1), Alloca1);
-    
-    llvm::Value* power = Builder->CreateLoad(ty, Alloca1);
-    llvm::Value* eq = Builder->CreateICmpEQ(power, llvm::ConstantInt::get(ty, 0));
-
-    llvm::BasicBlock* BaseBB = llvm::BasicBlock::Create(*TheContext, "", F);
-    llvm::BasicBlock* RecBB = llvm::BasicBlock::Create(*TheContext, "", F);
-    llvm::BasicBlock* IPowBB = llvm::BasicBlock::Create(*TheContext, "", F);
-    llvm::BasicBlock* UPowBB = llvm::BasicBlock::Create(*TheContext, "", F);
-    Builder->CreateCondBr(eq, BaseBB, RecBB);
-
-    Builder->SetInsertPoint(BaseBB);
-    Builder->CreateRet(llvm::ConstantFP::get(Builder->getDoubleTy(), 1));
-
-    Builder->SetInsertPoint(RecBB);
-    llvm::Value* lt = Builder->CreateICmpSLT(Builder->CreateLoad(ty, Alloca1), llvm::ConstantInt::get(ty, 0));
-    Builder->CreateCondBr(lt, IPowBB, UPowBB);
-
-    Builder->SetInsertPoint(IPowBB);
-    llvm::Value* neg = Builder->CreateNeg(Builder->CreateLoad(ty, Alloca1));
-    llvm::Value* calltmp = Builder->CreateCall(F, {Builder->CreateLoad(ty, Alloca0), neg});
-    llvm::Value* div = Builder->CreateFDiv(llvm::ConstantFP::get(Builder->getDoubleTy(), 1), calltmp);
-    Builder->CreateRet(div);
-    
-    Builder->SetInsertPoint(UPowBB);
-    llvm::Value* sub = Builder->CreateSub(Builder->CreateLoad(ty, Alloca1), llvm::ConstantInt::get(ty, 1));
-    llvm::Value* calltmp1 = Builder->CreateCall(F, {Builder->CreateLoad(ty, Alloca0), sub});
-    llvm::Value* mul = Builder->CreateMul(Builder->CreateSIToFP(Builder->CreateLoad(ty, Alloca0), Builder->getDoubleTy()), calltmp1);
-    Builder->CreateRet(mul);
-    
-    Builder->restoreIP(PrevInsertPoint);
+    llvm::FunctionType *FT = llvm::FunctionType::get(ty, {ty, ty}, false);
+    F = llvm::Function::Create(FT, llvm::Function::InternalLinkage, name, Ctx.Module.get());
+    F->setDoesNotAccessMemory();
+    F->setDoesNotThrow();
+    llvm::Argument* base = F->getArg(0); base->setName("Val");
+    llvm::Argument* power = F->getArg(1); power->setName("Power");
+
+    llvm::IRBuilder<> B(llvm::BasicBlock::Create(*Ctx.Context, "entry", F));
+    llvm::BasicBlock* NegBB = llvm::BasicBlock::Create(*Ctx.Context, "negative", F);
+    llvm::BasicBlock* LoopBB = llvm::BasicBlock::Create(*Ctx.Context, "loop", F);
+    llvm::BasicBlock* StepBB = llvm::BasicBlock::Create(*Ctx.Context, "step", F);
+    llvm::BasicBlock* DoneBB = llvm::BasicBlock::Create(*Ctx.Context, "done", F);
+
+    llvm::Value* one = llvm::ConstantInt::get(ty, 1);
+    llvm::Value* minusOne = llvm::ConstantInt::getSigned(ty, -1);
+    B.CreateCondBr(B.CreateICmpSLT(power, llvm::ConstantInt::get(ty, 0)), NegBB, LoopBB);
+
+    // only 1 and -1 have an integer inverse
+    B.SetInsertPoint(NegBB);
+    llvm::Value* odd = B.CreateTrunc(power, B.getInt1Ty(), "odd");
+    llvm::Value* unit = B.CreateSelect(B.CreateICmpEQ(base, minusOne), B.CreateSelect(odd, minusOne, one), llvm::ConstantInt::get(ty, 0));
+    B.CreateRet(B.CreateSelect(B.CreateICmpEQ(base, one), one, unit));
+
+    B.SetInsertPoint(LoopBB);
+    llvm::PHINode* result = B.CreatePHI(ty, 2, "result");
+    llvm::PHINode* square = B.CreatePHI(ty, 2, "square");
+    llvm::PHINode* rest = B.CreatePHI(ty, 2, "rest");
+    B.CreateCondBr(B.CreateICmpEQ(rest, llvm::ConstantInt::get(ty, 0)), DoneBB, StepBB);
+
+    B.SetInsertPoint(StepBB);
+    llvm::Value* bit = B.CreateTrunc(rest, B.getInt1Ty(), "bit");
+    llvm::Value* next = B.CreateSelect(bit, B.CreateMul(result, square), result);
+    llvm::Value* squared = B.CreateMul(square, square);
+    llvm::Value* shifted = B.CreateLShr(rest, 1);
+    B.CreateBr(LoopBB);
+
+    result->addIncoming(one, &F->getEntryBlock()); result->addIncoming(next, StepBB);
+    square->addIncoming(base, &F->getEntryBlock()); square->addIncoming(squared, StepBB);
+    rest->addIncoming(power, &F->getEntryBlock()); rest->addIncoming(shifted, StepBB);
+
+    B.SetInsertPoint(DoneBB);
+    B.CreateRet(result);
     return F;
 }
 
-llvm::Value *BinaryOperatorAST::codegen() {
+llvm::Value *BinaryOperatorAST::codegen(CompilerContext &Ctx) {
     if (Op == "=" || Op == ":=") {
-        if (const auto *Var = dynamic_cast<VariableAST*>(LHS.get())) {
-            return handleAssignment(RHS.get(), RHS->getType(), Var->getType(), Var->getName(), Var->getConstness(), Var->getDecl(), Var->hasComptimeVal(), Op == ":=");
-        } else if (auto *Arr = dynamic_cast<AccessElementOperatorAST*>(LHS.get())) {
-            llvm::Value *LHSVal = Arr->requireLValue();
-            return Builder->CreateStore(RHS->codegen(), LHSVal);
-        } else if (auto *Deref = dynamic_cast<DereferenceOperatorAST*>(LHS.get())) {
-            llvm::Value *LHSVal = Deref->requireLValue();
-            StoreOrMemCpy(RHS.get(), RHS->getType(), LHSVal, Deref->getType());
+        if (const auto *Var = dynamic_cast<VariableAST*>(LHS)) {
+            return handleAssignment(Ctx, RHS, RHS->getType(Ctx), Var->getType(Ctx), Var->getName(), Var->getConstness(), Var->getDecl(), Var->hasComptimeVal(), Op == ":=");
+        } else if (auto *Arr = dynamic_cast<AccessElementOperatorAST*>(LHS)) {
+            llvm::Value *LHSVal = Arr->requireLValue(Ctx);
+            return Ctx.Builder->CreateStore(RHS->codegen(Ctx), LHSVal);
+        } else if (auto *Deref = dynamic_cast<DereferenceOperatorAST*>(LHS)) {
+            llvm::Value *LHSVal = Deref->requireLValue(Ctx);
+            StoreOrMemCpy(Ctx, RHS, RHS->getType(Ctx), LHSVal, Deref->getType(Ctx));
             return nullptr;
         } else {
             babel_panic("Destination of '=' must be assignable");
         }
     }
 
-    llvm::Value *left = LHS->codegen();
-    llvm::Value *right = RHS->codegen();
+    llvm::Value *left = LHS->codegen(Ctx);
+    llvm::Value *right = RHS->codegen(Ctx);
     if (!left || !right) return nullptr;
 
-    BabelType lTy = LHS->getType();
-    BabelType rTy = RHS->getType();
+    BabelType lTy = LHS->getType(Ctx);
+    BabelType rTy = RHS->getType(Ctx);
 
     using enum OpKind;
     switch (getOperation(Op, lTy, rTy)) {
         case Div: {
             if (isBabelInteger(lTy) && isBabelInteger(rTy)) {
-                llvm::Type* doubleTy = llvm::Type::getDoubleTy(*TheContext);
-                left = Builder->CreateSIToFP(left, doubleTy, "lhsfp");
-                right = Builder->CreateSIToFP(right, doubleTy, "rhsfp");
+                llvm::Type* doubleTy = llvm::Type::getDoubleTy(*Ctx.Context);
+                left = Ctx.Builder->CreateSIToFP(left, doubleTy, "lhsfp");
+                right = Ctx.Builder->CreateSIToFP(right, doubleTy, "rhsfp");
             } else {
                 if (canImplicitCast(lTy, rTy)) {
-                    left = performImplicitCast(left, lTy, rTy);
+                    left = performImplicitCast(*Ctx.Builder, left, lTy, rTy);
                 } else if (canImplicitCast(rTy, lTy)) {
-                    right = performImplicitCast(right, rTy, lTy);
+                    right = performImplicitCast(*Ctx.Builder, right, rTy, lTy);
                 } else {
                     babel_panic("Types dont match for binary operator; implicit cast failed or is not allowed");
                 }
@@ -974,17 +1027,17 @@ llvm::Value *BinaryOperatorAST::codegen() {
         }
         case PowerFloatInt: {
             if (lTy == BabelType::Float16()) {
-                llvm::Type* floatTy = llvm::Type::getFloatTy(*TheContext);
-                left = Builder->CreateFPExt(left, floatTy, "lhsf32");
+                llvm::Type* floatTy = llvm::Type::getFloatTy(*Ctx.Context);
+                left = Ctx.Builder->CreateFPExt(left, floatTy, "lhsf32");
             }
-            right = Builder->CreateSExtOrTrunc(right, llvm::Type::getInt32Ty(*TheContext));
+            right = Ctx.Builder->CreateSExtOrTrunc(right, llvm::Type::getInt32Ty(*Ctx.Context));
             break;
         }
         case PowerFloat: {
             if ((lTy == BabelType::Float16() || isBabelInteger(lTy)) && rTy == BabelType::Float16()) {
-                llvm::Type* floatTy = llvm::Type::getFloatTy(*TheContext);
-                left = isBabelInteger(lTy) ? Builder->CreateSIToFP(left, floatTy, "lhsf32") : Builder->CreateFPExt(left, floatTy, "lhsf32");
-                right = Builder->CreateFPExt(right, floatTy, "rhsf32");
+                llvm::Type* floatTy = llvm::Type::getFloatTy(*Ctx.Context);
+                left = isBabelInteger(lTy) ? Ctx.Builder->CreateSIToFP(left, floatTy, "lhsf32") : Ctx.Builder->CreateFPExt(left, floatTy, "lhsf32");
+                right = Ctx.Builder->CreateFPExt(right, floatTy, "rhsf32");
                 lTy = BabelType::Float32();
                 rTy = BabelType::Float32();
                 break;
@@ -996,9 +1049,9 @@ llvm::Value *BinaryOperatorAST::codegen() {
         case RemFloat: case Shl: case Shr: case LShr:
         case PowerInt: case BitAnd: case BitXor: case BitOr: {
             if (canImplicitCast(lTy, rTy)) {
-                left = performImplicitCast(left, lTy, rTy);
+                left = performImplicitCast(*Ctx.Builder, left, lTy, rTy);
             } else if (canImplicitCast(rTy, lTy)) {
-                right = performImplicitCast(right, rTy, lTy);
+                right = performImplicitCast(*Ctx.Builder, right, rTy, lTy);
             } else {
                 babel_panic("Types dont match for binary operator; implicit cast failed or is not allowed");
             }
@@ -1009,137 +1062,141 @@ llvm::Value *BinaryOperatorAST::codegen() {
 
     switch (getOperation(Op, lTy, rTy)) {
         case AddInt:
-            return Builder->CreateAdd(left, right, "addtmp");
+            return Ctx.Builder->CreateAdd(left, right, "addtmp");
         case AddFloat:
-            return Builder->CreateFAdd(left, right, "addtmp");
+            return Ctx.Builder->CreateFAdd(left, right, "addtmp");
         case AddPtr:
-            return Builder->CreateInBoundsGEP(
-                resolveLLVMType(lTy.isPointer() ? *lTy.getPointer().to : *rTy.getPointer().to),
+            return Ctx.Builder->CreateInBoundsGEP(
+                resolveLLVMType(*Ctx.Context, lTy.isPointer() ? *lTy.getPointer().to : *rTy.getPointer().to),
                 lTy.isPointer() ? left : right,
                 {!lTy.isPointer() ? left : right},
                 "paddtmp"
             );
         case SubInt:
-            return Builder->CreateSub(left, right, "subtmp");
+            return Ctx.Builder->CreateSub(left, right, "subtmp");
         case SubFloat:
-            return Builder->CreateFSub(left, right, "subtmp");
+            return Ctx.Builder->CreateFSub(left, right, "subtmp");
         case SubPtr:
-            return Builder->CreateInBoundsGEP(
-                resolveLLVMType(lTy.isPointer() ? *lTy.getPointer().to : *rTy.getPointer().to),
+            return Ctx.Builder->CreateInBoundsGEP(
+                resolveLLVMType(*Ctx.Context, lTy.isPointer() ? *lTy.getPointer().to : *rTy.getPointer().to),
                 lTy.isPointer() ? left : right,
-                {Builder->CreateNeg(!lTy.isPointer() ? left : right)},
+                {Ctx.Builder->CreateNeg(!lTy.isPointer() ? left : right)},
                 "psubtmp"
             );
         case PtrDiff:
-            return Builder->CreatePtrDiff(resolveLLVMType(*lTy.getPointer().to), left, right, "ptrdiff");
+            return Ctx.Builder->CreatePtrDiff(resolveLLVMType(*Ctx.Context, *lTy.getPointer().to), left, right, "ptrdiff");
         case MulInt:
-            return Builder->CreateMul(left, right, "multmp");
+            return Ctx.Builder->CreateMul(left, right, "multmp");
         case MulFloat:
-            return Builder->CreateFMul(left, right, "multmp");
+            return Ctx.Builder->CreateFMul(left, right, "multmp");
         case MulBool: {
             llvm::Value* b = lTy == BabelType::Boolean() ? left : right;
             llvm::Value* num = lTy == BabelType::Boolean() ? right : left;
-            llvm::Function* copysign = llvm::Intrinsic::getDeclaration(TheModule.get(), llvm::Intrinsic::copysign, {num->getType(), num->getType()});
+            llvm::Function* copysign = llvm::Intrinsic::getDeclaration(Ctx.Module.get(), llvm::Intrinsic::copysign, {num->getType(), num->getType()});
 
             llvm::Value* zeroVal = num->getType()->isFloatingPointTy()
-                ? Builder->CreateCall(copysign, {llvm::ConstantFP::getZero(num->getType()), num})
+                ? Ctx.Builder->CreateCall(copysign, {llvm::ConstantFP::getZero(num->getType()), num})
                 : llvm::cast<llvm::Value>(llvm::ConstantInt::get(num->getType(), 0));
-            return Builder->CreateSelect(b, num, zeroVal, "multmp");
+            return Ctx.Builder->CreateSelect(b, num, zeroVal, "multmp");
         }
         case Div:
-            return Builder->CreateFDiv(left, right, "divtmp");
+            return Ctx.Builder->CreateFDiv(left, right, "divtmp");
         case IDiv:
-            return Builder->CreateSDiv(left, right, "idivtmp");
+            return Ctx.Builder->CreateSDiv(left, right, "idivtmp");
         case RemInt:
-            return Builder->CreateSRem(left, right, "remtmp");
+            return Ctx.Builder->CreateSRem(left, right, "remtmp");
         case RemFloat:
-            return Builder->CreateFRem(left, right, "remtmp");
+            return Ctx.Builder->CreateFRem(left, right, "remtmp");
         case PowerInt: {
-            assert(left->getType() == right->getType());
-            llvm::Function* F = getOrCreate_ipow(left->getType());
-            return Builder->CreateCall(F, {left, right}, "powtmp");
+            auto* base = llvm::dyn_cast<llvm::ConstantInt>(left);
+            auto* power = llvm::dyn_cast<llvm::ConstantInt>(right);
+            if (base && power)
+                return llvm::ConstantInt::get(*Ctx.Context, foldIntegerPower(base->getValue(), power->getValue()));
+
+            llvm::Function* F = getOrCreate_ipow(Ctx, left->getType());
+            return Ctx.Builder->CreateCall(F, {left, right}, "powtmp");
         }
         case PowerFloatInt: {
-            llvm::Function* powi = llvm::Intrinsic::getDeclaration(TheModule.get(), llvm::Intrinsic::powi, {left->getType(), right->getType()});
-            llvm::Value* call = Builder->CreateCall(powi, {left, right}, "powtmp");
-            return lTy == BabelType::Float16() ? Builder->CreateFPTrunc(call, resolveLLVMType(lTy)) : call;
+            llvm::Function* powi = llvm::Intrinsic::getDeclaration(Ctx.Module.get(), llvm::Intrinsic::powi, {left->getType(), right->getType()});
+            llvm::Value* call = Ctx.Builder->CreateCall(powi, {left, right}, "powtmp");
+            return lTy == BabelType::Float16() ? Ctx.Builder->CreateFPTrunc(call, resolveLLVMType(*Ctx.Context, lTy)) : call;
         }
         case PowerFloat: {
-            llvm::Function* pow = llvm::Intrinsic::getDeclaration(TheModule.get(), llvm::Intrinsic::pow, {left->getType(), right->getType()});
-            llvm::Value* call = Builder->CreateCall(pow, {left, right}, "powtmp");
-            return lTy == BabelType::Float16() && rTy == BabelType::Float16() ? Builder->CreateFPTrunc(call, resolveLLVMType(lTy)) : call;
+            llvm::Function* pow = llvm::Intrinsic::getDeclaration(Ctx.Module.get(), llvm::Intrinsic::pow, {left->getType(), right->getType()});
+            llvm::Value* call = Ctx.Builder->CreateCall(pow, {left, right}, "powtmp");
+            return lTy == BabelType::Float16() && rTy == BabelType::Float16() ? Ctx.Builder->CreateFPTrunc(call, resolveLLVMType(*Ctx.Context, lTy)) : call;
         }
         case Shl:
-            return Builder->CreateShl(left, right, "shltmp");
+            return Ctx.Builder->CreateShl(left, right, "shltmp");
         case Shr:
-            return Builder->CreateAShr(left, right, "shrtmp");
+            return Ctx.Builder->CreateAShr(left, right, "shrtmp");
         case LShr:
-            return Builder->CreateLShr(left, right, "lshrtmp");
+            return Ctx.Builder->CreateLShr(left, right, "lshrtmp");
         case BitAnd:
-            return Builder->CreateAnd(left, right, "andtmp");
+            return Ctx.Builder->CreateAnd(left, right, "andtmp");
         case BitXor:
-            return Builder->CreateXor(left, right, "xortmp");
+            return Ctx.Builder->CreateXor(left, right, "xortmp");
         case BitOr:
-            return Builder->CreateOr(left, right, "ortmp");
+            return Ctx.Builder->CreateOr(left, right, "ortmp");
         
         default:
             babel_panic("Invalid binary operator %s(%s, %s)", Op.c_str(), getBabelTypeName(lTy).c_str(), getBabelTypeName(rTy).c_str());
     }
 }
 
-llvm::Value *UnaryOperatorAST::codegen() {
-    llvm::Value *operand = Val->codegen();
-    BabelType ty = Val->getType();
+llvm::Value *UnaryOperatorAST::codegen(CompilerContext &Ctx) {
+    llvm::Value *operand = Val->codegen(Ctx);
+    BabelType ty = Val->getType(Ctx);
     if (!operand) return nullptr;
 
     using enum OpKind;
     switch (getOperation(Op, ty)) {
         case Not:
-            return Builder->CreateNot(operand, "nottmp");
+            return Ctx.Builder->CreateNot(operand, "nottmp");
         case Neg:
-            return Builder->CreateNeg(operand, "negtmp");
+            return Ctx.Builder->CreateNeg(operand, "negtmp");
         case FNeg:
-            return Builder->CreateFNeg(operand, "negtmp");
+            return Ctx.Builder->CreateFNeg(operand, "negtmp");
         case Id:
             return operand; // unary plus is the identity operation (i.e. a no-op)
         case PreInc: {
-            llvm::Value* inc = Builder->CreateAdd(operand, llvm::ConstantInt::get(llvm::Type::getInt32Ty(*TheContext), 1), "inc");
-            Builder->CreateStore(inc, Val->requireLValue());
+            llvm::Value* inc = Ctx.Builder->CreateAdd(operand, llvm::ConstantInt::get(llvm::Type::getInt32Ty(*Ctx.Context), 1), "inc");
+            Ctx.Builder->CreateStore(inc, Val->requireLValue(Ctx));
             return inc;
         }
         case PreDec: {
-            llvm::Value* dec = Builder->CreateSub(operand, llvm::ConstantInt::get(llvm::Type::getInt32Ty(*TheContext), 1), "dec");
-            Builder->CreateStore(dec, Val->requireLValue());
+            llvm::Value* dec = Ctx.Builder->CreateSub(operand, llvm::ConstantInt::get(llvm::Type::getInt32Ty(*Ctx.Context), 1), "dec");
+            Ctx.Builder->CreateStore(dec, Val->requireLValue(Ctx));
             return dec;
         }
         case PostInc: {
-            llvm::Value* inc = Builder->CreateAdd(operand, llvm::ConstantInt::get(llvm::Type::getInt32Ty(*TheContext), 1), "inc");
-            Builder->CreateStore(inc, Val->requireLValue());
+            llvm::Value* inc = Ctx.Builder->CreateAdd(operand, llvm::ConstantInt::get(llvm::Type::getInt32Ty(*Ctx.Context), 1), "inc");
+            Ctx.Builder->CreateStore(inc, Val->requireLValue(Ctx));
             return operand;
         }
         case PostDec: {
-            llvm::Value* dec = Builder->CreateSub(operand, llvm::ConstantInt::get(llvm::Type::getInt32Ty(*TheContext), 1), "dec");
-            Builder->CreateStore(dec, Val->requireLValue());
+            llvm::Value* dec = Ctx.Builder->CreateSub(operand, llvm::ConstantInt::get(llvm::Type::getInt32Ty(*Ctx.Context), 1), "dec");
+            Ctx.Builder->CreateStore(dec, Val->requireLValue(Ctx));
             return operand;
         }
         case PrePtrInc: {
-            llvm::Value* inc = Builder->CreateInBoundsGEP(resolveLLVMType(ty), operand, {llvm::ConstantInt::get(llvm::Type::getInt32Ty(*TheContext), 1)}, "ptrinc");
-            Builder->CreateStore(inc, Val->requireLValue());
+            llvm::Value* inc = Ctx.Builder->CreateInBoundsGEP(resolveLLVMType(*Ctx.Context, ty), operand, {llvm::ConstantInt::get(llvm::Type::getInt32Ty(*Ctx.Context), 1)}, "ptrinc");
+            Ctx.Builder->CreateStore(inc, Val->requireLValue(Ctx));
             return inc;
         }
         case PrePtrDec: {
-            llvm::Value* dec = Builder->CreateInBoundsGEP(resolveLLVMType(ty), operand, {llvm::ConstantInt::get(llvm::Type::getInt32Ty(*TheContext), -1)}, "ptrdec");
-            Builder->CreateStore(dec, Val->requireLValue());
+            llvm::Value* dec = Ctx.Builder->CreateInBoundsGEP(resolveLLVMType(*Ctx.Context, ty), operand, {llvm::ConstantInt::get(llvm::Type::getInt32Ty(*Ctx.Context), -1)}, "ptrdec");
+            Ctx.Builder->CreateStore(dec, Val->requireLValue(Ctx));
             return dec;
         }
         case PostPtrInc: {
-            llvm::Value* inc = Builder->CreateInBoundsGEP(resolveLLVMType(ty), operand, {llvm::ConstantInt::get(llvm::Type::getInt32Ty(*TheContext), 1)}, "ptrinc");
-            Builder->CreateStore(inc, Val->requireLValue());
+            llvm::Value* inc = Ctx.Builder->CreateInBoundsGEP(resolveLLVMType(*Ctx.Context, ty), operand, {llvm::ConstantInt::get(llvm::Type::getInt32Ty(*Ctx.Context), 1)}, "ptrinc");
+            Ctx.Builder->CreateStore(inc, Val->requireLValue(Ctx));
             return operand;
         }
         case PostPtrDec: {
-            llvm::Value* dec = Builder->CreateInBoundsGEP(resolveLLVMType(ty), operand, {llvm::ConstantInt::get(llvm::Type::getInt32Ty(*TheContext), -1)}, "ptrdec");
-            Builder->CreateStore(dec, Val->requireLValue());
+            llvm::Value* dec = Ctx.Builder->CreateInBoundsGEP(resolveLLVMType(*Ctx.Context, ty), operand, {llvm::ConstantInt::get(llvm::Type::getInt32Ty(*Ctx.Context), -1)}, "ptrdec");
+            Ctx.Builder->CreateStore(dec, Val->requireLValue(Ctx));
             return operand;
         }
 
@@ -1148,141 +1205,141 @@ llvm::Value *UnaryOperatorAST::codegen() {
     }
 }
 
-llvm::Value *AccessElementOperatorAST::codegen() {
-    if (!isBabelInteger(Index->getType()))
+llvm::Value *AccessElementOperatorAST::codegen(CompilerContext &Ctx) {
+    if (!isBabelInteger(Index->getType(Ctx)))
         babel_panic("Element access must use integer index");
     
-    if (!Container->getType().isArray())
-        babel_panic("'%s' object is not subscriptable", getBabelTypeName(Container->getType()).c_str());
+    if (!Container->getType(Ctx).isArray())
+        babel_panic("'%s' object is not subscriptable", getBabelTypeName(Container->getType(Ctx)).c_str());
 
     // maybe bounds check, or opt for a C++ like setup with at and operator[]
-    llvm::Value* zero = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*TheContext), 0);
-    llvm::Value* elmntPtr = Builder->CreateInBoundsGEP(resolveLLVMType(Container->getType()), Container->requireLValue(), {zero, Index->codegen()}, "elmntPtr");
+    llvm::Value* zero = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*Ctx.Context), 0);
+    llvm::Value* elmntPtr = Ctx.Builder->CreateInBoundsGEP(resolveLLVMType(*Ctx.Context, Container->getType(Ctx)), Container->requireLValue(Ctx), {zero, Index->codegen(Ctx)}, "elmntPtr");
 
     if (requiresLValue) {
-        if (auto const* var = dynamic_cast<VariableAST*>(Container.get()); var && var->getConstness())
+        if (auto const* var = dynamic_cast<VariableAST*>(Container); var && var->getConstness())
             babel_panic("The underlying array is constant");
 
         return elmntPtr;
     }
     
-    return Builder->CreateLoad(resolveLLVMType(*(Container->getType().getArray().inner)), elmntPtr, "arrtmp");
+    return Ctx.Builder->CreateLoad(resolveLLVMType(*Ctx.Context, *(Container->getType(Ctx).getArray().inner)), elmntPtr, "arrtmp");
 }
 
-llvm::Value *DereferenceOperatorAST::codegen() {
-    if (!Var->getType().isPointer()) {
+llvm::Value *DereferenceOperatorAST::codegen(CompilerContext &Ctx) {
+    if (!Var->getType(Ctx).isPointer()) {
         babel_panic("Cannot dereference non-pointer");
     }
 
     if (requiresLValue) {
-        if (Var->getType().getPointer().pointsToConst)
+        if (Var->getType(Ctx).getPointer().pointsToConst)
             babel_panic("The pointer points to constant data");
 
-        return Var->codegen();
+        return Var->codegen(Ctx);
     }
 
-    return Builder->CreateLoad(resolveLLVMType(*(Var->getType().getPointer().to)), Var->codegen(), "dereftmp");
+    return Ctx.Builder->CreateLoad(resolveLLVMType(*Ctx.Context, *(Var->getType(Ctx).getPointer().to)), Var->codegen(Ctx), "dereftmp");
 }
 
-llvm::Value *AddressOfOperatorAST::codegen() {
-    return Var->requireLValue();
+llvm::Value *AddressOfOperatorAST::codegen(CompilerContext &Ctx) {
+    return Operand->requireLValue(Ctx);
 }
 
-llvm::Value *ContinueStmtAST::codegen() {
+llvm::Value *ContinueStmtAST::codegen(CompilerContext &Ctx) {
     if (Target.has_value()) {
-        if (!LoopTable.contains(Target.value()))
+        if (!Ctx.LoopTable.contains(Target.value()))
             babel_panic("undefined loop label");
 
-        Builder->CreateBr(LoopTable.at(Target.value()).__continue__);
+        Ctx.Builder->CreateBr(Ctx.LoopTable.at(Target.value()).__continue__);
     } else {
-        if (LoopTable.at(".active").__continue__ == nullptr)
+        if (Ctx.LoopTable.at(".active").__continue__ == nullptr)
             babel_panic("continue statement outside of loop not allowed");
         
-        Builder->CreateBr(LoopTable.at(".active").__continue__);
+        Ctx.Builder->CreateBr(Ctx.LoopTable.at(".active").__continue__);
     }
 
     return nullptr;
 }
 
-llvm::Value *BreakStmtAST::codegen() {
+llvm::Value *BreakStmtAST::codegen(CompilerContext &Ctx) {
     if (Target.has_value()) {
-        if (!LoopTable.contains(Target.value()))
+        if (!Ctx.LoopTable.contains(Target.value()))
             babel_panic("undefined loop label");
 
-        Builder->CreateBr(LoopTable.at(Target.value()).__break__);
+        Ctx.Builder->CreateBr(Ctx.LoopTable.at(Target.value()).__break__);
     } else {
-        if (LoopTable.at(".active").__break__ == nullptr)
+        if (Ctx.LoopTable.at(".active").__break__ == nullptr)
             babel_panic("break statement outside of loop not allowed");
         
-        Builder->CreateBr(LoopTable.at(".active").__break__);
+        Ctx.Builder->CreateBr(Ctx.LoopTable.at(".active").__break__);
     }
 
     return nullptr;
 }
 
-llvm::Value *ReturnStmtAST::codegen() {
-    const llvm::Function *TheFunction = Builder->GetInsertBlock()->getParent();
+llvm::Value *ReturnStmtAST::codegen(CompilerContext &Ctx) {
+    const llvm::Function *TheFunction = Ctx.Builder->GetInsertBlock()->getParent();
     if (GLOBAL_SCOPE)
         babel_panic("Return statements must be inside of a task");
 
     if (Expr) {
-        llvm::Value *RetVal = Expr->codegen();
-        if (canImplicitCast(Expr->getType(), TaskTable.at(TheFunction->getName().str()).ret)) {
-            RetVal = performImplicitCast(RetVal, Expr->getType(), TaskTable.at(TheFunction->getName().str()).ret);
-            Builder->CreateRet(RetVal);
+        llvm::Value *RetVal = Expr->codegen(Ctx);
+        if (canImplicitCast(Expr->getType(Ctx), Ctx.TaskTable.at(TheFunction->getName().str()).ret)) {
+            RetVal = performImplicitCast(*Ctx.Builder, RetVal, Expr->getType(Ctx), Ctx.TaskTable.at(TheFunction->getName().str()).ret);
+            Ctx.Builder->CreateRet(RetVal);
         } else {
             babel_panic("Task return type does not match returned value (returned %s but expected %s); implicit cast failed or is not allowed", 
-                getBabelTypeName(Expr->getType()).c_str(), getBabelTypeName(TaskTable.at(TheFunction->getName().str()).ret).c_str());
+                getBabelTypeName(Expr->getType(Ctx)).c_str(), getBabelTypeName(Ctx.TaskTable.at(TheFunction->getName().str()).ret).c_str());
         }
     } else {
-        Builder->CreateRetVoid();
+        Ctx.Builder->CreateRetVoid();
     }
 
     return nullptr;
 }
 
-llvm::Value *GotoStmtAST::codegen() {
-    if (!LabelTable.contains(Target)) {
-        //llvm::Function* TheFunction = Builder->GetInsertBlock()->getParent();
-        llvm::BasicBlock* TargetBB = llvm::BasicBlock::Create(*TheContext, Target);
-        LabelTable[Target] = TargetBB;
+llvm::Value *GotoStmtAST::codegen(CompilerContext &Ctx) {
+    if (!Ctx.LabelTable.contains(Target)) {
+        //llvm::Function* TheFunction = Ctx.Builder->GetInsertBlock()->getParent();
+        llvm::BasicBlock* TargetBB = llvm::BasicBlock::Create(*Ctx.Context, Target);
+        Ctx.LabelTable[Target] = TargetBB;
     }
 
-    Builder->CreateBr(LabelTable[Target]);
+    Ctx.Builder->CreateBr(Ctx.LabelTable[Target]);
 
     // After a branch, we need to insert a new block for further instructions (if any)
-    // llvm::BasicBlock* DeadBB = llvm::BasicBlock::Create(*TheContext, "after_goto", Builder->GetInsertBlock()->getParent());
-    // Builder->SetInsertPoint(DeadBB);
+    // llvm::BasicBlock* DeadBB = llvm::BasicBlock::Create(*Ctx.Context, "after_goto", Ctx.Builder->GetInsertBlock()->getParent());
+    // Ctx.Builder->SetInsertPoint(DeadBB);
 
-    return nullptr; //llvm::Constant::getNullValue(llvm::Type::getVoidTy(*TheContext));
+    return nullptr; //llvm::Constant::getNullValue(llvm::Type::getVoidTy(*Ctx.Context));
 }
 
-llvm::Value* LabelStmtAST::codegen() {
-    llvm::Function* TheFunction = Builder->GetInsertBlock()->getParent();
+llvm::Value* LabelStmtAST::codegen(CompilerContext &Ctx) {
+    llvm::Function* TheFunction = Ctx.Builder->GetInsertBlock()->getParent();
 
     // If label doesn't exist, create it
-    if (!LabelTable.contains(Name)) {
-        llvm::BasicBlock* LabelBB = llvm::BasicBlock::Create(*TheContext, Name, TheFunction);
-        LabelTable[Name] = LabelBB;
+    if (!Ctx.LabelTable.contains(Name)) {
+        llvm::BasicBlock* LabelBB = llvm::BasicBlock::Create(*Ctx.Context, Name, TheFunction);
+        Ctx.LabelTable[Name] = LabelBB;
     } else {
         // If block was created ahead of time for a goto, just insert it into function now
-        if (LabelTable[Name]->getParent() == TheFunction) 
+        if (Ctx.LabelTable[Name]->getParent() == TheFunction) 
             babel_panic("Label was possibly inserted twice");
 
-        TheFunction->insert(TheFunction->end(), LabelTable[Name]);
+        TheFunction->insert(TheFunction->end(), Ctx.LabelTable[Name]);
     }
 
     // Move the builder to the label
-    Builder->CreateBr(LabelTable[Name]);
-    Builder->SetInsertPoint(LabelTable[Name]);
+    Ctx.Builder->CreateBr(Ctx.LabelTable[Name]);
+    Ctx.Builder->SetInsertPoint(Ctx.LabelTable[Name]);
 
-    return nullptr; //llvm::Constant::getNullValue(llvm::Type::getVoidTy(*TheContext));
+    return nullptr; //llvm::Constant::getNullValue(llvm::Type::getVoidTy(*Ctx.Context));
 }
 
-llvm::Value *BlockAST::codegen() {
+llvm::Value *BlockAST::codegen(CompilerContext &Ctx) {
     llvm::Value *Last = nullptr;
     for (const auto& Stmt : Statements) {
-        Last = Stmt->codegen();
+        Last = Stmt->codegen(Ctx);
         //if (!Last)
         //    return nullptr;
     }
@@ -1290,216 +1347,216 @@ llvm::Value *BlockAST::codegen() {
     return Last;
 }
 
-llvm::Value *IfStmtAST::codegen() {
-    llvm::Value* CondV = Cond->codegen();
+llvm::Value *IfStmtAST::codegen(CompilerContext &Ctx) {
+    llvm::Value* CondV = Cond->codegen(Ctx);
     if (!CondV)
         return nullptr;
 
     if (!CondV->getType()->isIntegerTy(1))
         babel_panic("Condition of if statement does not meet requirement: Boolean Type");
 
-    if (!Builder->GetInsertBlock())
+    if (!Ctx.Builder->GetInsertBlock())
         babel_panic("InsertBlock is nullptr (global level)");
 
-    llvm::Function *TheFunction = Builder->GetInsertBlock()->getParent();
-    llvm::BasicBlock *ThenBB = llvm::BasicBlock::Create(*TheContext, "then", TheFunction);
-    llvm::BasicBlock *ElseBB = llvm::BasicBlock::Create(*TheContext, "else");
-    llvm::BasicBlock *MergeBB = llvm::BasicBlock::Create(*TheContext, "ifcont");
+    llvm::Function *TheFunction = Ctx.Builder->GetInsertBlock()->getParent();
+    llvm::BasicBlock *ThenBB = llvm::BasicBlock::Create(*Ctx.Context, "then", TheFunction);
+    llvm::BasicBlock *ElseBB = llvm::BasicBlock::Create(*Ctx.Context, "else");
+    llvm::BasicBlock *MergeBB = llvm::BasicBlock::Create(*Ctx.Context, "ifcont");
 
-    Builder->CreateCondBr(CondV, ThenBB, ElseBB);
+    Ctx.Builder->CreateCondBr(CondV, ThenBB, ElseBB);
 
     // then block
-    Builder->SetInsertPoint(ThenBB);
-    Then->codegen();
-    /* if (!Then->codegen())
+    Ctx.Builder->SetInsertPoint(ThenBB);
+    Then->codegen(Ctx);
+    /* if (!Then->codegen(Ctx))
         return nullptr; */
 
-    Builder->CreateBr(MergeBB);
-    ThenBB = Builder->GetInsertBlock();
+    branchUnlessTerminated(Ctx, MergeBB);
+    ThenBB = Ctx.Builder->GetInsertBlock();
 
     // else block
     TheFunction->insert(TheFunction->end(), ElseBB);
-    Builder->SetInsertPoint(ElseBB);
-    if (Else && !Else->codegen()) // panic instead
+    Ctx.Builder->SetInsertPoint(ElseBB);
+    if (Else && !Else->codegen(Ctx)) // panic instead
         return nullptr;
 
-    Builder->CreateBr(MergeBB);
-    ElseBB = Builder->GetInsertBlock();
+    branchUnlessTerminated(Ctx, MergeBB);
+    ElseBB = Ctx.Builder->GetInsertBlock();
 
     TheFunction->insert(TheFunction->end(), MergeBB);
-    Builder->SetInsertPoint(MergeBB);
+    Ctx.Builder->SetInsertPoint(MergeBB);
 
-    return nullptr; //llvm::Constant::getNullValue(llvm::Type::getVoidTy(*TheContext));
+    return nullptr; //llvm::Constant::getNullValue(llvm::Type::getVoidTy(*Ctx.Context));
 }
 
-llvm::Value *WhileLoopAST::codegen() {
-    llvm::Function *TheFunction = Builder->GetInsertBlock()->getParent();
-    llvm::BasicBlock *CondBB = llvm::BasicBlock::Create(*TheContext, "for.cond", TheFunction);
-    llvm::BasicBlock *BodyBB = llvm::BasicBlock::Create(*TheContext, "for.body");
-    llvm::BasicBlock *EndBB = llvm::BasicBlock::Create(*TheContext, "for.end");
+llvm::Value *WhileLoopAST::codegen(CompilerContext &Ctx) {
+    llvm::Function *TheFunction = Ctx.Builder->GetInsertBlock()->getParent();
+    llvm::BasicBlock *CondBB = llvm::BasicBlock::Create(*Ctx.Context, "for.cond", TheFunction);
+    llvm::BasicBlock *BodyBB = llvm::BasicBlock::Create(*Ctx.Context, "for.body");
+    llvm::BasicBlock *EndBB = llvm::BasicBlock::Create(*Ctx.Context, "for.end");
 
-    LoopInfo previous = LoopTable.at(".active");
-    LoopTable[".active"] = {CondBB, EndBB};
+    LoopInfo previous = Ctx.LoopTable.at(".active");
+    Ctx.LoopTable[".active"] = {CondBB, EndBB};
 
     if (Label.has_value()) {
-        if (LoopTable.contains(Label.value()))
+        if (Ctx.LoopTable.contains(Label.value()))
             babel_panic("loop label already exists in outer loop");
 
-        LoopTable[Label.value()] = {CondBB, EndBB};
+        Ctx.LoopTable[Label.value()] = {CondBB, EndBB};
     }
 
-    Builder->CreateBr(CondBB);
-    Builder->SetInsertPoint(CondBB);
+    Ctx.Builder->CreateBr(CondBB);
+    Ctx.Builder->SetInsertPoint(CondBB);
 
-    llvm::Value* CondV = Cond->codegen();
+    llvm::Value* CondV = Cond->codegen(Ctx);
 
     if (!CondV->getType()->isIntegerTy(1))
         babel_panic("loop condition doesn't meet requirement: Boolean Type");
 
-    Builder->CreateCondBr(CondV, BodyBB, EndBB);
+    Ctx.Builder->CreateCondBr(CondV, BodyBB, EndBB);
 
     TheFunction->insert(TheFunction->end(), BodyBB);
-    Builder->SetInsertPoint(BodyBB);
-    Body->codegen();
-    Builder->CreateBr(CondBB);
+    Ctx.Builder->SetInsertPoint(BodyBB);
+    Body->codegen(Ctx);
+    branchUnlessTerminated(Ctx, CondBB);
 
     TheFunction->insert(TheFunction->end(), EndBB);
-    Builder->SetInsertPoint(EndBB);
+    Ctx.Builder->SetInsertPoint(EndBB);
 
-    LoopTable[".active"] = previous;
+    Ctx.LoopTable[".active"] = previous;
     if (Label.has_value())
-        LoopTable.erase(Label.value());
+        Ctx.LoopTable.erase(Label.value());
 
     return nullptr;
 }
 
-llvm::Value *ForLoopAST::codegen() {
-    llvm::Function *TheFunction = Builder->GetInsertBlock()->getParent();
-    llvm::BasicBlock *CondBB = llvm::BasicBlock::Create(*TheContext, "for.cond", TheFunction);
-    llvm::BasicBlock *BodyBB = llvm::BasicBlock::Create(*TheContext, "for.body");
-    llvm::BasicBlock *UpdateBB = llvm::BasicBlock::Create(*TheContext, "for.inc");
-    llvm::BasicBlock *EndBB = llvm::BasicBlock::Create(*TheContext, "for.end");
+llvm::Value *ForLoopAST::codegen(CompilerContext &Ctx) {
+    llvm::Function *TheFunction = Ctx.Builder->GetInsertBlock()->getParent();
+    llvm::BasicBlock *CondBB = llvm::BasicBlock::Create(*Ctx.Context, "for.cond", TheFunction);
+    llvm::BasicBlock *BodyBB = llvm::BasicBlock::Create(*Ctx.Context, "for.body");
+    llvm::BasicBlock *UpdateBB = llvm::BasicBlock::Create(*Ctx.Context, "for.inc");
+    llvm::BasicBlock *EndBB = llvm::BasicBlock::Create(*Ctx.Context, "for.end");
 
-    LoopInfo previous = LoopTable.at(".active");
-    LoopTable[".active"] = {UpdateBB, EndBB};
+    LoopInfo previous = Ctx.LoopTable.at(".active");
+    Ctx.LoopTable[".active"] = {UpdateBB, EndBB};
 
     if (Label.has_value()) {
-        if (LoopTable.contains(Label.value()))
+        if (Ctx.LoopTable.contains(Label.value()))
             babel_panic("loop label already exists in outer loop");
 
-        LoopTable[Label.value()] = {UpdateBB, EndBB};
+        Ctx.LoopTable[Label.value()] = {UpdateBB, EndBB};
     }
 
-    Init->codegen();
-    Builder->CreateBr(CondBB);
-    Builder->SetInsertPoint(CondBB);
+    Init->codegen(Ctx);
+    Ctx.Builder->CreateBr(CondBB);
+    Ctx.Builder->SetInsertPoint(CondBB);
 
-    llvm::Value* CondV = Cond->codegen();
+    llvm::Value* CondV = Cond->codegen(Ctx);
 
     if (!CondV->getType()->isIntegerTy(1))
         babel_panic("loop condition doesn't meet requirement: Boolean Type");
 
-    Builder->CreateCondBr(CondV, BodyBB, EndBB);
+    Ctx.Builder->CreateCondBr(CondV, BodyBB, EndBB);
 
     TheFunction->insert(TheFunction->end(), BodyBB);
-    Builder->SetInsertPoint(BodyBB);
-    Body->codegen();
-    Builder->CreateBr(UpdateBB);
+    Ctx.Builder->SetInsertPoint(BodyBB);
+    Body->codegen(Ctx);
+    branchUnlessTerminated(Ctx, UpdateBB);
 
     TheFunction->insert(TheFunction->end(), UpdateBB);
-    Builder->SetInsertPoint(UpdateBB);
-    Update->codegen();
-    Builder->CreateBr(CondBB);
+    Ctx.Builder->SetInsertPoint(UpdateBB);
+    Update->codegen(Ctx);
+    Ctx.Builder->CreateBr(CondBB);
 
     TheFunction->insert(TheFunction->end(), EndBB);
-    Builder->SetInsertPoint(EndBB);
+    Ctx.Builder->SetInsertPoint(EndBB);
 
-    LoopTable[".active"] = previous;
+    Ctx.LoopTable[".active"] = previous;
     if (Label.has_value())
-        LoopTable.erase(Label.value());
+        Ctx.LoopTable.erase(Label.value());
 
     return nullptr;
 }
 
-llvm::Value *ForInLoopAST::codegen() {
-    llvm::Function *TheFunction = Builder->GetInsertBlock()->getParent();
-    llvm::BasicBlock *CondBB = llvm::BasicBlock::Create(*TheContext, "for.cond", TheFunction);
-    llvm::BasicBlock *BodyBB = llvm::BasicBlock::Create(*TheContext, "for.body");
-    llvm::BasicBlock *UpdateBB = llvm::BasicBlock::Create(*TheContext, "for.inc");
-    llvm::BasicBlock *EndBB = llvm::BasicBlock::Create(*TheContext, "for.end");
+llvm::Value *ForInLoopAST::codegen(CompilerContext &Ctx) {
+    llvm::Function *TheFunction = Ctx.Builder->GetInsertBlock()->getParent();
+    llvm::BasicBlock *CondBB = llvm::BasicBlock::Create(*Ctx.Context, "for.cond", TheFunction);
+    llvm::BasicBlock *BodyBB = llvm::BasicBlock::Create(*Ctx.Context, "for.body");
+    llvm::BasicBlock *UpdateBB = llvm::BasicBlock::Create(*Ctx.Context, "for.inc");
+    llvm::BasicBlock *EndBB = llvm::BasicBlock::Create(*Ctx.Context, "for.end");
 
-    LoopInfo previous = LoopTable.at(".active");
-    LoopTable[".active"] = {UpdateBB, EndBB};
+    LoopInfo previous = Ctx.LoopTable.at(".active");
+    Ctx.LoopTable[".active"] = {UpdateBB, EndBB};
 
     if (Label.has_value()) {
-        if (LoopTable.contains(Label.value()))
+        if (Ctx.LoopTable.contains(Label.value()))
             babel_panic("loop label already exists in outer loop");
 
-        LoopTable[Label.value()] = {UpdateBB, EndBB};
+        Ctx.LoopTable[Label.value()] = {UpdateBB, EndBB};
     }
 
-    if (!Collection->getType().isArray())
+    if (!Collection->getType(Ctx).isArray())
         babel_panic("for in loop must use iterable collection");
     
     // alternatively an iterator type
-    llvm::AllocaInst* it = Builder->CreateAlloca(llvm::PointerType::getUnqual(*TheContext), nullptr, "it");
-    llvm::AllocaInst* end = Builder->CreateAlloca(llvm::PointerType::getUnqual(*TheContext), nullptr, "end");
+    llvm::AllocaInst* it = createEntryBlockAlloca(Ctx, llvm::PointerType::getUnqual(*Ctx.Context), "it");
+    llvm::AllocaInst* end = createEntryBlockAlloca(Ctx, llvm::PointerType::getUnqual(*Ctx.Context), "end");
 
-    llvm::Value* zero = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*TheContext), 0);
-    llvm::Value* length = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*TheContext), Collection->getType().getArray().size);
+    llvm::Value* zero = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*Ctx.Context), 0);
+    llvm::Value* length = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*Ctx.Context), Collection->getType(Ctx).getArray().size);
 
     // alternatively call Iterable.begin()
-    llvm::Value* front = Builder->CreateInBoundsGEP(resolveLLVMType(Collection->getType()), Collection->requireLValue(), {zero, zero});
-    Builder->CreateStore(front, it);
+    llvm::Value* front = Ctx.Builder->CreateInBoundsGEP(resolveLLVMType(*Ctx.Context, Collection->getType(Ctx)), Collection->requireLValue(Ctx), {zero, zero});
+    Ctx.Builder->CreateStore(front, it);
 
     // alternatively call Iterable.end()
-    llvm::Value* back = Builder->CreateInBoundsGEP(resolveLLVMType(Collection->getType()), Collection->requireLValue(), {zero, length});
-    Builder->CreateStore(back, end);
+    llvm::Value* back = Ctx.Builder->CreateInBoundsGEP(resolveLLVMType(*Ctx.Context, Collection->getType(Ctx)), Collection->requireLValue(Ctx), {zero, length});
+    Ctx.Builder->CreateStore(back, end);
 
-    Builder->CreateBr(CondBB);
-    Builder->SetInsertPoint(CondBB);
+    Ctx.Builder->CreateBr(CondBB);
+    Ctx.Builder->SetInsertPoint(CondBB);
 
     // alternatively Iterator.__operator_compare(it, end) != 0
-    llvm::Value *comp = Builder->CreateICmpNE(Builder->CreateLoad(llvm::PointerType::getUnqual(*TheContext), it), Builder->CreateLoad(llvm::PointerType::getUnqual(*TheContext), end), "cmp");
+    llvm::Value *comp = Ctx.Builder->CreateICmpNE(Ctx.Builder->CreateLoad(llvm::PointerType::getUnqual(*Ctx.Context), it), Ctx.Builder->CreateLoad(llvm::PointerType::getUnqual(*Ctx.Context), end), "cmp");
 
-    Builder->CreateCondBr(comp, BodyBB, EndBB);
+    Ctx.Builder->CreateCondBr(comp, BodyBB, EndBB);
 
     TheFunction->insert(TheFunction->end(), BodyBB);
-    Builder->SetInsertPoint(BodyBB);
+    Ctx.Builder->SetInsertPoint(BodyBB);
 
-    const auto *Var = dynamic_cast<VariableAST*>(Elmnt.get());
-    llvm::AllocaInst* a = Builder->CreateAlloca(resolveLLVMType(*Collection->getType().getArray().inner), nullptr, Var->getName());
-    NamedValues[Var->getName()] = {a, *Collection->getType().getArray().inner, false};
+    const auto *Var = dynamic_cast<VariableAST*>(Elmnt);
+    llvm::AllocaInst* a = createEntryBlockAlloca(Ctx, resolveLLVMType(*Ctx.Context, *Collection->getType(Ctx).getArray().inner), Var->getName());
+    Ctx.NamedValues[Var->getName()] = {a, *Collection->getType(Ctx).getArray().inner, false};
     // manual dereference, alternatively call Iterator.current()
-    Builder->CreateStore(Builder->CreateLoad(resolveLLVMType(*Collection->getType().getArray().inner), Builder->CreateLoad(llvm::PointerType::getUnqual(*TheContext), it)), a);
-    Body->codegen();
+    Ctx.Builder->CreateStore(Ctx.Builder->CreateLoad(resolveLLVMType(*Ctx.Context, *Collection->getType(Ctx).getArray().inner), Ctx.Builder->CreateLoad(llvm::PointerType::getUnqual(*Ctx.Context), it)), a);
+    Body->codegen(Ctx);
     
-    Builder->CreateBr(UpdateBB);
+    branchUnlessTerminated(Ctx, UpdateBB);
 
     TheFunction->insert(TheFunction->end(), UpdateBB);
-    Builder->SetInsertPoint(UpdateBB);
+    Ctx.Builder->SetInsertPoint(UpdateBB);
 
     // alternatively call Iterator.advance()
-    llvm::Value* it1 = Builder->CreateLoad(llvm::PointerType::getUnqual(*TheContext), it);
-    llvm::Value* one = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*TheContext), 1);
-    llvm::Value* incDec = Builder->CreateInBoundsGEP(llvm::Type::getInt32Ty(*TheContext), it1, {one}, "incdec");
-    Builder->CreateStore(incDec, it);
+    llvm::Value* it1 = Ctx.Builder->CreateLoad(llvm::PointerType::getUnqual(*Ctx.Context), it);
+    llvm::Value* one = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*Ctx.Context), 1);
+    llvm::Value* incDec = Ctx.Builder->CreateInBoundsGEP(llvm::Type::getInt32Ty(*Ctx.Context), it1, {one}, "incdec");
+    Ctx.Builder->CreateStore(incDec, it);
     
-    Builder->CreateBr(CondBB);
+    Ctx.Builder->CreateBr(CondBB);
 
     TheFunction->insert(TheFunction->end(), EndBB);
-    Builder->SetInsertPoint(EndBB);
+    Ctx.Builder->SetInsertPoint(EndBB);
 
-    LoopTable[".active"] = previous;
+    Ctx.LoopTable[".active"] = previous;
     if (Label.has_value())
-        LoopTable.erase(Label.value());
+        Ctx.LoopTable.erase(Label.value());
 
     return nullptr;
 }
 
-BabelType MacroCallAST::getType() const {
+BabelType MacroCallAST::getType(CompilerContext &Ctx) const {
     if (name == "va_arg") {
-        if (Args.size() != 2 || !std::holds_alternative<std::unique_ptr<BaseAST>>(Args[0]) || !std::holds_alternative<BabelType>(Args[1]))
+        if (Args.size() != 2 || !std::holds_alternative<BaseAST*>(Args[0]) || !std::holds_alternative<BabelType>(Args[1]))
             babel_panic("@va_arg requires list name and type parameter");
         
         return std::get<BabelType>(Args[1]);
@@ -1508,155 +1565,155 @@ BabelType MacroCallAST::getType() const {
     }
 }
 
-llvm::Value *MacroCallAST::codegen() {
+llvm::Value *MacroCallAST::codegen(CompilerContext &Ctx) {
     if (name == "va_list") {
 
         #if defined(_M_ARM64) || defined(__aarch64__)
-            #define __BUILTIN_VA_LIST llvm::StructType::get(*TheContext, {\
-                llvm::PointerType::get(*TheContext, 0),\
-                llvm::PointerType::get(*TheContext, 0),\
-                llvm::PointerType::get(*TheContext, 0),\
-                llvm::IntegerType::getInt32Ty(*TheContext),\
-                llvm::IntegerType::getInt32Ty(*TheContext)\
+            #define __BUILTIN_VA_LIST llvm::StructType::get(*Ctx.Context, {\
+                llvm::PointerType::get(*Ctx.Context, 0),\
+                llvm::PointerType::get(*Ctx.Context, 0),\
+                llvm::PointerType::get(*Ctx.Context, 0),\
+                llvm::IntegerType::getInt32Ty(*Ctx.Context),\
+                llvm::IntegerType::getInt32Ty(*Ctx.Context)\
             })
         #elif defined(_WIN32) || defined(__i386__)
-            #define __BUILTIN_VA_LIST llvm::PointerType::get(*TheContext, 0)
+            #define __BUILTIN_VA_LIST llvm::PointerType::get(*Ctx.Context, 0)
         #elif defined(__powerpc__)
-            #define __BUILTIN_VA_LIST llvm::ArrayType::get(llvm::StructType::get(*TheContext, {\
-                llvm::IntegerType::getInt8Ty(*TheContext),\
-                llvm::IntegerType::getInt8Ty(*TheContext),\
-                llvm::IntegerType::getInt16Ty(*TheContext),\
-                llvm::PointerType::get(*TheContext, 0),\
-                llvm::PointerType::get(*TheContext, 0)\
+            #define __BUILTIN_VA_LIST llvm::ArrayType::get(llvm::StructType::get(*Ctx.Context, {\
+                llvm::IntegerType::getInt8Ty(*Ctx.Context),\
+                llvm::IntegerType::getInt8Ty(*Ctx.Context),\
+                llvm::IntegerType::getInt16Ty(*Ctx.Context),\
+                llvm::PointerType::get(*Ctx.Context, 0),\
+                llvm::PointerType::get(*Ctx.Context, 0)\
             }), 1)
         #elif defined(__s390__) || defined(__zarch__)
-            #define __BUILTIN_VA_LIST llvm::ArrayType::get(llvm::StructType::get(*TheContext, {\
-                llvm::IntegerType::getInt64Ty(*TheContext),\
-                llvm::IntegerType::getInt64Ty(*TheContext),\
-                llvm::PointerType::get(*TheContext, 0),\
-                llvm::PointerType::get(*TheContext, 0)\
+            #define __BUILTIN_VA_LIST llvm::ArrayType::get(llvm::StructType::get(*Ctx.Context, {\
+                llvm::IntegerType::getInt64Ty(*Ctx.Context),\
+                llvm::IntegerType::getInt64Ty(*Ctx.Context),\
+                llvm::PointerType::get(*Ctx.Context, 0),\
+                llvm::PointerType::get(*Ctx.Context, 0)\
             }), 1)
         #elif defined(__hexagon__)
-            #define __BUILTIN_VA_LIST llvm::StructType::get(*TheContext, {\
-                llvm::PointerType::get(*TheContext, 0),\
-                llvm::PointerType::get(*TheContext, 0),\
-                llvm::PointerType::get(*TheContext, 0)\
+            #define __BUILTIN_VA_LIST llvm::StructType::get(*Ctx.Context, {\
+                llvm::PointerType::get(*Ctx.Context, 0),\
+                llvm::PointerType::get(*Ctx.Context, 0),\
+                llvm::PointerType::get(*Ctx.Context, 0)\
             })
         #elif defined(__xtensa__)
-            #define __BUILTIN_VA_LIST llvm::StructType::get(*TheContext, {\
-                llvm::PointerType::get(*TheContext, 0),\
-                llvm::PointerType::get(*TheContext, 0),\
-                llvm::IntegerType::getInt32Ty(*TheContext)\
+            #define __BUILTIN_VA_LIST llvm::StructType::get(*Ctx.Context, {\
+                llvm::PointerType::get(*Ctx.Context, 0),\
+                llvm::PointerType::get(*Ctx.Context, 0),\
+                llvm::IntegerType::getInt32Ty(*Ctx.Context)\
             })
         #elif defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
-            #define __BUILTIN_VA_LIST llvm::ArrayType::get(llvm::StructType::get(*TheContext, {\
-                llvm::IntegerType::getInt32Ty(*TheContext),\
-                llvm::IntegerType::getInt32Ty(*TheContext),\
-                llvm::PointerType::get(*TheContext, 0),\
-                llvm::PointerType::get(*TheContext, 0)\
+            #define __BUILTIN_VA_LIST llvm::ArrayType::get(llvm::StructType::get(*Ctx.Context, {\
+                llvm::IntegerType::getInt32Ty(*Ctx.Context),\
+                llvm::IntegerType::getInt32Ty(*Ctx.Context),\
+                llvm::PointerType::get(*Ctx.Context, 0),\
+                llvm::PointerType::get(*Ctx.Context, 0)\
             }), 1)
         #else
             // most other platforms like ARM32 just use a { ptr }, so thats our best guess
-            #define __BUILTIN_VA_LIST llvm::StructType::get(*TheContext, llvm::ArrayRef<llvm::Type*>{llvm::PointerType::get(*TheContext, 0)})
+            #define __BUILTIN_VA_LIST llvm::StructType::get(*Ctx.Context, llvm::ArrayRef<llvm::Type*>{llvm::PointerType::get(*Ctx.Context, 0)})
         #endif
 
-        llvm::AllocaInst* ap = Builder->CreateAlloca(__BUILTIN_VA_LIST);
+        llvm::AllocaInst* ap = Ctx.Builder->CreateAlloca(__BUILTIN_VA_LIST);
 
-        if (Args.size() != 1 || !std::holds_alternative<std::unique_ptr<BaseAST>>(Args[0]))
+        if (Args.size() != 1 || !std::holds_alternative<BaseAST*>(Args[0]))
             babel_panic("@va_list requires name parameter");
 
-        auto var = dynamic_cast<VariableAST*>(std::get<std::unique_ptr<BaseAST>>(Args[0]).get());
-        NamedValues[var->getName()] = {ap, BabelType::Pointer(TheArena.make(BabelType::Void()), true), true};
+        auto var = dynamic_cast<VariableAST*>(std::get<BaseAST*>(Args[0]));
+        Ctx.NamedValues[var->getName()] = {ap, BabelType::Pointer(Ctx.Arena.make(BabelType::Void()), true), true};
 
         return nullptr;
     } else if (name == "va_start") {
-        llvm::Function* va_start = llvm::Intrinsic::getDeclaration(TheModule.get(), llvm::Intrinsic::vastart, {llvm::PointerType::get(*TheContext, 0)});
+        llvm::Function* va_start = llvm::Intrinsic::getDeclaration(Ctx.Module.get(), llvm::Intrinsic::vastart, {llvm::PointerType::get(*Ctx.Context, 0)});
         
-        if (Args.size() != 1 || !std::holds_alternative<std::unique_ptr<BaseAST>>(Args[0]))
+        if (Args.size() != 1 || !std::holds_alternative<BaseAST*>(Args[0]))
             babel_panic("@va_start requires name parameter");
 
-        auto var = dynamic_cast<VariableAST*>(std::get<std::unique_ptr<BaseAST>>(Args[0]).get());
-        llvm::Value* ap = NamedValues.at(var->getName()).val;
+        auto var = dynamic_cast<VariableAST*>(std::get<BaseAST*>(Args[0]));
+        llvm::Value* ap = Ctx.NamedValues.at(var->getName()).val;
 
         if (llvm::Type* type = ap->getType(); type->isArrayTy()) {
-            llvm::Value* zero = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*TheContext), 0);
-            ap = Builder->CreateInBoundsGEP(type, ap, {zero, zero});
+            llvm::Value* zero = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*Ctx.Context), 0);
+            ap = Ctx.Builder->CreateInBoundsGEP(type, ap, {zero, zero});
         }
 
-        Builder->CreateCall(va_start, {ap});
+        Ctx.Builder->CreateCall(va_start, {ap});
         return nullptr;
     } else if (name == "va_end") {
-        llvm::Function* va_end = llvm::Intrinsic::getDeclaration(TheModule.get(), llvm::Intrinsic::vaend, {llvm::PointerType::get(*TheContext, 0)});
+        llvm::Function* va_end = llvm::Intrinsic::getDeclaration(Ctx.Module.get(), llvm::Intrinsic::vaend, {llvm::PointerType::get(*Ctx.Context, 0)});
         
-        if (Args.size() != 1 || !std::holds_alternative<std::unique_ptr<BaseAST>>(Args[0]))
+        if (Args.size() != 1 || !std::holds_alternative<BaseAST*>(Args[0]))
             babel_panic("@va_end requires name parameter");
 
-        auto var = dynamic_cast<VariableAST*>(std::get<std::unique_ptr<BaseAST>>(Args[0]).get());
-        llvm::Value* ap = NamedValues.at(var->getName()).val;
+        auto var = dynamic_cast<VariableAST*>(std::get<BaseAST*>(Args[0]));
+        llvm::Value* ap = Ctx.NamedValues.at(var->getName()).val;
 
         if (llvm::Type* type = ap->getType(); type->isArrayTy()) {
-            llvm::Value* zero = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*TheContext), 0);
-            ap = Builder->CreateInBoundsGEP(type, ap, {zero, zero});
+            llvm::Value* zero = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*Ctx.Context), 0);
+            ap = Ctx.Builder->CreateInBoundsGEP(type, ap, {zero, zero});
         }
 
-        Builder->CreateCall(va_end, {ap});
+        Ctx.Builder->CreateCall(va_end, {ap});
         return nullptr;
     } else if (name == "va_copy") {
-        llvm::Function* va_copy = llvm::Intrinsic::getDeclaration(TheModule.get(), llvm::Intrinsic::vacopy, {llvm::PointerType::get(*TheContext, 0), llvm::PointerType::get(*TheContext, 0)});
+        llvm::Function* va_copy = llvm::Intrinsic::getDeclaration(Ctx.Module.get(), llvm::Intrinsic::vacopy, {llvm::PointerType::get(*Ctx.Context, 0), llvm::PointerType::get(*Ctx.Context, 0)});
         
-        if (Args.size() != 2 || !std::holds_alternative<std::unique_ptr<BaseAST>>(Args[0]) || !std::holds_alternative<std::unique_ptr<BaseAST>>(Args[1]))
+        if (Args.size() != 2 || !std::holds_alternative<BaseAST*>(Args[0]) || !std::holds_alternative<BaseAST*>(Args[1]))
             babel_panic("@va_copy requires destination and source parameter");
 
-        auto dst = dynamic_cast<VariableAST*>(std::get<std::unique_ptr<BaseAST>>(Args[0]).get());
-        auto src = dynamic_cast<VariableAST*>(std::get<std::unique_ptr<BaseAST>>(Args[1]).get());
-        llvm::Value* ap = NamedValues.at(dst->getName()).val;
-        llvm::Value* aq = NamedValues.at(src->getName()).val;
+        auto dst = dynamic_cast<VariableAST*>(std::get<BaseAST*>(Args[0]));
+        auto src = dynamic_cast<VariableAST*>(std::get<BaseAST*>(Args[1]));
+        llvm::Value* ap = Ctx.NamedValues.at(dst->getName()).val;
+        llvm::Value* aq = Ctx.NamedValues.at(src->getName()).val;
 
         if (llvm::Type* type = ap->getType(); type->isArrayTy()) {
-            llvm::Value* zero = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*TheContext), 0);
-            ap = Builder->CreateInBoundsGEP(type, ap, {zero, zero});
-            aq = Builder->CreateInBoundsGEP(type, aq, {zero, zero});
+            llvm::Value* zero = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*Ctx.Context), 0);
+            ap = Ctx.Builder->CreateInBoundsGEP(type, ap, {zero, zero});
+            aq = Ctx.Builder->CreateInBoundsGEP(type, aq, {zero, zero});
         }
 
-        Builder->CreateCall(va_copy, {ap, aq});
+        Ctx.Builder->CreateCall(va_copy, {ap, aq});
         return nullptr;
     } else if (name == "va_arg") {
-        if (Args.size() != 2 || !std::holds_alternative<std::unique_ptr<BaseAST>>(Args[0]) || !std::holds_alternative<BabelType>(Args[1]))
+        if (Args.size() != 2 || !std::holds_alternative<BaseAST*>(Args[0]) || !std::holds_alternative<BabelType>(Args[1]))
             babel_panic("@va_arg requires list name and type parameter");
 
-        auto var = dynamic_cast<VariableAST*>(std::get<std::unique_ptr<BaseAST>>(Args[0]).get());
-        llvm::Value* ap = NamedValues.at(var->getName()).val;
+        auto var = dynamic_cast<VariableAST*>(std::get<BaseAST*>(Args[0]));
+        llvm::Value* ap = Ctx.NamedValues.at(var->getName()).val;
 
         if (llvm::Type* type = ap->getType(); type->isArrayTy()) {
-            llvm::Value* zero = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*TheContext), 0);
-            ap = Builder->CreateInBoundsGEP(type, ap, {zero, zero});
+            llvm::Value* zero = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*Ctx.Context), 0);
+            ap = Ctx.Builder->CreateInBoundsGEP(type, ap, {zero, zero});
         }
         
-        return Builder->CreateVAArg(ap, resolveLLVMType(std::get<BabelType>(Args[1])));
+        return Ctx.Builder->CreateVAArg(ap, resolveLLVMType(*Ctx.Context, std::get<BabelType>(Args[1])));
     } else {
         babel_panic("No macro with name @%s exists", name.c_str());
     }
 }
 
-llvm::Value *TaskCallAST::codegen() {
+llvm::Value *TaskCallAST::codegen(CompilerContext &Ctx) {
     if (callsTo == "main") babel_panic("Calling main is not allowed, as the programs entry point it is invoked automatically");
 
-    if (PolymorphTable.at(callsTo)) {
-        auto underscore_fold = [](std::string a, const std::unique_ptr<BaseAST>& b) { return std::move(a) + '_' + getBabelTypeName(b->getType()); };
+    if (Ctx.PolymorphTable.at(callsTo)) {
+        auto underscore_fold = [&](std::string a, const BaseAST* b) { return std::move(a) + '_' + getBabelTypeName(b->getType(Ctx)); };
  
-        std::string typeinfo = !Args.empty() ? std::accumulate(std::next(Args.begin()), Args.end(), getBabelTypeName(Args[0]->getType()), underscore_fold) : "";
+        std::string typeinfo = !Args.empty() ? std::accumulate(std::next(Args.begin()), Args.end(), getBabelTypeName(Args[0]->getType(Ctx)), underscore_fold) : "";
         std::string name = std::format("{}.polymorphic.{}", callsTo, typeinfo);
 
-        if (!TaskTable.contains(name)) {
+        if (!Ctx.TaskTable.contains(name)) {
             auto matches = [&](const std::pair<std::string, TaskTypeInfo>& kv) {
-                auto argTypes = Args | std::views::transform([](const std::unique_ptr<BaseAST>& elmnt){ return elmnt->getType(); });
+                auto argTypes = Args | std::views::transform([&](const BaseAST* elmnt){ return elmnt->getType(Ctx); });
 
                 return kv.first.starts_with(callsTo) 
                     && kv.first.ends_with("...")
                     && std::ranges::equal(kv.second.args, argTypes | std::views::take(kv.second.args.size()));
             };
 
-            auto filtered = TaskTable | std::views::filter(matches);
+            auto filtered = Ctx.TaskTable | std::views::filter(matches);
             auto size = std::distance(filtered.begin(), filtered.end());
 
             if (size == 1) {
@@ -1669,7 +1726,7 @@ llvm::Value *TaskCallAST::codegen() {
                 babel_panic("ambiguous call of polymorphic task '%s', multiple matching tasks exist:\n%s", callsTo.c_str(), candidates.c_str());
             } else {
                 std::string expected = "";
-                for (const auto&[key, value] : TaskTable) {
+                for (const auto&[key, value] : Ctx.TaskTable) {
                     if (key.starts_with(callsTo + ".polymorphic")) {
                         expected += formatArgs(value.args, value.isVarArg) + '\n';
                     }
@@ -1681,7 +1738,7 @@ llvm::Value *TaskCallAST::codegen() {
         callsTo = name;
     }
 
-    llvm::Function *CalleF = TheModule->getFunction(callsTo);
+    llvm::Function *CalleF = Ctx.Module->getFunction(callsTo);
     if (!CalleF) babel_panic("Unknown Task '%s' referenced", callsTo.c_str());
 
     if (CalleF->arg_size() != Args.size() && !CalleF->isVarArg())
@@ -1692,28 +1749,28 @@ llvm::Value *TaskCallAST::codegen() {
 
     std::vector<llvm::Value *> ArgsV;
     for (unsigned int i = 0, e = Args.size(); i != e; ++i) {
-        llvm::Value *val = Args[i]->codegen();
-        if (canImplicitCast(Args[i]->getType(), TaskTable.at(callsTo).args[i]))
-            val = performImplicitCast(val, Args[i]->getType(), TaskTable.at(callsTo).args[i]);
+        llvm::Value *val = Args[i]->codegen(Ctx);
+        if (canImplicitCast(Args[i]->getType(Ctx), Ctx.TaskTable.at(callsTo).args[i]))
+            val = performImplicitCast(*Ctx.Builder, val, Args[i]->getType(Ctx), Ctx.TaskTable.at(callsTo).args[i]);
         
         ArgsV.push_back(val);
     }
 
-    if (TaskTable.at(callsTo).ret == BabelType::Void())
-        return Builder->CreateCall(CalleF, ArgsV);
-    return Builder->CreateCall(CalleF, ArgsV, "calltmp");
+    if (Ctx.TaskTable.at(callsTo).ret == BabelType::Void())
+        return Ctx.Builder->CreateCall(CalleF, ArgsV);
+    return Ctx.Builder->CreateCall(CalleF, ArgsV, "calltmp");
 }
 
-llvm::Function *TaskHeaderAST::codegen() {
-    update();
+llvm::Function *TaskHeaderAST::codegen(CompilerContext &Ctx) {
+    update(Ctx);
     std::vector<llvm::Type*> Types;
     //std::ranges::transform(ArgTypes, Types.begin(), [](const BabelType& type) { return resolveLLVMType(type); });
     for (const BabelType& type : ArgTypes) {
-        Types.push_back(resolveLLVMType(type));
+        Types.push_back(resolveLLVMType(*Ctx.Context, type));
     }
 
-    llvm::FunctionType *FT = llvm::FunctionType::get(resolveLLVMType(ReturnType), Types, isVarArg);
-    llvm::Function *F = llvm::Function::Create(FT, llvm::Function::ExternalLinkage, Name, TheModule.get());
+    llvm::FunctionType *FT = llvm::FunctionType::get(resolveLLVMType(*Ctx.Context, ReturnType), Types, isVarArg);
+    llvm::Function *F = llvm::Function::Create(FT, llvm::Function::ExternalLinkage, Name, Ctx.Module.get());
 
     unsigned int idx = 0;
     for (auto &Arg : F->args()) {
@@ -1723,67 +1780,96 @@ llvm::Function *TaskHeaderAST::codegen() {
     return F;
 }
 
-llvm::Function *TaskAST::codegen() {
-    Header->update();
-    llvm::Function *TheFunction = TheModule->getFunction(Header->getName());
-    if (!TheFunction) TheFunction = Header->codegen();
+llvm::Function *TaskAST::codegen(CompilerContext &Ctx) {
+    Header->update(Ctx);
+    llvm::Function *TheFunction = Ctx.Module->getFunction(Header->getName());
+    if (!TheFunction) TheFunction = Header->codegen(Ctx);
     if (!TheFunction) return nullptr;
     if (!TheFunction->empty()) babel_panic("Task cannot be redefined");
 
-    llvm::IRBuilder<>::InsertPoint PrevInsertPoint = Builder->saveIP();
+    llvm::IRBuilder<>::InsertPoint PrevInsertPoint = Ctx.Builder->saveIP();
 
-    llvm::BasicBlock *BB = llvm::BasicBlock::Create(*TheContext, "entry", TheFunction);
-    Builder->SetInsertPoint(BB);
+    llvm::BasicBlock *BB = llvm::BasicBlock::Create(*Ctx.Context, "entry", TheFunction);
+    Ctx.Builder->SetInsertPoint(BB);
 
-    NamedValues.clear();
+    Ctx.NamedValues.clear();
     //for (auto &Arg : TheFunction->args()) {
     //for (unsigned int i = 0; i < TheFunction->arg_size(); i++) {
     unsigned int i = 0;
     for (auto it = TheFunction->arg_begin(); it != TheFunction->arg_end(); it++, i++) {
         auto &Arg = *it;
         llvm::IRBuilder<> TmpB(&TheFunction->getEntryBlock(), TheFunction->getEntryBlock().begin());
-        llvm::AllocaInst *Alloca = TmpB.CreateAlloca(resolveLLVMType(Header->getArgTypes()[i]), nullptr, Arg.getName());
-        Builder->CreateStore(&Arg, Alloca);
-        NamedValues[std::string(Arg.getName())] = {Alloca, Header->getArgTypes()[i], false};
+        llvm::AllocaInst *Alloca = TmpB.CreateAlloca(resolveLLVMType(*Ctx.Context, Header->getArgTypes()[i]), nullptr, Arg.getName());
+        Ctx.Builder->CreateStore(&Arg, Alloca);
+        Ctx.NamedValues[std::string(Arg.getName())] = {Alloca, Header->getArgTypes()[i], false};
     }
 
-    //if (llvm::Value *RetVal = Body->codegen()) {
-        //Builder->CreateRet(RetVal);
-        Body->codegen();
+    //if (llvm::Value *RetVal = Body->codegen(Ctx)) {
+        //Ctx.Builder->CreateRet(RetVal);
+        Body->codegen(Ctx);
         if (Header->getRetType() == BabelType::Void())
-            Builder->CreateRetVoid();
+            Ctx.Builder->CreateRetVoid();
         verifyFunction(*TheFunction);
-        Builder->restoreIP(PrevInsertPoint);
+        Ctx.Builder->restoreIP(PrevInsertPoint);
         return TheFunction;
     //}
 
     //TheFunction->eraseFromParent();
-    Builder->restoreIP(PrevInsertPoint);
+    Ctx.Builder->restoreIP(PrevInsertPoint);
     return nullptr;
 }
 
+// Only the prototype, the body is generated later into a module of its own
+llvm::Function *TaskAST::declare(CompilerContext &Ctx) {
+    Header->update(Ctx);
+    if (llvm::Function *TheFunction = Ctx.Module->getFunction(Header->getName()))
+        return TheFunction;
+    return Header->codegen(Ctx);
+}
+
 // maybe omit BaseAST inheritance
 class RootAST : public BaseAST {
-    std::deque<std::unique_ptr<BaseAST>> TopLevelNodes;
+    ASTList TopLevelNodes;
 
     public:
-        explicit RootAST(std::deque<std::unique_ptr<BaseAST>> TopLevelNodes) : TopLevelNodes(std::move(TopLevelNodes)) {}
-        llvm::Function *codegen() override;
+        explicit RootAST(ASTList TopLevelNodes) : TopLevelNodes(TopLevelNodes) {}
+        llvm::Function *codegen(CompilerContext &Ctx) override;
+        llvm::Function *codegen(CompilerContext &Ctx, const std::vector<std::string> &Prologue);
+        llvm::Function *codegenDeferringTasks(CompilerContext &Ctx, std::vector<TaskAST*> &Deferred);
+        llvm::Function *codegenEntry(CompilerContext &Ctx, const std::string &Name);
+
+    private:
+        llvm::Function *codegenProgram(CompilerContext &Ctx, std::vector<TaskAST*> *Deferred, const std::vector<std::string> &Prologue = {});
 };
 
-llvm::Function *RootAST::codegen() {
-    if (llvm::Function* userDefinedMain = TheModule->getFunction("main")) {
+llvm::Function *RootAST::codegen(CompilerContext &Ctx) {
+    return codegenProgram(Ctx, nullptr);
+}
+
+// The last file of a program, main first runs the top level code of the files before it, their entries
+// generated by codegenEntry and named in Prologue
+llvm::Function *RootAST::codegen(CompilerContext &Ctx, const std::vector<std::string> &Prologue) {
+    return codegenProgram(Ctx, nullptr, Prologue);
+}
+
+// Top level tasks are only declared and left to the caller, everything else is generated as usual
+llvm::Function *RootAST::codegenDeferringTasks(CompilerContext &Ctx, std::vector<TaskAST*> &Deferred) {
+    return codegenProgram(Ctx, &Deferred);
+}
+
+llvm::Function *RootAST::codegenProgram(CompilerContext &Ctx, std::vector<TaskAST*> *Deferred, const std::vector<std::string> &Prologue) {
+    if (llvm::Function* userDefinedMain = Ctx.Module->getFunction("main")) {
         userDefinedMain->setName("user.main");
     }
 
     // Actual entry point main for libc, _start maybe later
-    llvm::Type *Int32Ty = llvm::Type::getInt32Ty(*TheContext);
-    llvm::PointerType *CharPtrTy = llvm::PointerType::getUnqual(llvm::Type::getInt8Ty(*TheContext));
+    llvm::Type *Int32Ty = llvm::Type::getInt32Ty(*Ctx.Context);
+    llvm::PointerType *CharPtrTy = llvm::PointerType::getUnqual(llvm::Type::getInt8Ty(*Ctx.Context));
     llvm::FunctionType *MainType = llvm::FunctionType::get(Int32Ty, {Int32Ty, CharPtrTy, CharPtrTy}, false);
 
-    llvm::Function *MainFn = llvm::Function::Create(MainType, llvm::Function::ExternalLinkage, "main", TheModule.get());
-    llvm::BasicBlock *MainEntry = llvm::BasicBlock::Create(*TheContext, "entry", MainFn);
-    Builder->SetInsertPoint(MainEntry);
+    llvm::Function *MainFn = llvm::Function::Create(MainType, llvm::Function::ExternalLinkage, "main", Ctx.Module.get());
+    llvm::BasicBlock *MainEntry = llvm::BasicBlock::Create(*Ctx.Context, "entry", MainFn);
+    Ctx.Builder->SetInsertPoint(MainEntry);
 
     auto ArgIter = MainFn->arg_begin();
     llvm::Value *Argc = &*ArgIter++;
@@ -1792,57 +1878,110 @@ llvm::Function *RootAST::codegen() {
 
     // Store globals
     auto *GArgc = new llvm::GlobalVariable(
-        *TheModule, Int32Ty, false, llvm::GlobalValue::ExternalLinkage, nullptr, "__argc__"
+        *Ctx.Module, Int32Ty, false, llvm::GlobalValue::ExternalLinkage, nullptr, "__argc__"
     );
     GArgc->setInitializer(llvm::ConstantInt::get(Int32Ty, 0));
 
     auto *GArgv = new llvm::GlobalVariable(
-        *TheModule, CharPtrTy, false, llvm::GlobalValue::ExternalLinkage, nullptr, "__argv__"
+        *Ctx.Module, CharPtrTy, false, llvm::GlobalValue::ExternalLinkage, nullptr, "__argv__"
     );
     GArgv->setInitializer(llvm::ConstantPointerNull::get(CharPtrTy));
 
     auto *GEnvp = new llvm::GlobalVariable(
-        *TheModule, CharPtrTy, false, llvm::GlobalValue::ExternalLinkage, nullptr, "__envp__"
+        *Ctx.Module, CharPtrTy, false, llvm::GlobalValue::ExternalLinkage, nullptr, "__envp__"
     );
     GEnvp->setInitializer(llvm::ConstantPointerNull::get(CharPtrTy));
 
-    Builder->CreateStore(Argc, GArgc);
-    Builder->CreateStore(Argv, GArgv);
-    Builder->CreateStore(Envp, GEnvp);
+    Ctx.Builder->CreateStore(Argc, GArgc);
+    Ctx.Builder->CreateStore(Argv, GArgv);
+    Ctx.Builder->CreateStore(Envp, GEnvp);
+
+    Ctx.GlobalValues["__argc__"] = {GArgc, BabelType::Int32(), false, false};
+    Ctx.GlobalValues["__argv__"] = {GArgv, BabelType::CString(), false, false};
+    Ctx.GlobalValues["__envp__"] = {GEnvp, BabelType::CString(), false, false};
 
-    GlobalValues["__argc__"] = {GArgc, BabelType::Int32(), false, false};
-    GlobalValues["__argv__"] = {GArgv, BabelType::CString(), false, false};
-    GlobalValues["__envp__"] = {GEnvp, BabelType::CString(), false, false};
+    for (const std::string &Name : Prologue) {
+        Ctx.Builder->CreateCall(Ctx.Module->getOrInsertFunction(Name, llvm::FunctionType::get(Int32Ty, false)));
+    }
 
     // __global_main wrapper for top level code
-    llvm::FunctionType *FT = llvm::FunctionType::get(llvm::Type::getInt32Ty(*TheContext), false);
-    llvm::Function *globalMain = llvm::Function::Create(FT, llvm::Function::InternalLinkage, "__global_main", TheModule.get());
+    llvm::FunctionType *FT = llvm::FunctionType::get(llvm::Type::getInt32Ty(*Ctx.Context), false);
+    llvm::Function *globalMain = llvm::Function::Create(FT, llvm::Function::InternalLinkage, "__global_main", Ctx.Module.get());
 
-    llvm::BasicBlock *Entry = llvm::BasicBlock::Create(*TheContext, "entry", globalMain);
-    Builder->SetInsertPoint(Entry);
+    llvm::BasicBlock *Entry = llvm::BasicBlock::Create(*Ctx.Context, "entry", globalMain);
+    Ctx.Builder->SetInsertPoint(Entry);
 
     for (const auto& Node : TopLevelNodes) {
-        Node->codegen();
+        if (TaskAST* Task = Deferred ? dynamic_cast<TaskAST*>(Node) : nullptr) {
+            Task->declare(Ctx);
+            Deferred->push_back(Task);
+        } else {
+            Node->codegen(Ctx);
+        }
     }
 
-    if (llvm::Function *UserMain = TheModule->getFunction("user.main")) {
+    if (llvm::Function *UserMain = Ctx.Module->getFunction("user.main")) {
         if (UserMain->getReturnType()->isVoidTy()) {
-            Builder->CreateCall(UserMain);
-            Builder->CreateRet(llvm::ConstantInt::get(llvm::Type::getInt32Ty(*TheContext), 0));
+            Ctx.Builder->CreateCall(UserMain);
+            Ctx.Builder->CreateRet(llvm::ConstantInt::get(llvm::Type::getInt32Ty(*Ctx.Context), 0));
         } else if (UserMain->getReturnType()->isIntegerTy(32)) {
-            llvm::Value* RetVal = Builder->CreateCall(UserMain);
-            Builder->CreateRet(RetVal);
+            llvm::Value* RetVal = Ctx.Builder->CreateCall(UserMain);
+            Ctx.Builder->CreateRet(RetVal);
         } else {
             babel_panic("main method must return integer or void type");
         }
     } else {
-        Builder->CreateRet(llvm::ConstantInt::get(llvm::Type::getInt32Ty(*TheContext), 0));
+        Ctx.Builder->CreateRet(llvm::ConstantInt::get(llvm::Type::getInt32Ty(*Ctx.Context), 0));
     }
 
     // Call __global_main and return its result
-    Builder->SetInsertPoint(MainEntry);
-    llvm::Value *GlobalMainRet = Builder->CreateCall(globalMain);
-    Builder->CreateRet(GlobalMainRet);
+    Ctx.Builder->SetInsertPoint(MainEntry);
+    llvm::Value *GlobalMainRet = Ctx.Builder->CreateCall(globalMain);
+    Ctx.Builder->CreateRet(GlobalMainRet);
 
     return MainFn;
+}
+
+// Top level code of a REPL line on its own, without main and the argc/argv globals that every line
+// would define again. The name has to start with __global_main to be treated as global scope.
+llvm::Function *RootAST::codegenEntry(CompilerContext &Ctx, const std::string &Name) {
+    llvm::FunctionType *FT = llvm::FunctionType::get(llvm::Type::getInt32Ty(*Ctx.Context), false);
+    llvm::Function *Entry = llvm::Function::Create(FT, llvm::Function::ExternalLinkage, Name, Ctx.Module.get());
+    Ctx.Builder->SetInsertPoint(llvm::BasicBlock::Create(*Ctx.Context, "entry", Entry));
+
+    for (const auto& Node : TopLevelNodes) {
+        Node->codegen(Ctx);
+    }
+
+    if (!Ctx.Builder->GetInsertBlock()->getTerminator())
+        Ctx.Builder->CreateRet(llvm::ConstantInt::get(llvm::Type::getInt32Ty(*Ctx.Context), 0));
+
+    return Entry;
+}
+
+// Every REPL line is compiled into a module of its own, so tasks and globals of earlier lines are declared
+// again for it to link against. Their values and comptime initializers belonged to the earlier modules.
+void redeclareEarlierDefinitions(CompilerContext &Ctx) {
+    for (const auto& [Name, Info] : Ctx.TaskTable) {
+        if (Ctx.Module->getFunction(Name)) continue;
+
+        std::vector<llvm::Type*> Types;
+        for (const BabelType& type : Info.args) {
+            Types.push_back(resolveLLVMType(*Ctx.Context, type));
+        }
+
+        llvm::FunctionType *FT = llvm::FunctionType::get(resolveLLVMType(*Ctx.Context, Info.ret), Types, Info.isVarArg);
+        llvm::Function::Create(FT, llvm::Function::ExternalLinkage, Name, Ctx.Module.get());
+    }
+
+    for (auto& [Name, Symbol] : Ctx.GlobalValues) {
+        if (Symbol.val == nullptr) continue;
+
+        Symbol.val = new llvm::GlobalVariable(*Ctx.Module, resolveLLVMType(*Ctx.Context, Symbol.type), Symbol.isConstant, llvm::GlobalValue::ExternalLinkage, nullptr, Name);
+        Symbol.isComptime = false;
+        Symbol.comptimeInit = nullptr;
+    }
+
+    Ctx.NamedValues.clear();
+    Ctx.LabelTable.clear();
 }
\ No newline at end of file
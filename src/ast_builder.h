@@ -1,16 +1,28 @@
 #include <string>
+#include <string_view>
 #include <optional>
+#include <span>
 #include <stack>
+#include <unordered_map>
+#include <unordered_set>
 
+#include "arena.h"
 #include "ast.h"
 
+// Node of the concrete parse tree. Nodes are allocated in their ParseTree's arena and never copied, kind is
+// the grammar symbol id in the parse table, name views its symbol name and data the token text in the source
 struct TreeNode {
-    std::string name;
-    std::optional<std::string> data;
-    std::list<TreeNode> children;
+    uint32_t kind;
+    std::string_view name;
+    std::optional<std::string_view> data;
+    std::span<const TreeNode* const> children;
+
+    std::string text() const {
+        return std::string(data.value());
+    }
 
     bool has_tokenized_child() const {
-        return std::ranges::any_of(children, [](const TreeNode& child) { return child.data.has_value(); });
+        return std::ranges::any_of(children, [](const TreeNode* child) { return child->data.has_value(); });
     }
 
     friend std::ostream& operator<<(std::ostream& os, const TreeNode& node) {
@@ -33,7 +45,7 @@ struct TreeNode {
 
             // Push children onto the stack in reverse order
             for (auto childIter = currentNode->children.rbegin(); childIter != currentNode->children.rend(); ++childIter) {
-                nodeStack.emplace(std::to_address(childIter), depth + 1);
+                nodeStack.emplace(*childIter, depth + 1);
             }
         }
 
@@ -41,7 +53,66 @@ struct TreeNode {
     }
 };
 
-BabelType getBabelType(std::stack<std::variant<TreeNode, std::unique_ptr<BaseAST>>>& stack) {
+// Owns every node parsed from one compilation unit, parse tree and AST alike, they are freed together with the tree.
+// Token text is viewed rather than copied, so the source has to outlive the tree, unless it was streamed.
+class ParseTree {
+public:
+    const TreeNode* root = nullptr; // stays null if only the AST was built
+    RootAST* ast = nullptr;         // top level statements, null if the grammar reduced none
+
+    const TreeNode* makeToken(uint32_t kind, std::string_view name, std::string_view text) {
+        return arena.make<TreeNode>(kind, name, text, std::span<const TreeNode* const>{});
+    }
+
+    // For tokens whose text goes away before the tree does, like those of a TokenStream
+    const TreeNode* makeOwnedToken(uint32_t kind, std::string_view name, std::string_view text) {
+        std::span<char> copy = arena.copy(text);
+        return makeToken(kind, name, std::string_view(copy.data(), copy.size()));
+    }
+
+    // Like makeOwnedToken for tokens that only come in a few texts, like keywords and punctuation, whose
+    // text is copied once per tree instead of once per token
+    const TreeNode* makeInternedToken(uint32_t kind, std::string_view name, std::string_view text) {
+        auto interned = internedText.find(text);
+        if (interned == internedText.end()) {
+            std::span<char> copy = arena.copy(text);
+            interned = internedText.emplace(copy.data(), copy.size()).first;
+        }
+        return makeToken(kind, name, *interned);
+    }
+
+    const TreeNode* makeNode(uint32_t kind, std::string_view name, std::span<const TreeNode* const> children) {
+        return arena.make<TreeNode>(kind, name, std::nullopt, arena.copy(children));
+    }
+
+    template<typename T, typename... Args>
+    T* makeAST(Args&&... args) {
+        return arena.make<T>(std::forward<Args>(args)...);
+    }
+
+    template<std::ranges::sized_range R>
+    ASTList makeList(const R& nodes) {
+        return arena.copy(nodes);
+    }
+
+    // Ties what the token text views, like the mapping of its source file, to the lifetime of the tree
+    template<typename T>
+    void keepAlive(T&& owner) {
+        arena.make<std::decay_t<T>>(std::forward<T>(owner));
+    }
+
+    size_t capacity() const {
+        return arena.capacity();
+    }
+
+private:
+    Arena arena;
+    std::unordered_set<std::string_view> internedText; // views copies in the arena
+};
+
+using ReducedNodeStack = std::stack<std::variant<const TreeNode*, BaseAST*>>;
+
+BabelType getBabelType(CompilerContext& Ctx, ReducedNodeStack& stack) {
     // ignore optionals, arrays and template stuff for now
 
     const std::unordered_map<std::string, BabelType> TypeMap = {
@@ -62,532 +133,703 @@ BabelType getBabelType(std::stack<std::variant<TreeNode, std::unique_ptr<BaseAST
         {"void", BabelType::Void()},
     };
 
-    BabelType type = TypeMap.at(std::get<TreeNode>(stack.top()).data.value()); stack.pop();
+    BabelType type = TypeMap.at(std::get<const TreeNode*>(stack.top())->text()); stack.pop();
 
     // TODO: rethink this, there doesn't have to be a colon (e.g. extern task lalala() => void)
     // should work for now tho (because of bottom return)
-    if (std::holds_alternative<TreeNode>(stack.top()) && std::get<TreeNode>(stack.top()).name == "COLON") {
+    if (std::holds_alternative<const TreeNode*>(stack.top()) && std::get<const TreeNode*>(stack.top())->name == "COLON") {
         return type;
     }
 
-    while (std::holds_alternative<TreeNode>(stack.top()) && (std::get<TreeNode>(stack.top()).name == "MULTIPLY" || std::get<TreeNode>(stack.top()).name == "CONST")) {
-        bool isConst = std::get<TreeNode>(stack.top()).name == "CONST";
+    while (std::holds_alternative<const TreeNode*>(stack.top()) && (std::get<const TreeNode*>(stack.top())->name == "MULTIPLY" || std::get<const TreeNode*>(stack.top())->name == "POWER" || std::get<const TreeNode*>(stack.top())->name == "CONST")) {
+        bool isConst = std::get<const TreeNode*>(stack.top())->name == "CONST";
         if (isConst)
             stack.pop();
         
-        assert(std::get<TreeNode>(stack.top()).name == "MULTIPLY"); stack.pop();
+        const TreeNode* star = std::get<const TreeNode*>(stack.top()); stack.pop();
+        assert(star->name == "MULTIPLY" || star->name == "POWER");
 
-        const BabelType* stored = TheArena.make(type);
+        const BabelType* stored = Ctx.Arena.make(type);
         type = BabelType::Pointer(stored, isConst);
+
+        // ** lexes as one token, it is two pointers
+        if (star->name == "POWER")
+            type = BabelType::Pointer(Ctx.Arena.make(type), false);
     }
 
     return type;
 }
 
-void buildNode(std::stack<std::variant<TreeNode, std::unique_ptr<BaseAST>>>& nodeStack, std::string_view type, int removeCount) {
-    std::variant<TreeNode, std::unique_ptr<BaseAST>> node;
-
-    if (type == "atom") {
-        TreeNode atom = std::get<TreeNode>(nodeStack.top()); nodeStack.pop();
-        if (atom.name == "INTEGER") {
-            node = std::make_unique<IntegerAST>(atom.data.value());
-        } else if (atom.name == "FLOATING_POINT") {
-            node = std::make_unique<FloatingPointAST>(atom.data.value());
-        } else if (atom.name == "BOOL") {
-            node = std::make_unique<BooleanAST>(atom.data.value());
-        } else if (atom.name == "VAR") {
-            node = std::make_unique<VariableAST>(atom.data.value(), std::nullopt, false, false, false);
-        } else if (atom.name == "CSTRING") {
-            node = std::make_unique<CStringAST>(unescapeString(atom.data.value().substr(2, atom.data.value().size() - 3)));
-        } else if (atom.name == "STRING") {
-            babel_stub();
-        } else if (atom.name == "CHAR") {
-            node = std::make_unique<CharacterAST>(atom.data.value().at(1));
-        }
+// Number of dereferences in a chained_indirection, ** being two of them
+size_t indirectionDepth(const TreeNode* chain) {
+    size_t depth = 0;
+    for (const TreeNode* child : chain->children) {
+        depth += child->name == "POWER" ? 2 : child->name == "MULTIPLY" ? 1 : indirectionDepth(child);
+    }
+    return depth;
+}
+
+// Semantic action run when a rule is reduced. They are bound to the rules once per parse table,
+// so a reduction dispatches on the rule index instead of comparing nonterminal names.
+enum class ReduceAction : uint8_t {
+    Tree, // no AST node, keeps the concrete tree node
+    Skip, // handled by it's corresponding statement
+    Atom,
+    BinaryOperator,
+    Comparison,
+    Conjunction,
+    Disjunction,
+    UnaryOperator,
+    Postfix,
+    Primary,
+    Assignment,
+    ShortDeclaration,
+    ElementAssignment,
+    IndirectAssignment,
+    IfStmt,
+    WhileLoop,
+    ForLoop,
+    ForInLoop,
+    ContinueStmt,
+    BreakStmt,
+    ReturnStmt,
+    GotoStmt,
+    LabelStmt,
+    ExternTask,
+    TaskDef,
+    MacroCall,
+    FunctionCall,
+    ClassConstruction,
+    SimpleStmt,
+    Terminator
+};
+
+ReduceAction reduceActionFor(std::string_view nonterminal) {
+    static const std::unordered_map<std::string_view, ReduceAction> actions = {
+        {"atom", ReduceAction::Atom},
+        {"sum", ReduceAction::BinaryOperator},
+        {"term", ReduceAction::BinaryOperator},
+        {"exponentiation", ReduceAction::BinaryOperator},
+        {"exponent", ReduceAction::BinaryOperator},
+        {"shift_expression", ReduceAction::BinaryOperator},
+        {"bitwise_and", ReduceAction::BinaryOperator},
+        {"bitwise_or", ReduceAction::BinaryOperator},
+        {"bitwise_xor", ReduceAction::BinaryOperator},
+        {"contravalence", ReduceAction::BinaryOperator},
+        {"comparison", ReduceAction::Comparison},
+        {"conjunction", ReduceAction::Conjunction},
+        {"disjunction", ReduceAction::Disjunction},
+        {"inversion", ReduceAction::UnaryOperator},
+        {"prefix", ReduceAction::UnaryOperator},
+        {"postfix", ReduceAction::Postfix},
+        {"primary", ReduceAction::Primary},
+        {"assignment", ReduceAction::Assignment},
+        {"short_declaration", ReduceAction::ShortDeclaration},
+        {"element_assignment", ReduceAction::ElementAssignment},
+        {"indirect_assignment", ReduceAction::IndirectAssignment},
+        {"if_stmt", ReduceAction::IfStmt},
+        {"elif_stmt", ReduceAction::Skip},
+        {"task_header", ReduceAction::Skip},
+        {"args", ReduceAction::Skip},
+        {"params", ReduceAction::Skip},
+        {"generic_list", ReduceAction::Skip},
+        {"type", ReduceAction::Skip},
+        {"type_spec", ReduceAction::Skip},
+        {"type_signature", ReduceAction::Skip},
+        {"and_chain", ReduceAction::Skip},
+        {"or_chain", ReduceAction::Skip},
+        {"while_loop", ReduceAction::WhileLoop},
+        {"for_loop", ReduceAction::ForLoop},
+        {"for_in_loop", ReduceAction::ForInLoop},
+        {"continue_stmt", ReduceAction::ContinueStmt},
+        {"break_stmt", ReduceAction::BreakStmt},
+        {"return_stmt", ReduceAction::ReturnStmt},
+        {"goto_stmt", ReduceAction::GotoStmt},
+        {"label_stmt", ReduceAction::LabelStmt},
+        {"extern_task", ReduceAction::ExternTask},
+        {"task_def", ReduceAction::TaskDef},
+        {"macro_call", ReduceAction::MacroCall},
+        {"function_call", ReduceAction::FunctionCall},
+        {"class_construction", ReduceAction::ClassConstruction},
+        {"simple_stmt", ReduceAction::SimpleStmt},
+        {"terminator", ReduceAction::Terminator},
+    };
 
-        //std::get<std::unique_ptr<BaseAST>>(node)->codegen()->print(llvm::errs());
-        //fprintf(stderr, "\n");
-    } else if (type == "sum" || type == "term" || type == "shift_expression" || type == "bitwise_and" || type == "bitwise_or" || type == "bitwise_xor" || type == "contravalence") {
-        std::unique_ptr<BaseAST> rhs = std::move(std::get<std::unique_ptr<BaseAST>>(nodeStack.top())); nodeStack.pop();
-        TreeNode op = std::get<TreeNode>(nodeStack.top()); nodeStack.pop();
-        std::unique_ptr<BaseAST> lhs = std::move(std::get<std::unique_ptr<BaseAST>>(nodeStack.top())); nodeStack.pop();
+    auto it = actions.find(nonterminal);
+    return it == actions.end() ? ReduceAction::Tree : it->second;
+}
+
+// Rules without a token among their symbols are usually not worth an action, these ones always need it
+constexpr bool alwaysReduces(ReduceAction action) {
+    return action == ReduceAction::SimpleStmt || action == ReduceAction::Comparison || action == ReduceAction::Conjunction || action == ReduceAction::Disjunction;
+}
+
+void buildNode(CompilerContext& Ctx, ReducedNodeStack& nodeStack, ParseTree& tree, ReduceAction action, uint32_t kind, std::string_view type, int removeCount) {
+    std::variant<const TreeNode*, BaseAST*> node;
+
+    switch (action) {
+        case ReduceAction::Atom: {
+            const TreeNode* atom = std::get<const TreeNode*>(nodeStack.top()); nodeStack.pop();
+            std::string text = atom->text();
+            if (atom->name == "INTEGER") {
+                node = tree.makeAST<IntegerAST>(text);
+            } else if (atom->name == "FLOATING_POINT") {
+                node = tree.makeAST<FloatingPointAST>(text);
+            } else if (atom->name == "BOOL") {
+                node = tree.makeAST<BooleanAST>(text);
+            } else if (atom->name == "VAR") {
+                node = tree.makeAST<VariableAST>(Ctx, text, std::nullopt, false, false, false);
+            } else if (atom->name == "CSTRING") {
+                node = tree.makeAST<CStringAST>(unescapeString(text.substr(2, text.size() - 3)));
+            } else if (atom->name == "STRING") {
+                babel_stub();
+            } else if (atom->name == "CHAR") {
+                node = tree.makeAST<CharacterAST>(text.at(1));
+            }
 
-        node = std::make_unique<BinaryOperatorAST>(op.data.value(), std::move(lhs), std::move(rhs));
+            //std::get<BaseAST*>(node)->codegen()->print(llvm::errs());
+            //fprintf(stderr, "\n");
+            break;
+        }
+        case ReduceAction::BinaryOperator: {
+            BaseAST* rhs = std::get<BaseAST*>(nodeStack.top()); nodeStack.pop();
+            const TreeNode* op = std::get<const TreeNode*>(nodeStack.top()); nodeStack.pop();
+            BaseAST* lhs = std::get<BaseAST*>(nodeStack.top()); nodeStack.pop();
+
+            node = tree.makeAST<BinaryOperatorAST>(op->text(), lhs, rhs);
         
-        //std::get<std::unique_ptr<BaseAST>>(node)->codegen()->print(llvm::errs());
-        //fprintf(stderr, "\n");
-    } else if (type == "comparison" || type == "conjunction" || type == "disjunction") {
-        node = std::move(nodeStack.top()); nodeStack.pop();
+            //std::get<BaseAST*>(node)->codegen()->print(llvm::errs());
+            //fprintf(stderr, "\n");
+            break;
+        }
+        case ReduceAction::Comparison: case ReduceAction::Conjunction: case ReduceAction::Disjunction: {
+            node = nodeStack.top(); nodeStack.pop();
         
-        std::deque<std::string> ops = {};
-        std::deque<std::unique_ptr<BaseAST>> vals = {};
+            std::deque<std::string> ops = {};
+            std::deque<BaseAST*> vals = {};
 
-        auto isComp = [&nodeStack, &type]() { return std::get<TreeNode>(nodeStack.top()).name == "cmp_op" && type == "comparison"; };
-        auto isAnd = [&nodeStack, &type]() { return std::get<TreeNode>(nodeStack.top()).name == "AND" && type == "conjunction"; };
-        auto isOr = [&nodeStack, &type]() { return std::get<TreeNode>(nodeStack.top()).name == "OR" && type == "disjunction"; };
+            auto isComp = [&nodeStack, action]() { return std::get<const TreeNode*>(nodeStack.top())->name == "cmp_op" && action == ReduceAction::Comparison; };
+            auto isAnd = [&nodeStack, action]() { return std::get<const TreeNode*>(nodeStack.top())->name == "AND" && action == ReduceAction::Conjunction; };
+            auto isOr = [&nodeStack, action]() { return std::get<const TreeNode*>(nodeStack.top())->name == "OR" && action == ReduceAction::Disjunction; };
 
-        while (std::holds_alternative<TreeNode>(nodeStack.top()) && (isComp() || isAnd() || isOr())) {
-            std::string op = std::get<TreeNode>(nodeStack.top()).name == "cmp_op"
-                ? std::get<TreeNode>(nodeStack.top()).children.front().data.value()
-                : std::get<TreeNode>(nodeStack.top()).data.value();
+            while (!nodeStack.empty() && std::holds_alternative<const TreeNode*>(nodeStack.top()) && (isComp() || isAnd() || isOr())) {
+                std::string op = std::get<const TreeNode*>(nodeStack.top())->name == "cmp_op"
+                    ? std::get<const TreeNode*>(nodeStack.top())->children.front()->text()
+                    : std::get<const TreeNode*>(nodeStack.top())->text();
 
-            ops.push_front(op);
-            nodeStack.pop(); // operator
-            vals.push_front(std::move(std::get<std::unique_ptr<BaseAST>>(nodeStack.top()))); nodeStack.pop();
-        }
+                ops.push_front(op);
+                nodeStack.pop(); // operator
+                vals.push_front(std::get<BaseAST*>(nodeStack.top())); nodeStack.pop();
+            }
 
-        if (!ops.empty()) {
-            vals.push_back(std::move(std::get<std::unique_ptr<BaseAST>>(node)));
-            node = std::make_unique<ComparisonChainAST>(std::move(ops), std::move(vals));
+            if (!ops.empty()) {
+                vals.push_back(std::get<BaseAST*>(node));
+                node = tree.makeAST<ComparisonChainAST>(std::move(ops), tree.makeList(vals));
+            }
+            break;
         }
-    } else if (type == "inversion" || type == "prefix") {
-        std::unique_ptr<BaseAST> operand = std::move(std::get<std::unique_ptr<BaseAST>>(nodeStack.top())); nodeStack.pop();
-        TreeNode op = std::get<TreeNode>(nodeStack.top()); nodeStack.pop();
+        case ReduceAction::UnaryOperator: {
+            BaseAST* operand = std::get<BaseAST*>(nodeStack.top()); nodeStack.pop();
+            const TreeNode* op = std::get<const TreeNode*>(nodeStack.top()); nodeStack.pop();
 
-        std::string s = (op.name == "INCREMENT" || op.name == "DECREMENT") ? "pre" : "";
+            std::string s = (op->name == "INCREMENT" || op->name == "DECREMENT") ? "pre" : "";
 
-        if (op.data.value() == "&") {
-            node = std::make_unique<AddressOfOperatorAST>(std::move(operand));
-        } else {
-            node = std::make_unique<UnaryOperatorAST>(s + op.data.value(), std::move(operand));
+            if (op->text() == "&") {
+                node = tree.makeAST<AddressOfOperatorAST>(Ctx, operand);
+            } else {
+                node = tree.makeAST<UnaryOperatorAST>(s + op->text(), operand);
+            }
+            break;
         }
-    } else if (type == "postfix") {
-        if (std::holds_alternative<TreeNode>(nodeStack.top()) && std::get<TreeNode>(nodeStack.top()).name == "RSQUARE") {
-            nodeStack.pop();
-            std::unique_ptr<BaseAST> index = std::move(std::get<std::unique_ptr<BaseAST>>(nodeStack.top())); nodeStack.pop();
-            nodeStack.pop(); // LSQUARE
-            std::unique_ptr<BaseAST> container = std::move(std::get<std::unique_ptr<BaseAST>>(nodeStack.top())); nodeStack.pop();
+        case ReduceAction::Postfix: {
+            if (std::holds_alternative<const TreeNode*>(nodeStack.top()) && std::get<const TreeNode*>(nodeStack.top())->name == "RSQUARE") {
+                nodeStack.pop();
+                BaseAST* index = std::get<BaseAST*>(nodeStack.top()); nodeStack.pop();
+                nodeStack.pop(); // LSQUARE
+                BaseAST* container = std::get<BaseAST*>(nodeStack.top()); nodeStack.pop();
 
-            node = std::make_unique<AccessElementOperatorAST>(std::move(container), std::move(index));
-        } else if (std::holds_alternative<TreeNode>(nodeStack.top()) && std::get<TreeNode>(nodeStack.top()).name == "MULTIPLY") {
-            nodeStack.pop();
-            node = std::make_unique<DereferenceOperatorAST>(std::move(std::get<std::unique_ptr<BaseAST>>(nodeStack.top()))); nodeStack.pop();
-        } else {
-            TreeNode op = std::get<TreeNode>(nodeStack.top()); nodeStack.pop();
-            std::unique_ptr<BaseAST> operand = std::move(std::get<std::unique_ptr<BaseAST>>(nodeStack.top())); nodeStack.pop();
+                node = tree.makeAST<AccessElementOperatorAST>(container, index);
+            } else if (std::holds_alternative<const TreeNode*>(nodeStack.top()) && std::get<const TreeNode*>(nodeStack.top())->name == "MULTIPLY") {
+                nodeStack.pop();
+                node = tree.makeAST<DereferenceOperatorAST>(std::get<BaseAST*>(nodeStack.top())); nodeStack.pop();
+            } else if (std::holds_alternative<const TreeNode*>(nodeStack.top()) && std::get<const TreeNode*>(nodeStack.top())->name == "POWER") {
+                // p** lexes as a single POWER token
+                nodeStack.pop();
+                BaseAST* pointer = tree.makeAST<DereferenceOperatorAST>(std::get<BaseAST*>(nodeStack.top())); nodeStack.pop();
+                node = tree.makeAST<DereferenceOperatorAST>(pointer);
+            } else {
+                const TreeNode* op = std::get<const TreeNode*>(nodeStack.top()); nodeStack.pop();
+                BaseAST* operand = std::get<BaseAST*>(nodeStack.top()); nodeStack.pop();
 
-            node = std::make_unique<UnaryOperatorAST>("post" + op.data.value(), std::move(operand));
+                node = tree.makeAST<UnaryOperatorAST>("post" + op->text(), operand);
+            }
+            break;
         }
-    } else if (type == "primary") {
-        if (std::holds_alternative<TreeNode>(nodeStack.top()) && std::get<TreeNode>(nodeStack.top()).name == "RPAREN") {
-            nodeStack.pop();
-            node = std::move(std::get<std::unique_ptr<BaseAST>>(nodeStack.top())); nodeStack.pop();
-            nodeStack.pop(); //LPAREN
+        case ReduceAction::Primary: {
+            if (std::holds_alternative<const TreeNode*>(nodeStack.top()) && std::get<const TreeNode*>(nodeStack.top())->name == "RPAREN") {
+                nodeStack.pop();
+                node = std::get<BaseAST*>(nodeStack.top()); nodeStack.pop();
+                nodeStack.pop(); //LPAREN
+            }
+            break;
         }
-    } else if (type == "assignment") {
-        std::unique_ptr<BaseAST> rhs = std::move(std::get<std::unique_ptr<BaseAST>>(nodeStack.top())); nodeStack.pop();
-        TreeNode op = std::get<TreeNode>(nodeStack.top()); nodeStack.pop();
+        case ReduceAction::Assignment: {
+            BaseAST* rhs = std::get<BaseAST*>(nodeStack.top()); nodeStack.pop();
+            const TreeNode* op = std::get<const TreeNode*>(nodeStack.top()); nodeStack.pop();
         
-        std::optional<BabelType> varType = std::nullopt;
-        // TODO: Handle the new typing system! (also in the task headers/externs)
-        // TODO: DIFFERENT CHECK!
-        if (std::get<TreeNode>(nodeStack.top()).name == "TYPE") {
-            varType = getBabelType(nodeStack);
-            nodeStack.pop(); // COLON
-        }
+            std::optional<BabelType> varType = std::nullopt;
+            // TODO: Handle the new typing system! (also in the task headers/externs)
+            // TODO: DIFFERENT CHECK!
+            if (std::get<const TreeNode*>(nodeStack.top())->name == "TYPE") {
+                varType = getBabelType(Ctx, nodeStack);
+                nodeStack.pop(); // COLON
+            }
 
-        TreeNode var = std::get<TreeNode>(nodeStack.top()); nodeStack.pop();
+            const TreeNode* var = std::get<const TreeNode*>(nodeStack.top()); nodeStack.pop();
 
-        bool isDeclaration = false;
-        bool isConstant = false;
-        if (!nodeStack.empty() && std::holds_alternative<TreeNode>(nodeStack.top()) && (std::get<TreeNode>(nodeStack.top()).name == "LET" || std::get<TreeNode>(nodeStack.top()).name == "CONST")) {
-            TreeNode vardecl = std::get<TreeNode>(nodeStack.top()); nodeStack.pop();
-            isDeclaration = true;
-            isConstant = vardecl.name == "CONST";
-        }
+            bool isDeclaration = false;
+            bool isConstant = false;
+            if (!nodeStack.empty() && std::holds_alternative<const TreeNode*>(nodeStack.top()) && (std::get<const TreeNode*>(nodeStack.top())->name == "LET" || std::get<const TreeNode*>(nodeStack.top())->name == "CONST")) {
+                const TreeNode* vardecl = std::get<const TreeNode*>(nodeStack.top()); nodeStack.pop();
+                isDeclaration = true;
+                isConstant = vardecl->name == "CONST";
+            }
 
-        if (auto subop = op.children.front().data.value(); subop != "=") {
-            auto subexpr = std::make_unique<BinaryOperatorAST>(subop.substr(0, subop.size() - 1), std::make_unique<VariableAST>(var.data.value(), std::nullopt, isConstant, isDeclaration, rhs->isComptimeAssignable()), std::move(rhs));
-            node = std::make_unique<BinaryOperatorAST>("=", std::make_unique<VariableAST>(var.data.value(), std::nullopt, isConstant, isDeclaration, subexpr->isComptimeAssignable()), std::move(subexpr));
-        } else {
-            if (!varType.has_value()) varType = rhs->getType();
-            node = std::make_unique<BinaryOperatorAST>(subop, std::make_unique<VariableAST>(var.data.value(), varType, isConstant, isDeclaration, rhs->isComptimeAssignable()), std::move(rhs));
-        }
-    } else if (type == "short_declaration") {
-        std::unique_ptr<BaseAST> rhs = std::move(std::get<std::unique_ptr<BaseAST>>(nodeStack.top())); nodeStack.pop();
-        nodeStack.pop(); // COLON_EQUALS
-        TreeNode var = std::get<TreeNode>(nodeStack.top()); nodeStack.pop();
-
-        node = std::make_unique<BinaryOperatorAST>(":=", std::make_unique<VariableAST>(var.data.value(), rhs->getType(), false, true, rhs->isComptimeAssignable()), std::move(rhs));        
-    } else if (type == "element_assignment") {
-        std::unique_ptr<BaseAST> rhs = std::move(std::get<std::unique_ptr<BaseAST>>(nodeStack.top())); nodeStack.pop();
-        TreeNode op = std::get<TreeNode>(nodeStack.top()); nodeStack.pop();
-
-        nodeStack.pop(); // RSQUARE
-        std::unique_ptr<BaseAST> index = std::move(std::get<std::unique_ptr<BaseAST>>(nodeStack.top())); nodeStack.pop();
-        nodeStack.pop(); // LSQUARE
-        TreeNode var = std::get<TreeNode>(nodeStack.top()); nodeStack.pop();
-
-        if (auto subop = op.children.front().data.value(); subop != "=") {
-            auto subexpr = std::make_unique<BinaryOperatorAST>(subop.substr(0, subop.size() - 1), std::make_unique<AccessElementOperatorAST>(std::make_unique<VariableAST>(var.data.value(), std::nullopt, false, false, false), std::move(index)), std::move(rhs));
-            node = std::make_unique<BinaryOperatorAST>("=", std::make_unique<AccessElementOperatorAST>(std::make_unique<VariableAST>(var.data.value(), std::nullopt, false, false, false), std::move(index)), std::move(subexpr));
-        } else {
-            node = std::make_unique<BinaryOperatorAST>(subop, std::make_unique<AccessElementOperatorAST>(std::make_unique<VariableAST>(var.data.value(), std::nullopt, false, false, false), std::move(index)), std::move(rhs));
+            if (auto subop = op->children.front()->text(); subop != "=") {
+                auto subexpr = tree.makeAST<BinaryOperatorAST>(subop.substr(0, subop.size() - 1), tree.makeAST<VariableAST>(Ctx, var->text(), std::nullopt, isConstant, isDeclaration, rhs->isComptimeAssignable(Ctx)), rhs);
+                node = tree.makeAST<BinaryOperatorAST>("=", tree.makeAST<VariableAST>(Ctx, var->text(), std::nullopt, isConstant, isDeclaration, subexpr->isComptimeAssignable(Ctx)), subexpr);
+            } else {
+                if (!varType.has_value() && isDeclaration) varType = rhs->getType(Ctx);
+                node = tree.makeAST<BinaryOperatorAST>(subop, tree.makeAST<VariableAST>(Ctx, var->text(), varType, isConstant, isDeclaration, rhs->isComptimeAssignable(Ctx)), rhs);
+            }
+            break;
         }
-    } else if (type == "indirect_assignment") {
-        std::unique_ptr<BaseAST> rhs = std::move(std::get<std::unique_ptr<BaseAST>>(nodeStack.top())); nodeStack.pop();
-        TreeNode op = std::get<TreeNode>(nodeStack.top()); nodeStack.pop();
+        case ReduceAction::ShortDeclaration: {
+            BaseAST* rhs = std::get<BaseAST*>(nodeStack.top()); nodeStack.pop();
+            nodeStack.pop(); // COLON_EQUALS
+            const TreeNode* var = std::get<const TreeNode*>(nodeStack.top()); nodeStack.pop();
 
-        TreeNode chained_deref = std::get<TreeNode>(nodeStack.top()); nodeStack.pop();
-        TreeNode var = std::get<TreeNode>(nodeStack.top()); nodeStack.pop();
+            node = tree.makeAST<BinaryOperatorAST>(":=", tree.makeAST<VariableAST>(Ctx, var->text(), rhs->getType(Ctx), false, true, rhs->isComptimeAssignable(Ctx)), rhs);        
+            break;
+        }
+        case ReduceAction::ElementAssignment: {
+            BaseAST* rhs = std::get<BaseAST*>(nodeStack.top()); nodeStack.pop();
+            const TreeNode* op = std::get<const TreeNode*>(nodeStack.top()); nodeStack.pop();
 
-        auto makeDerefExpr = [&](void) {
-            std::unique_ptr<BaseAST> expr =
-                std::make_unique<VariableAST>(var.data.value(), std::nullopt, false, false, false);
+            nodeStack.pop(); // RSQUARE
+            BaseAST* index = std::get<BaseAST*>(nodeStack.top()); nodeStack.pop();
+            nodeStack.pop(); // LSQUARE
+            const TreeNode* var = std::get<const TreeNode*>(nodeStack.top()); nodeStack.pop();
 
-            for (size_t i = 0; i < chained_deref.children.size(); ++i) {
-                expr = std::make_unique<DereferenceOperatorAST>(std::move(expr));
+            if (auto subop = op->children.front()->text(); subop != "=") {
+                auto subexpr = tree.makeAST<BinaryOperatorAST>(subop.substr(0, subop.size() - 1), tree.makeAST<AccessElementOperatorAST>(tree.makeAST<VariableAST>(Ctx, var->text(), std::nullopt, false, false, false), index), rhs);
+                node = tree.makeAST<BinaryOperatorAST>("=", tree.makeAST<AccessElementOperatorAST>(tree.makeAST<VariableAST>(Ctx, var->text(), std::nullopt, false, false, false), index), subexpr);
+            } else {
+                node = tree.makeAST<BinaryOperatorAST>(subop, tree.makeAST<AccessElementOperatorAST>(tree.makeAST<VariableAST>(Ctx, var->text(), std::nullopt, false, false, false), index), rhs);
             }
+            break;
+        }
+        case ReduceAction::IndirectAssignment: {
+            BaseAST* rhs = std::get<BaseAST*>(nodeStack.top()); nodeStack.pop();
+            const TreeNode* op = std::get<const TreeNode*>(nodeStack.top()); nodeStack.pop();
 
-            return expr;
-        };
+            const TreeNode* chained_deref = std::get<const TreeNode*>(nodeStack.top()); nodeStack.pop();
+            const TreeNode* var = std::get<const TreeNode*>(nodeStack.top()); nodeStack.pop();
 
-        if (auto subop = op.children.front().data.value(); subop != "=") {
-            auto subexpr = std::make_unique<BinaryOperatorAST>(subop.substr(0, subop.size() - 1), makeDerefExpr(), std::move(rhs));
-            node = std::make_unique<BinaryOperatorAST>("=", makeDerefExpr(), std::move(subexpr));
-        } else {
-            node = std::make_unique<BinaryOperatorAST>(subop, makeDerefExpr(), std::move(rhs));
-        }
-    } else if (type == "if_stmt") {
-        nodeStack.pop(); // END
+            auto makeDerefExpr = [&](void) {
+                BaseAST* expr =
+                    tree.makeAST<VariableAST>(Ctx, var->text(), std::nullopt, false, false, false);
 
-        std::deque<std::unique_ptr<BaseAST>> statements;
-        while (!std::holds_alternative<TreeNode>(nodeStack.top())) {
-            statements.push_front(std::move(std::get<std::unique_ptr<BaseAST>>(nodeStack.top())));
-            nodeStack.pop();
+                for (size_t i = 0; i < indirectionDepth(chained_deref); ++i) {
+                    expr = tree.makeAST<DereferenceOperatorAST>(expr);
+                }
+
+                return expr;
+            };
+
+            if (auto subop = op->children.front()->text(); subop != "=") {
+                auto subexpr = tree.makeAST<BinaryOperatorAST>(subop.substr(0, subop.size() - 1), makeDerefExpr(), rhs);
+                node = tree.makeAST<BinaryOperatorAST>("=", makeDerefExpr(), subexpr);
+            } else {
+                node = tree.makeAST<BinaryOperatorAST>(subop, makeDerefExpr(), rhs);
+            }
+            break;
         }
-        std::unique_ptr<BaseAST> block = std::make_unique<BlockAST>(std::move(statements));
+        case ReduceAction::IfStmt: {
+            nodeStack.pop(); // END
 
-        if (std::get<TreeNode>(nodeStack.top()).name == "ELSE") {
-            nodeStack.pop(); // ELSE
-            
-            std::deque<std::unique_ptr<BaseAST>> elif_statements;
-            while (!std::holds_alternative<TreeNode>(nodeStack.top())) {
-                elif_statements.push_front(std::move(std::get<std::unique_ptr<BaseAST>>(nodeStack.top())));
+            std::deque<BaseAST*> statements;
+            while (!std::holds_alternative<const TreeNode*>(nodeStack.top())) {
+                statements.push_front(std::get<BaseAST*>(nodeStack.top()));
                 nodeStack.pop();
             }
-            auto elif_block = std::make_unique<BlockAST>(std::move(elif_statements));
-            nodeStack.pop(); // THEN
+            BaseAST* block = tree.makeAST<BlockAST>(tree.makeList(statements));
 
-            auto condition = std::move(std::get<std::unique_ptr<BaseAST>>(nodeStack.top())); nodeStack.pop();
-            block = std::make_unique<IfStmtAST>(std::move(condition), std::move(elif_block), std::move(block));
+            if (std::get<const TreeNode*>(nodeStack.top())->name == "ELSE") {
+                nodeStack.pop(); // ELSE
+            
+                std::deque<BaseAST*> elif_statements;
+                while (!std::holds_alternative<const TreeNode*>(nodeStack.top())) {
+                    elif_statements.push_front(std::get<BaseAST*>(nodeStack.top()));
+                    nodeStack.pop();
+                }
+                auto elif_block = tree.makeAST<BlockAST>(tree.makeList(elif_statements));
+                nodeStack.pop(); // THEN
 
-            bool is_if = std::get<TreeNode>(nodeStack.top()).name == "IF";
-            nodeStack.pop(); // ELIF or IF
+                auto condition = std::get<BaseAST*>(nodeStack.top()); nodeStack.pop();
+                block = tree.makeAST<IfStmtAST>(condition, elif_block, block);
 
-            if (is_if) {
-                node = std::move(block);
-                goto done;
-            }
+                bool is_if = std::get<const TreeNode*>(nodeStack.top())->name == "IF";
+                nodeStack.pop(); // ELIF or IF
 
-        } else {
-            nodeStack.pop(); // THEN
+                if (is_if) {
+                    node = block;
+                    goto done;
+                }
 
-            auto condition = std::move(std::get<std::unique_ptr<BaseAST>>(nodeStack.top())); nodeStack.pop();
-            block = std::make_unique<IfStmtAST>(std::move(condition), std::move(block), nullptr);
+            } else {
+                nodeStack.pop(); // THEN
 
-            bool is_if = std::get<TreeNode>(nodeStack.top()).name == "IF";
-            nodeStack.pop(); // ELIF or IF
+                auto condition = std::get<BaseAST*>(nodeStack.top()); nodeStack.pop();
+                block = tree.makeAST<IfStmtAST>(condition, block, nullptr);
 
-            if (is_if) {
-                node = std::move(block);
-                goto done;
-            }
-        }
+                bool is_if = std::get<const TreeNode*>(nodeStack.top())->name == "IF";
+                nodeStack.pop(); // ELIF or IF
 
-        while (true) {
-            std::deque<std::unique_ptr<BaseAST>> elif_statements;
-            while (!std::holds_alternative<TreeNode>(nodeStack.top())) {
-                elif_statements.push_front(std::move(std::get<std::unique_ptr<BaseAST>>(nodeStack.top())));
-                nodeStack.pop();
+                if (is_if) {
+                    node = block;
+                    goto done;
+                }
             }
-            auto elif_block = std::make_unique<BlockAST>(std::move(elif_statements));
-            nodeStack.pop(); // THEN
 
-            auto condition = std::move(std::get<std::unique_ptr<BaseAST>>(nodeStack.top())); nodeStack.pop();
-            block = std::make_unique<IfStmtAST>(std::move(condition), std::move(elif_block), std::move(block));
+            while (true) {
+                std::deque<BaseAST*> elif_statements;
+                while (!std::holds_alternative<const TreeNode*>(nodeStack.top())) {
+                    elif_statements.push_front(std::get<BaseAST*>(nodeStack.top()));
+                    nodeStack.pop();
+                }
+                auto elif_block = tree.makeAST<BlockAST>(tree.makeList(elif_statements));
+                nodeStack.pop(); // THEN
+
+                auto condition = std::get<BaseAST*>(nodeStack.top()); nodeStack.pop();
+                block = tree.makeAST<IfStmtAST>(condition, elif_block, block);
 
-            bool is_if = std::get<TreeNode>(nodeStack.top()).name == "IF";
-            nodeStack.pop(); // ELIF or IF
+                bool is_if = std::get<const TreeNode*>(nodeStack.top())->name == "IF";
+                nodeStack.pop(); // ELIF or IF
 
-            if (is_if) {
-                node = std::move(block);
-                goto done;
+                if (is_if) {
+                    node = block;
+                    goto done;
+                }
             }
-        }
 
-        done:
-            //std::get<std::unique_ptr<BaseAST>>(node)->codegen()->print(llvm::errs());
-            fprintf(stderr, "\n");
-    } else if (type == "elif_stmt" || type == "task_header" || type == "args" || type == "params" || type == "generic_list" || type == "type" || type == "type_spec" || type == "type_signature" || type == "and_chain" || type == "or_chain") {
-        return; // handled by it's corresponding statement
-    } else if (type == "while_loop") {
-        nodeStack.pop(); // END
-
-        std::deque<std::unique_ptr<BaseAST>> statements;
-        while (!std::holds_alternative<TreeNode>(nodeStack.top())) {
-            statements.push_front(std::move(std::get<std::unique_ptr<BaseAST>>(nodeStack.top())));
-            nodeStack.pop();
+            done:
+                //std::get<BaseAST*>(node)->codegen()->print(llvm::errs());
+            break;
         }
-        std::unique_ptr<BaseAST> block = std::make_unique<BlockAST>(std::move(statements));
+        case ReduceAction::Skip: {
+            return; // handled by it's corresponding statement
+        }
+        case ReduceAction::WhileLoop: {
+            nodeStack.pop(); // END
 
-        nodeStack.pop(); // DO
-        std::unique_ptr<BaseAST> cond = std::move(std::get<std::unique_ptr<BaseAST>>(nodeStack.top())); nodeStack.pop();
-        nodeStack.pop(); // WHILE
+            std::deque<BaseAST*> statements;
+            while (!std::holds_alternative<const TreeNode*>(nodeStack.top())) {
+                statements.push_front(std::get<BaseAST*>(nodeStack.top()));
+                nodeStack.pop();
+            }
+            BaseAST* block = tree.makeAST<BlockAST>(tree.makeList(statements));
 
-        std::optional<std::string> label = std::nullopt;
-        if (std::holds_alternative<TreeNode>(nodeStack.top()) && std::get<TreeNode>(nodeStack.top()).name == "COLON") {
-            nodeStack.pop(); // COLON
-            label = std::get<TreeNode>(nodeStack.top()).data.value(); nodeStack.pop();
-            nodeStack.pop(); // LABEL_START
-        }
+            nodeStack.pop(); // DO
+            BaseAST* cond = std::get<BaseAST*>(nodeStack.top()); nodeStack.pop();
+            nodeStack.pop(); // WHILE
 
-        node = std::make_unique<WhileLoopAST>(label, std::move(cond), std::move(block));
-    } else if (type == "for_loop") {
-        nodeStack.pop(); // END
+            std::optional<std::string> label = std::nullopt;
+            if (std::holds_alternative<const TreeNode*>(nodeStack.top()) && std::get<const TreeNode*>(nodeStack.top())->name == "COLON") {
+                nodeStack.pop(); // COLON
+                label = std::get<const TreeNode*>(nodeStack.top())->text(); nodeStack.pop();
+                nodeStack.pop(); // LABEL_START
+            }
 
-        std::deque<std::unique_ptr<BaseAST>> statements;
-        while (!std::holds_alternative<TreeNode>(nodeStack.top())) {
-            statements.push_front(std::move(std::get<std::unique_ptr<BaseAST>>(nodeStack.top())));
-            nodeStack.pop();
+            node = tree.makeAST<WhileLoopAST>(label, cond, block);
+            break;
         }
-        std::unique_ptr<BaseAST> block = std::make_unique<BlockAST>(std::move(statements));
+        case ReduceAction::ForLoop: {
+            nodeStack.pop(); // END
 
-        nodeStack.pop(); // DO
+            std::deque<BaseAST*> statements;
+            while (!std::holds_alternative<const TreeNode*>(nodeStack.top())) {
+                statements.push_front(std::get<BaseAST*>(nodeStack.top()));
+                nodeStack.pop();
+            }
+            BaseAST* block = tree.makeAST<BlockAST>(tree.makeList(statements));
 
-        std::unique_ptr<BaseAST> inc = std::move(std::get<std::unique_ptr<BaseAST>>(nodeStack.top())); nodeStack.pop();
-        nodeStack.pop(); // SEMICOLON
-        std::unique_ptr<BaseAST> cond = std::move(std::get<std::unique_ptr<BaseAST>>(nodeStack.top())); nodeStack.pop();
-        nodeStack.pop(); // SEMICOLON
-        std::unique_ptr<BaseAST> init = std::move(std::get<std::unique_ptr<BaseAST>>(nodeStack.top())); nodeStack.pop();
+            nodeStack.pop(); // DO
 
-        nodeStack.pop(); // FOR
+            BaseAST* inc = std::get<BaseAST*>(nodeStack.top()); nodeStack.pop();
+            nodeStack.pop(); // SEMICOLON
+            BaseAST* cond = std::get<BaseAST*>(nodeStack.top()); nodeStack.pop();
+            nodeStack.pop(); // SEMICOLON
+            BaseAST* init = std::get<BaseAST*>(nodeStack.top()); nodeStack.pop();
 
-        std::optional<std::string> label = std::nullopt;
-        if (std::holds_alternative<TreeNode>(nodeStack.top()) && std::get<TreeNode>(nodeStack.top()).name == "COLON") {
-            nodeStack.pop(); // COLON
-            label = std::get<TreeNode>(nodeStack.top()).data.value(); nodeStack.pop();
-            nodeStack.pop(); // LABEL_START
-        }
+            nodeStack.pop(); // FOR
 
-        node = std::make_unique<ForLoopAST>(label, std::move(init), std::move(cond), std::move(inc), std::move(block));
-    } else if (type == "for_in_loop") {
-        nodeStack.pop(); // END
+            std::optional<std::string> label = std::nullopt;
+            if (std::holds_alternative<const TreeNode*>(nodeStack.top()) && std::get<const TreeNode*>(nodeStack.top())->name == "COLON") {
+                nodeStack.pop(); // COLON
+                label = std::get<const TreeNode*>(nodeStack.top())->text(); nodeStack.pop();
+                nodeStack.pop(); // LABEL_START
+            }
 
-        std::deque<std::unique_ptr<BaseAST>> statements;
-        while (!std::holds_alternative<TreeNode>(nodeStack.top())) {
-            statements.push_front(std::move(std::get<std::unique_ptr<BaseAST>>(nodeStack.top())));
-            nodeStack.pop();
+            node = tree.makeAST<ForLoopAST>(label, init, cond, inc, block);
+            break;
         }
-        std::unique_ptr<BaseAST> block = std::make_unique<BlockAST>(std::move(statements));
+        case ReduceAction::ForInLoop: {
+            nodeStack.pop(); // END
+
+            std::deque<BaseAST*> statements;
+            while (!std::holds_alternative<const TreeNode*>(nodeStack.top())) {
+                statements.push_front(std::get<BaseAST*>(nodeStack.top()));
+                nodeStack.pop();
+            }
+            BaseAST* block = tree.makeAST<BlockAST>(tree.makeList(statements));
 
-        nodeStack.pop(); // DO
+            nodeStack.pop(); // DO
 
-        std::unique_ptr<BaseAST> collection = std::make_unique<VariableAST>(std::get<TreeNode>(nodeStack.top()).data.value(), std::nullopt, false, false, false); nodeStack.pop();
-        nodeStack.pop(); // IN
-        std::unique_ptr<BaseAST> elmntName = std::make_unique<VariableAST>(std::get<TreeNode>(nodeStack.top()).data.value(), std::nullopt, false, false, false); nodeStack.pop();
-        nodeStack.pop(); // FOR
+            BaseAST* collection = tree.makeAST<VariableAST>(Ctx, std::get<const TreeNode*>(nodeStack.top())->text(), std::nullopt, false, false, false); nodeStack.pop();
+            nodeStack.pop(); // IN
+            BaseAST* elmntName = tree.makeAST<VariableAST>(Ctx, std::get<const TreeNode*>(nodeStack.top())->text(), std::nullopt, false, false, false); nodeStack.pop();
+            nodeStack.pop(); // FOR
 
-        std::optional<std::string> label = std::nullopt;
-        if (std::holds_alternative<TreeNode>(nodeStack.top()) && std::get<TreeNode>(nodeStack.top()).name == "COLON") {
-            nodeStack.pop(); // COLON
-            label = std::get<TreeNode>(nodeStack.top()).data.value(); nodeStack.pop();
-            nodeStack.pop(); // LABEL_START          
-        }
+            std::optional<std::string> label = std::nullopt;
+            if (std::holds_alternative<const TreeNode*>(nodeStack.top()) && std::get<const TreeNode*>(nodeStack.top())->name == "COLON") {
+                nodeStack.pop(); // COLON
+                label = std::get<const TreeNode*>(nodeStack.top())->text(); nodeStack.pop();
+                nodeStack.pop(); // LABEL_START          
+            }
 
-        node = std::make_unique<ForInLoopAST>(label, std::move(elmntName), std::move(collection), std::move(block));
-    } else if (type == "continue_stmt") {
-        std::optional<std::string> label = std::nullopt;
-        if (std::holds_alternative<TreeNode>(nodeStack.top()) && std::get<TreeNode>(nodeStack.top()).name == "VAR") {
-            label = std::get<TreeNode>(nodeStack.top()).data.value(); nodeStack.pop();
+            node = tree.makeAST<ForInLoopAST>(label, elmntName, collection, block);
+            break;
         }
+        case ReduceAction::ContinueStmt: {
+            std::optional<std::string> label = std::nullopt;
+            if (std::holds_alternative<const TreeNode*>(nodeStack.top()) && std::get<const TreeNode*>(nodeStack.top())->name == "VAR") {
+                label = std::get<const TreeNode*>(nodeStack.top())->text(); nodeStack.pop();
+            }
 
-        nodeStack.pop(); // CONTINUE
-        node = std::make_unique<ContinueStmtAST>(label);
-    } else if (type == "break_stmt") {
-        std::optional<std::string> label = std::nullopt;
-        if (std::holds_alternative<TreeNode>(nodeStack.top()) && std::get<TreeNode>(nodeStack.top()).name == "VAR") {
-            label = std::get<TreeNode>(nodeStack.top()).data.value(); nodeStack.pop();
+            nodeStack.pop(); // CONTINUE
+            node = tree.makeAST<ContinueStmtAST>(label);
+            break;
         }
+        case ReduceAction::BreakStmt: {
+            std::optional<std::string> label = std::nullopt;
+            if (std::holds_alternative<const TreeNode*>(nodeStack.top()) && std::get<const TreeNode*>(nodeStack.top())->name == "VAR") {
+                label = std::get<const TreeNode*>(nodeStack.top())->text(); nodeStack.pop();
+            }
 
-        nodeStack.pop(); // BREAK
-        node = std::make_unique<BreakStmtAST>(label);
-    } else if (type == "return_stmt") {
-        // assuming not multiple return values
-        if (!std::holds_alternative<TreeNode>(nodeStack.top())) {
-            node = std::make_unique<ReturnStmtAST>(std::move(std::get<std::unique_ptr<BaseAST>>(nodeStack.top())));
-            nodeStack.pop();
-            nodeStack.pop(); // RETURN
-        } else {
-            node = std::make_unique<ReturnStmtAST>(nullptr);
-            nodeStack.pop(); // RETURN
+            nodeStack.pop(); // BREAK
+            node = tree.makeAST<BreakStmtAST>(label);
+            break;
         }
-    } else if (type == "goto_stmt") {
-        std::string target = std::get<TreeNode>(nodeStack.top()).data.value(); nodeStack.pop();
-        nodeStack.pop(); // GOTO
-
-        node = std::make_unique<GotoStmtAST>(target);
-    } else if (type == "label_stmt") {
-        std::string name = std::get<TreeNode>(nodeStack.top()).data.value(); nodeStack.pop();
-        nodeStack.pop(); // LABEL_START
-
-        node = std::make_unique<LabelStmtAST>(name);
-    } else if (type == "extern_task") {
-        BabelType retType = getBabelType(nodeStack);
-        nodeStack.pop(); nodeStack.pop(); // RARR and RPAREN
-
-        std::deque<BabelType> ArgTypes;
-        bool isVarArg = false;
-
-        bool isFirstIter = true;
-        while (std::get<TreeNode>(nodeStack.top()).name != "LPAREN") {
-            if (std::get<TreeNode>(nodeStack.top()).name == "VARARG") {
-                isVarArg = true;
-                nodeStack.pop(); // VARARG
-
-                if (!isFirstIter)
-                    babel_panic("variable arguments must appear last in task definition");
+        case ReduceAction::ReturnStmt: {
+            // assuming not multiple return values
+            if (!std::holds_alternative<const TreeNode*>(nodeStack.top())) {
+                node = tree.makeAST<ReturnStmtAST>(std::get<BaseAST*>(nodeStack.top()));
+                nodeStack.pop();
+                nodeStack.pop(); // RETURN
             } else {
-                ArgTypes.push_front(getBabelType(nodeStack));
+                node = tree.makeAST<ReturnStmtAST>(nullptr);
+                nodeStack.pop(); // RETURN
             }
+            break;
+        }
+        case ReduceAction::GotoStmt: {
+            std::string target = std::get<const TreeNode*>(nodeStack.top())->text(); nodeStack.pop();
+            nodeStack.pop(); // GOTO
 
-            if (std::get<TreeNode>(nodeStack.top()).name == "COMMA")
-                nodeStack.pop();
+            node = tree.makeAST<GotoStmtAST>(target);
+            break;
+        }
+        case ReduceAction::LabelStmt: {
+            std::string name = std::get<const TreeNode*>(nodeStack.top())->text(); nodeStack.pop();
+            nodeStack.pop(); // LABEL_START
 
-            isFirstIter = false;
+            node = tree.makeAST<LabelStmtAST>(name);
+            break;
         }
+        case ReduceAction::ExternTask: {
+            BabelType retType = getBabelType(Ctx, nodeStack);
+            nodeStack.pop(); nodeStack.pop(); // RARR and RPAREN
 
-        nodeStack.pop(); // LPAREN
-        std::string TaskName = std::get<TreeNode>(nodeStack.top()).data.value(); nodeStack.pop();
-        nodeStack.pop(); nodeStack.pop(); // TASK and EXTERN
+            std::deque<BabelType> ArgTypes;
+            bool isVarArg = false;
 
-        node = std::make_unique<TaskHeaderAST>(TaskName, std::deque<std::string>(ArgTypes.size(), "") , ArgTypes, retType, isVarArg);
-    } else if (type == "task_def") {
-        nodeStack.pop(); // END
+            bool isFirstIter = true;
+            while (std::get<const TreeNode*>(nodeStack.top())->name != "LPAREN") {
+                if (std::get<const TreeNode*>(nodeStack.top())->name == "VARARG") {
+                    isVarArg = true;
+                    nodeStack.pop(); // VARARG
 
-        std::deque<std::unique_ptr<BaseAST>> statements;
-        while (!std::holds_alternative<TreeNode>(nodeStack.top())) {
-            statements.push_front(std::move(std::get<std::unique_ptr<BaseAST>>(nodeStack.top())));
-            nodeStack.pop();
-        }
-        std::unique_ptr<BaseAST> block = std::make_unique<BlockAST>(std::move(statements));
+                    if (!isFirstIter)
+                        babel_panic("variable arguments must appear last in task definition");
+                } else {
+                    ArgTypes.push_front(getBabelType(Ctx, nodeStack));
+                }
 
-        nodeStack.pop(); // DO
-        BabelType retType = getBabelType(nodeStack);
-        nodeStack.pop(); nodeStack.pop(); // RARR and RPAREN
+                if (std::get<const TreeNode*>(nodeStack.top())->name == "COMMA")
+                    nodeStack.pop();
 
-        std::deque<std::string> ArgNames;
-        std::deque<BabelType> ArgTypes;
-        bool isVarArg = false;
+                isFirstIter = false;
+            }
 
-        bool isFirstIter = true;
-        while (std::get<TreeNode>(nodeStack.top()).name != "LPAREN") {
-            if (std::get<TreeNode>(nodeStack.top()).name == "VARARG") {
-                isVarArg = true;
-                nodeStack.pop(); // VARARG
+            nodeStack.pop(); // LPAREN
+            std::string TaskName = std::get<const TreeNode*>(nodeStack.top())->text(); nodeStack.pop();
+            nodeStack.pop(); nodeStack.pop(); // TASK and EXTERN
 
-                if (!isFirstIter)
-                    babel_panic("variable arguments must appear last in task definition");
-            } else {
-                // assuming no default value for now
-                ArgTypes.push_front(getBabelType(nodeStack));
-                nodeStack.pop(); // COLON
-                ArgNames.push_front(std::get<TreeNode>(nodeStack.top()).data.value()); nodeStack.pop();
-            }
+            node = tree.makeAST<TaskHeaderAST>(Ctx, TaskName, std::deque<std::string>(ArgTypes.size(), "") , ArgTypes, retType, isVarArg);
+            break;
+        }
+        case ReduceAction::TaskDef: {
+            nodeStack.pop(); // END
 
-            if (std::get<TreeNode>(nodeStack.top()).name == "COMMA")
+            std::deque<BaseAST*> statements;
+            while (!std::holds_alternative<const TreeNode*>(nodeStack.top())) {
+                statements.push_front(std::get<BaseAST*>(nodeStack.top()));
                 nodeStack.pop();
+            }
+            BaseAST* block = tree.makeAST<BlockAST>(tree.makeList(statements));
 
-            isFirstIter = false;
-        }
+            nodeStack.pop(); // DO
+            BabelType retType = getBabelType(Ctx, nodeStack);
+            nodeStack.pop(); nodeStack.pop(); // RARR and RPAREN
 
-        nodeStack.pop(); // LPAREN
-        std::string TaskName = std::get<TreeNode>(nodeStack.top()).data.value(); nodeStack.pop();
-        nodeStack.pop(); // TASK
-        
-        auto header = std::make_unique<TaskHeaderAST>(TaskName, std::move(ArgNames), std::move(ArgTypes), retType, isVarArg);
-        node = std::make_unique<TaskAST>(std::move(header), std::move(block));
-    } else if (type == "macro_call") {
-        std::deque<std::variant<std::unique_ptr<BaseAST>, BabelType>> Args;
-        if (std::get<TreeNode>(nodeStack.top()).name == "RPAREN") {
-            nodeStack.pop(); // RPAREN
+            std::deque<std::string> ArgNames;
+            std::deque<BabelType> ArgTypes;
+            bool isVarArg = false;
+
+            bool isFirstIter = true;
+            while (std::get<const TreeNode*>(nodeStack.top())->name != "LPAREN") {
+                if (std::get<const TreeNode*>(nodeStack.top())->name == "VARARG") {
+                    isVarArg = true;
+                    nodeStack.pop(); // VARARG
 
-            // assuming expressions/types as params
-            while (!std::holds_alternative<TreeNode>(nodeStack.top()) || std::get<TreeNode>(nodeStack.top()).name != "LPAREN") {
-                if (std::holds_alternative<TreeNode>(nodeStack.top())) {
-                    Args.emplace_front(getBabelType(nodeStack));
+                    if (!isFirstIter)
+                        babel_panic("variable arguments must appear last in task definition");
                 } else {
-                    Args.emplace_front(std::move(std::get<std::unique_ptr<BaseAST>>(nodeStack.top()))); nodeStack.pop();
+                    // assuming no default value for now
+                    ArgTypes.push_front(getBabelType(Ctx, nodeStack));
+                    nodeStack.pop(); // COLON
+                    ArgNames.push_front(std::get<const TreeNode*>(nodeStack.top())->text()); nodeStack.pop();
                 }
 
-                if (std::get<TreeNode>(nodeStack.top()).name == "COMMA")
+                if (std::get<const TreeNode*>(nodeStack.top())->name == "COMMA")
                     nodeStack.pop();
+
+                isFirstIter = false;
             }
+
             nodeStack.pop(); // LPAREN
-        }
+            std::string TaskName = std::get<const TreeNode*>(nodeStack.top())->text(); nodeStack.pop();
+            nodeStack.pop(); // TASK
+        
+            auto header = tree.makeAST<TaskHeaderAST>(Ctx, TaskName, std::move(ArgNames), std::move(ArgTypes), retType, isVarArg);
+            node = tree.makeAST<TaskAST>(header, block);
+            break;
+        }
+        case ReduceAction::MacroCall: {
+            std::deque<std::variant<BaseAST*, BabelType>> Args;
+            if (std::get<const TreeNode*>(nodeStack.top())->name == "RPAREN") {
+                nodeStack.pop(); // RPAREN
+
+                // assuming expressions/types as params
+                while (!std::holds_alternative<const TreeNode*>(nodeStack.top()) || std::get<const TreeNode*>(nodeStack.top())->name != "LPAREN") {
+                    if (std::holds_alternative<const TreeNode*>(nodeStack.top())) {
+                        Args.emplace_front(getBabelType(Ctx, nodeStack));
+                    } else {
+                        Args.emplace_front(std::get<BaseAST*>(nodeStack.top())); nodeStack.pop();
+                    }
+
+                    if (std::get<const TreeNode*>(nodeStack.top())->name == "COMMA")
+                        nodeStack.pop();
+                }
+                nodeStack.pop(); // LPAREN
+            }
 
-        auto name = std::get<TreeNode>(nodeStack.top()).data.value(); nodeStack.pop();
-        nodeStack.pop(); // AT
-        node = std::make_unique<MacroCallAST>(name, std::move(Args));
-    } else if (type == "function_call") {
-        nodeStack.pop(); // RPAREN
-
-        // assuming expressions as params
-        std::deque<std::unique_ptr<BaseAST>> Args;
-        while (!std::holds_alternative<TreeNode>(nodeStack.top()) || std::get<TreeNode>(nodeStack.top()).name != "LPAREN") {
-            Args.push_front(std::move(std::get<std::unique_ptr<BaseAST>>(nodeStack.top()))); nodeStack.pop();
-            if (std::get<TreeNode>(nodeStack.top()).name == "COMMA")
-                nodeStack.pop();
+            auto name = std::get<const TreeNode*>(nodeStack.top())->text(); nodeStack.pop();
+            nodeStack.pop(); // AT
+            node = tree.makeAST<MacroCallAST>(name, std::move(Args));
+            break;
         }
+        case ReduceAction::FunctionCall: {
+            nodeStack.pop(); // RPAREN
 
-        nodeStack.pop(); // LPAREN
-        auto name = std::get<TreeNode>(nodeStack.top()).data.value(); nodeStack.pop();
-        node = std::make_unique<TaskCallAST>(name, std::move(Args));
-    } else if (type == "class_construction") {
-        nodeStack.pop(); // RPAREN
+            // assuming expressions as params
+            std::deque<BaseAST*> Args;
+            while (!std::holds_alternative<const TreeNode*>(nodeStack.top()) || std::get<const TreeNode*>(nodeStack.top())->name != "LPAREN") {
+                Args.push_front(std::get<BaseAST*>(nodeStack.top())); nodeStack.pop();
+                if (std::get<const TreeNode*>(nodeStack.top())->name == "COMMA")
+                    nodeStack.pop();
+            }
 
-        std::deque<std::unique_ptr<BaseAST>> Args;
-        while (!std::holds_alternative<TreeNode>(nodeStack.top()) || std::get<TreeNode>(nodeStack.top()).name != "LPAREN") {
-            Args.push_front(std::move(std::get<std::unique_ptr<BaseAST>>(nodeStack.top()))); nodeStack.pop();
-            if (std::get<TreeNode>(nodeStack.top()).name == "COMMA")
-                nodeStack.pop();
+            nodeStack.pop(); // LPAREN
+            auto name = std::get<const TreeNode*>(nodeStack.top())->text(); nodeStack.pop();
+            node = tree.makeAST<TaskCallAST>(name, tree.makeList(Args));
+            break;
         }
+        case ReduceAction::ClassConstruction: {
+            nodeStack.pop(); // RPAREN
 
-        nodeStack.pop(); // LPAREN
-        auto name = std::get<TreeNode>(nodeStack.top()).data.value(); nodeStack.pop();
-        nodeStack.pop(); // NEW
+            std::deque<BaseAST*> Args;
+            while (!std::holds_alternative<const TreeNode*>(nodeStack.top()) || std::get<const TreeNode*>(nodeStack.top())->name != "LPAREN") {
+                Args.push_front(std::get<BaseAST*>(nodeStack.top())); nodeStack.pop();
+                if (std::get<const TreeNode*>(nodeStack.top())->name == "COMMA")
+                    nodeStack.pop();
+            }
+
+            nodeStack.pop(); // LPAREN
+            auto name = std::get<const TreeNode*>(nodeStack.top())->text(); nodeStack.pop();
+            nodeStack.pop(); // NEW
 
-        if (name == "Array") {
-            node = std::make_unique<ArrayAST>(std::move(Args));
-        } else {
-            babel_stub();
+            if (name == "Array") {
+                node = tree.makeAST<ArrayAST>(Ctx, tree.makeList(Args));
+            } else {
+                babel_stub();
+            }
+            break;
+        }
+        case ReduceAction::SimpleStmt: {
+            if (std::holds_alternative<const TreeNode*>(nodeStack.top()) && std::get<const TreeNode*>(nodeStack.top())->name == "NOOP") {
+                nodeStack.pop(); // NOOP
+                node = tree.makeAST<BlockAST>(ASTList{});
+            } else {
+                node = std::get<BaseAST*>(nodeStack.top()); nodeStack.pop();
+                if (!std::get<BaseAST*>(node)->isStatementLike())
+                    babel_panic("expression has no effect as a statement");
+            }
+            break;
         }
-    } else if (type == "simple_stmt") {
-        if (std::holds_alternative<TreeNode>(nodeStack.top()) && std::get<TreeNode>(nodeStack.top()).name == "NOOP") {
-            nodeStack.pop(); // NOOP
-            node = std::make_unique<BlockAST>(std::deque<std::unique_ptr<BaseAST>>{});
-        } else {
-            node = std::move(std::get<std::unique_ptr<BaseAST>>(nodeStack.top())); nodeStack.pop();
-            if (!std::get<std::unique_ptr<BaseAST>>(node)->isStatementLike())
-                babel_panic("expression has no effect as a statement");
+        case ReduceAction::Terminator: {
+            nodeStack.pop();
+            return;
         }
-    } else if (type == "terminator") {
-        nodeStack.pop();
-        return;
-    } else {
-        node = TreeNode();
-        std::get<TreeNode>(node).name = type;
-        for (int i = 0; i < removeCount; i++) {
-            if (!std::holds_alternative<TreeNode>(nodeStack.top()))
-                continue;
-
-            TreeNode rdChild = std::get<TreeNode>(nodeStack.top()); nodeStack.pop();
-            if (rdChild.children.empty() && !rdChild.data.has_value())
-                continue;
-
-            std::get<TreeNode>(node).children.push_front(rdChild);
+        case ReduceAction::Tree: {
+            std::vector<const TreeNode*> children;
+            for (int i = 0; i < removeCount; i++) {
+                if (!std::holds_alternative<const TreeNode*>(nodeStack.top()))
+                    continue;
+
+                const TreeNode* rdChild = std::get<const TreeNode*>(nodeStack.top()); nodeStack.pop();
+                if (rdChild->children.empty() && !rdChild->data.has_value())
+                    continue;
+
+                children.push_back(rdChild);
+            }
+
+            std::ranges::reverse(children);
+            node = tree.makeNode(kind, type, children);
+            break;
         }
     }
 
-    nodeStack.push(std::move(node));
+    nodeStack.push(node);
 }
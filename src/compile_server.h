@@ -0,0 +1,274 @@
+#ifndef COMPILE_SERVER_H
+#define COMPILE_SERVER_H
+
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// A babel that stays up and compiles for thin clients, so only its first compile pays for starting the
+// process, initializing LLVM and setting up the lexer and parser. A client connects to the Unix socket and
+// sends its working directory, its arguments and its stdin, stdout and stderr. The server forks a child
+// per request that runs them like a fresh babel would, straight on the client's streams, and answers with
+// its exit status. Requests run side by side and neither their state nor a crash outlives the child.
+//
+// Request: a 4 byte length with the three streams attached as SCM_RIGHTS, then that many bytes of NUL
+// terminated strings, the working directory first. Reply: the 4 byte exit status.
+//
+// A request writes wherever the server's user may, so only that user can reach the socket or is answered.
+using CompileRequestHandler = std::function<int(const std::vector<std::string>& args)>;
+
+#ifdef _WIN32
+int serveCompiles(const std::string&, const CompileRequestHandler&) {
+    std::cerr << "The compile server needs Unix sockets, it is not available on this platform\n";
+    return 1;
+}
+
+std::optional<int> compileOnServer(const std::string&, const std::vector<std::string>&) {
+    std::cerr << "The compile server needs Unix sockets, it is not available on this platform\n";
+    return std::nullopt;
+}
+#else
+
+bool sendAll(int fd, const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t written = send(fd, bytes, size, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return false;
+        bytes += written;
+        size -= written;
+    }
+    return true;
+}
+
+bool receiveAll(int fd, void* data, size_t size) {
+    char* bytes = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t received = recv(fd, bytes, size, 0);
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) return false;
+        bytes += received;
+        size -= received;
+    }
+    return true;
+}
+
+std::optional<sockaddr_un> unixSocketAddress(const std::string& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof address.sun_path) {
+        std::cerr << "Invalid socket path '" << path << "'\n";
+        return std::nullopt;
+    }
+
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return address;
+}
+
+// Whether the process at the other end of a connection runs as the same user as the server
+bool isSameUser(int connection) {
+    ucred peer{};
+    socklen_t size = sizeof peer;
+    return getsockopt(connection, SOL_SOCKET, SO_PEERCRED, &peer, &size) == 0 && size == sizeof peer && peer.uid == getuid();
+}
+
+// Runs one request on its own connection and answers with the exit status of the compile
+int handleCompileRequest(int connection, const CompileRequestHandler& compile) {
+    uint32_t size = 0;
+    int streams[3];
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof streams)] = {};
+    iovec data{&size, sizeof size};
+
+    msghdr message{};
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof control;
+
+    if (recvmsg(connection, &message, MSG_CMSG_CLOEXEC) != sizeof size) return 1;
+    cmsghdr* header = CMSG_FIRSTHDR(&message);
+    if (!header || header->cmsg_type != SCM_RIGHTS || header->cmsg_len != CMSG_LEN(sizeof streams)) return 1;
+    std::memcpy(streams, CMSG_DATA(header), sizeof streams);
+
+    std::string payload(size, '\0');
+    if (!receiveAll(connection, payload.data(), size)) return 1;
+
+    std::vector<std::string> args;
+    for (size_t begin = 0, end; begin < payload.size(); begin = end + 1) {
+        end = payload.find('\0', begin);
+        if (end == std::string::npos) return 1;
+        args.push_back(payload.substr(begin, end - begin));
+    }
+    if (args.empty()) return 1;
+
+    pid_t compiler = fork();
+    if (compiler == 0) {
+        close(connection);
+        for (int fd = 0; fd < 3; fd++) dup2(streams[fd], fd);
+
+        if (chdir(args.front().c_str()) != 0) {
+            std::cerr << "Cannot enter '" << args.front() << "': " << std::strerror(errno) << "\n";
+            std::_Exit(1);
+        }
+
+        args.erase(args.begin());
+        // exit and not _exit, the streams still have to be flushed to the client
+        std::exit(compile(args));
+    }
+
+    for (int fd : streams) close(fd);
+
+    int32_t status = 1;
+    int waitStatus = 0;
+    if (compiler > 0 && waitpid(compiler, &waitStatus, 0) == compiler) {
+        // like a shell reports it, so clients fail the same way a local babel would
+        status = WIFSIGNALED(waitStatus) ? 128 + WTERMSIG(waitStatus) : WEXITSTATUS(waitStatus);
+    }
+
+    sendAll(connection, &status, sizeof status);
+    close(connection);
+    return 0;
+}
+
+// Accepts requests until the process is stopped. compile is called in a fresh child per request, with the
+// arguments of the client and already in its working directory.
+int serveCompiles(const std::string& socketPath, const CompileRequestHandler& compile) {
+    std::optional<sockaddr_un> address = unixSocketAddress(socketPath);
+    if (!address) return 1;
+
+    int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener < 0) {
+        std::cerr << "Cannot create socket: " << std::strerror(errno) << "\n";
+        return 1;
+    }
+
+    // a server that was killed leaves its socket behind, one that still accepts connections is left alone
+    std::error_code error;
+    if (std::filesystem::is_socket(socketPath, error)) {
+        int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        bool accepted = probe >= 0 && connect(probe, reinterpret_cast<sockaddr*>(&*address), sizeof *address) == 0;
+        bool refused = probe >= 0 && !accepted && errno == ECONNREFUSED;
+        if (probe >= 0) close(probe);
+
+        if (accepted) {
+            std::cerr << "Another compile server is listening on '" << socketPath << "'\n";
+            close(listener);
+            return 1;
+        }
+        if (refused) std::filesystem::remove(socketPath, error);
+    }
+
+    // nobody can connect before listen, so the socket is private before the first request can arrive
+    if (bind(listener, reinterpret_cast<sockaddr*>(&*address), sizeof *address) != 0 || chmod(socketPath.c_str(), 0600) != 0
+        || listen(listener, SOMAXCONN) != 0) {
+        std::cerr << "Cannot listen on '" << socketPath << "': " << std::strerror(errno) << "\n";
+        close(listener);
+        return 1;
+    }
+
+    // finished handlers are reaped by the kernel
+    std::signal(SIGCHLD, SIG_IGN);
+    std::cerr << "Compile server listening on " << socketPath << "\n";
+
+    while (true) {
+        int connection = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        if (connection < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            std::cerr << "Cannot accept connection: " << std::strerror(errno) << "\n";
+            close(listener);
+            return 1;
+        }
+
+        if (!isSameUser(connection)) {
+            std::cerr << "Refusing a request from another user\n";
+            close(connection);
+            continue;
+        }
+
+        pid_t handler = fork();
+        if (handler == 0) {
+            close(listener);
+            // the handler waits for its compile itself
+            std::signal(SIGCHLD, SIG_DFL);
+            std::_Exit(handleCompileRequest(connection, compile));
+        }
+
+        if (handler < 0) std::cerr << "Cannot fork: " << std::strerror(errno) << "\n";
+        close(connection);
+    }
+}
+
+// Has the server at socketPath compile with args as if they were passed to this process. Returns the exit
+// status of the compile, or nothing if the server could not be reached or dropped the request.
+std::optional<int> compileOnServer(const std::string& socketPath, const std::vector<std::string>& args) {
+    std::optional<sockaddr_un> address = unixSocketAddress(socketPath);
+    if (!address) return std::nullopt;
+
+    int connection = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (connection < 0 || connect(connection, reinterpret_cast<sockaddr*>(&*address), sizeof *address) != 0) {
+        std::cerr << "Cannot connect to compile server at '" << socketPath << "': " << std::strerror(errno) << "\n";
+        if (connection >= 0) close(connection);
+        return std::nullopt;
+    }
+
+    std::error_code error;
+    std::string payload = std::filesystem::current_path(error).string();
+    payload += '\0';
+    for (const std::string& arg : args) {
+        payload += arg;
+        payload += '\0';
+    }
+
+    uint32_t size = payload.size();
+    int streams[3] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof streams)] = {};
+    iovec data{&size, sizeof size};
+
+    msghdr message{};
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof control;
+
+    cmsghdr* header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof streams);
+    std::memcpy(CMSG_DATA(header), streams, sizeof streams);
+
+    // the compile writes to our streams directly, anything we buffered has to come first
+    std::cout.flush();
+    std::cerr.flush();
+
+    int32_t status = 0;
+    bool answered = sendmsg(connection, &message, MSG_NOSIGNAL) == sizeof size
+        && sendAll(connection, payload.data(), payload.size())
+        && receiveAll(connection, &status, sizeof status);
+    close(connection);
+
+    if (!answered) {
+        std::cerr << "Compile server at '" << socketPath << "' dropped the request\n";
+        return std::nullopt;
+    }
+
+    return status;
+}
+#endif
+
+#endif /* COMPILE_SERVER_H */
@@ -0,0 +1,167 @@
+#ifndef EMITTER_H
+#define EMITTER_H
+
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Support/CodeGen.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetOptions.h"
+#include "llvm/TargetParser/Host.h"
+
+#include "optimizer.h"
+
+// What the driver writes for a module, selected by --emit=, -S or -c
+enum class EmitKind {
+    LLVMIR,
+    LLVMBitcode,
+    Assembly,
+    Object,
+    Executable
+};
+
+std::optional<EmitKind> parseEmitKind(std::string_view name) {
+    if (name == "llvm-ir") return EmitKind::LLVMIR;
+    if (name == "llvm-bc") return EmitKind::LLVMBitcode;
+    if (name == "asm") return EmitKind::Assembly;
+    if (name == "obj") return EmitKind::Object;
+    if (name == "exe") return EmitKind::Executable;
+    return std::nullopt;
+}
+
+// Output next to the working directory named after the source, like the .ll files always were
+std::filesystem::path defaultOutputPath(const std::filesystem::path& source, EmitKind kind) {
+    switch (kind) {
+        case EmitKind::LLVMIR: return source.stem().string() + ".ll";
+        case EmitKind::LLVMBitcode: return source.stem().string() + ".bc";
+        case EmitKind::Assembly: return source.stem().string() + ".s";
+        case EmitKind::Object: return source.stem().string() + ".o";
+        case EmitKind::Executable: return source.stem();
+    }
+
+    babel_unreachable();
+}
+
+llvm::CodeGenOptLevel toCodeGenLevel(OptLevel level) {
+    switch (level) {
+        case OptLevel::O0: return llvm::CodeGenOptLevel::None;
+        case OptLevel::O1: return llvm::CodeGenOptLevel::Less;
+        case OptLevel::O2: case OptLevel::Os: return llvm::CodeGenOptLevel::Default;
+        case OptLevel::O3: return llvm::CodeGenOptLevel::Aggressive;
+    }
+
+    babel_unreachable();
+}
+
+// Machine for the host triple with a generic CPU, so objects run on any machine of the same architecture.
+// Code is position independent to link into the default PIE executables.
+std::unique_ptr<llvm::TargetMachine> createHostTargetMachine(OptLevel level) {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+
+    std::string triple = llvm::sys::getDefaultTargetTriple();
+    std::string error;
+    const llvm::Target* target = llvm::TargetRegistry::lookupTarget(triple, error);
+    if (!target) {
+        llvm::errs() << "Cannot generate code for " << triple << ": " << error << "\n";
+        return nullptr;
+    }
+
+    return std::unique_ptr<llvm::TargetMachine>(target->createTargetMachine(triple, "generic", "", llvm::TargetOptions(), llvm::Reloc::PIC_, std::nullopt, toCodeGenLevel(level)));
+}
+
+// Has to happen before optimizing, the passes query the data layout and the target for costs
+void prepareModule(llvm::Module& module, const llvm::TargetMachine& machine) {
+    module.setTargetTriple(machine.getTargetTriple().str());
+    module.setDataLayout(machine.createDataLayout());
+}
+
+// Links objects through the compiler driver babel was built with, the externs.cpp runtime is linked in statically
+bool linkExecutable(const std::vector<std::filesystem::path>& objects, const std::filesystem::path& output) {
+    std::string linker = BABEL_LINKER;
+    std::vector<std::string> objectPaths(objects.begin(), objects.end());
+    std::string runtimePath = BABEL_RUNTIME_LIBRARY;
+    std::string outputPath = output.string();
+
+    llvm::SmallVector<llvm::StringRef, 6> args = {linker};
+    args.append(objectPaths.begin(), objectPaths.end());
+    args.append({runtimePath, "-o", outputPath});
+    std::string error;
+    int status = llvm::sys::ExecuteAndWait(linker, args, std::nullopt, {}, 0, 0, &error);
+
+    if (status != 0) {
+        llvm::errs() << "Linking " << outputPath << " failed" << (error.empty() ? "" : ": " + error) << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+// Writes the module in the requested form. Everything but LLVM IR goes through the code generator or the
+// bitcode writer directly, executables are linked from a temporary object file.
+bool emitModule(llvm::Module& module, llvm::TargetMachine& machine, EmitKind kind, const std::filesystem::path& output) {
+    if (kind != EmitKind::LLVMIR && llvm::verifyModule(module, &llvm::errs())) {
+        llvm::errs() << "Not emitting invalid module\n";
+        return false;
+    }
+
+    if (kind == EmitKind::Executable) {
+        llvm::SmallString<128> object;
+        if (std::error_code EC = llvm::sys::fs::createTemporaryFile("babel", "o", object)) {
+            llvm::errs() << "Error creating object file: " << EC.message() << "\n";
+            return false;
+        }
+
+        bool linked = emitModule(module, machine, EmitKind::Object, object.str().str()) && linkExecutable({object.str().str()}, output);
+        llvm::sys::fs::remove(object);
+        return linked;
+    }
+
+    std::error_code EC;
+    llvm::raw_fd_ostream out(output.string(), EC, kind == EmitKind::LLVMIR || kind == EmitKind::Assembly ? llvm::sys::fs::OF_Text : llvm::sys::fs::OF_None);
+    if (EC) {
+        llvm::errs() << "Error opening file: " << EC.message() << "\n";
+        return false;
+    }
+
+    switch (kind) {
+        case EmitKind::LLVMIR:
+            module.print(out, nullptr);
+            return true;
+        case EmitKind::LLVMBitcode:
+            llvm::WriteBitcodeToFile(module, out);
+            return true;
+        case EmitKind::Assembly: case EmitKind::Object: {
+            llvm::legacy::PassManager passes;
+            llvm::CodeGenFileType fileType = kind == EmitKind::Assembly ? llvm::CodeGenFileType::AssemblyFile : llvm::CodeGenFileType::ObjectFile;
+            if (machine.addPassesToEmitFile(passes, out, nullptr, fileType)) {
+                llvm::errs() << "The target cannot emit this kind of file\n";
+                return false;
+            }
+
+            passes.run(module);
+            return true;
+        }
+        case EmitKind::Executable:
+            break;
+    }
+
+    babel_unreachable();
+}
+
+#endif /* EMITTER_H */
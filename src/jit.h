@@ -0,0 +1,124 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "emitter.h"
+#include "optimizer.h"
+
+// Compiles modules in memory with ORC's LLJIT and runs them in the babel process. Everything added ends
+// up in the same JITDylib, so later modules link against what earlier ones defined. Symbols no module
+// defines are looked up in the process itself, which has libc and the externs.cpp runtime linked in.
+class BabelJIT {
+public:
+    static std::unique_ptr<BabelJIT> create(OptLevel level) {
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmPrinter();
+
+        auto machineBuilder = llvm::orc::JITTargetMachineBuilder::detectHost();
+        if (!machineBuilder) return fail(machineBuilder.takeError());
+        machineBuilder->setCodeGenOptLevel(toCodeGenLevel(level));
+
+        // the passes take their cost models from a machine like the one the JIT compiles for, as they do for --emit
+        auto machine = machineBuilder->createTargetMachine();
+        if (!machine) return fail(machine.takeError());
+
+        auto jit = llvm::orc::LLJITBuilder().setJITTargetMachineBuilder(std::move(*machineBuilder)).create();
+        if (!jit) return fail(jit.takeError());
+
+        auto process = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess((*jit)->getDataLayout().getGlobalPrefix());
+        if (!process) return fail(process.takeError());
+        (*jit)->getMainJITDylib().addGenerator(std::move(*process));
+
+        return std::unique_ptr<BabelJIT>(new BabelJIT(std::move(*jit), std::move(*machine), level));
+    }
+
+    llvm::orc::LLJIT& getLLJIT() {
+        return *jit;
+    }
+
+    // Modules have to be laid out like this before codegen
+    void prepareModule(llvm::Module& module) const {
+        module.setTargetTriple(jit->getTargetTriple().str());
+        module.setDataLayout(jit->getDataLayout());
+    }
+
+    // Optimizes the module and hands it to the JIT together with its context. Nothing is compiled
+    // until one of its symbols is looked up.
+    bool addModule(std::unique_ptr<llvm::Module> module, std::unique_ptr<llvm::LLVMContext> context, bool timePasses = false) {
+        if (llvm::verifyModule(*module, &llvm::errs())) {
+            llvm::errs() << "Not running invalid module\n";
+            return false;
+        }
+
+        optimizeModule(*module, level, machine.get(), timePasses);
+        if (llvm::Error error = jit->addIRModule(llvm::orc::ThreadSafeModule(std::move(module), std::move(context)))) {
+            report(std::move(error));
+            return false;
+        }
+
+        return true;
+    }
+
+    // Runs a `i32 ()` entry such as the one generated for every REPL line
+    std::optional<int> run(const std::string& entry) {
+        using EntryPoint = int (*)();
+        auto address = jit->lookup(entry);
+        if (!address) {
+            report(address.takeError());
+            return std::nullopt;
+        }
+
+        return address->toPtr<EntryPoint>()();
+    }
+
+    // Runs the `main` RootAST generates, with the arguments the script was given
+    std::optional<int> runMain(const std::vector<std::string>& args) {
+        using MainPoint = int (*)(int, char**, char**);
+        auto address = jit->lookup("main");
+        if (!address) {
+            report(address.takeError());
+            return std::nullopt;
+        }
+
+        std::vector<std::string> storage = args;
+        std::vector<char*> argv;
+        for (std::string& arg : storage) argv.push_back(arg.data());
+        argv.push_back(nullptr);
+
+        return address->toPtr<MainPoint>()(static_cast<int>(args.size()), argv.data(), nullptr);
+    }
+
+private:
+    std::unique_ptr<llvm::orc::LLJIT> jit;
+    std::unique_ptr<llvm::TargetMachine> machine;
+    OptLevel level;
+
+    BabelJIT(std::unique_ptr<llvm::orc::LLJIT> jit, std::unique_ptr<llvm::TargetMachine> machine, OptLevel level)
+        : jit(std::move(jit)), machine(std::move(machine)), level(level) {}
+
+    static void report(llvm::Error error) {
+        llvm::errs() << "JIT error: " << llvm::toString(std::move(error)) << "\n";
+    }
+
+    static std::unique_ptr<BabelJIT> fail(llvm::Error error) {
+        report(std::move(error));
+        return nullptr;
+    }
+};
+
+#endif /* JIT_H */
@@ -1,28 +1,98 @@
+#ifndef LEXER_H
+#define LEXER_H
+
+#include <cstdint>
+#include <deque>
+#include <istream>
+#include <optional>
 #include <iostream>
+#include <limits>
 #include <string>
+#include <string_view>
 #include <list>
 #include <map>
+#include <unordered_map>
 #include <ranges>
 #include <algorithm>
-#include <regex>
 #include <stdexcept>
+#include <vector>
+
+#include "lexer_dfa.h"
+#include "time_report.h"
+#include "util.hpp"
+
+using TokenKind = uint16_t;
+
+// Token kinds are interned once from the lexer specs and the grammar terminals, so everything after the
+// lexer compares and indexes small integers instead of names. Interning happens while the lexer and the
+// parser are constructed, kind ids are only stable within one process.
+class TokenKinds {
+public:
+    static constexpr TokenKind END_OF_INPUT = 0; // the grammar's "$"
+
+    static TokenKind intern(std::string_view name) {
+        TokenKinds& kinds = instance();
+        if (auto it = kinds.ids.find(name); it != kinds.ids.end())
+            return it->second;
+
+        if (kinds.names.size() > std::numeric_limits<TokenKind>::max())
+            babel_panic("Too many token kinds, cannot intern '%.*s'", static_cast<int>(name.size()), name.data());
+
+        TokenKind kind = static_cast<TokenKind>(kinds.names.size());
+        kinds.ids.emplace(kinds.names.emplace_back(name), kind);
+        return kind;
+    }
+
+    static std::string_view name(TokenKind kind) {
+        return instance().names[kind];
+    }
 
+    static size_t count() {
+        return instance().names.size();
+    }
+
+private:
+    std::deque<std::string> names; // deque, so the views used as keys stay valid
+    std::unordered_map<std::string_view, TokenKind> ids;
+
+    TokenKinds() {
+        ids.emplace(names.emplace_back("$"), END_OF_INPUT);
+    }
+
+    static TokenKinds& instance() {
+        static TokenKinds kinds;
+        return kinds;
+    }
+};
+
+// A token's value is a view into the lexed source, which has to outlive parsing
 class Token {
 private:
-    std::string type;
-    std::string value;
+    std::string_view value;
+    uint64_t offset = 0; // 64 bit, a streamed source can be larger than 4 GiB
+    TokenKind kind = TokenKinds::END_OF_INPUT;
 
 public:
-    Token(const std::string& type, const std::string& value) : type(type), value(value) {}
+    Token(TokenKind kind, std::string_view value, uint64_t offset = 0) : value(value), offset(offset), kind(kind) {}
+    Token(std::string_view type, std::string_view value, uint64_t offset = 0) : Token(TokenKinds::intern(type), value, offset) {}
+
+    TokenKind getKind() const {
+        return kind;
+    }
 
-    std::string getType() const {
-        return type;
+    std::string_view getType() const {
+        return TokenKinds::name(kind);
     }
 
-    std::string getValue() const {
+    std::string_view getValue() const {
         return value;
     }
 
+    // byte offset of the token in the source it was lexed from
+    uint64_t getOffset() const {
+        return offset;
+    }
+
     friend std::ostream& operator<<(std::ostream &s, const Token &token) {
         if (token.getValue() != "") {
             return s << token.getType() << " : " << token.getValue();    
@@ -69,18 +139,26 @@ class Position {
 };
 
 class Lexer {
+    friend class TokenStream;
+
     private:
         std::string file_name;
         std::string text;
         
         std::list<std::pair<std::string, std::string>> token_specs;
+        std::vector<TokenKind> token_kinds;
+        LexerDFA dfa;
 
         Position pos;
         char current_char;
 
     public:
-        Lexer (std::string file_name, std::list<std::pair<std::string, std::string>> token_specs) : file_name(file_name), token_specs(token_specs) {
+        Lexer (std::string file_name, std::list<std::pair<std::string, std::string>> token_specs) : file_name(file_name), token_specs(token_specs), dfa(token_specs) {
             //pos = Position(0, -1, -1, file_name, text);
+            for (const auto& [token_type, pattern] : token_specs) {
+                token_kinds.push_back(TokenKinds::intern(token_type));
+            }
+
             current_char = (char) 0;
             advance();
         }
@@ -90,66 +168,231 @@ class Lexer {
             current_char = pos.getInd() < text.size() ? text[pos.getInd()] : (char) 0;
         }
 
-        std::vector<Token> tokenize(std::string input_stream) const {
+        // The returned tokens point into input_stream
+        std::vector<Token> tokenize(std::string_view input_stream) const {
             std::vector<Token> tokens;
-            
-            while (!input_stream.empty()) {
-                bool matched = false;
-                for (const auto& [token_type, pattern] : token_specs) {
-                    std::regex regex_pattern("^" + pattern);
-                    std::smatch re;
-                    
-                    if (regex_search(input_stream, re, regex_pattern)) {
-                        std::string match = re[0];
-                        assert(match.size() != 0 && "Matched token is empty");
-                        tokens.emplace_back(token_type, match);
-                        input_stream = re.suffix();
-                        matched = true;
-                        break;
-                    }
-                }
+            size_t offset = 0;
 
-                if (!matched) {
+            while (offset < input_stream.size()) {
+                if (std::optional<LexerDFA::Match> match = dfa.match(input_stream.substr(offset))) {
+                    tokens.emplace_back(token_kinds[match->spec], input_stream.substr(offset, match->length), offset);
+                    offset += match->length;
+                } else {
                     //ignore or handle errors
-                    input_stream = input_stream.substr(1);
+                    ++offset;
                 }
-            }            
+            }
 
             return tokens;
         }
 
         static void handleComments(std::vector<Token>& tokens) {
+            static const TokenKind COMMENT = TokenKinds::intern("COMMENT");
+
             // just remove all comments for now
-            std::erase_if(tokens, [](const Token& token) { return token.getType() == "COMMENT"; });
+            std::erase_if(tokens, [](const Token& token) { return token.getKind() == COMMENT; });
         }
 
         static std::vector<Token> insertSemicolons(std::vector<Token>& tokens) {
-            auto subv = std::ranges::unique(tokens, [](const Token& a, const Token& b) { return a.getType() == "NEWLINE" && b.getType() == "NEWLINE"; });
+            static const TokenKind NEWLINE = TokenKinds::intern("NEWLINE");
+            static const TokenKind SEMICOLON = TokenKinds::intern("SEMICOLON");
+
+            auto subv = std::ranges::unique(tokens, [](const Token& a, const Token& b) { return a.getKind() == NEWLINE && b.getKind() == NEWLINE; });
             tokens.erase(subv.begin(), tokens.end());
 
             for (size_t i = 1; i < tokens.size() - 1; ++i) {
-                if (tokens[i].getType() == "NEWLINE" && isLineTerminating(tokens[i-1].getType()) && !isContinuation(tokens[i+1].getType())) {
-                    tokens[i] = Token("SEMICOLON", ";");
+                if (tokens[i].getKind() == NEWLINE && isLineTerminating(tokens[i-1].getKind()) && !isContinuation(tokens[i+1].getKind())) {
+                    tokens[i] = Token(SEMICOLON, ";", tokens[i].getOffset());
                 }
             }
 
-            std::erase_if(tokens, [](const Token& tok){ return tok.getType() == "NEWLINE"; });
+            std::erase_if(tokens, [](const Token& tok){ return tok.getKind() == NEWLINE; });
 
-            if (tokens.back().getType() != "SEMICOLON")
-                tokens.emplace_back("SEMICOLON", ";");
+            if (tokens.back().getKind() != SEMICOLON)
+                tokens.emplace_back(SEMICOLON, ";", tokens.back().getOffset() + tokens.back().getValue().size());
 
             return tokens;
         }
 
-        static bool isLineTerminating(std::string_view type) {
-            return type == "VAR" || type == "TYPE" || 
-                    type == "INTEGER" || type == "FLOATING_POINT" || type == "CHAR" || type == "STRING" || type == "BOOL" || type == "NULL" ||
-                    type == "BREAK" || type == "CONTINUE" || type == "RETURN" || type == "NOOP" || type == "FALLTHROUGH" || type ==  "END" ||
-                    type == "INCREMENT" || type == "DECREMENT" || type == "RPAREN" || type == "RBRACE";
+        static bool isLineTerminating(TokenKind kind) {
+            static const std::vector<TokenKind> kinds = [] {
+                std::vector<TokenKind> result;
+                for (std::string_view type : {"VAR", "TYPE",
+                        "INTEGER", "FLOATING_POINT", "CHAR", "STRING", "BOOL", "NULL",
+                        "BREAK", "CONTINUE", "RETURN", "NOOP", "FALLTHROUGH", "END",
+                        "INCREMENT", "DECREMENT", "RPAREN", "RBRACE"}) {
+                    result.push_back(TokenKinds::intern(type));
+                }
+                return result;
+            }();
+
+            return std::ranges::find(kinds, kind) != kinds.end();
         }
         
-        static bool isContinuation(std::string_view type) {
+        // Identifiers and literals, the tokens whose text the AST keeps and that can have any text. Keywords and
+        // punctuation only come in a few texts.
+        static bool isIdentifierOrLiteral(TokenKind kind) {
+            static const std::vector<TokenKind> kinds = [] {
+                std::vector<TokenKind> result;
+                for (std::string_view type : {"VAR", "INTEGER", "FLOATING_POINT", "CHAR", "STRING", "CSTRING"}) {
+                    result.push_back(TokenKinds::intern(type));
+                }
+                return result;
+            }();
+
+            return std::ranges::find(kinds, kind) != kinds.end();
+        }
+
+        static bool isContinuation(TokenKind kind) {
+            static const TokenKind DOT = TokenKinds::intern("DOT");
+
             // method chaining, also consider adding else (and similar), opening "brace" things like if condition then, pipe operator
-            return type == "DOT";
+            return kind == DOT;
+        }
+};
+
+// Tokens of an input that is read chunk by chunk, as fast as the parser asks for them, so neither the
+// source nor its tokens are ever held whole. Comments are dropped and semicolons inserted on the way, like
+// handleComments and insertSemicolons do for a vector, which only takes the tokens around a newline. A
+// token read from a stream views the read buffer and only stays valid until the next call of next(), one
+// lexed from a source in memory, like a mapped file, views that source and is never copied.
+class TokenStream {
+    public:
+        static constexpr size_t defaultChunkSize = 64 * 1024;
+
+        TokenStream(const Lexer& lexer, std::istream& input, size_t chunkSize = defaultChunkSize) : lexer(lexer), input(&input), chunkSize(std::max<size_t>(chunkSize, 1)) {}
+
+        // The source has to outlive the tokens
+        TokenStream(const Lexer& lexer, std::string_view source) : lexer(lexer), window(source), exhausted(true) {}
+
+        // whether tokens stay valid after the next call, because they view a source that is held whole
+        bool viewsSource() const {
+            return input == nullptr;
+        }
+
+        // Prints every token that passes by like a vector of them would be printed, braces included
+        void echoTo(std::ostream& out) {
+            echo = &out;
+        }
+
+        // nullptr at the end of input
+        const Token* next() {
+            PhaseAccumulator::Piece piece(lexing);
+            if (!produce()) {
+                if (echo && !finished) *echo << (emitted ? "}" : "{}");
+                finished = true;
+                return nullptr;
+            }
+
+            if (echo) *echo << (emitted ? ", " : "{") << current.value();
+            emitted = true;
+            previous = current->getKind();
+            end = current->getOffset() + current->getValue().size();
+            return &current.value();
+        }
+
+    private:
+        const Lexer& lexer;
+        std::istream* input = nullptr;
+        size_t chunkSize = defaultChunkSize;
+        std::ostream* echo = nullptr;
+        PhaseAccumulator lexing{"Lex"};
+
+        std::string buffer;
+        std::string_view window; // what is lexed, buffer or the source
+        size_t position = 0;     // in window
+        uint64_t dropped = 0;    // bytes of the source that were read and dropped from the front of buffer
+        bool exhausted = false;
+
+        std::optional<Token> current;
+        std::optional<Token> pending; // read past a newline to decide whether it ends a statement
+        std::optional<TokenKind> previous;
+        uint64_t end = 0;
+        bool emitted = false;
+        bool finished = false;
+
+        bool produce() {
+            static const TokenKind NEWLINE = TokenKinds::intern("NEWLINE");
+            static const TokenKind SEMICOLON = TokenKinds::intern("SEMICOLON");
+
+            if (finished) return false;
+
+            if (pending) {
+                current = std::exchange(pending, std::nullopt);
+                return true;
+            }
+
+            current = lexSignificant();
+            if (current && current->getKind() == NEWLINE) {
+                uint64_t newline = current->getOffset();
+                do {
+                    current = lexSignificant();
+                } while (current && current->getKind() == NEWLINE);
+
+                if (current && previous && Lexer::isLineTerminating(*previous) && !Lexer::isContinuation(current->getKind())) {
+                    pending = std::exchange(current, Token(SEMICOLON, ";", newline));
+                }
+            }
+
+            // every program ends a statement
+            if (!current && emitted && previous != SEMICOLON) {
+                current = Token(SEMICOLON, ";", end);
+            }
+
+            return current.has_value();
+        }
+
+        std::optional<Token> lexSignificant() {
+            static const TokenKind COMMENT = TokenKinds::intern("COMMENT");
+
+            std::optional<Token> token;
+            do {
+                token = lex();
+            } while (token && token->getKind() == COMMENT);
+            return token;
+        }
+
+        std::optional<Token> lex() {
+            while (true) {
+                if (position == window.size() && !refill()) return std::nullopt;
+
+                bool reachedEnd = false;
+                std::string_view rest = window.substr(position);
+                std::optional<LexerDFA::Match> match = lexer.dfa.match(rest, &reachedEnd);
+
+                // the token could go on in the part of the input that wasn't read yet
+                if (reachedEnd && !exhausted) {
+                    refill();
+                    continue;
+                }
+
+                if (match) {
+                    Token token(lexer.token_kinds[match->spec], rest.substr(0, match->length), dropped + position);
+                    position += match->length;
+                    return token;
+                }
+
+                //ignore or handle errors
+                ++position;
+            }
+        }
+
+        // Drops what was lexed already, the token handed out last is released by the time this runs
+        bool refill() {
+            if (exhausted) return false;
+
+            buffer.erase(0, position);
+            dropped += position;
+            position = 0;
+
+            size_t size = buffer.size();
+            buffer.resize(size + chunkSize);
+            input->read(buffer.data() + size, static_cast<std::streamsize>(chunkSize));
+            buffer.resize(size + static_cast<size_t>(input->gcount()));
+            exhausted = !*input;
+            window = buffer;
+            return buffer.size() > size;
         }
 };
+
+#endif /* LEXER_H */
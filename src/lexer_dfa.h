@@ -0,0 +1,617 @@
+#ifndef LEXER_DFA_H
+#define LEXER_DFA_H
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <limits>
+#include <list>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "util.hpp"
+
+// Compiles the lexer's token specs into one minimized DFA, so a whole input is scanned in a single pass.
+//
+// The result matches what running the specs one after another as ECMAScript regexes anchored at the
+// current position would produce: the first spec in list order that matches wins and its greedy match
+// is taken. Once a spec has matched, every spec after it is dropped from the DFA state, so plain maximal
+// munch on the DFA yields exactly that spec and length.
+//
+// Supported syntax is what the token specs use: literals and escapes, [...] classes, ., \d \w \s (and
+// their negations), \b \B, (...) and (?:...) groups, | and the greedy quantifiers * + ? {n} {n,} {n,m}.
+// Every match starts at the beginning of the remaining input, so \b sees no word character before it.
+class LexerDFA {
+    public:
+        struct Match {
+            size_t spec;
+            size_t length;
+        };
+
+        static constexpr uint32_t DEAD = 0;
+        static constexpr int32_t NO_MATCH = -1;
+
+        explicit LexerDFA(const std::list<std::pair<std::string, std::string>>& token_specs) {
+            NFA nfa;
+            std::vector<int> starts;
+
+            for (const auto& [token_type, pattern] : token_specs) {
+                RegexParser parser(pattern);
+                RegexNode ast = parser.parse();
+                int accept = nfa.add({NFAState::Accept, {}, {}, static_cast<int>(starts.size())});
+                starts.push_back(nfa.compile(ast, accept, static_cast<int>(starts.size())));
+            }
+
+            buildByteClasses(nfa);
+            buildStates(nfa, starts, token_specs);
+            minimize();
+        }
+
+        // Longest match of the first spec that matches at the start of input, std::nullopt if no spec does.
+        // reachedEnd tells whether the automaton was still running at the end of input, so more input could
+        // have made for a longer match.
+        std::optional<Match> match(std::string_view input, bool* reachedEnd = nullptr) const {
+            uint32_t state = start;
+            int32_t spec = NO_MATCH;
+            size_t length = 0;
+            if (reachedEnd) *reachedEnd = true;
+
+            for (size_t i = 0; i < input.size();) {
+                state = transitions[state * numClasses + byteClass[static_cast<unsigned char>(input[i])]];
+                if (state == DEAD) {
+                    if (reachedEnd) *reachedEnd = false;
+                    break;
+                }
+
+                ++i;
+                bool nextIsWord = i < input.size() && isWordByte(static_cast<unsigned char>(input[i]));
+                int32_t accepted = accepts[state * 2 + nextIsWord];
+                if (accepted != NO_MATCH) {
+                    spec = accepted;
+                    length = i;
+                }
+            }
+
+            if (spec == NO_MATCH)
+                return std::nullopt;
+
+            return Match{static_cast<size_t>(spec), length};
+        }
+
+        size_t stateCount() const {
+            return accepts.size() / 2;
+        }
+
+    private:
+        using CharSet = std::bitset<256>;
+
+        struct RegexNode {
+            enum Kind { Empty, Set, Concat, Alternate, Repeat, WordBoundary, NotWordBoundary } kind = Empty;
+            CharSet chars;
+            int min = 0;
+            int max = 0; // -1 for unbounded
+            std::vector<RegexNode> children;
+        };
+
+        class RegexParser {
+            public:
+                explicit RegexParser(std::string_view pattern) : pattern(pattern) {}
+
+                RegexNode parse() {
+                    // every spec is anchored anyway
+                    if (peek('^'))
+                        ++pos;
+
+                    RegexNode node = parseAlternation();
+                    if (pos != pattern.size())
+                        fail("unexpected ')'");
+
+                    return node;
+                }
+
+            private:
+                std::string_view pattern;
+                size_t pos = 0;
+
+                BABEL_NORETURN void fail(const char* reason) const {
+                    babel_panic("Unsupported token pattern '%.*s' at offset %zu: %s", static_cast<int>(pattern.size()), pattern.data(), pos, reason);
+                }
+
+                bool peek(char c) const {
+                    return pos < pattern.size() && pattern[pos] == c;
+                }
+
+                RegexNode parseAlternation() {
+                    RegexNode first = parseConcatenation();
+                    if (!peek('|'))
+                        return first;
+
+                    RegexNode node;
+                    node.kind = RegexNode::Alternate;
+                    node.children.push_back(std::move(first));
+
+                    while (peek('|')) {
+                        ++pos;
+                        node.children.push_back(parseConcatenation());
+                    }
+
+                    return node;
+                }
+
+                RegexNode parseConcatenation() {
+                    RegexNode node;
+                    node.kind = RegexNode::Concat;
+
+                    while (pos < pattern.size() && !peek('|') && !peek(')')) {
+                        node.children.push_back(parseRepetition());
+                    }
+
+                    return node;
+                }
+
+                RegexNode parseRepetition() {
+                    RegexNode atom = parseAtom();
+
+                    while (pos < pattern.size()) {
+                        int min, max;
+                        char c = pattern[pos];
+
+                        if (c == '*') { min = 0; max = -1; ++pos; }
+                        else if (c == '+') { min = 1; max = -1; ++pos; }
+                        else if (c == '?') { min = 0; max = 1; ++pos; }
+                        else if (c == '{') { ++pos; parseBounds(min, max); }
+                        else break;
+
+                        if (peek('?'))
+                            fail("lazy quantifiers are not supported");
+
+                        RegexNode node;
+                        node.kind = RegexNode::Repeat;
+                        node.min = min;
+                        node.max = max;
+                        node.children.push_back(std::move(atom));
+                        atom = std::move(node);
+                    }
+
+                    return atom;
+                }
+
+                int parseNumber() {
+                    if (pos >= pattern.size() || pattern[pos] < '0' || pattern[pos] > '9')
+                        fail("expected a number");
+
+                    int value = 0;
+                    while (pos < pattern.size() && pattern[pos] >= '0' && pattern[pos] <= '9') {
+                        value = value * 10 + (pattern[pos++] - '0');
+                    }
+
+                    return value;
+                }
+
+                void parseBounds(int& min, int& max) {
+                    min = max = parseNumber();
+
+                    if (peek(',')) {
+                        ++pos;
+                        max = peek('}') ? -1 : parseNumber();
+                    }
+
+                    if (!peek('}') || (max != -1 && max < min))
+                        fail("malformed {n,m} quantifier");
+
+                    ++pos;
+                }
+
+                RegexNode parseAtom() {
+                    RegexNode node;
+                    char c = pattern[pos++];
+
+                    switch (c) {
+                        case '(': {
+                            if (peek('?')) {
+                                if (pos + 1 >= pattern.size() || pattern[pos + 1] != ':')
+                                    fail("only (?:...) groups are supported");
+                                pos += 2;
+                            }
+
+                            node = parseAlternation();
+                            if (!peek(')'))
+                                fail("missing ')'");
+
+                            ++pos;
+                            return node;
+                        }
+                        case '[':
+                            node.kind = RegexNode::Set;
+                            node.chars = parseClass();
+                            return node;
+                        case '.':
+                            node.kind = RegexNode::Set;
+                            node.chars.set();
+                            node.chars.reset('\n');
+                            node.chars.reset('\r');
+                            return node;
+                        case '\\':
+                            if (peek('b') || peek('B')) {
+                                node.kind = pattern[pos++] == 'b' ? RegexNode::WordBoundary : RegexNode::NotWordBoundary;
+                                return node;
+                            }
+
+                            node.kind = RegexNode::Set;
+                            node.chars = parseEscape();
+                            return node;
+                        case '^': case '$':
+                            fail("anchors are only supported at the start of a pattern");
+                        case '*': case '+': case '?': case '{':
+                            fail("quantifier without an operand");
+                        default:
+                            node.kind = RegexNode::Set;
+                            node.chars.set(static_cast<unsigned char>(c));
+                            return node;
+                    }
+                }
+
+                CharSet parseEscape() {
+                    if (pos >= pattern.size())
+                        fail("trailing backslash");
+
+                    CharSet chars;
+                    char c = pattern[pos++];
+
+                    switch (c) {
+                        case 'd': case 'D':
+                            for (int b = '0'; b <= '9'; ++b) chars.set(b);
+                            break;
+                        case 'w': case 'W':
+                            for (int b = 0; b < 256; ++b) chars[b] = isWordByte(static_cast<unsigned char>(b));
+                            break;
+                        case 's': case 'S':
+                            for (char b : std::string_view(" \t\n\r\f\v")) chars.set(static_cast<unsigned char>(b));
+                            break;
+                        case 'n': chars.set('\n'); break;
+                        case 'r': chars.set('\r'); break;
+                        case 't': chars.set('\t'); break;
+                        case 'f': chars.set('\f'); break;
+                        case 'v': chars.set('\v'); break;
+                        case '0': chars.set(0); break;
+                        default:
+                            if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9'))
+                                fail("unsupported escape sequence");
+                            chars.set(static_cast<unsigned char>(c));
+                    }
+
+                    if (c == 'D' || c == 'W' || c == 'S')
+                        chars.flip();
+
+                    return chars;
+                }
+
+                CharSet parseClass() {
+                    CharSet chars;
+                    bool negated = peek('^');
+                    if (negated)
+                        ++pos;
+
+                    bool first = true;
+                    while (pos < pattern.size() && (first || !peek(']'))) {
+                        first = false;
+
+                        CharSet single;
+                        int low = -1;
+
+                        if (peek('\\')) {
+                            ++pos;
+                            single = parseEscape();
+                            if (single.count() == 1)
+                                for (int b = 0; b < 256; ++b) if (single[b]) low = b;
+                        } else {
+                            low = static_cast<unsigned char>(pattern[pos++]);
+                            single.set(low);
+                        }
+
+                        // a '-' at the end of the class is a literal
+                        if (low != -1 && peek('-') && pos + 1 < pattern.size() && pattern[pos + 1] != ']') {
+                            ++pos;
+                            int high = static_cast<unsigned char>(pattern[pos++]);
+                            if (high == '\\') {
+                                CharSet escaped = parseEscape();
+                                if (escaped.count() != 1)
+                                    fail("invalid range in character class");
+                                for (int b = 0; b < 256; ++b) if (escaped[b]) high = b;
+                            }
+
+                            if (high < low)
+                                fail("invalid range in character class");
+
+                            for (int b = low; b <= high; ++b) chars.set(b);
+                        } else {
+                            chars |= single;
+                        }
+                    }
+
+                    if (!peek(']'))
+                        fail("missing ']'");
+
+                    ++pos;
+                    return negated ? ~chars : chars;
+                }
+        };
+
+        struct NFAState {
+            enum Kind { Set, Split, WordBoundary, NotWordBoundary, Accept } kind;
+            CharSet chars;
+            std::vector<int> out;
+            int spec;
+        };
+
+        struct NFA {
+            std::vector<NFAState> states;
+
+            int add(NFAState state) {
+                states.push_back(std::move(state));
+                return static_cast<int>(states.size()) - 1;
+            }
+
+            // Builds the automaton back to front, node continues with next once it matched
+            int compile(const RegexNode& node, int next, int spec) {
+                switch (node.kind) {
+                    case RegexNode::Empty:
+                        return next;
+                    case RegexNode::Set:
+                        return add({NFAState::Set, node.chars, {next}, spec});
+                    case RegexNode::WordBoundary:
+                        return add({NFAState::WordBoundary, {}, {next}, spec});
+                    case RegexNode::NotWordBoundary:
+                        return add({NFAState::NotWordBoundary, {}, {next}, spec});
+                    case RegexNode::Concat:
+                        for (auto it = node.children.rbegin(); it != node.children.rend(); ++it) {
+                            next = compile(*it, next, spec);
+                        }
+                        return next;
+                    case RegexNode::Alternate: {
+                        std::vector<int> out;
+                        for (const RegexNode& child : node.children) {
+                            out.push_back(compile(child, next, spec));
+                        }
+                        return add({NFAState::Split, {}, std::move(out), spec});
+                    }
+                    case RegexNode::Repeat: {
+                        const RegexNode& child = node.children.front();
+
+                        if (node.max == -1) {
+                            int loop = add({NFAState::Split, {}, {}, spec});
+                            int body = compile(child, loop, spec);
+                            states[loop].out = {body, next};
+                            next = loop;
+                        } else {
+                            for (int i = node.min; i < node.max; ++i) {
+                                int body = compile(child, next, spec);
+                                next = add({NFAState::Split, {}, {body, next}, spec});
+                            }
+                        }
+
+                        for (int i = 0; i < node.min; ++i) {
+                            next = compile(child, next, spec);
+                        }
+
+                        return next;
+                    }
+                }
+
+                babel_unreachable();
+            }
+        };
+
+        // A DFA state before minimization: the NFA states reached by the last consumed byte and whether it was a word character,
+        // the latter is needed to resolve \b against the following byte
+        using StateKey = std::pair<std::vector<int>, bool>;
+
+        std::array<uint8_t, 256> byteClass{};
+        uint32_t numClasses = 0;
+        uint32_t start = 0;
+        std::vector<uint32_t> transitions; // stateCount() * numClasses
+        std::vector<int32_t> accepts;      // stateCount() * 2, indexed by whether the next byte is a word character
+
+        static constexpr bool isWordByte(unsigned char c) {
+            return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+        }
+
+        // Bytes that no character set and no \b can tell apart share a column in the transition table
+        void buildByteClasses(const NFA& nfa) {
+            std::vector<int> classes(256);
+            for (int b = 0; b < 256; ++b) classes[b] = isWordByte(static_cast<unsigned char>(b));
+
+            std::vector<CharSet> sets;
+            for (const NFAState& state : nfa.states) {
+                if (state.kind == NFAState::Set && std::find(sets.begin(), sets.end(), state.chars) == sets.end())
+                    sets.push_back(state.chars);
+            }
+
+            for (const CharSet& set : sets) {
+                std::map<std::pair<int, bool>, int> split;
+                for (int b = 0; b < 256; ++b) {
+                    classes[b] = split.try_emplace({classes[b], set[b]}, static_cast<int>(split.size())).first->second;
+                }
+            }
+
+            numClasses = 0;
+            for (int b = 0; b < 256; ++b) numClasses = std::max<uint32_t>(numClasses, classes[b] + 1);
+
+            if (numClasses > std::numeric_limits<uint8_t>::max())
+                babel_panic("Token specs need %u byte classes, at most 255 are supported", numClasses);
+
+            for (int b = 0; b < 256; ++b) byteClass[b] = static_cast<uint8_t>(classes[b]);
+        }
+
+        // Follows epsilon edges from core, resolving \b between the previous and the next byte
+        static void closure(const NFA& nfa, const std::vector<int>& core, bool prevIsWord, bool nextIsWord, std::vector<int>& result, std::vector<char>& seen) {
+            std::fill(seen.begin(), seen.end(), 0);
+            result.clear();
+            std::vector<int> stack(core.rbegin(), core.rend());
+
+            while (!stack.empty()) {
+                int id = stack.back();
+                stack.pop_back();
+
+                if (seen[id])
+                    continue;
+                seen[id] = 1;
+
+                const NFAState& state = nfa.states[id];
+                switch (state.kind) {
+                    case NFAState::Set:
+                    case NFAState::Accept:
+                        result.push_back(id);
+                        break;
+                    case NFAState::Split:
+                        for (auto it = state.out.rbegin(); it != state.out.rend(); ++it) stack.push_back(*it);
+                        break;
+                    case NFAState::WordBoundary:
+                        if (prevIsWord != nextIsWord) stack.push_back(state.out.front());
+                        break;
+                    case NFAState::NotWordBoundary:
+                        if (prevIsWord == nextIsWord) stack.push_back(state.out.front());
+                        break;
+                }
+            }
+        }
+
+        static int32_t firstAccepted(const NFA& nfa, const std::vector<int>& states) {
+            int32_t spec = NO_MATCH;
+
+            for (int id : states) {
+                if (nfa.states[id].kind == NFAState::Accept && (spec == NO_MATCH || nfa.states[id].spec < spec))
+                    spec = nfa.states[id].spec;
+            }
+
+            return spec;
+        }
+
+        // Subset construction, state 0 is the dead state
+        void buildStates(const NFA& nfa, const std::vector<int>& starts, const std::list<std::pair<std::string, std::string>>& token_specs) {
+            std::array<int, 256> representative{};
+            for (int b = 255; b >= 0; --b) representative[byteClass[b]] = b;
+
+            std::map<StateKey, uint32_t> ids;
+            std::vector<StateKey> pending;
+
+            auto idOf = [&](StateKey key) {
+                if (key.first.empty())
+                    return DEAD;
+
+                auto [it, inserted] = ids.try_emplace(key, static_cast<uint32_t>(ids.size() + 1));
+                if (inserted)
+                    pending.push_back(std::move(key));
+
+                return it->second;
+            };
+
+            transitions.assign(numClasses, DEAD);
+            accepts.assign(2, NO_MATCH);
+
+            std::vector<int> sortedStarts = starts;
+            std::sort(sortedStarts.begin(), sortedStarts.end());
+            start = idOf({sortedStarts, false});
+
+            std::vector<int> reached;
+            std::vector<int> next;
+            std::vector<char> seen(nfa.states.size());
+
+            for (size_t i = 0; i < pending.size(); ++i) {
+                StateKey key = pending[i];
+                uint32_t id = static_cast<uint32_t>(i + 1);
+
+                for (bool nextIsWord : {false, true}) {
+                    closure(nfa, key.first, key.second, nextIsWord, reached, seen);
+                    accepts.push_back(firstAccepted(nfa, reached));
+                }
+
+                if (id == start && (accepts[2 * id] != NO_MATCH || accepts[2 * id + 1] != NO_MATCH)) {
+                    int32_t spec = std::max(accepts[2 * id], accepts[2 * id + 1]);
+                    babel_panic("Token pattern for %s matches the empty string", std::next(token_specs.begin(), spec)->first.c_str());
+                }
+
+                for (uint32_t c = 0; c < numClasses; ++c) {
+                    unsigned char byte = static_cast<unsigned char>(representative[c]);
+                    bool isWord = isWordByte(byte);
+                    closure(nfa, key.first, key.second, isWord, reached, seen);
+
+                    // specs after one that already matched can never win
+                    int32_t matched = firstAccepted(nfa, reached);
+
+                    next.clear();
+                    for (int state : reached) {
+                        const NFAState& nfaState = nfa.states[state];
+                        if (nfaState.kind == NFAState::Set && nfaState.chars[byte] && (matched == NO_MATCH || nfaState.spec <= matched))
+                            next.push_back(nfaState.out.front());
+                    }
+
+                    std::sort(next.begin(), next.end());
+                    next.erase(std::unique(next.begin(), next.end()), next.end());
+
+                    transitions.push_back(idOf({next, isWord}));
+                }
+            }
+        }
+
+        // Moore's partition refinement, the dead state stays state 0
+        void minimize() {
+            size_t count = stateCount();
+            std::vector<uint32_t> block(count);
+            size_t numBlocks = 0;
+
+            {
+                std::map<std::pair<int32_t, int32_t>, uint32_t> initial;
+                initial.try_emplace({NO_MATCH, NO_MATCH}, 0); // the dead state and everything equivalent to it
+
+                for (size_t s = 0; s < count; ++s) {
+                    block[s] = initial.try_emplace({accepts[2 * s], accepts[2 * s + 1]}, static_cast<uint32_t>(initial.size())).first->second;
+                }
+
+                numBlocks = initial.size();
+            }
+
+            while (true) {
+                std::map<std::vector<uint32_t>, uint32_t> signatures;
+                std::vector<uint32_t> refined(count);
+
+                std::vector<uint32_t> deadSignature(numClasses + 1, block[DEAD]);
+                signatures.try_emplace(deadSignature, 0);
+
+                for (size_t s = 0; s < count; ++s) {
+                    std::vector<uint32_t> signature;
+                    signature.reserve(numClasses + 1);
+                    signature.push_back(block[s]);
+                    for (uint32_t c = 0; c < numClasses; ++c) signature.push_back(block[transitions[s * numClasses + c]]);
+
+                    refined[s] = signatures.try_emplace(std::move(signature), static_cast<uint32_t>(signatures.size())).first->second;
+                }
+
+                block = std::move(refined);
+                if (signatures.size() == numBlocks)
+                    break;
+
+                numBlocks = signatures.size();
+            }
+
+            std::vector<uint32_t> minimizedTransitions(numBlocks * numClasses, DEAD);
+            std::vector<int32_t> minimizedAccepts(numBlocks * 2, NO_MATCH);
+
+            for (size_t s = 0; s < count; ++s) {
+                for (uint32_t c = 0; c < numClasses; ++c) minimizedTransitions[block[s] * numClasses + c] = block[transitions[s * numClasses + c]];
+                minimizedAccepts[block[s] * 2] = accepts[2 * s];
+                minimizedAccepts[block[s] * 2 + 1] = accepts[2 * s + 1];
+            }
+
+            transitions = std::move(minimizedTransitions);
+            accepts = std::move(minimizedAccepts);
+            start = block[start];
+        }
+};
+
+#endif /* LEXER_DFA_H */
@@ -2,16 +2,21 @@
 #define LRPARSER_HPP
 
 #include <algorithm>
+#include <bit>
 #include <boost/algorithm/string.hpp>
 #include <boost/functional/hash.hpp>
 #include <cassert>
+#include <cstdint>
+#include <deque>
 #include <fstream>
 #include <format>
 #include <list>
 #include <map>
+#include <memory>
 #include <optional>
 #include <ranges>
 #include <regex>
+#include <span>
 #include <sstream>
 #include <stack>
 #include <string>
@@ -77,6 +82,51 @@ public:
 
 const std::string EPSILON = "''";
 
+// Dynamic bitset over symbol ids, sized once for the grammar it belongs to
+class SymbolSet {
+public:
+    SymbolSet() = default;
+    explicit SymbolSet(size_t size) : words((size + 63) / 64, 0) {}
+
+    void insert(uint32_t symbol) {
+        words[symbol >> 6] |= uint64_t{1} << (symbol & 63);
+    }
+
+    bool contains(uint32_t symbol) const {
+        return (words[symbol >> 6] >> (symbol & 63)) & 1;
+    }
+
+    // Adds every symbol of that, returns whether this set grew
+    bool merge(const SymbolSet& that) {
+        uint64_t added = 0;
+
+        for (size_t i = 0; i < words.size(); ++i) {
+            added |= that.words[i] & ~words[i];
+            words[i] |= that.words[i];
+        }
+
+        return added != 0;
+    }
+
+    template<typename Fn>
+    void forEach(Fn&& fn) const {
+        for (size_t i = 0; i < words.size(); ++i) {
+            for (uint64_t word = words[i]; word != 0; word &= word - 1) {
+                fn(static_cast<uint32_t>(i * 64 + std::countr_zero(word)));
+            }
+        }
+    }
+
+    size_t hash() const {
+        return boost::hash_range(words.begin(), words.end());
+    }
+
+    bool operator==(const SymbolSet& that) const = default;
+
+private:
+    std::vector<uint64_t> words;
+};
+
 class Grammar;
 class Rule {
 public:
@@ -123,9 +173,16 @@ class Grammar {
 private:
     void initializeRulesAndAlphabetAndNonterminals(const std::string& text);
     void initializeAlphabetAndTerminals();
-    bool collectDevelopmentFirsts(const std::vector<std::string>& development, std::list<std::string>& nonterminalFirsts);
+    void initializeSymbols();
     void initializeFirsts();
     void initializeFollows();
+    void initializeSequenceFirsts();
+
+    std::unordered_map<std::string, uint32_t, TransparentStringHash, std::equal_to<>> symbolIds;
+    std::vector<std::vector<int>> nonterminalRules;
+    std::vector<size_t> itemBase;
+    std::vector<SymbolSet> suffixFirsts;
+    std::vector<bool> suffixNullable;
 
 public:
     std::list<std::string> alphabet;
@@ -133,47 +190,85 @@ public:
     std::list<std::string> terminals;
     std::vector<Rule> rules = {};
     std::string text;
-    mutable std::unordered_map<std::string, std::list<std::string>, TransparentStringHash, std::equal_to<>> firsts;
+    std::unordered_map<std::string, std::list<std::string>, TransparentStringHash, std::equal_to<>> firsts;
     std::unordered_map<std::string, std::list<std::string>, TransparentStringHash, std::equal_to<>> follows;
     std::string axiom;
 
+    // Symbols are numbered nonterminals first, then terminals and finally the end of input marker "$".
+    // Sets of terminals (firsts, follows, lookaheads) are indexed by symbol id - number of nonterminals.
+    std::vector<std::string> symbols;
+    std::vector<std::vector<uint32_t>> ruleSymbols; // epsilon rules have no symbols
+    std::vector<SymbolSet> firstSets;               // by nonterminal
+    std::vector<SymbolSet> followSets;              // by nonterminal
+    std::vector<bool> nullable;                     // by nonterminal
+
     Grammar() = default;
     explicit Grammar(std::string const& text) {
         initializeRulesAndAlphabetAndNonterminals(text);
         initializeAlphabetAndTerminals();
+        initializeSymbols();
         initializeFirsts();
         initializeFollows();
+        initializeSequenceFirsts();
+    }
+
+    // symbols.size() if the symbol isn't part of the grammar
+    uint32_t symbolId(std::string_view symbol) const {
+        auto it = symbolIds.find(symbol);
+        return it == symbolIds.end() ? static_cast<uint32_t>(symbols.size()) : it->second;
     }
 
+    uint32_t numNonterminals() const { return static_cast<uint32_t>(nonterminals.size()); }
+    bool isNonterminal(uint32_t symbol) const { return symbol < nonterminals.size(); }
+    uint32_t terminalIndex(uint32_t symbol) const { return symbol - numNonterminals(); }
+    size_t terminalSetSize() const { return symbols.size() - nonterminals.size(); }
+    SymbolSet emptyTerminalSet() const { return SymbolSet(terminalSetSize()); }
+
+    const std::vector<int>& rulesForNonterminal(uint32_t nonterminal) const { return nonterminalRules[nonterminal]; }
+
+    // Items (rule, position) are numbered consecutively, position runs up to the number of rule symbols
+    size_t itemId(int rule, int position) const { return itemBase[rule] + position; }
+    size_t numItems() const { return itemBase.back(); }
+
+    // Firsts of the rule's symbols from position on, and whether all of them can derive epsilon
+    const SymbolSet& sequenceFirsts(int rule, int position) const { return suffixFirsts[itemId(rule, position)]; }
+    bool sequenceNullable(int rule, int position) const { return suffixNullable[itemId(rule, position)]; }
+
     std::vector<Rule> getRulesForNonterminal(std::string_view nonterminal) const;
 
     std::list<std::string> getSequenceFirsts(const std::vector<std::string>& sequence) const {
-        std::list<std::string> result = {};
-        bool epsilonInSymbolFirsts = true;
+        SymbolSet result = emptyTerminalSet();
+        bool epsilonInSequenceFirsts = true;
 
         for (const std::string& symbol : sequence) {
-            epsilonInSymbolFirsts = false;
-
-            if (std::ranges::find(terminals, symbol) != terminals.end()) {
-                addUnique(symbol, result);
+            if (symbol == EPSILON) continue;
 
+            uint32_t id = symbolId(symbol);
+            if (!isNonterminal(id)) {
+                result.insert(terminalIndex(id));
+                epsilonInSequenceFirsts = false;
                 break;
             }
-            
-            for (const std::string& first : firsts.at(symbol)) {
-                epsilonInSymbolFirsts |= first == EPSILON;
-                addUnique(first, result);
-            }
-            
-            epsilonInSymbolFirsts |= firsts.at(symbol).size() == 0;
 
-            if (!epsilonInSymbolFirsts) break;                
+            result.merge(firstSets[id]);
+            if (!nullable[id]) {
+                epsilonInSequenceFirsts = false;
+                break;
+            }
         }
 
-        if (epsilonInSymbolFirsts) addUnique(EPSILON, result);
+        std::list<std::string> names = terminalNames(result);
+        if (epsilonInSequenceFirsts) names.push_front(EPSILON);
 
-        return result;
-    }      
+        return names;
+    }
+
+    std::list<std::string> terminalNames(const SymbolSet& set) const {
+        std::list<std::string> names;
+        set.forEach([&](uint32_t terminal) { names.push_back(symbols[numNonterminals() + terminal]); });
+
+        return names;
+    }
 };
 
 Rule::Rule(const Grammar* grammar, const std::string& text) : grammar(grammar), index(static_cast<int>(grammar->rules.size()) ) {
@@ -197,8 +292,10 @@ void Grammar::initializeRulesAndAlphabetAndNonterminals (const std::string& gram
                 axiom = rule.nonterminal;
             }
             
-            addUnique(rule.nonterminal, alphabet);
-            addUnique(rule.nonterminal, nonterminals);
+            if (symbolIds.try_emplace(rule.nonterminal, static_cast<uint32_t>(symbolIds.size())).second) {
+                alphabet.push_back(rule.nonterminal);
+                nonterminals.push_back(rule.nonterminal);
+            }
         }
     }
 }
@@ -206,113 +303,154 @@ void Grammar::initializeRulesAndAlphabetAndNonterminals (const std::string& gram
 void Grammar::initializeAlphabetAndTerminals () {
     for (const Rule& rule : rules) {
         for (const std::string& symbol : rule.development) {
-            if (symbol != EPSILON && symbol != "$" && std::ranges::find(nonterminals, symbol) == nonterminals.end()) {
-                addUnique(symbol, alphabet);
-                addUnique(symbol, terminals);
+            if (symbol != EPSILON && symbol != "$" && symbolIds.try_emplace(symbol, static_cast<uint32_t>(symbolIds.size())).second) {
+                alphabet.push_back(symbol);
+                terminals.push_back(symbol);
             }
         }
     }
 }
 
-bool Grammar::collectDevelopmentFirsts(const std::vector<std::string>& development, std::list<std::string>& nonterminalFirsts) {
-    bool result = false;
-    bool epsilonInSymbolFirsts = true;
-    
-    for (const std::string& symbol : development) {
-        epsilonInSymbolFirsts = false;
+// Nonterminals and terminals already got their ids in order of appearance, so only "$" is left to number
+void Grammar::initializeSymbols() {
+    symbolIds.try_emplace("$", static_cast<uint32_t>(symbolIds.size()));
+    symbols.assign(nonterminals.begin(), nonterminals.end());
+    symbols.insert(symbols.end(), terminals.begin(), terminals.end());
+    symbols.emplace_back("$");
 
-        if (isElement(symbol, terminals)) {
-            result |= addUnique(symbol, nonterminalFirsts);
-            
-            break;
-        }
+    nonterminalRules.resize(nonterminals.size());
+    itemBase.push_back(0);
 
-        if (firsts.contains(symbol)) {
-            for (const std::string& first : firsts.at(symbol)) {
-                epsilonInSymbolFirsts |= first == EPSILON;
-                result |= addUnique(boost::trim_copy(first), nonterminalFirsts);
-            }
+    for (const Rule& rule : rules) {
+        std::vector<uint32_t>& ids = ruleSymbols.emplace_back();
+        for (const std::string& symbol : rule.development) {
+            if (symbol != EPSILON) ids.push_back(symbolIds.at(symbol));
         }
 
-        if (!epsilonInSymbolFirsts) break;
-    }
-
-    if (epsilonInSymbolFirsts) {
-        result |= addUnique(EPSILON, nonterminalFirsts);
+        nonterminalRules[symbolIds.at(rule.nonterminal)].push_back(rule.index);
+        itemBase.push_back(itemBase.back() + ids.size() + 1);
     }
-
-    return result;
 }
 
 void Grammar::initializeFirsts () {
+    firstSets.assign(nonterminals.size(), emptyTerminalSet());
+    nullable.assign(nonterminals.size(), false);
     bool notDone;
 
-    do{
+    do {
         notDone = false;
 
-        for (Rule& rule : rules) {
-            std::list<std::string> nonterminalFirsts = getOrCreateArray(firsts, rule.nonterminal);
+        for (const Rule& rule : rules) {
+            uint32_t nonterminal = symbolIds.at(rule.nonterminal);
+            bool developmentNullable = true;
+
+            for (uint32_t symbol : ruleSymbols[rule.index]) {
+                if (!isNonterminal(symbol)) {
+                    if (!firstSets[nonterminal].contains(terminalIndex(symbol))) {
+                        firstSets[nonterminal].insert(terminalIndex(symbol));
+                        notDone = true;
+                    }
+                    developmentNullable = false;
+                    break;
+                }
+
+                notDone |= firstSets[nonterminal].merge(firstSets[symbol]);
+                if (!nullable[symbol]) {
+                    developmentNullable = false;
+                    break;
+                }
+            }
 
-            if (rule.development.size() == 1 && rule.development.front() == EPSILON) {
-                notDone |= addUnique(EPSILON, nonterminalFirsts);
-            } else {
-                notDone |= collectDevelopmentFirsts(rule.development, nonterminalFirsts);
+            if (developmentNullable && !nullable[nonterminal]) {
+                nullable[nonterminal] = true;
+                notDone = true;
             }
-            firsts[rule.nonterminal] = nonterminalFirsts;
         }
     } while (notDone);
+
+    for (const std::string& nonterminal : nonterminals) {
+        uint32_t id = symbolIds.at(nonterminal);
+        std::list<std::string>& names = firsts[nonterminal] = terminalNames(firstSets[id]);
+        if (nullable[id]) names.push_front(EPSILON);
+    }
 }
 
 void Grammar::initializeFollows() {
+    followSets.assign(nonterminals.size(), emptyTerminalSet());
+    followSets[symbolIds.at(axiom)].insert(terminalIndex(static_cast<uint32_t>(symbols.size() - 1)));
     bool notDone;
 
     do {
         notDone = false;
-        
+
         for (const Rule& rule : rules) {
-            if (rule == rules.front()) {
-                std::list<std::string> nonterminalFollows = getOrCreateArray(follows, rule.nonterminal);
-                notDone |= addUnique<std::string>("$", nonterminalFollows);
-                follows[rule.nonterminal] = nonterminalFollows;
-            }
+            uint32_t nonterminal = symbolIds.at(rule.nonterminal);
+            const std::vector<uint32_t>& ids = ruleSymbols[rule.index];
+
+            // walk the development back to front, carrying the firsts of what follows the current symbol
+            SymbolSet trailer = followSets[nonterminal];
+            for (size_t i = ids.size(); i-- > 0;) {
+                uint32_t symbol = ids[i];
+
+                if (!isNonterminal(symbol)) {
+                    trailer = emptyTerminalSet();
+                    trailer.insert(terminalIndex(symbol));
+                    continue;
+                }
 
-            for (int i = 0; i < rule.development.size(); i++) {
-                std::string symbol = rule.development[i];
-
-                if (isElement(symbol, nonterminals)) {
-                    std::list<std::string> symbolFollows = getOrCreateArray(follows, symbol);
-                    
-                    std::vector<std::string> sliced = rule.development;
-                    auto end = sliced.begin();
-                    std::advance(end, i + 1);
-                    sliced.erase(sliced.begin(), end);
-                    
-                    std::list<std::string> afterSymbolFirsts = getSequenceFirsts(sliced);
-
-                    for (const std::string& first : afterSymbolFirsts) {
-                        if (first == EPSILON) {
-                            std::list<std::string> nonterminalFollows = follows[rule.nonterminal];
-
-                            for (const std::string& _ : nonterminalFollows) {
-                                notDone |= addUnique(_, symbolFollows);
-                            }
-                        } else {
-                            notDone |= addUnique(first, symbolFollows);
-                        }
-                    }
-                    follows[symbol] = symbolFollows;
+                notDone |= followSets[symbol].merge(trailer);
+                if (nullable[symbol]) {
+                    trailer.merge(firstSets[symbol]);
+                } else {
+                    trailer = firstSets[symbol];
                 }
             }
         }
     } while (notDone);
+
+    for (const std::string& nonterminal : nonterminals) {
+        follows[nonterminal] = terminalNames(followSets[symbolIds.at(nonterminal)]);
+    }
+}
+
+void Grammar::initializeSequenceFirsts() {
+    suffixFirsts.assign(numItems(), emptyTerminalSet());
+    suffixNullable.assign(numItems(), true);
+
+    for (const Rule& rule : rules) {
+        const std::vector<uint32_t>& ids = ruleSymbols[rule.index];
+
+        for (size_t position = ids.size(); position-- > 0;) {
+            size_t item = itemId(rule.index, static_cast<int>(position));
+            uint32_t symbol = ids[position];
+
+            if (!isNonterminal(symbol)) {
+                suffixFirsts[item].insert(terminalIndex(symbol));
+                suffixNullable[item] = false;
+                continue;
+            }
+
+            suffixFirsts[item] = firstSets[symbol];
+            if (nullable[symbol]) {
+                suffixFirsts[item].merge(suffixFirsts[item + 1]);
+                suffixNullable[item] = suffixNullable[item + 1];
+            } else {
+                suffixNullable[item] = false;
+            }
+        }
+    }
 }
 
 std::vector<Rule> Grammar::getRulesForNonterminal(std::string_view nonterminal) const {
-    auto filtered = rules | std::views::filter([nonterminal](const Rule& rule) {
-        return rule.nonterminal == nonterminal;
-    });
+    uint32_t id = symbolId(nonterminal);
+    if (!isNonterminal(id)) return {};
+
+    std::vector<Rule> result;
+    for (int rule : nonterminalRules[id]) {
+        result.push_back(rules[rule]);
+    }
 
-    return std::vector<Rule>(filtered.begin(), filtered.end());
+    return result;
 }
 
 class UnifiedItem {
@@ -409,112 +547,159 @@ public:
     }
 };
 
-inline size_t hash_value(const Rule& rule) {
-    size_t seed = 0;
-
-    boost::hash_combine(seed, rule.nonterminal);
-    boost::hash_combine(seed, rule.development);
-
-    return seed;
-}
-
-template <>
-struct std::hash<UnifiedItem> {
-    size_t operator()(const UnifiedItem& other) const {
-        size_t seed = 0;
-
-        boost::hash_combine(seed, other.rule);
-        boost::hash_combine(seed, other.dotIndex);
-
-        std::unordered_set<std::string, TransparentStringHash, std::equal_to<>> uniqueLookAheads(other.lookAheads.begin(), other.lookAheads.end());
-        boost::hash_combine(seed, boost::hash<std::unordered_set<std::string, TransparentStringHash, std::equal_to<>>>{}(uniqueLookAheads));
+// An LR(1) item of the closure table, rule and dot position plus the lookaheads that may follow the rule
+struct LRItem {
+    int rule;
+    int dotIndex;
+    SymbolSet lookAheads;
 
-        return seed;
-    }
+    bool operator==(const LRItem& that) const = default;
 };
 
 class Kernel {
 public:
     int index;
-    std::unordered_set<UnifiedItem> items;
-    std::vector<UnifiedItem> closure;
+    std::vector<LRItem> items;   // sorted by rule and dot position, so equal kernels compare equal
+    std::vector<LRItem> closure; // the kernel items followed by the items they predict, in discovery order
     std::unordered_map<std::string, int, TransparentStringHash, std::equal_to<>> gotos;
     std::list<std::string> keys;
 
-    Kernel (int index, const std::unordered_set<UnifiedItem>& items) : index(index), items(items), closure(slice(items, 0)) {}
+    Kernel(int index, std::vector<LRItem> items) : index(index), items(std::move(items)), closure(this->items) {}
 
     bool operator==(const Kernel& that) const {
         return items == that.items;
     }
 };
 
+// Canonical LR(1) automaton of a grammar. Items are numbered by the grammar, lookaheads are bitsets and
+// kernels are found by hash, so every kernel is closed exactly once with a worklist.
 class LRClosureTable {
 public:
     Grammar& grammar;
     std::deque<Kernel> kernels;
 
     explicit LRClosureTable(Grammar& grammar) : grammar(grammar) {
-        kernels.emplace_back(Kernel(0, {UnifiedItem(grammar.rules.front(), 0)}));
+        SymbolSet endOfInput = grammar.emptyTerminalSet();
+        endOfInput.insert(grammar.terminalIndex(grammar.symbolId("$")));
+        addKernel({{0, 0, endOfInput}});
 
-        for (int i = 0; i < kernels.size();) {
-            Kernel& kernel = kernels[i];
-            updateClosure(kernel);
-            
-            if (addGotos(kernel, kernels)) {
-                i = 0;
-            } else {
-                ++i;
-            }
+        std::vector<int> closureSlots(grammar.numItems(), -1);
+        std::vector<int> gotoGroups(grammar.symbols.size(), -1);
+
+        for (size_t i = 0; i < kernels.size(); ++i) {
+            updateClosure(kernels[i], closureSlots);
+            addGotos(static_cast<int>(i), gotoGroups);
         }
     }
 
-    void updateClosure(Kernel& kernel) const {
-        for (int i = 0; i < kernel.closure.size(); ++i) {
-            auto it = std::next(kernel.closure.begin(), i);
-            auto const& closure = *it;
-            std::vector<UnifiedItem> newItemsFromSymbolAfterDot = closure.newItemsFromSymbolAfterDot();
+    bool isReducible(const LRItem& item) const {
+        return item.dotIndex == static_cast<int>(grammar.ruleSymbols[item.rule].size());
+    }
 
-            for (const UnifiedItem& item : newItemsFromSymbolAfterDot) {
-                item.addUniqueTo(kernel.closure);
-            }
+private:
+    std::unordered_multimap<size_t, int> kernelsByHash;
+
+    static size_t hashItems(const std::vector<LRItem>& items) {
+        size_t seed = 0;
+
+        for (const LRItem& item : items) {
+            boost::hash_combine(seed, item.rule);
+            boost::hash_combine(seed, item.dotIndex);
+            boost::hash_combine(seed, item.lookAheads.hash());
         }
+
+        return seed;
     }
 
-    bool addGotos(Kernel& kernel, std::deque<Kernel>& kernel_dq) const {
-        bool lookAheadsPropagated = false;
-        std::unordered_map<std::string, std::unordered_set<UnifiedItem>, TransparentStringHash, std::equal_to<>> newKernels;
+    int addKernel(std::vector<LRItem> items) {
+        size_t hash = hashItems(items);
+
+        for (auto [it, end] = kernelsByHash.equal_range(hash); it != end; ++it) {
+            if (kernels[it->second].items == items) return it->second;
+        }
 
-        for (const UnifiedItem& item : kernel.closure) {
-            std::optional<UnifiedItem> newItem = item.newItemAfterShift();
+        int index = static_cast<int>(kernels.size());
+        kernels.emplace_back(index, std::move(items));
+        kernelsByHash.emplace(hash, index);
 
-            if (newItem != std::nullopt) {
-                std::string symbolAfterDot = item.rule.development[item.dotIndex];
+        return index;
+    }
 
-                addUnique(symbolAfterDot, kernel.keys);
-                newKernels[symbolAfterDot];
-                std::unordered_set<UnifiedItem>& newItems = newKernels.at(symbolAfterDot);
-                newItem.value().addUniqueTo(newItems);
-            }
+    // closureSlots maps item ids to their position in the closure, it is all -1 again on return
+    void updateClosure(Kernel& kernel, std::vector<int>& closureSlots) const {
+        std::vector<LRItem>& closure = kernel.closure;
+        std::deque<int> worklist;
+        std::vector<bool> queued(closure.size(), true);
+
+        for (int i = 0; i < static_cast<int>(closure.size()); ++i) {
+            closureSlots[grammar.itemId(closure[i].rule, closure[i].dotIndex)] = i;
+            worklist.push_back(i);
         }
-        
-        for (const std::string& key : kernel.keys) {
-            Kernel newKernel(static_cast<int>(kernels.size()), newKernels.at(key));
-            int targetKernelIndex = indexOf(newKernel, kernels);
 
-            if (targetKernelIndex < 0) {
-                kernel_dq.push_back(newKernel);
-                targetKernelIndex = newKernel.index;
-            } else {
-                for (const UnifiedItem& item : newKernel.items) {
-                    std::unordered_set<UnifiedItem>& items = kernel_dq[targetKernelIndex].items;
-                    lookAheadsPropagated |= item.addUniqueTo(items);
+        while (!worklist.empty()) {
+            int index = worklist.front();
+            worklist.pop_front();
+            queued[index] = false;
+
+            const LRItem& item = closure[index];
+            const std::vector<uint32_t>& symbols = grammar.ruleSymbols[item.rule];
+            if (item.dotIndex == static_cast<int>(symbols.size()) || !grammar.isNonterminal(symbols[item.dotIndex])) continue;
+
+            SymbolSet newLookAheads = grammar.sequenceFirsts(item.rule, item.dotIndex + 1);
+            if (grammar.sequenceNullable(item.rule, item.dotIndex + 1)) newLookAheads.merge(item.lookAheads);
+
+            for (int rule : grammar.rulesForNonterminal(symbols[item.dotIndex])) {
+                int& slot = closureSlots[grammar.itemId(rule, 0)];
+
+                if (slot < 0) {
+                    slot = static_cast<int>(closure.size());
+                    closure.push_back({rule, 0, newLookAheads});
+                    queued.push_back(true);
+                    worklist.push_back(slot);
+                } else if (closure[slot].lookAheads.merge(newLookAheads) && !queued[slot]) {
+                    queued[slot] = true;
+                    worklist.push_back(slot);
                 }
             }
-            
+        }
+
+        for (const LRItem& item : closure) {
+            closureSlots[grammar.itemId(item.rule, item.dotIndex)] = -1;
+        }
+    }
+
+    // gotoGroups maps symbol ids to their position in kernel.keys, it is all -1 again on return
+    void addGotos(int kernelIndex, std::vector<int>& gotoGroups) {
+        std::vector<uint32_t> keySymbols;
+        std::vector<std::vector<LRItem>> newKernels;
+
+        for (const LRItem& item : kernels[kernelIndex].closure) {
+            const std::vector<uint32_t>& symbols = grammar.ruleSymbols[item.rule];
+            if (item.dotIndex == static_cast<int>(symbols.size())) continue;
+
+            int& group = gotoGroups[symbols[item.dotIndex]];
+            if (group < 0) {
+                group = static_cast<int>(keySymbols.size());
+                keySymbols.push_back(symbols[item.dotIndex]);
+                newKernels.emplace_back();
+            }
+
+            newKernels[group].push_back({item.rule, item.dotIndex + 1, item.lookAheads});
+        }
+
+        for (size_t group = 0; group < keySymbols.size(); ++group) {
+            gotoGroups[keySymbols[group]] = -1;
+
+            std::vector<LRItem>& items = newKernels[group];
+            std::ranges::sort(items, {}, [](const LRItem& item) { return std::pair(item.rule, item.dotIndex); });
+            int targetKernelIndex = addKernel(std::move(items));
+
+            // kernels may have grown, so the reference is only taken now
+            Kernel& kernel = kernels[kernelIndex];
+            const std::string& key = grammar.symbols[keySymbols[group]];
+            kernel.keys.push_back(key);
             kernel.gotos.try_emplace(key, targetKernelIndex);
         }
-        
-        return lookAheadsPropagated;
     }
 };
 
@@ -573,11 +758,15 @@ public:
                 state.mapping.try_emplace(key, (isElement(key, closureTable.grammar.terminals) ? 's' : '\0'), nextStateIndex);
             }
 
-            for (const UnifiedItem& item : kernel.closure) {
-                if (item.dotIndex == item.rule.development.size() || item.rule.development.front() == EPSILON) {
-                    for (const std::string& lookAhead : item.lookAheads) {
-                        state.mapping.try_emplace(lookAhead, 'r', item.rule.index);
-                    }
+            for (const LRItem& item : kernel.closure) {
+                if (closureTable.isReducible(item)) {
+                    // shifts win shift/reduce conflicts, the earlier rule wins reduce/reduce conflicts
+                    item.lookAheads.forEach([&](uint32_t lookAhead) {
+                        auto [it, inserted] = state.mapping.try_emplace(grammar.symbols[grammar.numNonterminals() + lookAhead], 'r', item.rule);
+                        if (!inserted && it->second.actionType == 'r' && item.rule < it->second.actionValue) {
+                            it->second.actionValue = item.rule;
+                        }
+                    });
                 }
             }
             
@@ -594,25 +783,246 @@ std::optional<LRAction> chooseActionElement(State& state, const std::string& tok
     return state.mapping.at(token);
 }
 
+// Flat, integer indexed form of an LRTable that the parser runs on.
+// Symbols are numbered nonterminals first, then terminals and finally the end of input marker "$".
+// All members are views, so the same layout can be backed by lowered vectors or a memory-mapped parser.dat
+class ParseTable {
+public:
+    enum ActionKind : int32_t {
+        Error = 0,
+        Shift = 1,
+        Reduce = 2,
+        Goto = 3
+    };
+
+    static constexpr int32_t encode(ActionKind kind, int32_t value) { return static_cast<int32_t>(static_cast<uint32_t>(value) << 2) | kind; }
+    static constexpr ActionKind kindOf(int32_t action) { return static_cast<ActionKind>(action & 3); }
+    static constexpr int32_t valueOf(int32_t action) { return action >> 2; }
+
+    static constexpr uint32_t EMPTY_SLOT = 0xffffffffu;
+    static constexpr uint64_t packSlot(uint32_t check, int32_t action) { return (static_cast<uint64_t>(check) << 32) | static_cast<uint32_t>(action); }
+
+    uint32_t numSymbols = 0;
+    uint32_t numNonterminals = 0;
+    uint32_t numStates = 0;
+    uint32_t numRules = 0;
+
+    std::span<const uint32_t> symbolNameOffsets; // numSymbols + 1 offsets into symbolNames
+    std::span<const char> symbolNames;
+    std::span<const uint32_t> ruleLhs;
+    std::span<const uint32_t> ruleLength;        // number of symbols popped on reduce, 0 for epsilon rules
+    std::span<const uint32_t> firstsOffsets;     // numNonterminals + 1 offsets into firsts
+    std::span<const uint32_t> firsts;            // terminal ids, only used for error messages
+    // Row displacement ("comb vector") compression of the numStates * numSymbols action table. The entries of
+    // a row live at base + symbol, each slot packs the base of the row owning it (high half) with the action.
+    // States with identical rows share a base, distinct rows never do, so the parser identifies states by
+    // their base: shift and goto actions hold the target's base rather than its state number.
+    std::span<const uint32_t> stateBase;         // numStates row bases
+    std::span<const uint64_t> comb;
+
+    // keeps whatever the views point into alive (owned vectors or a file mapping)
+    std::shared_ptr<const void> storage;
+
+    ParseTable() = default;
+
+    static ParseTable lower(const LRTable& lrTable);
+
+    std::string_view symbolName(uint32_t symbol) const {
+        return {symbolNames.data() + symbolNameOffsets[symbol], symbolNameOffsets[symbol + 1] - symbolNameOffsets[symbol]};
+    }
+
+    uint32_t symbolId(std::string_view name) const {
+        auto it = symbolIds.find(name);
+        return it == symbolIds.end() ? numSymbols : it->second;
+    }
+
+    uint32_t rowOf(uint32_t state) const {
+        return stateBase[state];
+    }
+
+    // The comb is padded so that any symbol up to numSymbols (unknown) stays in bounds
+    int32_t action(uint32_t row, uint32_t symbol) const {
+        uint64_t slot = comb[static_cast<size_t>(row) + symbol];
+        return static_cast<uint32_t>(slot >> 32) == row ? static_cast<int32_t>(static_cast<uint32_t>(slot)) : encode(Error, 0);
+    }
+
+    // Terminal column for a token kind, numSymbols if the grammar doesn't know it
+    uint32_t terminalOf(TokenKind kind) const {
+        return kind < kindSymbols.size() ? kindSymbols[kind] : numSymbols;
+    }
+
+    ReduceAction reduceAction(uint32_t rule) const {
+        return ruleActions[rule];
+    }
+
+    bool isNonterminal(uint32_t symbol) const { return symbol < numNonterminals; }
+
+    // Must be called once all views are set, builds the name lookup, interns the terminals as token kinds
+    // and binds every rule to the semantic action of its left hand side
+    void index() {
+        symbolIds.clear();
+        symbolIds.reserve(numSymbols);
+
+        for (uint32_t symbol = 0; symbol < numSymbols; ++symbol) {
+            symbolIds.try_emplace(symbolName(symbol), symbol);
+        }
+
+        kindSymbols.assign(TokenKinds::count(), numSymbols);
+        for (uint32_t symbol = numNonterminals; symbol < numSymbols; ++symbol) {
+            TokenKind kind = TokenKinds::intern(symbolName(symbol));
+            if (kind >= kindSymbols.size())
+                kindSymbols.resize(kind + 1, numSymbols);
+            kindSymbols[kind] = symbol;
+        }
+
+        ruleActions.clear();
+        ruleActions.reserve(numRules);
+        for (uint32_t rule = 0; rule < numRules; ++rule) {
+            ruleActions.push_back(reduceActionFor(symbolName(ruleLhs[rule])));
+        }
+    }
+
+private:
+    std::unordered_map<std::string_view, uint32_t> symbolIds;
+    std::vector<uint32_t> kindSymbols;
+    std::vector<ReduceAction> ruleActions;
+};
+
+ParseTable ParseTable::lower(const LRTable& lrTable) {
+    struct Owned {
+        std::vector<uint32_t> symbolNameOffsets;
+        std::string symbolNames;
+        std::vector<uint32_t> ruleLhs;
+        std::vector<uint32_t> ruleLength;
+        std::vector<uint32_t> firstsOffsets;
+        std::vector<uint32_t> firsts;
+        std::vector<uint32_t> stateBase;
+        std::vector<uint64_t> comb;
+    };
+
+    const Grammar& grammar = lrTable.grammar;
+    auto owned = std::make_shared<Owned>();
+
+    const std::vector<std::string>& symbols = grammar.symbols;
+
+    for (const std::string& symbol : symbols) {
+        owned->symbolNameOffsets.push_back(static_cast<uint32_t>(owned->symbolNames.size()));
+        owned->symbolNames += symbol;
+    }
+    owned->symbolNameOffsets.push_back(static_cast<uint32_t>(owned->symbolNames.size()));
+
+    for (const Rule& rule : grammar.rules) {
+        owned->ruleLhs.push_back(grammar.symbolId(rule.nonterminal));
+        owned->ruleLength.push_back(static_cast<uint32_t>(grammar.ruleSymbols[rule.index].size()));
+    }
+
+    for (uint32_t nonterminal = 0; nonterminal < grammar.numNonterminals(); ++nonterminal) {
+        owned->firstsOffsets.push_back(static_cast<uint32_t>(owned->firsts.size()));
+        grammar.firstSets[nonterminal].forEach([&](uint32_t terminal) {
+            owned->firsts.push_back(grammar.numNonterminals() + terminal);
+        });
+    }
+    owned->firstsOffsets.push_back(static_cast<uint32_t>(owned->firsts.size()));
+
+    // Rows hold the target state for shifts and gotos until every base is known
+    using Row = std::vector<std::pair<uint32_t, int32_t>>;
+    std::vector<Row> rows(lrTable.states.size());
+    for (const State& state : lrTable.states) {
+        Row& row = rows[state.index];
+        for (const auto& [symbol, lrAction] : state.mapping) {
+            ActionKind kind = lrAction.actionType == 's' ? Shift : lrAction.actionType == 'r' ? Reduce : Goto;
+            row.emplace_back(grammar.symbolId(symbol), encode(kind, lrAction.actionValue));
+        }
+        std::ranges::sort(row);
+    }
+
+    // Identical rows are stored once, the rest is placed first fit, biggest rows first
+    std::map<Row, uint32_t> uniqueRows;
+    std::vector<const Row*> order;
+    for (const Row& row : rows) {
+        if (uniqueRows.try_emplace(row, 0).second) order.push_back(&row);
+    }
+    std::ranges::stable_sort(order, std::greater<>(), [](const Row* row) { return row->size(); });
+
+    std::vector<uint32_t> check;
+    std::vector<bool> baseUsed;
+    size_t firstFree = 0;
+    for (const Row* row : order) {
+        size_t base = row->empty() ? 0 : firstFree - std::min<size_t>(firstFree, row->front().first);
+
+        auto fits = [&](size_t candidate) {
+            if (candidate < baseUsed.size() && baseUsed[candidate]) return false;
+            return std::ranges::all_of(*row, [&](const auto& entry) {
+                size_t slot = candidate + entry.first;
+                return slot >= check.size() || check[slot] == EMPTY_SLOT;
+            });
+        };
+        while (!fits(base)) ++base;
+
+        if (base >= EMPTY_SLOT) babel_panic("Parse table too large to compress");
+        if (base >= baseUsed.size()) baseUsed.resize(base + 1);
+        baseUsed[base] = true;
+
+        // room for every symbol of this row plus the unknown symbol
+        if (check.size() < base + symbols.size() + 1) check.resize(base + symbols.size() + 1, EMPTY_SLOT);
+        for (const auto& entry : *row) check[base + entry.first] = static_cast<uint32_t>(base);
+
+        while (firstFree < check.size() && check[firstFree] != EMPTY_SLOT) ++firstFree;
+        uniqueRows[*row] = static_cast<uint32_t>(base);
+    }
+
+    for (const Row& row : rows) {
+        owned->stateBase.push_back(uniqueRows.at(row));
+    }
+
+    owned->comb.assign(check.size(), packSlot(EMPTY_SLOT, encode(Error, 0)));
+    for (const auto& [row, base] : uniqueRows) {
+        for (auto [symbol, action] : row) {
+            if (kindOf(action) != Reduce) action = encode(kindOf(action), static_cast<int32_t>(owned->stateBase[valueOf(action)]));
+            owned->comb[base + symbol] = packSlot(base, action);
+        }
+    }
+
+    ParseTable table;
+    table.numSymbols = static_cast<uint32_t>(symbols.size());
+    table.numNonterminals = static_cast<uint32_t>(grammar.nonterminals.size());
+    table.numStates = static_cast<uint32_t>(lrTable.states.size());
+    table.numRules = static_cast<uint32_t>(grammar.rules.size());
+    table.symbolNameOffsets = owned->symbolNameOffsets;
+    table.symbolNames = owned->symbolNames;
+    table.ruleLhs = owned->ruleLhs;
+    table.ruleLength = owned->ruleLength;
+    table.firstsOffsets = owned->firstsOffsets;
+    table.firsts = owned->firsts;
+    table.stateBase = owned->stateBase;
+    table.comb = owned->comb;
+    table.storage = std::move(owned);
+    table.index();
+
+    return table;
+}
+
 class Parser {
 public:
-    LRTable lrTable;
+    ParseTable table;
     Parser() = default;
-    explicit Parser(const LRTable& lrTable) : lrTable(lrTable) {}
+    explicit Parser(const LRTable& lrTable) : table(ParseTable::lower(lrTable)) {}
+    explicit Parser(ParseTable table) : table(std::move(table)) {}
 
-    BABEL_COLD std::string retrieveMessage(const State& state, const std::string& token) const {
-        std::unordered_map<std::string, LRAction, TransparentStringHash, std::equal_to<>> m = state.mapping;
-        
+    BABEL_COLD std::string retrieveMessage(uint32_t row, const std::string& token) const {
         std::list<std::string> expected;
-        for (const auto& [symbol, _] : m) {
-            if (isElement(symbol, lrTable.grammar.nonterminals)) {
-                expected.splice(expected.end(), lrTable.grammar.firsts.at(symbol));
+        for (uint32_t symbol = 0; symbol < table.numSymbols; ++symbol) {
+            if (ParseTable::kindOf(table.action(row, symbol)) == ParseTable::Error) continue;
+
+            if (table.isNonterminal(symbol)) {
+                for (uint32_t i = table.firstsOffsets[symbol]; i < table.firstsOffsets[symbol + 1]; ++i) {
+                    expected.emplace_back(table.symbolName(table.firsts[i]));
+                }
             } else {
-                expected.push_back(symbol);
+                expected.emplace_back(table.symbolName(symbol));
             }
         }
         
-        expected.remove(EPSILON);
         expected.sort();
         expected.unique();
         if (auto it = std::ranges::find(expected, "$"); it != expected.end()) {
@@ -629,75 +1039,147 @@ public:
         return std::regex_replace(msg, std::regex("'\\$'"), "EOF");
     }
 
-    std::variant<TreeNode, std::string> parse(std::vector<Token> tokens) const {
-        tokens.emplace_back("$", "$");
-        std::stack<TreeNode> nodeStack;
-        std::stack<std::variant<TreeNode, std::unique_ptr<BaseAST>>> reducedNodes;
-        std::stack<int> stateStack;
-        stateStack.push(0);
-        int tokenIndex = 0;
-        Token token = tokens[tokenIndex];
-        std::string token_type = token.getType();
-        State state = lrTable.states[stateStack.top()];
-        std::optional<LRAction> actionElement = chooseActionElement(state, token_type);
-
-        while (actionElement != std::nullopt && actionElement.value().toString() != "r0") {
-            if (actionElement.value().actionType == 's') {
-                TreeNode shiftNode;
-                shiftNode.name = tokens[tokenIndex].getType();
-                shiftNode.data = tokens[tokenIndex].getValue();
-
-                nodeStack.emplace(shiftNode);
+    // Runs the automaton only, without building a tree or any AST. Returns whether tokens form a valid program.
+    bool recognize(const std::vector<Token>& tokens) const {
+        std::vector<uint32_t> stateStack;
+        stateStack.reserve(64);
+        stateStack.push_back(table.rowOf(0));
+
+        size_t tokenIndex = 0;
+        uint32_t terminal = table.terminalOf(tokens.empty() ? TokenKinds::END_OF_INPUT : tokens[0].getKind());
+
+        while (true) {
+            int32_t action = table.action(stateStack.back(), terminal);
+
+            switch (ParseTable::kindOf(action)) {
+                case ParseTable::Shift:
+                    stateStack.push_back(ParseTable::valueOf(action));
+                    ++tokenIndex;
+                    terminal = table.terminalOf(tokenIndex < tokens.size() ? tokens[tokenIndex].getKind() : TokenKinds::END_OF_INPUT);
+                    break;
+                case ParseTable::Reduce: {
+                    int32_t ruleIndex = ParseTable::valueOf(action);
+                    if (ruleIndex == 0)
+                        return true;
+
+                    stateStack.resize(stateStack.size() - table.ruleLength[ruleIndex]);
+                    int32_t gotoAction = table.action(stateStack.back(), table.ruleLhs[ruleIndex]);
+                    if (ParseTable::kindOf(gotoAction) != ParseTable::Goto)
+                        return false;
+
+                    stateStack.push_back(ParseTable::valueOf(gotoAction));
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+    }
+
+    // Parses tokens and builds the AST on the fly, it is handed out in ParseTree::ast for codegen. The concrete
+    // parse tree is only kept with buildTree, without it ParseTree::root stays null and only the token nodes
+    // the AST builder looks at are allocated. Tasks and variables are declared in Ctx, codegen has to use the same one.
+    std::variant<ParseTree, std::string> parse(const std::vector<Token>& tokens, CompilerContext& Ctx, bool buildTree = true) const {
+        size_t tokenIndex = 0;
+        return parseTokens([&]() { return tokenIndex < tokens.size() ? &tokens[tokenIndex++] : nullptr; }, Ctx, buildTree, false);
+    }
+
+    // Pulls the tokens from the stream only as the parse needs them. The text of identifiers and literals read
+    // from an istream is copied into the tree, each other text only once. Text of a source in memory is viewed
+    // like that of a token vector.
+    std::variant<ParseTree, std::string> parse(TokenStream& tokens, CompilerContext& Ctx, bool buildTree = true) const {
+        return parseTokens([&]() { return tokens.next(); }, Ctx, buildTree, !tokens.viewsSource());
+    }
+
+private:
+    // next hands out one token after the other and nullptr at the end of input, a token only has to stay
+    // valid until the following call
+    template<typename NextToken>
+    std::variant<ParseTree, std::string> parseTokens(NextToken&& next, CompilerContext& Ctx, bool buildTree, bool copyText) const {
+        const Token* current = next();
+        // anything past the last token is the end of input
+        auto terminal = [&]() {
+            return table.terminalOf(current ? current->getKind() : TokenKinds::END_OF_INPUT);
+        };
+
+        ParseTree tree;
+        PhaseAccumulator building("Build AST");
+        std::vector<const TreeNode*> nodeStack;
+        std::vector<bool> tokenStack; // whether each symbol on the stack is a token, parallel to the state stack
+        ReducedNodeStack reducedNodes;
+        std::vector<uint32_t> stateStack;
+        stateStack.reserve(64);
+        stateStack.push_back(table.rowOf(0));
+        int32_t action = table.action(stateStack.back(), terminal());
+
+        while (ParseTable::kindOf(action) == ParseTable::Shift || (ParseTable::kindOf(action) == ParseTable::Reduce && ParseTable::valueOf(action) != 0)) {
+            if (ParseTable::kindOf(action) == ParseTable::Shift) {
+                // only identifiers and literals take memory per token, the text of the other tokens is shared
+                const TreeNode* shiftNode = !copyText ? tree.makeToken(terminal(), current->getType(), current->getValue())
+                    : Lexer::isIdentifierOrLiteral(current->getKind()) ? tree.makeOwnedToken(terminal(), current->getType(), current->getValue())
+                    : tree.makeInternedToken(terminal(), current->getType(), current->getValue());
+
                 reducedNodes.emplace(shiftNode);
-                stateStack.push(actionElement.value().actionValue);
-                tokenIndex++;
-            } else if (actionElement.value().actionType == 'r') {
-                int ruleIndex = actionElement.value().actionValue;
-                Rule rule = lrTable.grammar.rules[ruleIndex];
-                int removeCount = isElement(EPSILON, rule.development) ? 0 : static_cast<int>(rule.development.size());
-
-                TreeNode newNode;
-                newNode.name = rule.nonterminal;
-
-                for (int i = 0; i < removeCount; i++) {
-                    TreeNode child = nodeStack.top(); nodeStack.pop();
-                    newNode.children.push_front(child);
-                    stateStack.pop();
+                if (buildTree) nodeStack.push_back(shiftNode);
+                tokenStack.push_back(true);
+                stateStack.push_back(ParseTable::valueOf(action));
+                current = next();
+            } else {
+                int32_t ruleIndex = ParseTable::valueOf(action);
+                uint32_t lhs = table.ruleLhs[ruleIndex];
+                std::string_view nonterminal = table.symbolName(lhs);
+                int removeCount = static_cast<int>(table.ruleLength[ruleIndex]);
+
+                if (buildTree) {
+                    std::span<const TreeNode* const> children(nodeStack.end() - removeCount, nodeStack.end());
+                    const TreeNode* newNode = tree.makeNode(lhs, nonterminal, children);
+                    nodeStack.resize(nodeStack.size() - removeCount);
+                    nodeStack.push_back(newNode);
                 }
 
-                nodeStack.push(newNode);
+                bool hasTokenizedChild = std::any_of(tokenStack.end() - removeCount, tokenStack.end(), std::identity());
+                tokenStack.resize(tokenStack.size() - removeCount);
+                tokenStack.push_back(false);
+                stateStack.resize(stateStack.size() - removeCount);
 
-                bool treatSpecial = rule.nonterminal == "simple_stmt" || rule.nonterminal == "comparison" || rule.nonterminal == "conjunction" || rule.nonterminal == "disjunction";
-                if (newNode.has_tokenized_child() || treatSpecial || isElement(EPSILON, rule.development)) {
-                    buildNode(reducedNodes, rule.nonterminal, removeCount);
+                ReduceAction reduceAction = table.reduceAction(ruleIndex);
+                if (hasTokenizedChild || removeCount == 0 || alwaysReduces(reduceAction)) {
+                    PhaseAccumulator::Piece piece(building);
+                    buildNode(Ctx, reducedNodes, tree, reduceAction, lhs, nonterminal, removeCount);
                 }
-            } else {
-                stateStack.push(actionElement.value().actionValue);
+
+                int32_t gotoAction = table.action(stateStack.back(), lhs);
+                if (ParseTable::kindOf(gotoAction) != ParseTable::Goto) {
+                    action = gotoAction;
+                    break;
+                }
+
+                stateStack.push_back(ParseTable::valueOf(gotoAction));
             }
             
-            state = lrTable.states[stateStack.top()];
-            token_type = (nodeStack.size() + stateStack.size()) % 2 == 0 ? nodeStack.top().name : tokens[tokenIndex].getType();
-            actionElement = chooseActionElement(state, token_type);
+            action = table.action(stateStack.back(), terminal());
         }
 
-        if (actionElement != std::nullopt && actionElement.value().toString() == "r0") {
-            if (!std::holds_alternative<TreeNode>(reducedNodes.top())) {
-                std::deque<std::unique_ptr<BaseAST>> statement_list;
+        if (ParseTable::kindOf(action) == ParseTable::Reduce && ParseTable::valueOf(action) == 0) {
+            if (!std::holds_alternative<const TreeNode*>(reducedNodes.top())) {
+                std::deque<BaseAST*> statement_list;
                 while (!reducedNodes.empty()) {
-                    statement_list.push_front(std::move(std::get<std::unique_ptr<BaseAST>>(reducedNodes.top())));
+                    statement_list.push_front(std::get<BaseAST*>(reducedNodes.top()));
                     reducedNodes.pop();
                 }
 
-                auto root = std::make_unique<RootAST>(std::move(statement_list));
-                root->codegen();
+                tree.ast = tree.makeAST<RootAST>(tree.makeList(statement_list));
+            }
+
+            if (buildTree) {
+                tree.root = tree.makeNode(table.ruleLhs[0], table.symbolName(table.ruleLhs[0]), nodeStack);
             }
 
-            //return TreeNode{lrTable.grammar.axiom, std::nullopt, {reducedNodes.top()}};
-            return TreeNode{lrTable.grammar.axiom, std::nullopt, {nodeStack.top()}};
-            //return "Success";
+            return tree;
         }
 
-        return "SyntaxError: " + retrieveMessage(state, tokens[tokenIndex].getValue());
+        std::string found = current ? std::string(current->getValue()) : "$";
+        return "SyntaxError: " + retrieveMessage(stateStack.back(), found);
     }
 };
 
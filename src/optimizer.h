@@ -0,0 +1,192 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "llvm/Analysis/CGSCCPassManager.h"
+#include "llvm/Analysis/LazyCallGraph.h"
+#include "llvm/Analysis/LoopAnalysisManager.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PassInstrumentation.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Passes/OptimizationLevel.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/TimeProfiler.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+
+#include "util.hpp"
+
+// -O flags of the driver, mapped onto the default pipelines of LLVM's new pass manager
+enum class OptLevel {
+    O0,
+    O1,
+    O2,
+    O3,
+    Os
+};
+
+std::optional<OptLevel> parseOptLevel(std::string_view flag) {
+    if (flag == "-O0") return OptLevel::O0;
+    if (flag == "-O1") return OptLevel::O1;
+    if (flag == "-O2") return OptLevel::O2;
+    if (flag == "-O3") return OptLevel::O3;
+    if (flag == "-Os") return OptLevel::Os;
+    return std::nullopt;
+}
+
+llvm::OptimizationLevel toLLVMLevel(OptLevel level) {
+    switch (level) {
+        case OptLevel::O0: return llvm::OptimizationLevel::O0;
+        case OptLevel::O1: return llvm::OptimizationLevel::O1;
+        case OptLevel::O2: return llvm::OptimizationLevel::O2;
+        case OptLevel::O3: return llvm::OptimizationLevel::O3;
+        case OptLevel::Os: return llvm::OptimizationLevel::Os;
+    }
+
+    babel_unreachable();
+}
+
+// The function a pass ran on, or the module
+std::string passUnitName(const llvm::Any& ir) {
+    if (const auto* function = llvm::any_cast<const llvm::Function*>(&ir))
+        return (*function)->getName().str();
+    if (const auto* loop = llvm::any_cast<const llvm::Loop*>(&ir))
+        return (*loop)->getHeader()->getParent()->getName().str();
+    if (const auto* scc = llvm::any_cast<const llvm::LazyCallGraph::SCC*>(&ir))
+        return (*scc)->begin()->getFunction().getName().str();
+    return "<module>";
+}
+
+// Wall time of every pass, split by the function (or module) it ran on. Pass managers and adaptors
+// only forward to the passes they hold, so they are left out to not count the same time twice.
+class PassTimer {
+public:
+    void registerCallbacks(llvm::PassInstrumentationCallbacks& callbacks) {
+        callbacks.registerBeforeNonSkippedPassCallback([this](llvm::StringRef pass, llvm::Any ir) {
+            if (isContainer(pass)) return;
+            running.push_back(Clock::now());
+        });
+        callbacks.registerAfterPassCallback([this](llvm::StringRef pass, llvm::Any ir, const llvm::PreservedAnalyses&) {
+            if (isContainer(pass)) return;
+            stop(pass, passUnitName(ir));
+        });
+        callbacks.registerAfterPassInvalidatedCallback([this](llvm::StringRef pass, const llvm::PreservedAnalyses&) {
+            if (isContainer(pass)) return;
+            stop(pass, "<invalidated>");
+        });
+    }
+
+    void print(llvm::raw_ostream& os) const {
+        std::map<std::string, Duration> perUnit;
+        Duration total{};
+        for (const auto& [key, duration] : timings) {
+            perUnit[key.first] += duration;
+            total += duration;
+        }
+
+        std::vector<std::pair<std::pair<std::string, std::string>, Duration>> sorted(timings.begin(), timings.end());
+        std::ranges::stable_sort(sorted, [&](const auto& a, const auto& b) {
+            if (a.first.first != b.first.first) return perUnit.at(a.first.first) > perUnit.at(b.first.first);
+            return a.second > b.second;
+        });
+
+        os << "===== Pass execution timing report =====\n";
+        os << llvm::format("  Total: %.3f ms\n", toMilliseconds(total));
+
+        std::string_view currentUnit;
+        for (const auto& [key, duration] : sorted) {
+            if (key.first != currentUnit) {
+                currentUnit = key.first;
+                os << llvm::format("  %8.3f ms  %s\n", toMilliseconds(perUnit.at(key.first)), key.first.c_str());
+            }
+            os << llvm::format("    %8.3f ms  %s\n", toMilliseconds(duration), key.second.c_str());
+        }
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+    using Duration = Clock::duration;
+
+    std::vector<Clock::time_point> running;
+    std::map<std::pair<std::string, std::string>, Duration> timings; // (unit, pass) -> time
+
+    static bool isContainer(llvm::StringRef pass) {
+        return pass.contains("PassManager") || pass.contains("PassAdaptor") || pass.contains("WrapperPass") || pass.contains("DevirtSCCRepeatedPass");
+    }
+
+    static double toMilliseconds(Duration duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+
+    void stop(llvm::StringRef pass, std::string unit) {
+        if (running.empty()) return;
+
+        Duration elapsed = Clock::now() - running.back();
+        running.pop_back();
+        timings[{std::move(unit), pass.str()}] += elapsed;
+    }
+};
+
+// Every pass becomes an event of the --trace of this thread, with the function it ran on as its detail
+void registerPassTracing(llvm::PassInstrumentationCallbacks& callbacks) {
+    callbacks.registerBeforeNonSkippedPassCallback([](llvm::StringRef pass, llvm::Any ir) {
+        llvm::timeTraceProfilerBegin(pass, passUnitName(ir));
+    });
+    callbacks.registerAfterPassCallback([](llvm::StringRef, llvm::Any, const llvm::PreservedAnalyses&) {
+        llvm::timeTraceProfilerEnd();
+    });
+    callbacks.registerAfterPassInvalidatedCallback([](llvm::StringRef, const llvm::PreservedAnalyses&) {
+        llvm::timeTraceProfilerEnd();
+    });
+}
+
+// Runs the default pipeline for the level on the module. Broken modules are left alone, the passes
+// assume valid IR and the verifier output is more useful than whatever they would make of it.
+// Modules for ThinLTO get the pre-link pipeline, it leaves inlining and most optimizing to the link.
+void optimizeModule(llvm::Module& module, OptLevel level, llvm::TargetMachine* machine = nullptr, bool timePasses = false, bool thinLTOPreLink = false) {
+    if (llvm::verifyModule(module)) {
+        llvm::errs() << "warning: module is not valid IR, skipping optimization\n";
+        return;
+    }
+
+    llvm::PassInstrumentationCallbacks callbacks;
+    PassTimer timer;
+    if (timePasses) timer.registerCallbacks(callbacks);
+    if (llvm::timeTraceProfilerEnabled()) registerPassTracing(callbacks);
+
+    llvm::LoopAnalysisManager loopAnalyses;
+    llvm::FunctionAnalysisManager functionAnalyses;
+    llvm::CGSCCAnalysisManager cgsccAnalyses;
+    llvm::ModuleAnalysisManager moduleAnalyses;
+
+    llvm::PassBuilder passBuilder(machine, llvm::PipelineTuningOptions(), std::nullopt, &callbacks);
+    passBuilder.registerModuleAnalyses(moduleAnalyses);
+    passBuilder.registerCGSCCAnalyses(cgsccAnalyses);
+    passBuilder.registerFunctionAnalyses(functionAnalyses);
+    passBuilder.registerLoopAnalyses(loopAnalyses);
+    passBuilder.crossRegisterProxies(loopAnalyses, functionAnalyses, cgsccAnalyses, moduleAnalyses);
+
+    llvm::ModulePassManager passes;
+    if (level == OptLevel::O0)
+        passes = passBuilder.buildO0DefaultPipeline(llvm::OptimizationLevel::O0, thinLTOPreLink);
+    else if (thinLTOPreLink)
+        passes = passBuilder.buildThinLTOPreLinkDefaultPipeline(toLLVMLevel(level));
+    else
+        passes = passBuilder.buildPerModuleDefaultPipeline(toLLVMLevel(level));
+    passes.run(module, moduleAnalyses);
+
+    if (timePasses) timer.print(llvm::errs());
+}
+
+#endif /* OPTIMIZER_H */
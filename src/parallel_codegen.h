@@ -0,0 +1,142 @@
+#ifndef PARALLEL_CODEGEN_H
+#define PARALLEL_CODEGEN_H
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+
+#include "lrparser.h"
+#include "emitter.h"
+#include "optimizer.h"
+#include "task_cache.h"
+
+constexpr size_t batchesPerJob = 4;
+
+// Declarations nothing in the module refers to, they would make cache keys depend on unrelated code
+void dropUnusedDeclarations(llvm::Module& module) {
+    for (llvm::Function& function : llvm::make_early_inc_range(module)) {
+        if (function.isDeclaration() && function.use_empty()) function.eraseFromParent();
+    }
+
+    for (llvm::GlobalVariable& global : llvm::make_early_inc_range(module.globals())) {
+        if (global.isDeclaration() && global.use_empty()) global.eraseFromParent();
+    }
+}
+
+// Generates the program into Ctx.Module like RootAST::codegen, but with the bodies of top level tasks split
+// across worker threads. Every task is declared up front, then the tasks are generated and optimized in
+// batches, each into a module and context of its own, next to the top level code the calling thread
+// optimizes meanwhile. The batches come back as bitcode and are linked into Ctx.Module, so only tasks of
+// the same batch can be inlined into each other.
+// With a cache every task is a batch of its own, and tasks whose IR the cache has seen before are not
+// optimized again, their bitcode comes from the cache.
+bool codegenParallel(CompilerContext& Ctx, RootAST& root, unsigned jobs, OptLevel level, bool timePasses = false, TaskCache* cache = nullptr) {
+    std::vector<TaskAST*> tasks;
+    root.codegenDeferringTasks(Ctx, tasks);
+    const std::string dataLayout = Ctx.Module->getDataLayoutStr();
+    const std::string triple = Ctx.Module->getTargetTriple();
+
+    // a machine per thread, the passes query it while optimizing
+    std::unique_ptr<llvm::TargetMachine> machine = createHostTargetMachine(level);
+    if (!machine) return false;
+
+    std::vector<std::unique_ptr<llvm::TargetMachine>> machines;
+    for (size_t i = 0; i < std::min<size_t>(jobs, tasks.size()); i++) {
+        machines.push_back(createHostTargetMachine(level));
+        if (!machines.back()) return false;
+    }
+
+    // every batch module declares all tasks again, a few batches per thread still even out uneven tasks
+    const size_t batches = cache ? tasks.size() : std::min<size_t>(tasks.size(), machines.size() * batchesPerJob);
+    std::vector<llvm::SmallVector<char, 0>> bitcode(batches);
+    std::atomic<size_t> next = 0;
+    std::atomic<bool> valid = true;
+
+    auto work = [&](llvm::TargetMachine* machine) {
+        for (size_t i = next++; i < batches; i = next++) {
+            std::span<TaskAST* const> batch(tasks.begin() + i * tasks.size() / batches, tasks.begin() + (i + 1) * tasks.size() / batches);
+
+            // the tables of Ctx are only read, every batch continues in a copy of them
+            CompilerContext Batch("tasks");
+            Batch.Module->setDataLayout(dataLayout);
+            Batch.Module->setTargetTriple(triple);
+            Batch.GlobalValues = Ctx.GlobalValues;
+            Batch.TaskTable = Ctx.TaskTable;
+            Batch.PolymorphTable = Ctx.PolymorphTable;
+
+            // the batch first, the argument names of their own declarations are what the bodies look up.
+            // The globals the top level code defined are declared, their values are filled in while linking.
+            for (TaskAST* task : batch) task->declare(Batch);
+            redeclareEarlierDefinitions(Batch);
+
+            // broken modules would not read back in, the verifier says what is wrong with them instead
+            for (TaskAST* task : batch) task->codegen(Batch);
+            if (llvm::verifyModule(*Batch.Module, &llvm::errs())) {
+                valid = false;
+                continue;
+            }
+
+            std::string key;
+            if (cache) {
+                dropUnusedDeclarations(*Batch.Module);
+                key = TaskCache::key(*Batch.Module, level);
+                if (auto cached = cache->lookup(key)) {
+                    bitcode[i] = std::move(*cached);
+                    continue;
+                }
+            }
+
+            optimizeModule(*Batch.Module, level, machine);
+            llvm::raw_svector_ostream out(bitcode[i]);
+            llvm::WriteBitcodeToFile(*Batch.Module, out);
+            if (cache) cache->store(key, bitcode[i]);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (const auto& machine : machines) {
+        workers.emplace_back(work, machine.get());
+    }
+
+    optimizeModule(*Ctx.Module, level, machine.get(), timePasses);
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    if (!valid) {
+        llvm::errs() << "Not linking invalid task modules\n";
+        return false;
+    }
+
+    for (size_t i = 0; i < batches; i++) {
+        auto parsed = llvm::parseBitcodeFile(llvm::MemoryBufferRef(llvm::StringRef(bitcode[i].data(), bitcode[i].size()), "tasks"), *Ctx.Context);
+        if (!parsed) {
+            llvm::errs() << "Error reading task module: " << llvm::toString(parsed.takeError()) << "\n";
+            return false;
+        }
+
+        if (llvm::Linker::linkModules(*Ctx.Module, std::move(*parsed))) {
+            llvm::errs() << "Error linking task module\n";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+#endif /* PARALLEL_CODEGEN_H */
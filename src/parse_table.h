@@ -0,0 +1,228 @@
+#ifndef PARSE_TABLE_H
+#define PARSE_TABLE_H
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "lrparser.h"
+
+// parser.dat layout, all integers in host byte order:
+//   ParseTableHeader
+//   uint64_t comb[combSize]
+//   uint32_t symbolNameOffsets[numSymbols + 1]
+//   uint32_t ruleLhs[numRules]
+//   uint32_t ruleLength[numRules]
+//   uint32_t firstsOffsets[numNonterminals + 1]
+//   uint32_t firsts[numFirsts]
+//   uint32_t stateBase[numStates]
+//   char     symbolNames[symbolNamesSize]
+// The header is a multiple of 8 bytes and every section but the trailing names a multiple of 4,
+// so the file can be used in place once mapped.
+
+constexpr char PARSE_TABLE_MAGIC[8] = {'B', 'A', 'B', 'E', 'L', 'P', 'T', '\0'};
+constexpr uint32_t PARSE_TABLE_VERSION = 2;
+
+struct ParseTableHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t grammarHash;
+    uint32_t numSymbols;
+    uint32_t numNonterminals;
+    uint32_t numStates;
+    uint32_t numRules;
+    uint32_t numFirsts;
+    uint32_t symbolNamesSize;
+    uint32_t combSize;
+    uint32_t reserved;
+};
+static_assert(sizeof(ParseTableHeader) % alignof(uint64_t) == 0, "the comb section directly follows the header");
+
+// FNV-1a, stable across platforms and standard library implementations unlike std::hash
+constexpr uint64_t hashGrammar(std::string_view text) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+
+    for (char c : text) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+inline size_t parseTablePayloadSize(const ParseTableHeader& header) {
+    return sizeof(uint32_t) * (header.numSymbols + 1)
+         + sizeof(uint32_t) * header.numRules * 2
+         + sizeof(uint32_t) * (header.numNonterminals + 1)
+         + sizeof(uint32_t) * header.numFirsts
+         + sizeof(uint32_t) * header.numStates
+         + sizeof(uint64_t) * static_cast<size_t>(header.combSize)
+         + header.symbolNamesSize;
+}
+
+template <typename T>
+void writeSection(std::ostream& out, std::span<const T> section) {
+    out.write(reinterpret_cast<const char*>(section.data()), static_cast<std::streamsize>(section.size_bytes()));
+}
+
+void writeParseTable(std::ostream& out, const ParseTable& table, uint64_t grammarHash) {
+    ParseTableHeader header = {};
+    std::memcpy(header.magic, PARSE_TABLE_MAGIC, sizeof(header.magic));
+    header.version = PARSE_TABLE_VERSION;
+    header.headerSize = sizeof(ParseTableHeader);
+    header.grammarHash = grammarHash;
+    header.numSymbols = table.numSymbols;
+    header.numNonterminals = table.numNonterminals;
+    header.numStates = table.numStates;
+    header.numRules = table.numRules;
+    header.numFirsts = static_cast<uint32_t>(table.firsts.size());
+    header.symbolNamesSize = static_cast<uint32_t>(table.symbolNames.size());
+    header.combSize = static_cast<uint32_t>(table.comb.size());
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    writeSection(out, table.comb);
+    writeSection(out, table.symbolNameOffsets);
+    writeSection(out, table.ruleLhs);
+    writeSection(out, table.ruleLength);
+    writeSection(out, table.firstsOffsets);
+    writeSection(out, table.firsts);
+    writeSection(out, table.stateBase);
+    writeSection(out, table.symbolNames);
+}
+
+template <typename T>
+void writeArraySource(std::ostream& out, std::string_view type, std::string_view name, std::span<const T> values) {
+    out << "inline constexpr std::array<" << type << ", " << values.size() << "> " << name << " = {";
+
+    for (size_t i = 0; i < values.size(); ++i) {
+        out << (i % 16 == 0 ? "\n    " : " ") << values[i] << ",";
+    }
+
+    out << "\n};\n\n";
+}
+
+// Emits the table as constexpr arrays, which are compiled into babel when BABEL_EMBEDDED_PARSE_TABLE is defined
+void writeParseTableSource(std::ostream& out, const ParseTable& table, uint64_t grammarHash) {
+    out << "// Generated by babel_tablegen from grammar.txt, do not edit\n";
+    out << "#include <array>\n#include <cstdint>\n\n";
+    out << "namespace babel_tables {\n\n";
+    out << "inline constexpr uint64_t grammarHash = " << grammarHash << "ull;\n";
+    out << "inline constexpr uint32_t numSymbols = " << table.numSymbols << ";\n";
+    out << "inline constexpr uint32_t numNonterminals = " << table.numNonterminals << ";\n";
+    out << "inline constexpr uint32_t numStates = " << table.numStates << ";\n";
+    out << "inline constexpr uint32_t numRules = " << table.numRules << ";\n\n";
+
+    std::vector<int> names(table.symbolNames.begin(), table.symbolNames.end());
+    writeArraySource<int>(out, "char", "symbolNames", names);
+    writeArraySource(out, "uint32_t", "symbolNameOffsets", table.symbolNameOffsets);
+    writeArraySource(out, "uint32_t", "ruleLhs", table.ruleLhs);
+    writeArraySource(out, "uint32_t", "ruleLength", table.ruleLength);
+    writeArraySource(out, "uint32_t", "firstsOffsets", table.firstsOffsets);
+    writeArraySource(out, "uint32_t", "firsts", table.firsts);
+    writeArraySource(out, "uint32_t", "stateBase", table.stateBase);
+    writeArraySource(out, "uint64_t", "comb", table.comb);
+
+    out << "} // namespace babel_tables\n";
+}
+
+template <typename T>
+std::span<const T> readSection(const char*& cursor, size_t count) {
+    std::span<const T> section(reinterpret_cast<const T*>(cursor), count);
+    cursor += section.size_bytes();
+    return section;
+}
+
+// Maps a parser.dat file and returns a table that points directly into the mapping.
+// Returns std::nullopt if the file is missing, truncated, from another format version
+// or was generated for a different grammar (when an expected hash is given).
+std::optional<ParseTable> loadParseTable(const std::filesystem::path& path, std::optional<uint64_t> expectedGrammarHash) {
+    namespace bip = boost::interprocess;
+
+    std::error_code ec;
+    if (!std::filesystem::is_regular_file(path, ec) || std::filesystem::file_size(path, ec) < sizeof(ParseTableHeader))
+        return std::nullopt;
+
+    std::shared_ptr<bip::mapped_region> region;
+    try {
+        bip::file_mapping file(path.string().c_str(), bip::read_only);
+        region = std::make_shared<bip::mapped_region>(file, bip::read_only);
+    } catch (const bip::interprocess_exception&) {
+        return std::nullopt;
+    }
+
+    const char* base = static_cast<const char*>(region->get_address());
+    const auto* header = reinterpret_cast<const ParseTableHeader*>(base);
+
+    if (std::memcmp(header->magic, PARSE_TABLE_MAGIC, sizeof(header->magic)) != 0
+        || header->version != PARSE_TABLE_VERSION
+        || header->headerSize != sizeof(ParseTableHeader)
+        || region->get_size() != sizeof(ParseTableHeader) + parseTablePayloadSize(*header))
+        return std::nullopt;
+
+    if (expectedGrammarHash.has_value() && header->grammarHash != expectedGrammarHash.value())
+        return std::nullopt;
+
+    ParseTable table;
+    table.numSymbols = header->numSymbols;
+    table.numNonterminals = header->numNonterminals;
+    table.numStates = header->numStates;
+    table.numRules = header->numRules;
+
+    const char* cursor = base + sizeof(ParseTableHeader);
+    table.comb = readSection<uint64_t>(cursor, header->combSize);
+    table.symbolNameOffsets = readSection<uint32_t>(cursor, header->numSymbols + 1);
+    table.ruleLhs = readSection<uint32_t>(cursor, header->numRules);
+    table.ruleLength = readSection<uint32_t>(cursor, header->numRules);
+    table.firstsOffsets = readSection<uint32_t>(cursor, header->numNonterminals + 1);
+    table.firsts = readSection<uint32_t>(cursor, header->numFirsts);
+    table.stateBase = readSection<uint32_t>(cursor, header->numStates);
+    table.symbolNames = readSection<char>(cursor, header->symbolNamesSize);
+
+    if (table.symbolNameOffsets.back() != header->symbolNamesSize || table.firstsOffsets.back() != header->numFirsts)
+        return std::nullopt;
+
+    // action() relies on every row, including the unknown symbol column, lying within the comb
+    if (std::ranges::any_of(table.stateBase, [&](uint32_t stateBase) { return static_cast<size_t>(stateBase) + header->numSymbols >= header->combSize; }))
+        return std::nullopt;
+
+    table.storage = std::move(region);
+    table.index();
+
+    return table;
+}
+
+#ifdef BABEL_EMBEDDED_PARSE_TABLE
+#include "parse_tables.inc"
+
+// The table compiled into the executable, no construction and no files needed
+ParseTable embeddedParseTable() {
+    ParseTable table;
+    table.numSymbols = babel_tables::numSymbols;
+    table.numNonterminals = babel_tables::numNonterminals;
+    table.numStates = babel_tables::numStates;
+    table.numRules = babel_tables::numRules;
+    table.symbolNameOffsets = babel_tables::symbolNameOffsets;
+    table.symbolNames = babel_tables::symbolNames;
+    table.ruleLhs = babel_tables::ruleLhs;
+    table.ruleLength = babel_tables::ruleLength;
+    table.firstsOffsets = babel_tables::firstsOffsets;
+    table.firsts = babel_tables::firsts;
+    table.stateBase = babel_tables::stateBase;
+    table.comb = babel_tables::comb;
+    table.index();
+
+    return table;
+}
+#endif
+
+#endif /* PARSE_TABLE_H */
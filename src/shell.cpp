@@ -1,6 +1,17 @@
 //#include "lexer.h"
 #include "lrparser.h"
+#include "parse_table.h"
+#include "token_specs.h"
 #include "colormod.h"
+#include "emitter.h"
+#include "jit.h"
+#include "tiering.h"
+#include "optimizer.h"
+#include "parallel_codegen.h"
+#include "compile_server.h"
+#include "thin_lto.h"
+#include "time_report.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include <boost/iostreams/filtering_stream.hpp>
 #include <boost/iostreams/filter/zlib.hpp>
 #include <fstream>
@@ -11,28 +22,98 @@
 #include <iostream>
 #include <string>
 #include <filesystem>
+#include <charconv>
 
 #include "tools.h"
 
-void run(const Lexer& lexer, const Parser& parser, const std::string& text) {
-    std::vector<Token> tokens = lexer.tokenize(text);
-    Lexer::handleComments(tokens);
-    Lexer::insertSemicolons(tokens);
-    std::cout << tokens << std::endl;
-    // std::visit([](const auto& value) { /* std::cout << value << std::endl; */ }, parser.parse(tokens));
-    std::variant<TreeNode, std::string> out = parser.parse(tokens);
+// Counts heap allocations for --time-report, the array and nothrow forms end up here as well
+void* operator new(std::size_t size) {
+    if (TimeReport::countAllocations.load(std::memory_order_relaxed))
+        TimeReport::allocations.fetch_add(1, std::memory_order_relaxed);
+
+    if (void* memory = std::malloc(size ? size : 1)) return memory;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+// Parses the text, the AST stays in the returned tree for the caller to generate code from.
+// Tokens are lexed as the parser asks for them, so their vector is never built.
+std::optional<ParseTree> parseTokens(CompilerContext& Ctx, const Parser& parser, TokenStream& tokens, bool echoTokens) {
+    if (echoTokens) tokens.echoTo(std::cout);
+    std::variant<ParseTree, std::string> out = parser.parse(tokens, Ctx, false);
+
+    // the echo covers all tokens, also those behind a syntax error
+    if (echoTokens) {
+        while (tokens.next()) {}
+        std::cout << std::endl;
+    }
     
-    if (std::holds_alternative<std::string>(out))
+    if (std::holds_alternative<std::string>(out)) {
         std::cout << std::get<std::string>(out) << '\n';
+        return std::nullopt;
+    }
+
+    return std::move(std::get<ParseTree>(out));
+}
+
+std::optional<ParseTree> parseText(CompilerContext& Ctx, const Lexer& lexer, const Parser& parser, std::istream& input, bool echoTokens) {
+    PhaseTimer timer("Parse");
+    TokenStream tokens(lexer, input);
+    return parseTokens(Ctx, parser, tokens, echoTokens);
+}
+
+// Sources are mapped read-only and lexed in place, the tree views its token text in the mapping and keeps it
+std::optional<ParseTree> parseSource(CompilerContext& Ctx, const Lexer& lexer, const Parser& parser, const std::filesystem::path& source, bool echoTokens) {
+    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> mapping = llvm::MemoryBuffer::getFile(source.string(), false, false);
+    if (!mapping) {
+        std::cerr << "Cannot open '" << source.string() << "': " << mapping.getError().message() << "\n";
+        return std::nullopt;
+    }
+
+    PhaseTimer timer("Parse", source.string());
+    TokenStream tokens(lexer, mapping.get()->getBuffer());
+    std::optional<ParseTree> tree = parseTokens(Ctx, parser, tokens, echoTokens);
+    if (tree.has_value()) tree->keepAlive(std::move(mapping.get()));
+    return tree;
+}
+
+bool run(CompilerContext& Ctx, const Lexer& lexer, const Parser& parser, const std::filesystem::path& source, bool echoTokens = true) {
+    std::optional<ParseTree> tree = parseSource(Ctx, lexer, parser, source, echoTokens);
+    if (!tree.has_value() || !tree->ast) return false;
+
+    PhaseTimer timer("Codegen");
+    tree->ast->codegen(Ctx);
+    return true;
 }
 
 Parser loadParserData(const std::filesystem::path& project_root) {
     std::filesystem::path grammarPath = project_root / "build" / "grammar.txt";
     std::ifstream t(grammarPath);
-    if (!t.is_open()) { std::cout << "Error opening file" << std::endl; }
     std::stringstream buffer;
     buffer << t.rdbuf();
 
+    // Prefer the table generated at build time, it is only rebuilt here if grammar.txt changed since
+    std::optional<uint64_t> grammarHash = t.is_open() ? std::optional(hashGrammar(buffer.str())) : std::nullopt;
+
+#ifdef BABEL_EMBEDDED_PARSE_TABLE
+    // The compiled in table doesn't need grammar.txt at all, it is only consulted to notice local grammar edits
+    if (!grammarHash.has_value() || grammarHash.value() == babel_tables::grammarHash) {
+        return Parser(embeddedParseTable());
+    }
+#endif
+
+    if (!t.is_open()) { std::cout << "Error opening file" << std::endl; }
+    if (std::optional<ParseTable> table = loadParseTable(grammarPath.parent_path() / "assets" / "parser.dat", grammarHash)) {
+        return Parser(std::move(table.value()));
+    }
+
     Grammar grammar(transform_string(buffer.str()));
     LRClosureTable closureTable(grammar);
     LRTable lrTable(closureTable);
@@ -42,173 +123,354 @@ Parser loadParserData(const std::filesystem::path& project_root) {
 }
 
 Lexer setupModuleAndLexer(const std::string& file_name) {
-    auto lexer = Lexer(file_name, {
-        {"TYPE", "\\b(?:int|int8|int16|int32|int64|int128|float|float16|float32|float64|float128|bool|string|cstr|char|list|tuple|map|dict|any|void)\\b"},
-        {"CLASS", "\\bclass\\b"},
-        {"EXTERN", "\\bextern\\b"},
-        {"TASK", "\\btask\\b"},
-        {"STRUCT", "\\bstruct\\b"},
-        {"COMMENT", R"(\\\\.*)"},
-        {"LET", "\\blet\\b"},
-        {"CONST", "\\bconst\\b"},
-        {"CSTRING", R"~(c"(\\.|[^"\\])*")~"},
-        {"STRING", R"~("(\\.|[^"\\])*")~"},
-        {"CHAR", "'[^']{1}'"},
-        {"BOOL", "(TRUE|FALSE)"},
-        {"AT", "@"},
-        {"LPAREN", "\\("},
-        {"LSQUARE", "\\["},
-        {"RSQUARE", "\\]"},
-        {"LBRACE", "\\{"},
-        {"RBRACE", "\\}"},
-        {"RPAREN", "\\)"},
-        {"IF", "\\bif\\b"},
-        {"ELSE", "\\belse\\b"},
-        {"ELIF", "\\belif\\b"},
-        {"THEN", "\\bthen\\b"},
-        {"MATCH", "\\bmatch\\b"},
-        {"CASE", "\\bcase\\b"},
-        {"OTHERWISE", "\\botherwise\\b"},
-        {"END", "\\bend\\b"},
-        {"DO", "\\bdo\\b"},
-        {"WHILE", "\\bwhile\\b"},
-        {"FOR", "\\bfor\\b"},
-        {"IN", "\\bin\\b"},
-        {"TO", "\\bto\\b"},
-        {"STEP", "\\bstep\\b"},
-        {"TRY", "\\btry\\b"},
-        {"CATCH", "\\bcatch\\b"},
-        {"FINALLY", "\\bfinally\\b"},
-        {"NOOP", "\\bnoop\\b"},
-        {"CONTINUE", "\\bcontinue\\b"},
-        {"BREAK", "\\bbreak\\b"},
-        {"GOTO", "\\bgoto\\b"},
-        {"LABEL_START", "\\$"},
-        {"LOOP_LABEL_START", "'"},
-        {"RETURN", "\\breturn\\b"},
-        {"RAISE", "\\braise\\b"},
-        {"IMPORT", "\\bimp\\b"},
-        {"VARARG", "\\.\\.\\."},
-        {"COLON_EQUALS", ":="},
-        {"EQEQ", "=="},
-        {"PLUS_EQUALS", "\\+="},
-        {"MINUS_EQUALS", "-="},
-        {"MULTIPLY_EQUALS", "\\*="},
-        {"DIVIDE_EQUALS", "/="},
-        {"POWER_EQUALS", "\\*\\*="},
-        {"MODULO_EQUALS", "%="},
-        {"INTEGER_DIVIDE_EQUALS", "//="},
-        {"LSHIFT_EQUALS", "<<="},
-        {"RSHIFT_EQUALS", ">>="},
-        {"BIT_OR_EQUALS", "\\|="},
-        {"BIT_AND_EQUALS", "&="},
-        {"BIT_XOR_EQUALS", "\\^="},
-        {"NEGLIGIBLY_LOW", "<<<"},
-        {"LSHIFT", "<<"},
-        {"RSHIFT", ">>"},
-        {"LTEQ", "<="},
-        {"GTEQ", ">="},
-        {"NOTEQ", "!="},
-        {"RARR","=>"},
-        {"INTEGER_DIVIDE", "//"},
-        {"INCREMENT", "\\+\\+"},
-        {"DECREMENT", "--"},
-        {"PLUS", "\\+"},
-        {"MINUS", "-"},
-        {"MULTIPLY", "\\*"},
-        {"DIVIDE", "/"},
-        {"POWER", "\\*\\*"},
-        {"MODULO", "%"},
-        {"EQUALS", "="},
-        {"OR", "\\|\\|"},
-        {"XOR", "\\^\\^"},
-        {"AND", "&&"},
-        {"BIT_NOT", "~"},
-        {"BIT_OR", "\\|"},
-        {"BIT_XOR", "\\^"},
-        {"BIT_AND", "&"},
-        {"NOT", "!"},
-        {"LT", "<"},
-        {"GT", ">"},
-        {"COMMA", ","},
-        {"COLON", ":"},
-        {"SEMICOLON", ";"},
-        {"NEWLINE", "\n"},
-        {"NULL", "null"},
-        {"NEW", "new"},
-        {"FLOATING_POINT", "\\b(?:NaN|Inf)(?:_[HhFfDdQq])?\\b"},
-        {"VAR", "[a-zA-Z_][a-zA-Z0-9_]*"},
-        {"FLOATING_POINT", "\\b[0-9](?:[0-9']*[0-9])?[eE][+-]?[0-9](?:[0-9']*[0-9])?(?:_?[HhFfDdQq])?\\b"}, // leave these before integer, so the first part is not matched as one
-        {"FLOATING_POINT", "\\b[0-9](?:[0-9']*[0-9])?\\.[0-9](?:[0-9']*[0-9])?(?:[eE][+-]?[0-9](?:[0-9']*[0-9])?)?(?:_?[HhFfDdQq])?\\b"},
-        {"FLOATING_POINT", "\\b0x[0-9A-Fa-f](?:[0-9A-Fa-f']*[0-9A-Fa-f])?[pP][+-]?[0-9](?:[0-9']*[0-9])?(?:_[HhFfDdQq])?\\b"}, // hex versions
-        {"FLOATING_POINT", "\\b0x[0-9A-Fa-f](?:[0-9A-Fa-f']*[0-9A-Fa-f])?\\.[0-9A-Fa-f](?:[0-9A-Fa-f']*[0-9A-Fa-f])?(?:[pP][+-]?[0-9](?:[0-9']*[0-9])?)?(?:_[HhFfDdQq])?\\b"},
-        {"FLOATING_POINT", "\\b(?:0[ob])?[0-9](?:[0-9']*[0-9])?_?[HhFfDdQq]\\b"}, // before int, so for example 10f is not matched as one
-        {"INTEGER", "\\b(?:0[xob])?[0-9A-Fa-f](?:[0-9A-Fa-f']*[0-9A-Fa-f])?(?:_?[BbSsIiLlCc])?\\b"}, // leave this here so something like abc1 is matched as a variable
-        {"FLOATING_POINT", "\\b0x[0-9A-Fa-f](?:[0-9A-Fa-f']*[0-9A-Fa-f])?_[HhFfDdQq]\\b"}, // same as above, also int needs to be matched first (0xff)
-        {"FLOATING_POINT", "\\.[0-9](?:[0-9']*[0-9])?(?:[eE][+-]?[0-9](?:[0-9']*[0-9])?)?(?:_?[HhFfDdQq])?"}, // these may be after integer, since the dot distinguishes them immediately
-        {"FLOATING_POINT", "0x\\.[0-9A-Fa-f](?:[0-9A-Fa-f']*[0-9A-Fa-f])?(?:[pP][+-]?[0-9](?:[0-9']*[0-9])?)?(?:_[HhFfDdQq])?"},
-        {"DOT", "\\."} // needs to be matched after fp (.5)
-    });
+    auto lexer = Lexer(file_name, babelTokenSpecs());
 
     return lexer;
 }
 
-int main(int argc, char* argv[]) {
-    // Open a new context and module.
-    TheContext = std::make_unique<llvm::LLVMContext>();
-    TheModule = std::make_unique<llvm::Module>("Babel Core", *TheContext);
-
-    // Create a new builder for the module.
-    Builder = std::make_unique<llvm::IRBuilder<>>(*TheContext);
-
-    if (argc == 1) {
-        Lexer lexer = setupModuleAndLexer("repl");
-        const std::filesystem::path ROOT_DIR = std::filesystem::absolute(std::filesystem::path(argv[0])).parent_path();
-        Parser parser = loadParserData(ROOT_DIR);
-
-        std::cout << R"( _____       _          _   |  Documentation: https://github.com/WehrWolff/babel/wiki)" << "\n";
-        std::cout << R"(| ___ \     | |        | |  |                                                        )" << "\n";
-        std::cout << R"(| |_/ / __ _| |__   ___| |  |  Use beemo for managing packages                       )" << "\n";
-        std::cout << R"(| ___ \/ _` | '_ \ / _ \ |  |                                                        )" << "\n";
-        std::cout << R"(| |_/ / (_| | |_) |  __/ |  |  Version UNRELEASED (Mar 28, 2024)                     )" << "\n";
-        std::cout << R"(\____/ \__,_|_.__/ \___|_|  |  https://github.com/WehrWolff/babel                    )" << "\n\n";
-
-        while (true) {
+void printBanner() {
+    std::cout << R"( _____       _          _   |  Documentation: https://github.com/WehrWolff/babel/wiki)" << "\n";
+    std::cout << R"(| ___ \     | |        | |  |                                                        )" << "\n";
+    std::cout << R"(| |_/ / __ _| |__   ___| |  |  Use beemo for managing packages                       )" << "\n";
+    std::cout << R"(| ___ \/ _` | '_ \ / _ \ |  |                                                        )" << "\n";
+    std::cout << R"(| |_/ / (_| | |_) |  __/ |  |  Version UNRELEASED (Mar 28, 2024)                     )" << "\n";
+    std::cout << R"(\____/ \__,_|_.__/ \___|_|  |  https://github.com/WehrWolff/babel                    )" << "\n\n";
+}
+
+// What one babel invocation was asked to do
+struct DriverOptions {
+    OptLevel optLevel = OptLevel::O0;
+    bool timePasses = false;
+    bool timeReport = false;
+    std::optional<std::filesystem::path> traceFile; // --trace=, Chrome trace events of the compile
+    bool runScript = false;
+    bool tiered = false;
+    unsigned jobs = 1;
+    std::optional<EmitKind> emitKind;
+    std::vector<std::filesystem::path> sources; // later files see the tasks and globals of earlier ones
+    std::optional<std::filesystem::path> output;
+    std::vector<std::string> scriptArgs;
+    std::optional<std::string> serverSocket;  // --server=, keep serving compiles
+    std::optional<std::string> connectSocket; // --connect=, compile on that server instead
+    std::optional<std::filesystem::path> cacheDirectory;
+    uint64_t cacheSize = TaskCache::defaultSizeLimit;
+};
+
+// Reports what is wrong with the arguments itself, they don't include the name of the program
+std::optional<DriverOptions> parseArguments(const std::vector<std::string>& args) {
+    DriverOptions options;
+
+    for (size_t i = 0; i < args.size(); ++i) {
+        std::string_view arg = args[i];
+
+        // everything after the script belongs to it
+        if (options.runScript && !options.sources.empty()) {
+            options.scriptArgs.emplace_back(arg);
+        } else if (std::optional<OptLevel> level = parseOptLevel(arg)) {
+            options.optLevel = level.value();
+        } else if (arg == "--time-passes") {
+            options.timePasses = true;
+        } else if (arg == "--time-report") {
+            options.timeReport = true;
+        } else if (arg.starts_with("--trace=")) {
+            options.traceFile = arg.substr(8);
+        } else if (arg == "--run") {
+            options.runScript = true;
+        } else if (arg == "--tiered") {
+            options.tiered = true;
+        } else if (arg.starts_with("--jobs=")) {
+            auto [end, error] = std::from_chars(arg.data() + 7, arg.data() + arg.size(), options.jobs);
+            if (error != std::errc() || end != arg.data() + arg.size() || options.jobs == 0) {
+                std::cerr << "Invalid job count '" << arg.substr(7) << "'\n";
+                return std::nullopt;
+            }
+        } else if (arg.starts_with("--cache=")) {
+            options.cacheDirectory = arg.substr(8);
+        } else if (arg.starts_with("--cache-size=")) {
+            uint64_t megabytes = 0;
+            auto [end, error] = std::from_chars(arg.data() + 13, arg.data() + arg.size(), megabytes);
+            if (error != std::errc() || end != arg.data() + arg.size()) {
+                std::cerr << "Invalid cache size '" << arg.substr(13) << "', expected megabytes\n";
+                return std::nullopt;
+            }
+            options.cacheSize = megabytes << 20;
+        } else if (arg.starts_with("--server=")) {
+            options.serverSocket = arg.substr(9);
+        } else if (arg.starts_with("--connect=")) {
+            options.connectSocket = arg.substr(10);
+        } else if (arg == "-c") {
+            options.emitKind = EmitKind::Object;
+        } else if (arg == "-S") {
+            options.emitKind = EmitKind::Assembly;
+        } else if (arg.starts_with("--emit=")) {
+            options.emitKind = parseEmitKind(arg.substr(7));
+            if (!options.emitKind.has_value()) {
+                std::cerr << "Unknown emit kind '" << arg.substr(7) << "', expected llvm-ir, llvm-bc, asm, obj or exe\n";
+                return std::nullopt;
+            }
+        } else if (arg == "-o") {
+            if (++i == args.size()) {
+                std::cerr << "Missing file name after '-o'\n";
+                return std::nullopt;
+            }
+            options.output = args[i];
+        } else if (arg.starts_with("-")) {
+            std::cerr << "Unknown option '" << arg << "'\n";
+            return std::nullopt;
+        } else {
+            options.sources.emplace_back(arg);
+            if (options.runScript) options.scriptArgs.emplace_back(arg);
+        }
+    }
+
+    if (options.serverSocket.has_value() && args.size() != 1) {
+        std::cerr << "--server takes no other options, they are passed along with each compile\n";
+        return std::nullopt;
+    }
+
+    if (options.sources.empty() && (options.runScript || options.emitKind.has_value() || options.output.has_value())) {
+        std::cerr << "No source file to compile\n";
+        return std::nullopt;
+    }
+
+    if (options.tiered && !options.runScript) {
+        std::cerr << "--tiered only applies to --run\n";
+        return std::nullopt;
+    }
+
+    if (options.cacheDirectory.has_value() && (options.runScript || options.sources.size() != 1)) {
+        std::cerr << "--cache only applies to compiling a single source file\n";
+        return std::nullopt;
+    }
+
+    // every file gets an output of its own, only an executable is linked from all of them
+    if (options.sources.size() > 1 && options.output.has_value() && options.emitKind != EmitKind::Executable) {
+        std::cerr << "-o with several source files only applies to --emit=exe\n";
+        return std::nullopt;
+    }
+
+    if (options.runScript && (options.emitKind.has_value() || options.output.has_value())) {
+        std::cerr << "--run executes the program in memory, it cannot be combined with -c, -S, -o or --emit\n";
+        return std::nullopt;
+    }
+
+    return options;
+}
+
+std::unique_ptr<llvm::TargetMachine> createTargetMachine(OptLevel level) {
+    PhaseTimer timer("Target setup");
+    return createHostTargetMachine(level);
+}
+
+// --time-report and --trace cover what runs until finishInstrumentation
+void startInstrumentation(const DriverOptions& options) {
+    if (options.timeReport) TimeReport::instance().enable();
+    if (options.traceFile.has_value()) llvm::timeTraceProfilerInitialize(0, "babel");
+}
+
+void finishInstrumentation(const DriverOptions& options) {
+    if (options.timeReport) TimeReport::instance().print(llvm::errs());
+    if (!options.traceFile.has_value()) return;
+
+    std::error_code EC;
+    llvm::raw_fd_ostream out(options.traceFile->string(), EC, llvm::sys::fs::OF_Text);
+    if (EC) {
+        llvm::errs() << "Error writing trace: " << EC.message() << "\n";
+    } else {
+        llvm::timeTraceProfilerWrite(out);
+    }
+    llvm::timeTraceProfilerCleanup();
+}
+
+// Several files make one program. Each is generated into a module of its own that declares what the files
+// before it defined, the last one holds main, which runs the top level code of all files in order. The
+// modules are linked with ThinLTO, so small tasks are still inlined across files.
+int compileProgram(const DriverOptions& options, const Lexer& lexer, const Parser& parser) {
+    std::unique_ptr<llvm::TargetMachine> machine = createTargetMachine(options.optLevel);
+    if (!machine) return 1;
+
+    CompilerContext Ctx("Babel Core");
+    std::vector<std::string> entries;
+    std::vector<ThinLTOUnit> units;
+
+    for (const std::filesystem::path& source : options.sources) {
+        Ctx.openModule(source.string());
+        prepareModule(*Ctx.Module, *machine);
+        redeclareEarlierDefinitions(Ctx);
+
+        std::optional<ParseTree> tree = parseSource(Ctx, lexer, parser, source, false);
+        if (!tree.has_value() || !tree->ast) return 1;
+
+        if (PhaseTimer timer("Codegen", source.string()); &source == &options.sources.back()) {
+            tree->ast->codegen(Ctx, entries);
+        } else {
+            entries.push_back(std::format("__global_main.{}", entries.size()));
+            tree->ast->codegenEntry(Ctx, entries.back());
+        }
+
+        if (llvm::verifyModule(*Ctx.Module, &llvm::errs())) {
+            llvm::errs() << "Not compiling invalid module " << source.string() << "\n";
+            return 1;
+        }
+
+        PhaseTimer timer("Optimize", source.string());
+        optimizeModule(*Ctx.Module, options.optLevel, machine.get(), options.timePasses, true);
+        units.push_back(writeThinLTOUnit(source, *Ctx.Module));
+    }
+
+    PhaseTimer timer("ThinLTO link");
+    EmitKind kind = options.emitKind.value_or(EmitKind::LLVMIR);
+    return linkThinLTO(units, options.optLevel, options.jobs, kind, options.output.value_or(defaultOutputPath(options.sources.back(), kind))) ? 0 : 1;
+}
+
+// Everything babel does once the arguments are understood, with the lexer and parser set up by the caller
+int runDriver(const DriverOptions& options, const Lexer& lexer, const Parser& parser) {
+    const OptLevel optLevel = options.optLevel;
+    const bool timePasses = options.timePasses;
+
+    if (options.sources.empty()) {
+        std::unique_ptr<BabelJIT> jit = BabelJIT::create(optLevel);
+        if (!jit) return 1;
+
+        printBanner();
+        CompilerContext Ctx("repl");
+
+        // each line is compiled into its own module and runs as soon as it was entered
+        for (unsigned line = 0;; ++line) {
             std::string text;
             std::cout << color::rize("babel> ", color::FORMAT_CODE::BOLD, color::FORMAT_CODE::MAGENTA);
-            getline(std::cin, text);
-            
-            if (text == "exit()") break;
-            run(lexer, parser, text);
+            if (!getline(std::cin, text) || text == "exit()") break;
+
+            Ctx.openModule(std::format("repl.{}", line));
+            jit->prepareModule(*Ctx.Module);
+            redeclareEarlierDefinitions(Ctx);
+
+            std::istringstream input(text);
+            std::optional<ParseTree> tree = parseText(Ctx, lexer, parser, input, false);
+            if (!tree.has_value() || !tree->ast) continue;
+
+            std::string entry = std::format("__global_main.{}", line);
+            {
+                PhaseTimer timer("Codegen");
+                tree->ast->codegenEntry(Ctx, entry);
+            }
+
+            if (PhaseTimer timer("JIT compile"); !jit->addModule(std::move(Ctx.Module), std::move(Ctx.Context), timePasses))
+                continue;
+            jit->run(entry);
         }
-    } else if (argc == 2)
-    {
-        std::filesystem::path source = std::filesystem::absolute(argv[1]);
 
-        unsigned long size = std::filesystem::file_size(source);
-        std::string content(size, '\0');
-        std::ifstream in(source);
-        in.read(&content[0], size);
+        return 0;
+    }
+
+    if (options.sources.size() > 1)
+        return compileProgram(options, lexer, parser);
 
-        Lexer lexer = setupModuleAndLexer(argv[1]);
-        const std::filesystem::path ROOT_DIR = std::filesystem::absolute(std::filesystem::path(argv[0])).parent_path();
-        Parser parser = loadParserData(ROOT_DIR);
+    const std::filesystem::path& source = options.sources.front();
+    CompilerContext Ctx("Babel Core");
 
-        run(lexer, parser, content);
+    if (options.runScript) {
+        // tiered scripts start at -O0, the -O level is what hot tasks are recompiled at
+        std::unique_ptr<BabelJIT> jit = BabelJIT::create(options.tiered ? OptLevel::O0 : optLevel);
+        if (!jit) return 1;
 
-        std::error_code EC;
-        llvm::raw_fd_ostream outFile(source.stem().string() + ".ll", EC);
+        jit->prepareModule(*Ctx.Module);
+        // without a main of its own, the lookup would find the one of babel
+        if (!run(Ctx, lexer, parser, source, false)) return 1;
 
-        if (EC) {
-            llvm::errs() << "Error opening file: " << EC.message() << "\n";
-        } else {
-            TheModule->print(outFile, nullptr);
+        if (options.tiered) {
+            TieredExecution tiers(*jit, optLevel == OptLevel::O0 ? OptLevel::O2 : optLevel, TieredExecution::defaultThreshold);
+            if (PhaseTimer timer("JIT compile"); !tiers.addModule(std::move(Ctx.Module), std::move(Ctx.Context))) return 1;
+            PhaseTimer timer("Run");
+            return jit->runMain(options.scriptArgs).value_or(1);
         }
+
+        if (PhaseTimer timer("JIT compile"); !jit->addModule(std::move(Ctx.Module), std::move(Ctx.Context), timePasses)) return 1;
+        PhaseTimer timer("Run");
+        return jit->runMain(options.scriptArgs).value_or(1);
+    }
+
+    // Before codegen, type sizes come from the target's data layout
+    std::unique_ptr<llvm::TargetMachine> machine = createTargetMachine(optLevel);
+    if (!machine) return 1;
+    prepareModule(*Ctx.Module, *machine);
+
+    if (options.cacheDirectory.has_value()) {
+        // tasks are optimized one by one, only the ones that changed since they were cached
+        TaskCache cache(options.cacheDirectory.value(), options.cacheSize);
+        std::optional<ParseTree> tree = parseSource(Ctx, lexer, parser, source, true);
+        if (!tree.has_value() || !tree->ast) return 1;
+        PhaseTimer timer("Codegen and optimize");
+        bool compiled = codegenParallel(Ctx, *tree->ast, options.jobs, optLevel, timePasses, &cache);
+        cache.trim();
+        cache.printStatistics(llvm::errs());
+        if (!compiled) return 1;
+    } else if (options.jobs > 1) {
+        // task bodies are generated and optimized on their own threads, then linked back into the module
+        std::optional<ParseTree> tree = parseSource(Ctx, lexer, parser, source, true);
+        if (!tree.has_value() || !tree->ast) return 1;
+        PhaseTimer timer("Codegen and optimize");
+        if (!codegenParallel(Ctx, *tree->ast, options.jobs, optLevel, timePasses)) return 1;
+    } else {
+        if (!run(Ctx, lexer, parser, source)) return 1;
+        PhaseTimer timer("Optimize");
+        optimizeModule(*Ctx.Module, optLevel, machine.get(), timePasses);
     }
 
+    EmitKind kind = options.emitKind.value_or(EmitKind::LLVMIR);
+    if (PhaseTimer timer("Emit"); !emitModule(*Ctx.Module, *machine, kind, options.output.value_or(defaultOutputPath(source, kind))))
+        return 1;
+
+    // only the textual IR is worth echoing, the other outputs are what builds consume
+    if (kind != EmitKind::LLVMIR)
+        return 0;
+
     llvm::outs() << "=== LLVM IR Dump ===\n";
-    TheModule->print(llvm::outs(), nullptr);
-    llvm::verifyModule(*TheModule, &llvm::errs());
+    Ctx.Module->print(llvm::outs(), nullptr);
+    llvm::verifyModule(*Ctx.Module, &llvm::errs());
     
     return 0;
 }
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+    std::optional<DriverOptions> options = parseArguments(args);
+    if (!options.has_value()) return 1;
+
+    if (options->connectSocket.has_value()) {
+        // the server parses the arguments again, just without the one that sent them there
+        std::erase_if(args, [](const std::string& arg) { return arg.starts_with("--connect="); });
+        return compileOnServer(options->connectSocket.value(), args).value_or(1);
+    }
+
+    startInstrumentation(options.value());
+    const std::filesystem::path ROOT_DIR = std::filesystem::absolute(std::filesystem::path(argv[0])).parent_path();
+    Parser parser = [&] {
+        PhaseTimer timer("Load parser");
+        return loadParserData(ROOT_DIR);
+    }();
+
+    if (options->serverSocket.has_value()) {
+        // set up once, every compile forked off the server finds the target registered and the tables built
+        if (!createHostTargetMachine(OptLevel::O0)) return 1;
+        Lexer lexer = setupModuleAndLexer("server");
+
+        return serveCompiles(options->serverSocket.value(), [&](const std::vector<std::string>& args) {
+            std::optional<DriverOptions> request = parseArguments(args);
+            if (!request.has_value()) return 1;
+            if (request->serverSocket.has_value() || request->connectSocket.has_value()) {
+                std::cerr << "Compiles on a server cannot start or use servers themselves\n";
+                return 1;
+            }
+            startInstrumentation(request.value());
+            int status = runDriver(request.value(), lexer, parser);
+            finishInstrumentation(request.value());
+            return status;
+        });
+    }
+
+    Lexer lexer = setupModuleAndLexer(options->sources.empty() ? "repl" : options->sources.front().string());
+    int status = runDriver(options.value(), lexer, parser);
+    finishInstrumentation(options.value());
+    return status;
+}
@@ -0,0 +1,65 @@
+#include "lrparser.h"
+#include "parse_table.h"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// Build time generator for the parse table, so babel doesn't have to construct it on every launch.
+// Usage: babel_tablegen <grammar.txt> <parser.dat> [parse_tables.inc]
+// The optional third output is a C++ header with the same table as constexpr arrays, see embeddedParseTable()
+int main(int argc, char* argv[]) {
+    if (argc != 3 && argc != 4) {
+        std::cerr << "Usage: " << argv[0] << " <grammar.txt> <parser.dat> [parse_tables.inc]" << std::endl;
+        return 1;
+    }
+
+    std::ifstream in(argv[1]);
+    if (!in.is_open()) {
+        std::cerr << "Error opening grammar file " << argv[1] << std::endl;
+        return 1;
+    }
+
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+
+    Grammar grammar(transform_string(buffer.str()));
+    LRClosureTable closureTable(grammar);
+    LRTable lrTable(closureTable);
+    ParseTable table = ParseTable::lower(lrTable);
+
+    uint64_t grammarHash = hashGrammar(buffer.str());
+
+    std::filesystem::path output(argv[2]);
+    if (output.has_parent_path())
+        std::filesystem::create_directories(output.parent_path());
+
+    std::ofstream out(output, std::ios::binary);
+    if (!out.is_open()) {
+        std::cerr << "Error opening output file " << argv[2] << std::endl;
+        return 1;
+    }
+
+    writeParseTable(out, table, grammarHash);
+    if (!out.good())
+        return 1;
+
+    if (argc == 4) {
+        std::filesystem::path sourceOutput(argv[3]);
+        if (sourceOutput.has_parent_path())
+            std::filesystem::create_directories(sourceOutput.parent_path());
+
+        std::ofstream source(sourceOutput);
+        if (!source.is_open()) {
+            std::cerr << "Error opening output file " << argv[3] << std::endl;
+            return 1;
+        }
+
+        writeParseTableSource(source, table, grammarHash);
+        if (!source.good())
+            return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,123 @@
+#ifndef TASK_CACHE_H
+#define TASK_CACHE_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/SHA1.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "optimizer.h"
+
+// Optimized bitcode of single tasks on disk, one file per key. A key covers the unoptimized IR of the task
+// together with the declarations it uses, so it changes with the source of the task and with the signature
+// of anything it refers to, but not with edits elsewhere in the file. Hits refresh the modification time
+// of their file and trim drops the least recently used files once the cache outgrows its limit.
+class TaskCache {
+public:
+    static constexpr uint64_t defaultSizeLimit = 256ull << 20;
+
+    TaskCache(std::filesystem::path directory, uint64_t sizeLimit = defaultSizeLimit) : directory(std::move(directory)), sizeLimit(sizeLimit) {
+        std::error_code error;
+        std::filesystem::create_directories(this->directory, error);
+    }
+
+    // Everything besides the module that the optimized code depends on goes into the key as well
+    static std::string key(const llvm::Module& module, OptLevel level) {
+        std::string text;
+        llvm::raw_string_ostream out(text);
+        out << "babel-task-cache-1 " << LLVM_VERSION_STRING << " " << static_cast<int>(level) << " " << module.getTargetTriple() << " " << module.getDataLayoutStr() << "\n";
+        module.print(out, nullptr);
+        out.flush();
+
+        return llvm::toHex(llvm::SHA1::hash(llvm::arrayRefFromStringRef(text)), true);
+    }
+
+    std::optional<llvm::SmallVector<char, 0>> lookup(const std::string& key) {
+        std::filesystem::path path = directory / key;
+        std::error_code error;
+        uint64_t size = std::filesystem::file_size(path, error);
+        std::ifstream in(path, std::ios::binary);
+        llvm::SmallVector<char, 0> bitcode(error ? 0 : size);
+        if (error || !in.read(bitcode.data(), size)) {
+            misses++;
+            return std::nullopt;
+        }
+
+        hits++;
+        std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+        return bitcode;
+    }
+
+    // Written under a unique name and renamed, so concurrent compiles never read half a file
+    void store(const std::string& key, const llvm::SmallVector<char, 0>& bitcode) {
+        int fd;
+        llvm::SmallString<128> temporary;
+        if (llvm::sys::fs::createUniqueFile((directory / (key + ".%%%%%%.tmp")).string(), fd, temporary))
+            return;
+
+        {
+            llvm::raw_fd_ostream out(fd, true);
+            out.write(bitcode.data(), bitcode.size());
+        }
+
+        if (llvm::sys::fs::rename(temporary, (directory / key).string()))
+            llvm::sys::fs::remove(temporary);
+    }
+
+    // Removes the least recently used files until the cache fits its limit again
+    void trim() {
+        struct Entry {
+            std::filesystem::path path;
+            std::filesystem::file_time_type used;
+            uint64_t size;
+        };
+
+        std::vector<Entry> entries;
+        uint64_t total = 0;
+        std::error_code error;
+        for (const auto& file : std::filesystem::directory_iterator(directory, error)) {
+            if (!file.is_regular_file(error)) continue;
+            entries.push_back({file.path(), file.last_write_time(error), file.file_size(error)});
+            total += entries.back().size;
+        }
+
+        std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.used < b.used; });
+        for (const Entry& entry : entries) {
+            if (total <= sizeLimit) break;
+            if (std::filesystem::remove(entry.path, error)) {
+                total -= entry.size;
+                evicted++;
+            }
+        }
+    }
+
+    void printStatistics(llvm::raw_ostream& out) const {
+        out << "Task cache: " << hits.load() << " hits, " << misses.load() << " misses, " << evicted.load() << " evicted\n";
+    }
+
+    size_t hitCount() const { return hits.load(); }
+    size_t missCount() const { return misses.load(); }
+
+private:
+    std::filesystem::path directory;
+    uint64_t sizeLimit;
+    std::atomic<size_t> hits = 0;
+    std::atomic<size_t> misses = 0;
+    std::atomic<size_t> evicted = 0;
+};
+
+#endif /* TASK_CACHE_H */
@@ -0,0 +1,159 @@
+#ifndef THIN_LTO_H
+#define THIN_LTO_H
+
+#include <filesystem>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/ModuleSummaryAnalysis.h"
+#include "llvm/Analysis/ProfileSummaryInfo.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/Module.h"
+#include "llvm/LTO/Config.h"
+#include "llvm/LTO/LTO.h"
+#include "llvm/Support/Caching.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/TargetParser/Host.h"
+
+#include "emitter.h"
+#include "optimizer.h"
+
+// One source file of a program compiled from several, lowered to bitcode with a ThinLTO summary
+struct ThinLTOUnit {
+    std::filesystem::path source;
+    llvm::SmallVector<char, 0> bitcode;
+};
+
+// The summary lets the link import what it inlines from other units without loading them whole
+ThinLTOUnit writeThinLTOUnit(const std::filesystem::path& source, llvm::Module& module) {
+    ThinLTOUnit unit{source, {}};
+    llvm::ProfileSummaryInfo profile(module);
+    llvm::ModuleSummaryIndex index = llvm::buildModuleSummaryIndex(module, nullptr, &profile);
+    llvm::raw_svector_ostream out(unit.bitcode);
+    llvm::WriteBitcodeToFile(module, out, false, &index);
+    return unit;
+}
+
+unsigned toLTOLevel(OptLevel level) {
+    switch (level) {
+        case OptLevel::O0: return 0;
+        case OptLevel::O1: return 1;
+        case OptLevel::O2: case OptLevel::Os: return 2;
+        case OptLevel::O3: return 3;
+    }
+
+    babel_unreachable();
+}
+
+// Links the units with ThinLTO: every unit is optimized and compiled on its own backend thread, after
+// importing the small tasks of other units it calls. Each unit is written to the output of its source
+// like a single file compile would, executables link all of them into output.
+bool linkThinLTO(const std::vector<ThinLTOUnit>& units, OptLevel level, unsigned jobs, EmitKind kind, const std::filesystem::path& output) {
+    // the backends number the units after the partitions of the regular LTO module, which stays empty
+    size_t firstUnitTask = 0;
+    std::vector<std::filesystem::path> outputs(units.size());
+    for (size_t i = 0; i < units.size(); i++) {
+        outputs[i] = kind == EmitKind::Executable ? std::filesystem::path() : defaultOutputPath(units[i].source, kind);
+    }
+
+    if (kind == EmitKind::Executable) {
+        for (std::filesystem::path& object : outputs) {
+            llvm::SmallString<128> path;
+            if (std::error_code EC = llvm::sys::fs::createTemporaryFile("babel", "o", path)) {
+                llvm::errs() << "Error creating object file: " << EC.message() << "\n";
+                return false;
+            }
+            object = path.str().str();
+        }
+    }
+
+    llvm::lto::Config config;
+    config.CPU = "generic";
+    config.RelocModel = llvm::Reloc::PIC_;
+    config.OptLevel = toLTOLevel(level);
+    config.CGOptLevel = toCodeGenLevel(level);
+    config.CGFileType = kind == EmitKind::Assembly ? llvm::CodeGenFileType::AssemblyFile : llvm::CodeGenFileType::ObjectFile;
+    config.DefaultTriple = llvm::sys::getDefaultTargetTriple();
+
+    // IR and bitcode are what the backends have optimized, written instead of running the code generator
+    if (kind == EmitKind::LLVMIR || kind == EmitKind::LLVMBitcode) {
+        config.PreCodeGenModuleHook = [&](unsigned task, const llvm::Module& module) {
+            std::error_code EC;
+            llvm::raw_fd_ostream out(outputs[task - firstUnitTask].string(), EC, kind == EmitKind::LLVMIR ? llvm::sys::fs::OF_Text : llvm::sys::fs::OF_None);
+            if (EC) {
+                llvm::errs() << "Error opening file: " << EC.message() << "\n";
+            } else if (kind == EmitKind::LLVMIR) {
+                module.print(out, nullptr);
+            } else {
+                llvm::WriteBitcodeToFile(module, out);
+            }
+            return false;
+        };
+    }
+
+    llvm::lto::LTO lto(std::move(config), llvm::lto::createInProcessThinBackend(llvm::heavyweight_hardware_concurrency(jobs)));
+
+    // the inputs only refer to the module names, they have to outlive the link
+    std::vector<std::string> names;
+    for (const ThinLTOUnit& unit : units) {
+        names.push_back(unit.source.string());
+    }
+
+    std::set<std::string> defined;
+    for (size_t i = 0; i < units.size(); i++) {
+        const ThinLTOUnit& unit = units[i];
+        auto input = llvm::lto::InputFile::create(llvm::MemoryBufferRef(llvm::StringRef(unit.bitcode.data(), unit.bitcode.size()), names[i]));
+        if (!input) {
+            llvm::errs() << "Error reading " << unit.source.string() << ": " << llvm::toString(input.takeError()) << "\n";
+            return false;
+        }
+
+        // the first definition wins. Executables only need main, everything else may be internalized.
+        std::vector<llvm::lto::SymbolResolution> resolutions;
+        for (const llvm::lto::InputFile::Symbol& symbol : (*input)->symbols()) {
+            llvm::lto::SymbolResolution resolution;
+            resolution.Prevailing = !symbol.isUndefined() && defined.insert(symbol.getName().str()).second;
+            resolution.VisibleToRegularObj = kind != EmitKind::Executable || symbol.getName() == "main";
+            resolution.FinalDefinitionInLinkageUnit = kind == EmitKind::Executable && resolution.Prevailing;
+            resolutions.push_back(resolution);
+        }
+
+        if (llvm::Error error = lto.add(std::move(*input), resolutions)) {
+            llvm::errs() << "Error adding " << unit.source.string() << ": " << llvm::toString(std::move(error)) << "\n";
+            return false;
+        }
+    }
+
+    firstUnitTask = lto.getMaxTasks() - units.size();
+
+    auto addStream = [&](unsigned task, const llvm::Twine&) -> llvm::Expected<std::unique_ptr<llvm::CachedFileStream>> {
+        if (task < firstUnitTask) return llvm::createStringError(llvm::inconvertibleErrorCode(), "unexpected regular LTO partition");
+
+        std::error_code EC;
+        auto out = std::make_unique<llvm::raw_fd_ostream>(outputs[task - firstUnitTask].string(), EC, kind == EmitKind::Assembly ? llvm::sys::fs::OF_Text : llvm::sys::fs::OF_None);
+        if (EC) return llvm::errorCodeToError(EC);
+        return std::make_unique<llvm::CachedFileStream>(std::move(out));
+    };
+
+    llvm::Error error = lto.run(addStream);
+    bool linked = !error;
+    if (error) llvm::errs() << "ThinLTO failed: " << llvm::toString(std::move(error)) << "\n";
+
+    if (kind == EmitKind::Executable) {
+        linked = linked && linkExecutable(outputs, output);
+        for (const std::filesystem::path& object : outputs) {
+            llvm::sys::fs::remove(object.string());
+        }
+    }
+
+    return linked;
+}
+
+#endif /* THIN_LTO_H */
@@ -0,0 +1,239 @@
+#ifndef TIERING_H
+#define TIERING_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
+#include "llvm/ExecutionEngine/Orc/Core.h"
+#include "llvm/ExecutionEngine/Orc/IndirectionUtils.h"
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "jit.h"
+#include "optimizer.h"
+
+// Tiered execution on top of a BabelJIT that compiles at -O0. Tasks are called through ORC indirect stubs
+// and first point at their unoptimized code, which counts its calls. The call that reaches the threshold
+// queues the task for a background thread, which optimizes and compiles it on its own and then swaps the
+// stub over to the new code. Everything else keeps running the whole time.
+class TieredExecution {
+public:
+    // calls before a task counts as hot
+    static constexpr uint64_t defaultThreshold = 1000;
+
+    TieredExecution(BabelJIT& jit, OptLevel hotLevel, uint64_t threshold)
+        : jit(jit), hotLevel(hotLevel), threshold(std::max<uint64_t>(threshold, 1)),
+          stubs(llvm::orc::createLocalIndirectStubsManagerBuilder(jit.getLLJIT().getTargetTriple())()),
+          worker([this] { work(); }) {}
+
+    ~TieredExecution() {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        wakeup.notify_all();
+        worker.join();
+    }
+
+    TieredExecution(const TieredExecution&) = delete;
+    TieredExecution& operator=(const TieredExecution&) = delete;
+
+    bool addModule(std::unique_ptr<llvm::Module> module, std::unique_ptr<llvm::LLVMContext> context) {
+        if (llvm::verifyModule(*module, &llvm::errs())) {
+            llvm::errs() << "Not running invalid module\n";
+            return false;
+        }
+
+        // the hot tier is recompiled from the module as it was generated, not from the instrumented one
+        llvm::raw_svector_ostream out(bitcode);
+        llvm::WriteBitcodeToFile(*module, out);
+
+        std::vector<llvm::Function*> definitions;
+        for (llvm::Function& function : *module) {
+            if (!function.isDeclaration() && !function.hasLocalLinkage() && function.getName() != "main")
+                definitions.push_back(&function);
+        }
+
+        llvm::orc::LLJIT& lljit = jit.getLLJIT();
+        llvm::orc::SymbolMap symbols;
+        symbols[lljit.mangleAndIntern("babel.tier_up")] = llvm::orc::ExecutorSymbolDef(llvm::orc::ExecutorAddr::fromPtr(&TieredExecution::tierUp), llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable);
+
+        for (llvm::Function* function : definitions) {
+            std::string name = function->getName().str();
+            instrument(*function, static_cast<uint32_t>(tasks.size()));
+            tasks.push_back(name);
+
+            if (llvm::Error error = stubs->createStub(name, llvm::orc::ExecutorAddr(), llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable))
+                return fail(std::move(error));
+            symbols[lljit.mangleAndIntern(name)] = llvm::orc::ExecutorSymbolDef(stubs->findStub(name, false).getAddress(), llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable);
+        }
+
+        if (llvm::Error error = lljit.getMainJITDylib().define(llvm::orc::absoluteSymbols(std::move(symbols))))
+            return fail(std::move(error));
+        if (!jit.addModule(std::move(module), std::move(context)))
+            return false;
+
+        for (const std::string& name : tasks) {
+            if (!point(name, name + ".tier0")) return false;
+        }
+
+        return true;
+    }
+
+    // Blocks until every task queued so far was recompiled
+    void drain() {
+        std::unique_lock lock(mutex);
+        idle.wait(lock, [this] { return queue.empty() && !busy; });
+    }
+
+    size_t optimizedTasks() const {
+        return optimized.load();
+    }
+
+private:
+    BabelJIT& jit;
+    OptLevel hotLevel;
+    uint64_t threshold;
+    std::unique_ptr<llvm::orc::IndirectStubsManager> stubs;
+    llvm::SmallVector<char, 0> bitcode;
+    std::vector<std::string> tasks; // stub names by the id the instrumentation passes to tierUp
+    std::atomic<size_t> optimized = 0;
+
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::condition_variable idle;
+    std::deque<uint32_t> queue;
+    bool busy = false;
+    bool stopping = false;
+    std::thread worker; // last, it starts running in the constructor
+
+    // Called from the unoptimized code, exactly once per task
+    static void tierUp(TieredExecution* self, uint32_t task) {
+        {
+            std::lock_guard lock(self->mutex);
+            self->queue.push_back(task);
+        }
+        self->wakeup.notify_one();
+    }
+
+    // The definition moves to <name>.tier0 and everything that called it calls the stub instead. Its entry
+    // block bumps a counter before running the original body.
+    void instrument(llvm::Function& function, uint32_t id) {
+        llvm::Module& module = *function.getParent();
+        llvm::LLVMContext& context = module.getContext();
+        llvm::IRBuilder<> builder(context);
+
+        std::string name = function.getName().str();
+        function.setName(name + ".tier0");
+        function.replaceAllUsesWith(llvm::Function::Create(function.getFunctionType(), llvm::Function::ExternalLinkage, name, module));
+
+        llvm::Type* int64 = builder.getInt64Ty();
+        auto* counter = new llvm::GlobalVariable(module, int64, false, llvm::GlobalValue::InternalLinkage, builder.getInt64(0), name + ".calls");
+
+        llvm::PointerType* pointer = llvm::PointerType::getUnqual(builder.getInt8Ty());
+        llvm::FunctionCallee callback = module.getOrInsertFunction("babel.tier_up", builder.getVoidTy(), pointer, builder.getInt32Ty());
+
+        llvm::BasicBlock& entry = function.getEntryBlock();
+        auto allocas = std::find_if_not(entry.begin(), entry.end(), [](const llvm::Instruction& instruction) { return llvm::isa<llvm::AllocaInst>(instruction); });
+        llvm::BasicBlock* body = entry.splitBasicBlock(allocas, "body");
+        entry.getTerminator()->eraseFromParent();
+
+        builder.SetInsertPoint(&entry);
+        llvm::Value* calls = builder.CreateAtomicRMW(llvm::AtomicRMWInst::Add, counter, builder.getInt64(1), llvm::MaybeAlign(8), llvm::AtomicOrdering::Monotonic);
+        llvm::Value* hot = builder.CreateICmpEQ(calls, builder.getInt64(threshold - 1));
+        llvm::BasicBlock* tierUp = llvm::BasicBlock::Create(context, "tier.up", &function, body);
+        builder.CreateCondBr(hot, tierUp, body, llvm::MDBuilder(context).createBranchWeights(1, 1 << 20));
+
+        builder.SetInsertPoint(tierUp);
+        llvm::Constant* self = llvm::ConstantExpr::getIntToPtr(builder.getInt64(reinterpret_cast<uintptr_t>(this)), pointer);
+        builder.CreateCall(callback, {self, builder.getInt32(id)});
+        builder.CreateBr(body);
+    }
+
+    void work() {
+        std::unique_lock lock(mutex);
+        while (true) {
+            wakeup.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (stopping) return;
+
+            uint32_t task = queue.front();
+            queue.pop_front();
+            busy = true;
+            lock.unlock();
+
+            if (recompile(tasks[task])) optimized++;
+
+            lock.lock();
+            busy = false;
+            if (queue.empty()) idle.notify_all();
+        }
+    }
+
+    // Only the task keeps its body, as <name>.tier2. It refers to the other tasks through their stubs and
+    // to globals through the definitions of the unoptimized module. Local helpers come along as copies.
+    bool recompile(const std::string& name) {
+        auto context = std::make_unique<llvm::LLVMContext>();
+        auto parsed = llvm::parseBitcodeFile(llvm::MemoryBufferRef(llvm::StringRef(bitcode.data(), bitcode.size()), "tier0"), *context);
+        if (!parsed) return fail(parsed.takeError());
+        std::unique_ptr<llvm::Module> module = std::move(*parsed);
+
+        for (llvm::Function& function : *module) {
+            if (!function.isDeclaration() && !function.hasLocalLinkage() && function.getName() != name)
+                function.deleteBody();
+        }
+
+        for (llvm::GlobalVariable& global : module->globals()) {
+            if (!global.isDeclaration() && !global.hasLocalLinkage())
+                global.setInitializer(nullptr);
+        }
+
+        module->getFunction(name)->setName(name + ".tier2");
+
+        auto machineBuilder = llvm::orc::JITTargetMachineBuilder::detectHost();
+        if (!machineBuilder) return fail(machineBuilder.takeError());
+        machineBuilder->setCodeGenOptLevel(toCodeGenLevel(hotLevel));
+        auto machine = machineBuilder->createTargetMachine();
+        if (!machine) return fail(machine.takeError());
+
+        optimizeModule(*module, hotLevel, machine->get());
+        auto object = llvm::orc::SimpleCompiler(**machine)(*module);
+        if (!object) return fail(object.takeError());
+
+        if (llvm::Error error = jit.getLLJIT().addObjectFile(std::move(*object)))
+            return fail(std::move(error));
+        return point(name, name + ".tier2");
+    }
+
+    bool point(const std::string& stub, const std::string& target) {
+        auto address = jit.getLLJIT().lookup(target);
+        if (!address) return fail(address.takeError());
+
+        if (llvm::Error error = stubs->updatePointer(stub, *address))
+            return fail(std::move(error));
+        return true;
+    }
+
+    static bool fail(llvm::Error error) {
+        llvm::errs() << "JIT error: " << llvm::toString(std::move(error)) << "\n";
+        return false;
+    }
+};
+
+#endif /* TIERING_H */
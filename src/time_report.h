@@ -0,0 +1,240 @@
+#ifndef TIME_REPORT_H
+#define TIME_REPORT_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#include "llvm/Support/Format.h"
+#include "llvm/Support/TimeProfiler.h"
+#include "llvm/Support/raw_ostream.h"
+
+// Where a compile spends its time, for --time-report. Phases nest like the scopes that time them and
+// phases of the same name below the same parent are merged, so a phase run per file or per line adds up.
+// Every phase records wall time, the CPU time of the thread that timed it, the peak resident set size when
+// it ended and how many heap allocations it made. Each thread nests its own phases, one that isn't inside a
+// phase of its thread starts at the top, so work running on several threads at once is merged, not mixed.
+class TimeReport {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // counted by the replacement operator new of the driver while the report is on, stays 0 in programs
+    // without one. Apart from instance(), so counting doesn't depend on the report being constructed.
+    static inline std::atomic<uint64_t> allocations = 0;
+    static inline std::atomic<bool> countAllocations = false;
+
+    static TimeReport& instance() {
+        static TimeReport report;
+        return report;
+    }
+
+    static bool enabled() {
+        return instance().on;
+    }
+
+    void enable() {
+        on = true;
+        countAllocations = true;
+    }
+
+    void print(llvm::raw_ostream& os) const {
+        os << "===== Compile time report =====\n";
+        os << "          Wall    Thread CPU    Peak RSS      Allocs  Phase\n";
+        std::lock_guard lock(mutex);
+        for (const std::unique_ptr<Phase>& phase : root.children) print(os, *phase, 0);
+    }
+
+private:
+    friend class PhaseTimer;
+    friend class PhaseAccumulator;
+
+    struct Phase {
+        std::string name;
+        Clock::duration wall{};
+        double cpuSeconds = 0;
+        uint64_t allocations = 0;
+        uint64_t peakRSS = 0; // bytes
+        size_t count = 0;
+        bool accumulated = false; // only wall time and count were taken
+        std::vector<std::unique_ptr<Phase>> children;
+    };
+
+    bool on = false;
+    Phase root;
+    mutable std::mutex mutex; // guards the phases, their children and their numbers
+
+    TimeReport() = default;
+
+    // the phases the calling thread is in, innermost last
+    std::vector<Phase*>& running() {
+        thread_local std::vector<Phase*> phases{&root};
+        return phases;
+    }
+
+    Phase& enter(std::string_view name) {
+        std::vector<Phase*>& phases = running();
+        std::lock_guard lock(mutex);
+
+        Phase& parent = *phases.back();
+        for (std::unique_ptr<Phase>& child : parent.children) {
+            if (child->name == name) {
+                phases.push_back(child.get());
+                return *child;
+            }
+        }
+
+        parent.children.push_back(std::make_unique<Phase>());
+        parent.children.back()->name = name;
+        phases.push_back(parent.children.back().get());
+        return *phases.back();
+    }
+
+    void leave() {
+        std::vector<Phase*>& phases = running();
+        if (phases.size() > 1) phases.pop_back();
+    }
+
+    // CPU time of the calling thread, so workers of --jobs don't count towards the phase that waits for them
+    static double threadCpuSeconds() {
+#ifdef _WIN32
+        return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+#else
+        timespec time{};
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+        return static_cast<double>(time.tv_sec) + time.tv_nsec / 1e9;
+#endif
+    }
+
+    static uint64_t peakResidentSetSize() {
+#ifdef _WIN32
+        return 0;
+#else
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+        return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+        return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+    }
+
+    static void print(llvm::raw_ostream& os, const Phase& phase, unsigned depth) {
+        std::string label = std::string(2 * depth, ' ') + phase.name;
+        if (phase.count > 1) label += " (" + std::to_string(phase.count) + "x)";
+
+        double wall = std::chrono::duration<double, std::milli>(phase.wall).count();
+        if (phase.accumulated) {
+            os << llvm::format("  %9.3f ms             -           -           -  %s\n", wall, label.c_str());
+        } else {
+            os << llvm::format("  %9.3f ms  %9.3f ms  %7.1f MB  %10llu  %s\n", wall, phase.cpuSeconds * 1000, phase.peakRSS / 1048576.0,
+                               static_cast<unsigned long long>(phase.allocations), label.c_str());
+        }
+
+        for (const std::unique_ptr<Phase>& child : phase.children) print(os, *child, depth + 1);
+    }
+};
+
+// Times the scope it lives in as a phase of the report, and as an event of the --trace if that is on
+class PhaseTimer {
+public:
+    PhaseTimer(std::string_view name, std::string_view detail = {}) : trace(llvm::StringRef(name.data(), name.size()), llvm::StringRef(detail.data(), detail.size())) {
+        if (!TimeReport::enabled()) return;
+
+        phase = &TimeReport::instance().enter(name);
+        allocations = TimeReport::allocations.load(std::memory_order_relaxed);
+        cpu = TimeReport::threadCpuSeconds();
+        wall = TimeReport::Clock::now();
+    }
+
+    ~PhaseTimer() {
+        if (!phase) return;
+
+        TimeReport::Clock::duration elapsed = TimeReport::Clock::now() - wall;
+        double cpuSeconds = TimeReport::threadCpuSeconds() - cpu;
+        uint64_t allocated = TimeReport::allocations.load(std::memory_order_relaxed) - allocations;
+        uint64_t peakRSS = TimeReport::peakResidentSetSize();
+
+        TimeReport& report = TimeReport::instance();
+        {
+            std::lock_guard lock(report.mutex);
+            phase->wall += elapsed;
+            phase->cpuSeconds += cpuSeconds;
+            phase->allocations += allocated;
+            phase->peakRSS = std::max(phase->peakRSS, peakRSS);
+            phase->count++;
+        }
+        report.leave();
+    }
+
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+private:
+    llvm::TimeTraceScope trace;
+    TimeReport::Phase* phase = nullptr;
+    uint64_t allocations = 0;
+    double cpu = 0;
+    TimeReport::Clock::time_point wall;
+};
+
+// A phase that runs in many short pieces interleaved with its parent, like lexing while parsing. Only wall
+// time is taken per piece, and the total goes into the phase that is running when the accumulator goes away.
+class PhaseAccumulator {
+public:
+    explicit PhaseAccumulator(std::string_view name) : name(name), on(TimeReport::enabled()) {}
+
+    ~PhaseAccumulator() {
+        if (!on || pieces == 0) return;
+
+        TimeReport& report = TimeReport::instance();
+        TimeReport::Phase& phase = report.enter(name);
+        {
+            std::lock_guard lock(report.mutex);
+            phase.accumulated = true;
+            phase.wall += total;
+            phase.count++;
+        }
+        report.leave();
+    }
+
+    PhaseAccumulator(const PhaseAccumulator&) = delete;
+    PhaseAccumulator& operator=(const PhaseAccumulator&) = delete;
+
+    // Times the scope it lives in as one piece
+    class Piece {
+    public:
+        explicit Piece(PhaseAccumulator& accumulator) : accumulator(accumulator.on ? &accumulator : nullptr) {
+            if (this->accumulator) start = TimeReport::Clock::now();
+        }
+
+        ~Piece() {
+            if (!accumulator) return;
+            accumulator->total += TimeReport::Clock::now() - start;
+            accumulator->pieces++;
+        }
+
+    private:
+        PhaseAccumulator* accumulator;
+        TimeReport::Clock::time_point start;
+    };
+
+private:
+    std::string_view name;
+    bool on;
+    TimeReport::Clock::duration total{};
+    size_t pieces = 0;
+};
+
+#endif /* TIME_REPORT_H */
@@ -0,0 +1,119 @@
+#ifndef TOKEN_SPECS_H
+#define TOKEN_SPECS_H
+
+#include <list>
+#include <string>
+#include <utility>
+
+// Token kinds and their patterns, earlier entries take priority over later ones
+std::list<std::pair<std::string, std::string>> babelTokenSpecs() {
+    return {
+        {"TYPE", "\\b(?:int|int8|int16|int32|int64|int128|float|float16|float32|float64|float128|bool|string|cstr|char|list|tuple|map|dict|any|void)\\b"},
+        {"CLASS", "\\bclass\\b"},
+        {"EXTERN", "\\bextern\\b"},
+        {"TASK", "\\btask\\b"},
+        {"STRUCT", "\\bstruct\\b"},
+        {"COMMENT", R"(\\\\.*)"},
+        {"LET", "\\blet\\b"},
+        {"CONST", "\\bconst\\b"},
+        {"CSTRING", R"~(c"(\\.|[^"\\])*")~"},
+        {"STRING", R"~("(\\.|[^"\\])*")~"},
+        {"CHAR", "'[^']{1}'"},
+        {"BOOL", "(TRUE|FALSE)"},
+        {"AT", "@"},
+        {"LPAREN", "\\("},
+        {"LSQUARE", "\\["},
+        {"RSQUARE", "\\]"},
+        {"LBRACE", "\\{"},
+        {"RBRACE", "\\}"},
+        {"RPAREN", "\\)"},
+        {"IF", "\\bif\\b"},
+        {"ELSE", "\\belse\\b"},
+        {"ELIF", "\\belif\\b"},
+        {"THEN", "\\bthen\\b"},
+        {"MATCH", "\\bmatch\\b"},
+        {"CASE", "\\bcase\\b"},
+        {"OTHERWISE", "\\botherwise\\b"},
+        {"END", "\\bend\\b"},
+        {"DO", "\\bdo\\b"},
+        {"WHILE", "\\bwhile\\b"},
+        {"FOR", "\\bfor\\b"},
+        {"IN", "\\bin\\b"},
+        {"TO", "\\bto\\b"},
+        {"STEP", "\\bstep\\b"},
+        {"TRY", "\\btry\\b"},
+        {"CATCH", "\\bcatch\\b"},
+        {"FINALLY", "\\bfinally\\b"},
+        {"NOOP", "\\bnoop\\b"},
+        {"CONTINUE", "\\bcontinue\\b"},
+        {"BREAK", "\\bbreak\\b"},
+        {"GOTO", "\\bgoto\\b"},
+        {"LABEL_START", "\\$"},
+        {"LOOP_LABEL_START", "'"},
+        {"RETURN", "\\breturn\\b"},
+        {"RAISE", "\\braise\\b"},
+        {"IMPORT", "\\bimp\\b"},
+        {"VARARG", "\\.\\.\\."},
+        {"COLON_EQUALS", ":="},
+        {"EQEQ", "=="},
+        {"PLUS_EQUALS", "\\+="},
+        {"MINUS_EQUALS", "-="},
+        {"MULTIPLY_EQUALS", "\\*="},
+        {"DIVIDE_EQUALS", "/="},
+        {"POWER_EQUALS", "\\*\\*="},
+        {"MODULO_EQUALS", "%="},
+        {"INTEGER_DIVIDE_EQUALS", "//="},
+        {"LSHIFT_EQUALS", "<<="},
+        {"RSHIFT_EQUALS", ">>="},
+        {"BIT_OR_EQUALS", "\\|="},
+        {"BIT_AND_EQUALS", "&="},
+        {"BIT_XOR_EQUALS", "\\^="},
+        {"NEGLIGIBLY_LOW", "<<<"},
+        {"LSHIFT", "<<"},
+        {"RSHIFT", ">>"},
+        {"LTEQ", "<="},
+        {"GTEQ", ">="},
+        {"NOTEQ", "!="},
+        {"RARR","=>"},
+        {"INTEGER_DIVIDE", "//"},
+        {"INCREMENT", "\\+\\+"},
+        {"DECREMENT", "--"},
+        {"PLUS", "\\+"},
+        {"MINUS", "-"},
+        {"POWER", "\\*\\*"},
+        {"MULTIPLY", "\\*"},
+        {"DIVIDE", "/"},
+        {"MODULO", "%"},
+        {"EQUALS", "="},
+        {"OR", "\\|\\|"},
+        {"XOR", "\\^\\^"},
+        {"AND", "&&"},
+        {"BIT_NOT", "~"},
+        {"BIT_OR", "\\|"},
+        {"BIT_XOR", "\\^"},
+        {"BIT_AND", "&"},
+        {"NOT", "!"},
+        {"LT", "<"},
+        {"GT", ">"},
+        {"COMMA", ","},
+        {"COLON", ":"},
+        {"SEMICOLON", ";"},
+        {"NEWLINE", "\n"},
+        {"NULL", "null"},
+        {"NEW", "new"},
+        {"FLOATING_POINT", "\\b(?:NaN|Inf)(?:_[HhFfDdQq])?\\b"},
+        {"VAR", "[a-zA-Z_][a-zA-Z0-9_]*"},
+        {"FLOATING_POINT", "\\b[0-9](?:[0-9']*[0-9])?[eE][+-]?[0-9](?:[0-9']*[0-9])?(?:_?[HhFfDdQq])?\\b"}, // leave these before integer, so the first part is not matched as one
+        {"FLOATING_POINT", "\\b[0-9](?:[0-9']*[0-9])?\\.[0-9](?:[0-9']*[0-9])?(?:[eE][+-]?[0-9](?:[0-9']*[0-9])?)?(?:_?[HhFfDdQq])?\\b"},
+        {"FLOATING_POINT", "\\b0x[0-9A-Fa-f](?:[0-9A-Fa-f']*[0-9A-Fa-f])?[pP][+-]?[0-9](?:[0-9']*[0-9])?(?:_[HhFfDdQq])?\\b"}, // hex versions
+        {"FLOATING_POINT", "\\b0x[0-9A-Fa-f](?:[0-9A-Fa-f']*[0-9A-Fa-f])?\\.[0-9A-Fa-f](?:[0-9A-Fa-f']*[0-9A-Fa-f])?(?:[pP][+-]?[0-9](?:[0-9']*[0-9])?)?(?:_[HhFfDdQq])?\\b"},
+        {"FLOATING_POINT", "\\b(?:0[ob])?[0-9](?:[0-9']*[0-9])?_?[HhFfDdQq]\\b"}, // before int, so for example 10f is not matched as one
+        {"INTEGER", "\\b(?:0[xob])?[0-9A-Fa-f](?:[0-9A-Fa-f']*[0-9A-Fa-f])?(?:_?[BbSsIiLlCc])?\\b"}, // leave this here so something like abc1 is matched as a variable
+        {"FLOATING_POINT", "\\b0x[0-9A-Fa-f](?:[0-9A-Fa-f']*[0-9A-Fa-f])?_[HhFfDdQq]\\b"}, // same as above, also int needs to be matched first (0xff)
+        {"FLOATING_POINT", "\\.[0-9](?:[0-9']*[0-9])?(?:[eE][+-]?[0-9](?:[0-9']*[0-9])?)?(?:_?[HhFfDdQq])?"}, // these may be after integer, since the dot distinguishes them immediately
+        {"FLOATING_POINT", "0x\\.[0-9A-Fa-f](?:[0-9A-Fa-f']*[0-9A-Fa-f])?(?:[pP][+-]?[0-9](?:[0-9']*[0-9])?)?(?:_[HhFfDdQq])?"},
+        {"DOT", "\\."} // needs to be matched after fp (.5)
+    };
+}
+
+#endif /* TOKEN_SPECS_H */
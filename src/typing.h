@@ -138,9 +138,6 @@ inline std::size_t hash_value(const BabelType& t) {
     return boost::hash_value(t.type); // variant hash
 }
 
-static std::unique_ptr<llvm::LLVMContext> TheContext;
-static std::unique_ptr<llvm::IRBuilder<>> Builder;
-
 class TypeArena {
     std::vector<std::unique_ptr<BabelType>> storage;
 
@@ -154,56 +151,54 @@ public:
     }
 };
 
-static TypeArena TheArena;
-
-llvm::Type *resolveLLVMType(BabelType type) {
+llvm::Type *resolveLLVMType(llvm::LLVMContext &Context, BabelType type) {
     using enum BasicType;
 
     if (type.isBasic()) {
         switch (type.getBasic()) {
             case Int:
             case Int32:
-                return llvm::Type::getInt32Ty(*TheContext);
+                return llvm::Type::getInt32Ty(Context);
             case Int8:
-                return llvm::Type::getInt8Ty(*TheContext);
+                return llvm::Type::getInt8Ty(Context);
             case Int16:
-                return llvm::Type::getInt16Ty(*TheContext);
+                return llvm::Type::getInt16Ty(Context);
             case Int64:
-                return llvm::Type::getInt64Ty(*TheContext);
+                return llvm::Type::getInt64Ty(Context);
             case Int128:
-                return llvm::Type::getInt128Ty(*TheContext);
+                return llvm::Type::getInt128Ty(Context);
 
             case Float:
             case Float32:
-                return llvm::Type::getFloatTy(*TheContext);
+                return llvm::Type::getFloatTy(Context);
             case Float16:
-                return llvm::Type::getHalfTy(*TheContext);
+                return llvm::Type::getHalfTy(Context);
             case Float64:
-                return llvm::Type::getDoubleTy(*TheContext);
+                return llvm::Type::getDoubleTy(Context);
             case Float128:
-                return llvm::Type::getFP128Ty(*TheContext);
+                return llvm::Type::getFP128Ty(Context);
 
             case Boolean:
-                return llvm::Type::getInt1Ty(*TheContext);
+                return llvm::Type::getInt1Ty(Context);
 
             case CString:
-                return llvm::PointerType::getUnqual(llvm::Type::getInt8Ty(*TheContext));
+                return llvm::PointerType::getUnqual(llvm::Type::getInt8Ty(Context));
             
             case Character:
-                return llvm::Type::getInt8Ty(*TheContext);
+                return llvm::Type::getInt8Ty(Context);
 
             case Void:
-                return llvm::Type::getVoidTy(*TheContext);
+                return llvm::Type::getVoidTy(Context);
 
             default:
                 babel_panic("Unknow type");
         }
     } else if (type.isArray()) {
-        return llvm::ArrayType::get(resolveLLVMType(*type.getArray().inner), type.getArray().size);
+        return llvm::ArrayType::get(resolveLLVMType(Context, *type.getArray().inner), type.getArray().size);
     }
 
     // return llvm::PointerType::getUnqual(resolveLLVMType(*type.getPointer().to));
-    return llvm::PointerType::getUnqual(*TheContext);
+    return llvm::PointerType::getUnqual(Context);
 }
 
 std::string getBabelTypeName(BabelType type) {
@@ -314,16 +309,16 @@ bool canImplicitCast(BabelType from, BabelType to) {
     return std::ranges::find(it->second, to) != it->second.end();
 }
 
-llvm::Value *performImplicitCast(llvm::Value *val, BabelType from, BabelType to) {
+llvm::Value *performImplicitCast(llvm::IRBuilder<> &Builder, llvm::Value *val, BabelType from, BabelType to) {
     if (from == to)
         return val;
 
     if (isBabelInteger(from) && isBabelInteger(to)) {
-        return Builder->CreateSExtOrBitCast(val, resolveLLVMType(to));
+        return Builder.CreateSExtOrBitCast(val, resolveLLVMType(Builder.getContext(), to));
     } else if (isBabelInteger(from) && isBabelFloat(to)) {
-        return Builder->CreateSIToFP(val, resolveLLVMType(to));
+        return Builder.CreateSIToFP(val, resolveLLVMType(Builder.getContext(), to));
     } else if (isBabelFloat(from) && isBabelFloat(to)) {
-        return Builder->CreateFPExt(val, resolveLLVMType(to));
+        return Builder.CreateFPExt(val, resolveLLVMType(Builder.getContext(), to));
     }
 
     babel_panic("Cannot perform illegal type cast");
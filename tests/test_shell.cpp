@@ -1,5 +1,15 @@
 #include <gtest/gtest.h>
+#include "compile_server.h"
+#include "emitter.h"
+#include "jit.h"
 #include "lrparser.h"
+#include "optimizer.h"
+#include "parallel_codegen.h"
+#include "parse_table.h"
+#include "thin_lto.h"
+#include "tiering.h"
+#include "time_report.h"
+#include "token_specs.h"
 
 TEST(GrammarTest, AxiomAndRules) {
     Grammar grammar("A' -> A\nA -> a A\nA -> a");
@@ -30,21 +40,62 @@ TEST(ParserTest, Parse) {
     LRClosureTable lrClosureTable(grammar);
     LRTable lrTable(lrClosureTable);
     Parser parser(lrTable);
+    CompilerContext Ctx("test");
 
     std::vector<Token> tokens1 = {Token("a", "a")};
     std::vector<Token> tokens2 = {Token("a", "a"), Token("a", "a")};
     std::vector<Token> tokens3 = {Token("a", "a"), Token("b", "b")};
 
-    auto result1 = parser.parse(tokens1);
-    auto result2 = parser.parse(tokens2);
-    auto result3 = parser.parse(tokens3);
+    auto result1 = parser.parse(tokens1, Ctx);
+    auto result2 = parser.parse(tokens2, Ctx);
+    auto result3 = parser.parse(tokens3, Ctx);
 
-    ASSERT_TRUE(std::holds_alternative<TreeNode>(result1));
-    ASSERT_TRUE(std::holds_alternative<TreeNode>(result2));
+    ASSERT_TRUE(std::holds_alternative<ParseTree>(result1));
+    ASSERT_TRUE(std::holds_alternative<ParseTree>(result2));
     ASSERT_TRUE(std::holds_alternative<std::string>(result3));
     ASSERT_EQ("SyntaxError: Expected 'a' or EOF but found 'b'", std::get<std::string>(result3));
 }
 
+TEST(ParserTest, ParseTree) {
+    Grammar grammar("A' -> A\nA -> a A\nA -> a");
+    LRClosureTable lrClosureTable(grammar);
+    LRTable lrTable(lrClosureTable);
+    Parser parser(lrTable);
+    CompilerContext Ctx("test");
+
+    std::vector<Token> tokens = {Token("a", "a"), Token("a", "a")};
+    auto result = parser.parse(tokens, Ctx);
+    ASSERT_TRUE(std::holds_alternative<ParseTree>(result));
+
+    const TreeNode* root = std::get<ParseTree>(result).root;
+    ASSERT_EQ("A'", root->name);
+    ASSERT_EQ(1, root->children.size());
+
+    const TreeNode* node = root->children.front();
+    ASSERT_EQ(parser.table.symbolId("A"), node->kind);
+    ASSERT_EQ(2, node->children.size());
+    ASSERT_EQ("a", node->children[0]->data.value());
+    ASSERT_EQ(1, node->children[1]->children.size());
+
+    auto withoutTree = parser.parse(tokens, Ctx, false);
+    ASSERT_TRUE(std::holds_alternative<ParseTree>(withoutTree));
+    ASSERT_EQ(nullptr, std::get<ParseTree>(withoutTree).root);
+}
+
+TEST(ParserTest, ReduceActions) {
+    Grammar grammar("program' -> program\nprogram -> sum\nsum -> sum + atom\nsum -> atom\natom -> x");
+    LRClosureTable lrClosureTable(grammar);
+    LRTable lrTable(lrClosureTable);
+    Parser parser(lrTable);
+
+    ASSERT_EQ(ReduceAction::Tree, parser.table.reduceAction(1));
+    ASSERT_EQ(ReduceAction::BinaryOperator, parser.table.reduceAction(2));
+    ASSERT_EQ(ReduceAction::BinaryOperator, parser.table.reduceAction(3));
+    ASSERT_EQ(ReduceAction::Atom, parser.table.reduceAction(4));
+    ASSERT_EQ(ReduceAction::Tree, reduceActionFor("program"));
+    ASSERT_TRUE(alwaysReduces(reduceActionFor("simple_stmt")));
+}
+
 TEST(GrammarTest, AnotherGrammar) {
     Grammar grammar1("A' -> A\nA -> B\nA -> ''\nB -> ( A )");
     ASSERT_EQ("A'", grammar1.axiom);
@@ -53,6 +104,21 @@ TEST(GrammarTest, AnotherGrammar) {
     ASSERT_EQ(a1, grammar1.firsts.at("A"));
 }
 
+TEST(GrammarTest, FollowsAndSequenceFirsts) {
+    Grammar grammar("S' -> S\nS -> A B c\nA -> a\nA -> ''\nB -> b\nB -> ''");
+    const std::list<std::string> followsA = {"c", "b"};
+    ASSERT_EQ(followsA, grammar.follows.at("A"));
+    ASSERT_TRUE(grammar.nullable[grammar.symbolId("B")]);
+    ASSERT_FALSE(grammar.nullable[grammar.symbolId("S")]);
+
+    // S -> A B c after the dot in front of A: firsts of B c
+    const std::list<std::string> firsts = {"c", "b"};
+    ASSERT_EQ(firsts, grammar.terminalNames(grammar.sequenceFirsts(1, 1)));
+    ASSERT_FALSE(grammar.sequenceNullable(1, 1));
+    ASSERT_TRUE(grammar.sequenceNullable(1, 3));
+    ASSERT_EQ(firsts, grammar.getSequenceFirsts({"B", "c"}));
+}
+
 TEST(LRClosureTableTest, AnotherClosureTable) {
     Grammar grammar1("A' -> A\nA -> B\nA -> ''\nB -> ( A )");
     LRClosureTable lrClosureTable1(grammar1);
@@ -72,26 +138,774 @@ TEST(LRTableTest, AnotherLRTable) {
     ASSERT_EQ("r3", lrTable1.states[9].mapping.at(")").toString());
 }
 
+TEST(LRTableTest, CanonicalLookAheads) {
+    // LR(1) but not LALR(1): merging the two states reached on 'e' would make E and F conflict
+    Grammar grammar("S' -> S\nS -> a E c\nS -> a F d\nS -> b F c\nS -> b E d\nE -> e\nF -> e");
+    LRClosureTable lrClosureTable(grammar);
+    LRTable lrTable(lrClosureTable);
+    ASSERT_EQ(14, lrTable.states.size());
+    ASSERT_EQ("r5", lrTable.states[6].mapping.at("c").toString());
+    ASSERT_EQ("r6", lrTable.states[6].mapping.at("d").toString());
+    ASSERT_EQ("r6", lrTable.states[9].mapping.at("c").toString());
+    ASSERT_EQ("r5", lrTable.states[9].mapping.at("d").toString());
+}
+
+TEST(LRTableTest, ReduceReduceConflict) {
+    // B -> '' is predicted first, but C -> '' is the earlier rule
+    Grammar grammar("A' -> A\nA -> B y\nA -> C y\nC -> ''\nB -> ''");
+    LRClosureTable lrClosureTable(grammar);
+    LRTable lrTable(lrClosureTable);
+    ASSERT_EQ("r3", lrTable.states[0].mapping.at("y").toString());
+}
+
 TEST(ParserTest, AnotherParse) {
     Grammar grammar1("A' -> A\nA -> B\nA -> ''\nB -> ( A )");
     LRClosureTable lrClosureTable1(grammar1);
     LRTable lrTable1(lrClosureTable1);
     Parser parser1(lrTable1);
+    CompilerContext Ctx("test");
 
     std::vector<Token> tokens1 = {Token("(", "("), Token(")", ")")};
     std::vector<Token> tokens2 = {Token("(", "("), Token("(", "("), Token(")", ")"), Token(")", ")")};
     std::vector<Token> tokens3 = {Token("(", "("), Token(")", ")"), Token("(", "("), Token(")", ")")};
 
-    auto result1 = parser1.parse(tokens1);
-    auto result2 = parser1.parse(tokens2);
-    auto result3 = parser1.parse(tokens3);
+    auto result1 = parser1.parse(tokens1, Ctx);
+    auto result2 = parser1.parse(tokens2, Ctx);
+    auto result3 = parser1.parse(tokens3, Ctx);
 
-    ASSERT_TRUE(std::holds_alternative<TreeNode>(result1));
-    ASSERT_TRUE(std::holds_alternative<TreeNode>(result2));
+    ASSERT_TRUE(std::holds_alternative<ParseTree>(result1));
+    ASSERT_TRUE(std::holds_alternative<ParseTree>(result2));
     ASSERT_TRUE(std::holds_alternative<std::string>(result3));
     ASSERT_EQ("SyntaxError: Expected EOF but found '('", std::get<std::string>(result3));
 }
 
+TEST(ParseTableTest, CacheRoundTrip) {
+    const std::string text = "A' -> A\nA -> B\nA -> ''\nB -> ( A )";
+    Grammar grammar(text);
+    LRClosureTable lrClosureTable(grammar);
+    LRTable lrTable(lrClosureTable);
+
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "babel_test_parser.dat";
+    {
+        std::ofstream out(path, std::ios::binary);
+        writeParseTable(out, ParseTable::lower(lrTable), hashGrammar(text));
+    }
+
+    ASSERT_FALSE(loadParseTable(path, hashGrammar(text + "\n")).has_value());
+    {
+        std::optional<ParseTable> table = loadParseTable(path, hashGrammar(text));
+        ASSERT_TRUE(table.has_value());
+        ASSERT_EQ(10, table->numStates);
+
+        Parser parser(std::move(table.value()));
+        CompilerContext Ctx("test");
+        std::vector<Token> tokens1 = {Token("(", "("), Token(")", ")")};
+        std::vector<Token> tokens2 = {Token("(", "("), Token(")", ")"), Token("(", "("), Token(")", ")")};
+
+        ASSERT_TRUE(std::holds_alternative<ParseTree>(parser.parse(tokens1, Ctx)));
+        ASSERT_EQ("SyntaxError: Expected EOF but found '('", std::get<std::string>(parser.parse(tokens2, Ctx)));
+    }
+
+    std::filesystem::remove(path);
+}
+
+TEST(LexerTest, TokenPriority) {
+    Lexer lexer("test", babelTokenSpecs());
+    std::vector<Token> tokens = lexer.tokenize("let int8 x := 0x1F + .5f\nif_ iff 10f \"a\\\"b\" 'c' a.b \\\\ rest\n");
+
+    std::vector<std::pair<std::string, std::string>> expected = {
+        {"LET", "let"}, {"TYPE", "int8"}, {"VAR", "x"}, {"COLON_EQUALS", ":="}, {"INTEGER", "0x1F"}, {"PLUS", "+"},
+        {"FLOATING_POINT", ".5f"}, {"NEWLINE", "\n"}, {"VAR", "if_"}, {"VAR", "iff"}, {"FLOATING_POINT", "10f"},
+        {"STRING", "\"a\\\"b\""}, {"CHAR", "'c'"}, {"VAR", "a"}, {"DOT", "."}, {"VAR", "b"}, {"COMMENT", "\\\\ rest"}, {"NEWLINE", "\n"}
+    };
+
+    ASSERT_EQ(expected.size(), tokens.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        ASSERT_EQ(expected[i].first, tokens[i].getType());
+        ASSERT_EQ(expected[i].second, tokens[i].getValue());
+    }
+
+    ASSERT_EQ(4, tokens[1].getOffset());
+    ASSERT_EQ(TokenKinds::intern("TYPE"), tokens[1].getKind());
+}
+
+TEST(LexerTest, StreamMatchesTokenize) {
+    Lexer lexer("test", babelTokenSpecs());
+    std::string source = "\n\\\\ header\nlet long_variable_name := 12345.678 \\\\ trailing\n\n\nx++\nfoo(\"a long string\")\n  .bar()\nreturn x";
+
+    std::vector<Token> expected = lexer.tokenize(source);
+    Lexer::handleComments(expected);
+    Lexer::insertSemicolons(expected);
+
+    // tiny chunks cut through every token and make the lexer read on to finish them
+    for (size_t chunkSize : {1, 3, 4096}) {
+        std::istringstream input(source);
+        TokenStream stream(lexer, input, chunkSize);
+        for (const Token& token : expected) {
+            const Token* streamed = stream.next();
+            ASSERT_NE(nullptr, streamed);
+            ASSERT_EQ(token.getKind(), streamed->getKind());
+            ASSERT_EQ(token.getValue(), streamed->getValue());
+            ASSERT_EQ(token.getOffset(), streamed->getOffset());
+        }
+        ASSERT_EQ(nullptr, stream.next());
+    }
+
+    // a source held whole is lexed in place
+    TokenStream inPlace(lexer, source);
+    ASSERT_TRUE(inPlace.viewsSource());
+    for (const Token& token : expected) {
+        const Token* streamed = inPlace.next();
+        ASSERT_NE(nullptr, streamed);
+        ASSERT_EQ(token.getValue(), streamed->getValue());
+        if (token.getValue() != ";") ASSERT_EQ(source.data() + token.getOffset(), streamed->getValue().data());
+    }
+    ASSERT_EQ(nullptr, inPlace.next());
+}
+
+#ifdef BABEL_EMBEDDED_PARSE_TABLE
+TEST(ParseTableTest, EmbeddedTableMatchesGrammar) {
+    std::ifstream in(BABEL_GRAMMAR_SOURCE);
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    ASSERT_EQ(babel_tables::grammarHash, hashGrammar(buffer.str()));
+
+    Grammar grammar(transform_string(buffer.str()));
+    LRClosureTable closureTable(grammar);
+    LRTable lrTable(closureTable);
+    ParseTable lowered = ParseTable::lower(lrTable);
+    ParseTable embedded = embeddedParseTable();
+
+    ASSERT_EQ(lowered.numStates, embedded.numStates);
+    ASSERT_EQ(lowered.numSymbols, embedded.numSymbols);
+    ASSERT_TRUE(std::ranges::equal(lowered.symbolNames, embedded.symbolNames));
+    ASSERT_TRUE(std::ranges::equal(lowered.ruleLength, embedded.ruleLength));
+    ASSERT_TRUE(std::ranges::equal(lowered.firsts, embedded.firsts));
+    ASSERT_TRUE(std::ranges::equal(lowered.stateBase, embedded.stateBase));
+    ASSERT_TRUE(std::ranges::equal(lowered.comb, embedded.comb));
+}
+#endif
+
+TEST(ArenaTest, DestroysObjectsWithTheArena) {
+    int destroyed = 0;
+    struct Counted {
+        int* counter;
+        std::string name;
+        ~Counted() { ++*counter; }
+    };
+
+    {
+        Arena arena(64);
+        Counted* first = arena.make<Counted>(&destroyed, "first");
+        Counted* second = arena.make<Counted>(&destroyed, std::string(100, 'x'));
+        ASSERT_EQ("first", first->name);
+        ASSERT_EQ(100, second->name.size());
+
+        std::deque<int> values = {1, 2, 3};
+        std::span<int> copied = arena.copy(values);
+        ASSERT_EQ(3, copied.size());
+        ASSERT_EQ(3, copied[2]);
+
+        Arena moved = std::move(arena);
+        ASSERT_EQ(0, destroyed);
+    }
+
+    ASSERT_EQ(2, destroyed);
+}
+
+TEST(ArenaTest, AlignsAfterOversizedCopy) {
+    Arena arena(64);
+
+    // the copy gets a chunk of its own and leaves its cursor unaligned, with less room left than padding
+    std::string text(65, 'x');
+    std::span<char> copied = arena.copy(text);
+    ASSERT_EQ(65, copied.size());
+
+    uint64_t* value = arena.make<uint64_t>(42);
+    ASSERT_EQ(0, reinterpret_cast<uintptr_t>(value) % alignof(uint64_t));
+    ASSERT_EQ(42, *value);
+    ASSERT_EQ(0, arena.capacity() % alignof(std::max_align_t));
+}
+
+TEST(OptimizerTest, PromotesAllocasAboveO0) {
+    ASSERT_EQ(OptLevel::O2, parseOptLevel("-O2"));
+    ASSERT_EQ(OptLevel::Os, parseOptLevel("-Os"));
+    ASSERT_FALSE(parseOptLevel("-O4").has_value());
+
+    auto countAllocas = [](const llvm::Module& module) {
+        size_t allocas = 0;
+        for (const llvm::Function& function : module)
+            for (const llvm::BasicBlock& block : function)
+                for (const llvm::Instruction& instruction : block)
+                    allocas += llvm::isa<llvm::AllocaInst>(instruction);
+        return allocas;
+    };
+
+    for (OptLevel level : {OptLevel::O0, OptLevel::O1}) {
+        llvm::LLVMContext context;
+        llvm::Module module("test", context);
+        llvm::IRBuilder<> builder(context);
+
+        llvm::Type* int32 = builder.getInt32Ty();
+        llvm::Function* function = llvm::Function::Create(llvm::FunctionType::get(int32, {int32}, false), llvm::Function::ExternalLinkage, "identity", module);
+        builder.SetInsertPoint(llvm::BasicBlock::Create(context, "entry", function));
+        llvm::AllocaInst* slot = builder.CreateAlloca(int32);
+        builder.CreateStore(function->getArg(0), slot);
+        builder.CreateRet(builder.CreateLoad(int32, slot));
+
+        optimizeModule(module, level);
+        ASSERT_EQ(level == OptLevel::O0 ? 1 : 0, countAllocas(module));
+    }
+}
+
+TEST(EmitterTest, WritesObjectForHostTarget) {
+    ASSERT_EQ(EmitKind::LLVMBitcode, parseEmitKind("llvm-bc"));
+    ASSERT_FALSE(parseEmitKind("wasm").has_value());
+    ASSERT_EQ(std::filesystem::path("fib.o"), defaultOutputPath("examples/fib.babel", EmitKind::Object));
+    ASSERT_EQ(std::filesystem::path("fib"), defaultOutputPath("examples/fib.babel", EmitKind::Executable));
+
+    std::unique_ptr<llvm::TargetMachine> machine = createHostTargetMachine(OptLevel::O2);
+    ASSERT_NE(nullptr, machine);
+
+    llvm::LLVMContext context;
+    llvm::Module module("test", context);
+    prepareModule(module, *machine);
+    ASSERT_EQ(machine->getTargetTriple().str(), module.getTargetTriple());
+
+    llvm::IRBuilder<> builder(context);
+    llvm::Function* function = llvm::Function::Create(llvm::FunctionType::get(builder.getInt32Ty(), false), llvm::Function::ExternalLinkage, "answer", module);
+    builder.SetInsertPoint(llvm::BasicBlock::Create(context, "entry", function));
+    builder.CreateRet(builder.getInt32(42));
+
+    std::filesystem::path object = std::filesystem::temp_directory_path() / "babel_emitter_test.o";
+    ASSERT_TRUE(emitModule(module, *machine, EmitKind::Object, object));
+    ASSERT_GT(std::filesystem::file_size(object), 0u);
+    std::filesystem::remove(object);
+}
+
+#ifndef _WIN32
+TEST(CompileServerTest, RunsRequestsInClientDirectory) {
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "babel_server_test";
+    std::filesystem::create_directories(directory);
+    std::string socket = (directory / "socket").string();
+
+    pid_t server = fork();
+    if (server == 0) {
+        std::_Exit(serveCompiles(socket, [](const std::vector<std::string>& args) {
+            std::ofstream out("request.txt");
+            for (const std::string& arg : args) out << arg << ";";
+            return args.size() == 2 ? 7 : 1;
+        }));
+    }
+    ASSERT_GT(server, 0);
+
+    for (int i = 0; i < 100 && !std::filesystem::is_socket(socket); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+
+    std::filesystem::path previous = std::filesystem::current_path();
+    std::filesystem::current_path(directory);
+    std::optional<int> status = compileOnServer(socket, {"-c", "unit.babel"});
+    std::filesystem::current_path(previous);
+
+    kill(server, SIGTERM);
+    waitpid(server, nullptr, 0);
+
+    ASSERT_EQ(7, status);
+    std::ifstream request(directory / "request.txt");
+    std::string received((std::istreambuf_iterator<char>(request)), std::istreambuf_iterator<char>());
+    ASSERT_EQ("-c;unit.babel;", received);
+    ASSERT_FALSE(compileOnServer(socket, {}).has_value());
+    std::filesystem::remove_all(directory);
+}
+
+TEST(CompileServerTest, KeepsItsSocketPrivateAndInUse) {
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "babel_server_socket_test";
+    std::filesystem::create_directories(directory);
+    std::string socket = (directory / "socket").string();
+
+    pid_t server = fork();
+    if (server == 0) {
+        std::_Exit(serveCompiles(socket, [](const std::vector<std::string>&) { return 7; }));
+    }
+    ASSERT_GT(server, 0);
+
+    for (int i = 0; i < 100 && !std::filesystem::is_socket(socket); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+
+    // a second server must neither take over nor remove the socket of a running one
+    std::filesystem::perms permissions = std::filesystem::status(socket).permissions();
+    int second = serveCompiles(socket, [](const std::vector<std::string>&) { return 1; });
+    std::optional<int> status = compileOnServer(socket, {});
+
+    kill(server, SIGTERM);
+    waitpid(server, nullptr, 0);
+
+    ASSERT_EQ(std::filesystem::perms::owner_read | std::filesystem::perms::owner_write, permissions);
+    ASSERT_EQ(1, second);
+    ASSERT_EQ(7, status);
+
+    // the socket a killed server left behind is replaced
+    pid_t restarted = fork();
+    if (restarted == 0) {
+        std::_Exit(serveCompiles(socket, [](const std::vector<std::string>&) { return 8; }));
+    }
+    ASSERT_GT(restarted, 0);
+
+    status = std::nullopt;
+    for (int i = 0; i < 100 && !status; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        status = compileOnServer(socket, {});
+    }
+
+    kill(restarted, SIGTERM);
+    waitpid(restarted, nullptr, 0);
+    ASSERT_EQ(8, status);
+    std::filesystem::remove_all(directory);
+}
+#endif
+
+TEST(JITTest, LinksModulesAgainstEarlierOnes) {
+    std::unique_ptr<BabelJIT> jit = BabelJIT::create(OptLevel::O1);
+    ASSERT_NE(nullptr, jit);
+
+    auto context = std::make_unique<llvm::LLVMContext>();
+    auto module = std::make_unique<llvm::Module>("first", *context);
+    jit->prepareModule(*module);
+    llvm::IRBuilder<> builder(*context);
+    llvm::Function* answer = llvm::Function::Create(llvm::FunctionType::get(builder.getInt32Ty(), false), llvm::Function::ExternalLinkage, "answer", *module);
+    builder.SetInsertPoint(llvm::BasicBlock::Create(*context, "entry", answer));
+    builder.CreateRet(builder.getInt32(41));
+    ASSERT_TRUE(jit->addModule(std::move(module), std::move(context)));
+
+    // the second module only declares answer, like a REPL line calling a task of an earlier one
+    context = std::make_unique<llvm::LLVMContext>();
+    module = std::make_unique<llvm::Module>("second", *context);
+    jit->prepareModule(*module);
+    llvm::IRBuilder<> second(*context);
+    llvm::FunctionType* type = llvm::FunctionType::get(second.getInt32Ty(), false);
+    llvm::Function* declared = llvm::Function::Create(type, llvm::Function::ExternalLinkage, "answer", *module);
+    llvm::Function* entry = llvm::Function::Create(type, llvm::Function::ExternalLinkage, "__global_main.1", *module);
+    second.SetInsertPoint(llvm::BasicBlock::Create(*context, "entry", entry));
+    second.CreateRet(second.CreateAdd(second.CreateCall(declared), second.getInt32(1)));
+    ASSERT_TRUE(jit->addModule(std::move(module), std::move(context)));
+
+    ASSERT_EQ(42, jit->run("__global_main.1"));
+    ASSERT_FALSE(jit->run("missing").has_value());
+}
+
+TEST(JITTest, OptimizesForTheHostTarget) {
+    std::unique_ptr<BabelJIT> jit = BabelJIT::create(OptLevel::O2);
+    ASSERT_NE(nullptr, jit);
+
+    // the IR as the JIT compiles it, after the passes ran
+    std::string optimized;
+    jit->getLLJIT().getIRTransformLayer().setTransform([&](llvm::orc::ThreadSafeModule module, const llvm::orc::MaterializationResponsibility&) {
+        module.withModuleDo([&](llvm::Module& compiled) {
+            llvm::raw_string_ostream out(optimized);
+            compiled.print(out, nullptr);
+        });
+        return llvm::Expected<llvm::orc::ThreadSafeModule>(std::move(module));
+    });
+
+    // i32 vj_sum(i32* values, i32 count), a loop the vectorizer only widens with the costs of a real target
+    auto context = std::make_unique<llvm::LLVMContext>();
+    auto module = std::make_unique<llvm::Module>("vectorize", *context);
+    jit->prepareModule(*module);
+    llvm::IRBuilder<> builder(*context);
+    llvm::Type* i32 = builder.getInt32Ty();
+    llvm::FunctionType* type = llvm::FunctionType::get(i32, {llvm::PointerType::getUnqual(i32), i32}, false);
+    llvm::Function* sum = llvm::Function::Create(type, llvm::Function::ExternalLinkage, "vj_sum", *module);
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(*context, "entry", sum);
+    llvm::BasicBlock* loop = llvm::BasicBlock::Create(*context, "loop", sum);
+    llvm::BasicBlock* exit = llvm::BasicBlock::Create(*context, "exit", sum);
+
+    builder.SetInsertPoint(entry);
+    builder.CreateCondBr(builder.CreateICmpSGT(sum->getArg(1), builder.getInt32(0)), loop, exit);
+
+    builder.SetInsertPoint(loop);
+    llvm::PHINode* index = builder.CreatePHI(i32, 2);
+    llvm::PHINode* total = builder.CreatePHI(i32, 2);
+    llvm::Value* value = builder.CreateLoad(i32, builder.CreateInBoundsGEP(i32, sum->getArg(0), index));
+    llvm::Value* nextTotal = builder.CreateAdd(total, value);
+    llvm::Value* nextIndex = builder.CreateNSWAdd(index, builder.getInt32(1));
+    index->addIncoming(builder.getInt32(0), entry);
+    index->addIncoming(nextIndex, loop);
+    total->addIncoming(builder.getInt32(0), entry);
+    total->addIncoming(nextTotal, loop);
+    builder.CreateCondBr(builder.CreateICmpSLT(nextIndex, sum->getArg(1)), loop, exit);
+
+    builder.SetInsertPoint(exit);
+    llvm::PHINode* result = builder.CreatePHI(i32, 2);
+    result->addIncoming(builder.getInt32(0), entry);
+    result->addIncoming(nextTotal, loop);
+    builder.CreateRet(result);
+
+    ASSERT_TRUE(jit->addModule(std::move(module), std::move(context)));
+    auto address = jit->getLLJIT().lookup("vj_sum");
+    ASSERT_TRUE(static_cast<bool>(address));
+
+    int32_t values[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17};
+    using Sum = int32_t (*)(int32_t*, int32_t);
+    ASSERT_EQ(153, address->toPtr<Sum>()(values, 17));
+    ASSERT_NE(std::string::npos, optimized.find(" x i32>"));
+}
+
+TEST(JITTest, TiersUpHotTasks) {
+    std::unique_ptr<BabelJIT> jit = BabelJIT::create(OptLevel::O0);
+    ASSERT_NE(nullptr, jit);
+    TieredExecution tiers(*jit, OptLevel::O2, 3);
+
+    auto context = std::make_unique<llvm::LLVMContext>();
+    auto module = std::make_unique<llvm::Module>("tiered", *context);
+    jit->prepareModule(*module);
+    llvm::IRBuilder<> builder(*context);
+    llvm::Function* probe = llvm::Function::Create(llvm::FunctionType::get(builder.getInt32Ty(), false), llvm::Function::ExternalLinkage, "probe", *module);
+    builder.SetInsertPoint(llvm::BasicBlock::Create(*context, "entry", probe));
+    llvm::AllocaInst* slot = builder.CreateAlloca(builder.getInt32Ty());
+    builder.CreateStore(builder.getInt32(7), slot);
+    builder.CreateRet(builder.CreateLoad(builder.getInt32Ty(), slot));
+    ASSERT_TRUE(tiers.addModule(std::move(module), std::move(context)));
+
+    for (int i = 0; i < 5; i++) ASSERT_EQ(7, jit->run("probe"));
+    tiers.drain();
+
+    ASSERT_EQ(1u, tiers.optimizedTasks());
+    ASSERT_EQ(7, jit->run("probe"));
+}
+
+TEST(TimeReportTest, NestsAndMergesPhases) {
+    TimeReport::instance().enable();
+    for (int i = 0; i < 2; i++) {
+        PhaseTimer outer("report_outer");
+        PhaseTimer inner("report_inner", "detail");
+        PhaseAccumulator pieces("report_pieces");
+        for (int j = 0; j < 3; j++) PhaseAccumulator::Piece piece(pieces);
+    }
+
+    std::string report;
+    llvm::raw_string_ostream out(report);
+    TimeReport::instance().print(out);
+    out.flush();
+
+    ASSERT_NE(std::string::npos, report.find("  report_outer (2x)\n"));
+    ASSERT_NE(std::string::npos, report.find("    report_inner (2x)\n"));
+    ASSERT_NE(std::string::npos, report.find("-      report_pieces (2x)\n"));
+}
+
+TEST(TimeReportTest, KeepsThePhasesOfEachThreadApart) {
+    // like parsing on the workers of a concurrent compile while the driver is inside a phase
+    TimeReport::instance().enable();
+    auto work = [] {
+        for (int i = 0; i < 500; i++) {
+            PhaseTimer phase("report_worker");
+            PhaseAccumulator pieces("report_worker_pieces");
+            PhaseAccumulator::Piece piece(pieces);
+        }
+    };
+
+    {
+        PhaseTimer driver("report_driver");
+        std::thread first(work);
+        std::thread second(work);
+        first.join();
+        second.join();
+    }
+
+    std::string report;
+    llvm::raw_string_ostream out(report);
+    TimeReport::instance().print(out);
+    out.flush();
+
+    ASSERT_NE(std::string::npos, report.find("  report_driver\n"));
+    ASSERT_NE(std::string::npos, report.find("  report_worker (1000x)\n"));
+    ASSERT_NE(std::string::npos, report.find("-    report_worker_pieces (1000x)\n"));
+}
+
+// The parser of src/grammar.txt, which is only built once for all tests
+static const Parser& babelParser() {
+    static const Parser parser = [] {
+        std::ifstream in(BABEL_GRAMMAR_SOURCE);
+        std::stringstream buffer;
+        buffer << in.rdbuf();
+
+        Grammar grammar(transform_string(buffer.str()));
+        LRClosureTable closureTable(grammar);
+        return Parser(LRTable(closureTable));
+    }();
+    return parser;
+}
+
+static std::variant<ParseTree, std::string> parseBabel(CompilerContext& Ctx, std::string_view source) {
+    static const Lexer lexer("test", babelTokenSpecs());
+    std::vector<Token> tokens = lexer.tokenize(source);
+    Lexer::handleComments(tokens);
+    Lexer::insertSemicolons(tokens);
+    return babelParser().parse(tokens, Ctx, false);
+}
+
+TEST(StreamedParseTest, CopiesOnlyIdentifiersAndLiterals) {
+    Lexer lexer("test", babelTokenSpecs());
+    CompilerContext Ctx("streamed");
+    std::istringstream input("let sp_first = 1 + 2\nlet sp_second = sp_first + 3\n");
+    TokenStream stream(lexer, input, 4);
+    std::variant<ParseTree, std::string> tree = babelParser().parse(stream, Ctx);
+    ASSERT_TRUE(std::holds_alternative<ParseTree>(tree));
+
+    std::map<std::string, std::vector<const char*>> texts;
+    std::vector<const TreeNode*> pending = {std::get<ParseTree>(tree).root};
+    while (!pending.empty()) {
+        const TreeNode* node = pending.back();
+        pending.pop_back();
+        if (node->data) texts[std::string(node->name)].push_back(node->data->data());
+        pending.insert(pending.end(), node->children.begin(), node->children.end());
+    }
+
+    // every token had its text in the read buffer, a keyword or an operator is only copied out of it once
+    ASSERT_EQ(2u, texts["LET"].size());
+    ASSERT_EQ(texts["LET"][0], texts["LET"][1]);
+    ASSERT_EQ(2u, texts["PLUS"].size());
+    ASSERT_EQ(texts["PLUS"][0], texts["PLUS"][1]);
+    ASSERT_EQ(3u, texts["VAR"].size());
+    ASSERT_EQ(3u, std::unordered_set<const char*>(texts["VAR"].begin(), texts["VAR"].end()).size());
+}
+
+TEST(ParallelCodegenTest, LinksTasksGeneratedOnWorkers) {
+    CompilerContext Ctx("parallel");
+    std::variant<ParseTree, std::string> tree = parseBabel(Ctx,
+        "let offset: int = 2\n"
+        "task pc_add(a: int, b: int) => int do\n    return a + b\nend\n"
+        "task pc_twice(a: int) => int do\n    return pc_add(a, a) + offset\nend\n"
+        "task pc_answer() => int do\n    return pc_twice(20)\nend\n"
+        "pc_answer()\n");
+    ASSERT_TRUE(std::holds_alternative<ParseTree>(tree));
+
+    std::unique_ptr<BabelJIT> jit = BabelJIT::create(OptLevel::O2);
+    ASSERT_NE(nullptr, jit);
+    jit->prepareModule(*Ctx.Module);
+
+    ASSERT_TRUE(codegenParallel(Ctx, *std::get<ParseTree>(tree).ast, 2, OptLevel::O2));
+    ASSERT_FALSE(llvm::verifyModule(*Ctx.Module, &llvm::errs()));
+    for (const char* task : {"pc_add", "pc_twice", "pc_answer"}) {
+        ASSERT_FALSE(Ctx.Module->getFunction(task)->isDeclaration());
+    }
+
+    // the offset global is defined by the top level code and read by a task from another module
+    ASSERT_TRUE(jit->addModule(std::move(Ctx.Module), std::move(Ctx.Context)));
+    ASSERT_EQ(42, jit->run("pc_answer"));
+}
+
+TEST(CompilerContextTest, CompilesUnitsConcurrently) {
+    // the same task name in both units, each only sees its own declaration
+    auto compile = [&](const std::string& type, std::string& ir) {
+        CompilerContext Ctx(type);
+        std::string source = "task cc_value(a: " + type + ") => " + type + " do\n    return a + a\nend\ncc_value(1)\n";
+        std::variant<ParseTree, std::string> tree = parseBabel(Ctx, source);
+        if (!std::holds_alternative<ParseTree>(tree)) return;
+
+        std::get<ParseTree>(tree).ast->codegen(Ctx);
+        if (llvm::verifyModule(*Ctx.Module)) return;
+        llvm::raw_string_ostream out(ir);
+        Ctx.Module->getFunction("cc_value")->getFunctionType()->print(out);
+    };
+
+    std::string int32, int64;
+    std::thread first(compile, "int32", std::ref(int32));
+    std::thread second(compile, "int64", std::ref(int64));
+    first.join();
+    second.join();
+
+    ASSERT_EQ("i32 (i32)", int32);
+    ASSERT_EQ("i64 (i64)", int64);
+}
+
+TEST(TaskCacheTest, OnlyRecompilesChangedTasks) {
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "babel_task_cache_test";
+    std::filesystem::remove_all(directory);
+
+    auto compile = [&](const std::string& answer, TaskCache& cache) {
+        CompilerContext Ctx("cached");
+        std::string source =
+            "task tc_add(a: int, b: int) => int do\n    return a + b\nend\n"
+            "task tc_answer() => int do\n    return tc_add(" + answer + ", 2)\nend\n"
+            "tc_answer()\n";
+        std::variant<ParseTree, std::string> tree = parseBabel(Ctx, source);
+        return std::holds_alternative<ParseTree>(tree) && codegenParallel(Ctx, *std::get<ParseTree>(tree).ast, 1, OptLevel::O2, false, &cache)
+            && !llvm::verifyModule(*Ctx.Module, &llvm::errs()) && !Ctx.Module->getFunction("tc_answer")->isDeclaration();
+    };
+
+    TaskCache cold(directory);
+    ASSERT_TRUE(compile("40", cold));
+    ASSERT_EQ(0u, cold.hitCount());
+    ASSERT_EQ(2u, cold.missCount());
+
+    // only the edited task misses
+    TaskCache warm(directory);
+    ASSERT_TRUE(compile("40", warm));
+    ASSERT_TRUE(compile("41", warm));
+    ASSERT_EQ(3u, warm.hitCount());
+    ASSERT_EQ(1u, warm.missCount());
+
+    TaskCache empty(directory, 0);
+    empty.trim();
+    ASSERT_TRUE(std::filesystem::is_empty(directory));
+    std::filesystem::remove_all(directory);
+}
+
+TEST(ThinLTOTest, InlinesTasksAcrossFiles) {
+    std::unique_ptr<llvm::TargetMachine> machine = createHostTargetMachine(OptLevel::O2);
+    ASSERT_NE(nullptr, machine);
+
+    // the second file calls a task of the first, like the driver compiles `babel lib.babel app.babel`
+    CompilerContext Ctx("lto");
+    std::vector<ThinLTOUnit> units;
+    std::vector<std::string> sources = {"task lto_twice(a: int) => int do\n    return a + a\nend\n", "task lto_answer() => int do\n    return lto_twice(21)\nend\n"};
+    for (size_t i = 0; i < sources.size(); i++) {
+        std::string name = std::format("lto_{}.babel", i);
+        Ctx.openModule(name);
+        prepareModule(*Ctx.Module, *machine);
+        redeclareEarlierDefinitions(Ctx);
+
+        std::variant<ParseTree, std::string> tree = parseBabel(Ctx, sources[i]);
+        ASSERT_TRUE(std::holds_alternative<ParseTree>(tree));
+        if (i + 1 == sources.size()) {
+            std::get<ParseTree>(tree).ast->codegen(Ctx, {"__global_main.0"});
+        } else {
+            std::get<ParseTree>(tree).ast->codegenEntry(Ctx, "__global_main.0");
+        }
+
+        ASSERT_FALSE(llvm::verifyModule(*Ctx.Module, &llvm::errs()));
+        optimizeModule(*Ctx.Module, OptLevel::O2, machine.get(), false, true);
+        units.push_back(writeThinLTOUnit(name, *Ctx.Module));
+    }
+
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "babel_lto_test";
+    std::filesystem::create_directories(directory);
+    std::filesystem::path previous = std::filesystem::current_path();
+    std::filesystem::current_path(directory);
+    bool linked = linkThinLTO(units, OptLevel::O2, 2, EmitKind::LLVMIR, "lto");
+    std::filesystem::current_path(previous);
+    ASSERT_TRUE(linked);
+
+    std::ifstream in(directory / "lto_1.ll");
+    std::string ir((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    ASSERT_NE(std::string::npos, ir.find("ret i32 42"));
+    ASSERT_EQ(std::string::npos, ir.find("call i32 @lto_twice"));
+    std::filesystem::remove_all(directory);
+}
+
+TEST(ForInLoopTest, AssignsFromAndToTheLoopVariable) {
+    // the loop variable is only declared during codegen, assignments must not need its type before that
+    CompilerContext Ctx("forin");
+    std::variant<ParseTree, std::string> tree = parseBabel(Ctx,
+        "task fi_sum() => int do\n"
+        "    let values = new Array(3, 1, 4)\n"
+        "    let total = 0\n"
+        "    for value in values do\n"
+        "        total = total + value\n"
+        "        total += value\n"
+        "        value = value + 1\n"
+        "    end\n"
+        "    return total\n"
+        "end\n");
+    ASSERT_TRUE(std::holds_alternative<ParseTree>(tree));
+
+    std::get<ParseTree>(tree).ast->codegen(Ctx);
+    ASSERT_FALSE(Ctx.Module->getFunction("fi_sum")->isDeclaration());
+}
+
+TEST(VariableTest, OnlyComptimeGlobalsAreComptime) {
+    CompilerContext Ctx("comptime");
+    ASSERT_TRUE(std::holds_alternative<ParseTree>(parseBabel(Ctx, "let vt_global = 2\n")));
+
+    ASSERT_TRUE(VariableAST(Ctx, "vt_global", std::nullopt, false, false, false).isComptimeAssignable(Ctx));
+    ASSERT_FALSE(VariableAST(Ctx, "vt_local", std::nullopt, false, false, false).isComptimeAssignable(Ctx));
+}
+
+TEST(AddressOfTest, PointsIntoArrays) {
+    CompilerContext Ctx("address");
+    std::variant<ParseTree, std::string> tree = parseBabel(Ctx,
+        "task ao_second() => int do\n"
+        "    let values = new Array(3, 1, 4)\n"
+        "    let cursor = &(values[0])\n"
+        "    cursor = cursor + 1\n"
+        "    return (cursor*)\n"
+        "end\n");
+    ASSERT_TRUE(std::holds_alternative<ParseTree>(tree)) << std::get<std::string>(tree);
+
+    std::get<ParseTree>(tree).ast->codegen(Ctx);
+    ASSERT_FALSE(Ctx.Module->getFunction("ao_second")->isDeclaration());
+}
+
+TEST(IntegerPowerTest, SquaresAndFoldsConstants) {
+    CompilerContext Ctx("power");
+    std::variant<ParseTree, std::string> tree = parseBabel(Ctx,
+        "let ip_folded = 3 ** 4\n"
+        "task ip_power(a: int, b: int) => int do\n    return a ** b\nend\n"
+        "task ip_large() => int do\n    return ip_power(3, 13)\nend\n"
+        "task ip_negative_base() => int do\n    return ip_power(0 - 2, 5)\nend\n"
+        "task ip_zero() => int do\n    return ip_power(7, 0)\nend\n"
+        "task ip_inverse() => int do\n    return ip_power(2, 0 - 1) + ip_power(0 - 1, 0 - 3)\nend\n"
+        "ip_large()\n");
+    ASSERT_TRUE(std::holds_alternative<ParseTree>(tree));
+
+    std::get<ParseTree>(tree).ast->codegen(Ctx);
+    ASSERT_FALSE(llvm::verifyModule(*Ctx.Module, &llvm::errs()));
+
+    // constant operands never reach the helper, which stays an integer loop
+    auto* folded = llvm::dyn_cast<llvm::ConstantInt>(Ctx.Module->getGlobalVariable("ip_folded")->getInitializer());
+    ASSERT_NE(nullptr, folded);
+    ASSERT_EQ(81, folded->getSExtValue());
+    llvm::Function* ipow = Ctx.Module->getFunction("babel.ipow.i32");
+    ASSERT_NE(nullptr, ipow);
+    ASSERT_TRUE(ipow->getReturnType()->isIntegerTy(32));
+    for (const llvm::BasicBlock& block : *ipow) {
+        for (const llvm::Instruction& instruction : block) ASSERT_FALSE(llvm::isa<llvm::CallInst>(instruction));
+    }
+
+    std::unique_ptr<BabelJIT> jit = BabelJIT::create(OptLevel::O1);
+    ASSERT_NE(nullptr, jit);
+    jit->prepareModule(*Ctx.Module);
+    ASSERT_TRUE(jit->addModule(std::move(Ctx.Module), std::move(Ctx.Context)));
+    ASSERT_EQ(1594323, jit->run("ip_large"));
+    ASSERT_EQ(-32, jit->run("ip_negative_base"));
+    ASSERT_EQ(1, jit->run("ip_zero"));
+    ASSERT_EQ(-1, jit->run("ip_inverse"));
+}
+
+TEST(IntegerPowerTest, DereferencesTwiceAfterAnOperand) {
+    // ** lexes as one token, right after an operand it still dereferences twice like two * would
+    CompilerContext Ctx("dereference");
+    std::variant<ParseTree, std::string> tree = parseBabel(Ctx,
+        "task dd_read() => int do\n"
+        "    let value = 41\n"
+        "    let pointer = &value\n"
+        "    let outer = &pointer\n"
+        "    return (outer**)\n"
+        "end\n"
+        "task dd_next() => int do\n"
+        "    let value = 41\n"
+        "    let pointer = &value\n"
+        "    let outer = &pointer\n"
+        "    return outer** + 1\n"
+        "end\n");
+    ASSERT_TRUE(std::holds_alternative<ParseTree>(tree));
+
+    std::get<ParseTree>(tree).ast->codegen(Ctx);
+    ASSERT_FALSE(Ctx.Module->getFunction("dd_read")->isDeclaration());
+    ASSERT_EQ(nullptr, Ctx.Module->getFunction("babel.ipow.i32"));
+
+    // outer** + 1 adds to the value instead of raising outer to the power of +1
+    llvm::Function* next = Ctx.Module->getFunction("dd_next");
+    ASSERT_FALSE(next->isDeclaration());
+    bool adds = false;
+    for (const llvm::BasicBlock& block : *next) {
+        for (const llvm::Instruction& instruction : block) adds |= instruction.getOpcode() == llvm::Instruction::Add;
+    }
+    ASSERT_TRUE(adds);
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();